@@ -0,0 +1,452 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Benchmarks of the integrator and trajectory hot paths.
+ *
+ * The benchmarks use a chain of dim sites with nearest neighbour hopping and
+ * loss from every site.  The loss is split into NUM_CHANNELS decay channels
+ * acting on interleaved sets of sites.  Each benchmark is repeated with
+ * growing iteration counts until it runs for at least the minimum time, and
+ * rates are reported per second of wall clock time.
+ *
+ * Usage: oqs_bench [--filter=substring] [--min-time=seconds]
+ *                  [--max-dim=n] [--json=file]
+ *
+ * The JSON output follows the layout of Google Benchmark's JSON reporter so
+ * that the usual comparison tools can be used to track regressions. */
+#define _POSIX_C_SOURCE 199309L
+#include <Oqs.h>
+#include <Integrator.h>
+#include <DecayTime.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define NUM_CHANNELS 8
+#define MAX_RESULTS 256
+
+/* Model */
+
+struct Chain {
+	size_t dim;
+	double hopping;
+	double gamma;
+	long numRhsCalls;
+};
+
+/* y = -i H_eff x with H_eff = -J sum_i (|i><i+1| + h.c.) - i gamma / 2 */
+static void chainRHS(double t, const struct OqsAmplitude *x,
+		     struct OqsAmplitude *y, void *ctx)
+{
+	struct Chain *chain = (struct Chain *)ctx;
+	size_t n = chain->dim;
+	double J = chain->hopping;
+	double g = 0.5 * chain->gamma;
+	double re, im;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		re = 0;
+		im = 0;
+		if (i > 0) {
+			re += x[i - 1].re;
+			im += x[i - 1].im;
+		}
+		if (i + 1 < n) {
+			re += x[i + 1].re;
+			im += x[i + 1].im;
+		}
+		y[i].re = -J * im - g * x[i].re;
+		y[i].im = J * re - g * x[i].im;
+	}
+	++chain->numRhsCalls;
+}
+
+struct Channel {
+	struct Chain *chain;
+	size_t offset;
+};
+
+/* Loss from the sites i = offset mod NUM_CHANNELS */
+static void channelDecay(const struct OqsAmplitude *x, struct OqsAmplitude *y,
+			 void *ctx)
+{
+	struct Channel *channel = (struct Channel *)ctx;
+	double s = sqrt(channel->chain->gamma);
+	size_t i;
+	memset(y, 0, channel->chain->dim * sizeof(*y));
+	for (i = channel->offset; i < channel->chain->dim; i += NUM_CHANNELS) {
+		y[i].re = s * x[i].re;
+		y[i].im = s * x[i].im;
+	}
+}
+
+/* A normalized wave packet spread over the whole chain */
+static void initialState(struct OqsAmplitude *x, size_t dim)
+{
+	double nrm = 0;
+	size_t i;
+	for (i = 0; i < dim; ++i) {
+		x[i].re = cos(0.3 * i);
+		x[i].im = sin(0.7 * i);
+		nrm += x[i].re * x[i].re + x[i].im * x[i].im;
+	}
+	nrm = 1.0 / sqrt(nrm);
+	for (i = 0; i < dim; ++i) {
+		x[i].re *= nrm;
+		x[i].im *= nrm;
+	}
+}
+
+/* Harness */
+
+struct Counters {
+	double rhsCalls;
+	double steps;
+	double trajectories;
+	double calls;
+};
+
+struct BenchCase {
+	const char *name;
+	void *(*setup)(size_t dim);
+	/* Runs n iterations and accumulates the work done in counters */
+	void (*run)(void *fixture, long n, struct Counters *counters);
+	void (*teardown)(void *fixture);
+};
+
+struct Result {
+	char name[64];
+	long iterations;
+	double seconds;
+	struct Counters counters;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+/* Fixtures */
+
+struct Fixture {
+	struct Chain chain;
+	struct Channel channels[NUM_CHANNELS];
+	struct OqsDecayOperator decayOps[NUM_CHANNELS];
+	struct OqsSchrodingerEqn eqn;
+	struct Integrator integrator;
+	OqsJumpTrajectory trajectory;
+	/* x1 is the state at the end of the step taken by decayTimeSetup */
+	struct OqsAmplitude *x0, *x, *x1;
+	double tRight, z;
+};
+
+static void fixtureTeardown(void *fixture);
+
+/* Returns null if the fixture can't be allocated. */
+static void *fixtureSetup(size_t dim)
+{
+	struct Fixture *f = malloc(sizeof(*f));
+	int i;
+	if (f == 0) return 0;
+	f->chain.dim = dim;
+	f->chain.hopping = 1.0;
+	f->chain.gamma = 2.0;
+	f->chain.numRhsCalls = 0;
+	for (i = 0; i < NUM_CHANNELS; ++i) {
+		f->channels[i].chain = &f->chain;
+		f->channels[i].offset = i;
+		f->decayOps[i].apply = &channelDecay;
+		f->decayOps[i].ctx = f->channels + i;
+	}
+	f->eqn.RHS = &chainRHS;
+	f->eqn.ctx = &f->chain;
+	f->x0 = malloc(dim * sizeof(*f->x0));
+	f->x = malloc(dim * sizeof(*f->x));
+	f->x1 = 0;
+	integratorCreate(&f->integrator, dim);
+	if (oqsJumpTrajectoryCreate(dim, &f->trajectory) != OQS_SUCCESS ||
+	    f->x0 == 0 || f->x == 0 || f->integrator.data == 0) {
+		fixtureTeardown(f);
+		return 0;
+	}
+	initialState(f->x0, dim);
+	memcpy(f->x, f->x0, dim * sizeof(*f->x));
+	oqsJumpTrajectorySetSchrodingerEqn(f->trajectory, &f->eqn);
+	oqsJumpTrajectorySeed(f->trajectory, 1, 0);
+	return f;
+}
+
+static void fixtureTeardown(void *fixture)
+{
+	struct Fixture *f = (struct Fixture *)fixture;
+	oqsJumpTrajectoryDestroy(&f->trajectory);
+	integratorDestroy(&f->integrator);
+	free(f->x0);
+	free(f->x);
+	free(f->x1);
+	free(f);
+}
+
+/* Without loss the norm stays bounded over arbitrarily many steps. */
+static void *rk4Setup(size_t dim)
+{
+	struct Fixture *f = fixtureSetup(dim);
+	if (f) f->chain.gamma = 0;
+	return f;
+}
+
+static void rk4Run(void *fixture, long n, struct Counters *counters)
+{
+	struct Fixture *f = (struct Fixture *)fixture;
+	long i;
+	f->chain.numRhsCalls = 0;
+	for (i = 0; i < n; ++i) {
+		integratorTakeStep(&f->integrator, f->x, &chainRHS, &f->chain);
+	}
+	counters->rhsCalls += f->chain.numRhsCalls;
+	counters->steps += n;
+}
+
+/* Each iteration is a trajectory up to t = 0.1 including its jumps.  The
+ * steps are taken from the trajectory statistics and are only reported if
+ * the library is built with OQS_ENABLE_STATS. */
+static void advanceRun(void *fixture, long n, struct Counters *counters)
+{
+	struct Fixture *f = (struct Fixture *)fixture;
+	struct OqsTrajectoryStats stats;
+	double tFinal = 0.1;
+	int decay;
+	long i;
+	f->chain.numRhsCalls = 0;
+	for (i = 0; i < n; ++i) {
+		oqsJumpTrajectoryReset(f->trajectory, f->x0, 0);
+		while (oqsJumpTrajectoryAdvance(f->trajectory, tFinal)) {
+			decay = oqsJumpTrajectoryGetDecay(
+			    f->trajectory, NUM_CHANNELS, f->decayOps);
+			oqsJumpTrajectoryApplyDecay(f->trajectory,
+						    f->decayOps + decay);
+			counters->calls += 1;
+		}
+		oqsJumpTrajectoryGetStats(f->trajectory, &stats);
+		counters->steps += stats.steps;
+	}
+	counters->rhsCalls += f->chain.numRhsCalls;
+	counters->trajectories += n;
+}
+
+/* A single step across which the norm crosses the decay norm z */
+static void *decayTimeSetup(size_t dim)
+{
+	struct Fixture *f = fixtureSetup(dim);
+	if (f == 0) return 0;
+	f->x1 = malloc(dim * sizeof(*f->x1));
+	if (f->x1 == 0) {
+		fixtureTeardown(f);
+		return 0;
+	}
+	integratorTimeStepHint(&f->integrator, 0.1);
+	integratorTakeStep(&f->integrator, f->x, &chainRHS, &f->chain);
+	memcpy(f->x1, f->x, dim * sizeof(*f->x1));
+	f->tRight = integratorGetTime(&f->integrator);
+	f->z = 0.9;
+	return f;
+}
+
+/* findDecayTime overwrites the end of step state with the state at the
+ * decay, so every iteration restores it first.  The copy is part of the
+ * measured time. */
+static void decayTimeRun(void *fixture, long n, struct Counters *counters)
+{
+	struct Fixture *f = (struct Fixture *)fixture;
+	long i;
+	for (i = 0; i < n; ++i) {
+		memcpy(f->x, f->x1, f->chain.dim * sizeof(*f->x));
+		findDecayTime(&f->integrator, f->x0, f->x, 0, f->chain.dim, 0,
+			      f->tRight, f->z, 1.0e-7, 1.0e-12, 0);
+	}
+	counters->calls += n;
+}
+
+static void getDecayRun(void *fixture, long n, struct Counters *counters)
+{
+	struct Fixture *f = (struct Fixture *)fixture;
+	long i;
+	oqsJumpTrajectorySetState(f->trajectory, f->x0);
+	for (i = 0; i < n; ++i) {
+		oqsJumpTrajectoryGetDecay(f->trajectory, NUM_CHANNELS,
+					  f->decayOps);
+	}
+	counters->calls += n;
+}
+
+static const struct BenchCase cases[] = {
+    {"rk4_takeStep", &rk4Setup, &rk4Run, &fixtureTeardown},
+    {"oqsJumpTrajectoryAdvance", &fixtureSetup, &advanceRun,
+     &fixtureTeardown},
+    {"findDecayTime", &decayTimeSetup, &decayTimeRun, &fixtureTeardown},
+    {"oqsJumpTrajectoryGetDecay", &fixtureSetup, &getDecayRun,
+     &fixtureTeardown},
+};
+
+static const size_t dims[] = {2, 10, 100, 1000, 10000, 100000, 1000000};
+
+/* Returns 0 if the fixture can't be set up. */
+static int runCase(const struct BenchCase *bc, size_t dim, double minTime,
+		   struct Result *result)
+{
+	void *fixture = bc->setup(dim);
+	long n = 1;
+	double t0;
+	if (fixture == 0) return 0;
+	while (1) {
+		memset(&result->counters, 0, sizeof(result->counters));
+		t0 = now();
+		bc->run(fixture, n, &result->counters);
+		result->seconds = now() - t0;
+		result->iterations = n;
+		if (result->seconds >= minTime || n >= 1000000000L) break;
+		// Aim for the minimum time with some margin but grow by at
+		// most a factor of ten per round.
+		if (result->seconds <= minTime / 10.0) {
+			n *= 10;
+		} else {
+			n = (long)(1.4 * n * minTime / result->seconds) + 1;
+		}
+	}
+	bc->teardown(fixture);
+	snprintf(result->name, sizeof(result->name), "%s/%lu", bc->name,
+		 (unsigned long)dim);
+	return 1;
+}
+
+static void printCounter(FILE *out, const char *name, double count,
+			 double seconds)
+{
+	if (count > 0) {
+		fprintf(out, ",\n      \"%s\": %.6e", name, count / seconds);
+	}
+}
+
+static void writeJson(FILE *out, const struct Result *results,
+		      int numResults, double minTime)
+{
+	char date[64];
+	time_t t = time(0);
+	int i;
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&t));
+	fprintf(out, "{\n  \"context\": {\n");
+	fprintf(out, "    \"date\": \"%s\",\n", date);
+	fprintf(out, "    \"executable\": \"oqs_bench\",\n");
+	fprintf(out, "    \"min_time\": %g\n  },\n", minTime);
+	fprintf(out, "  \"benchmarks\": [");
+	for (i = 0; i < numResults; ++i) {
+		fprintf(out, "%s\n    {\n", i ? "," : "");
+		fprintf(out, "      \"name\": \"%s\",\n", results[i].name);
+		fprintf(out, "      \"iterations\": %ld,\n",
+			results[i].iterations);
+		fprintf(out, "      \"real_time\": %.6e,\n",
+			1.0e9 * results[i].seconds / results[i].iterations);
+		fprintf(out, "      \"time_unit\": \"ns\"");
+		printCounter(out, "rhs_calls_per_second",
+			     results[i].counters.rhsCalls,
+			     results[i].seconds);
+		printCounter(out, "steps_per_second", results[i].counters.steps,
+			     results[i].seconds);
+		printCounter(out, "trajectories_per_second",
+			     results[i].counters.trajectories,
+			     results[i].seconds);
+		printCounter(out, "calls_per_second", results[i].counters.calls,
+			     results[i].seconds);
+		fprintf(out, "\n    }");
+	}
+	fprintf(out, "\n  ]\n}\n");
+}
+
+int main(int argn, char **argv)
+{
+	const char *filter = "";
+	const char *jsonFile = 0;
+	double minTime = 0.5;
+	size_t maxDim = 1000000;
+	struct Result results[MAX_RESULTS];
+	struct Result *r;
+	int numResults = 0;
+	size_t c, d;
+	FILE *out;
+	int i;
+
+	for (i = 1; i < argn; ++i) {
+		if (strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+			minTime = atof(argv[i] + 11);
+		} else if (strncmp(argv[i], "--max-dim=", 10) == 0) {
+			maxDim = strtoul(argv[i] + 10, 0, 10);
+		} else if (strncmp(argv[i], "--json=", 7) == 0) {
+			jsonFile = argv[i] + 7;
+		} else {
+			fprintf(stderr,
+				"Usage: %s [--filter=substring] "
+				"[--min-time=seconds] [--max-dim=n] "
+				"[--json=file]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	printf("%-36s %12s %12s %14s %14s %14s\n", "Benchmark", "Time/iter",
+	       "Iterations", "RHS calls/s", "Steps/s", "Items/s");
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+		for (d = 0; d < sizeof(dims) / sizeof(dims[0]); ++d) {
+			if (dims[d] > maxDim) continue;
+			if (!strstr(cases[c].name, filter)) continue;
+			if (numResults == MAX_RESULTS) break;
+			r = results + numResults;
+			if (!runCase(cases + c, dims[d], minTime, r)) {
+				fprintf(stderr, "%s/%lu: out of memory\n",
+					cases[c].name, (unsigned long)dims[d]);
+				continue;
+			}
+			++numResults;
+			printf("%-36s %10.3e s %12ld %14.4e %14.4e %14.4e\n",
+			       r->name, r->seconds / r->iterations,
+			       r->iterations, r->counters.rhsCalls / r->seconds,
+			       r->counters.steps / r->seconds,
+			       (r->counters.trajectories > 0
+				    ? r->counters.trajectories
+				    : r->counters.calls) /
+				   r->seconds);
+			fflush(stdout);
+		}
+	}
+
+	if (jsonFile) {
+		out = fopen(jsonFile, "w");
+		if (!out) {
+			fprintf(stderr, "Could not open %s\n", jsonFile);
+			return 1;
+		}
+		writeJson(out, results, numResults, minTime);
+		fclose(out);
+	}
+	return 0;
+}
@@ -36,55 +36,45 @@ void excitedToGroundDecay(const struct OqsAmplitude *x, struct OqsAmplitude *y,
 	y[0].im = sgamma * x[1].im;
 }
 
-static void advanceTo(OqsJumpTrajectory trajectory, int numDecays,
-		      struct OqsDecayOperator *decays, double targetTime)
+static void excitedStateProjector(const struct OqsAmplitude *x,
+				  struct OqsAmplitude *y, void *ctx)
 {
-	int decayHappened = 1;
-	int decay;
-
-	while (decayHappened) {
-		decayHappened =
-		    oqsJumpTrajectoryAdvance(trajectory, targetTime);
-		if (decayHappened) {
-			decay = oqsJumpTrajectoryGetDecay(trajectory, numDecays,
-							  decays);
-			oqsJumpTrajectoryApplyDecay(trajectory, decays + decay);
-		}
-	}
+	y[0].re = 0;
+	y[0].im = 0;
+	y[1] = x[1];
 }
 
-static double excitedStatePopulation(OqsJumpTrajectory trajectory)
+#define NUM_THREADS 4
+
+struct SimulationCtx {
+	struct OqsSchrodingerEqn *eqn;
+	struct OqsDecayOperator *decay;
+	struct OqsAmplitude *initialState;
+};
+
+static OQS_STATUS setupTrajectory(OqsJumpTrajectory trajectory, int thread,
+				  void *ctx)
 {
-	struct OqsAmplitude* state;
-	double pe, pg;
-	state = oqsJumpTrajectoryGetState(trajectory);
-	pe = state[1].re * state[1].re + state[1].im * state[1].im;
-	pg = state[0].re * state[0].re + state[0].im * state[0].im;
-	return pe / (pe + pg);
+	struct SimulationCtx *c = (struct SimulationCtx *)ctx;
+	return oqsJumpTrajectorySetSchrodingerEqn(trajectory, c->eqn);
 }
 
-static double nrmSquared(OqsJumpTrajectory trajectory)
+static void sampleTrajectory(OqsJumpTrajectory trajectory, size_t index,
+			     OqsAccumulator accumulator, void *ctx)
 {
-	struct OqsAmplitude *state = oqsJumpTrajectoryGetState(trajectory);
-	double nrm = 0;
-	int i;
-	for (i = 0; i < 2; ++i) {
-		nrm += state[i].re * state[i].re + state[i].im * state[i].im;
-	}
-	return nrm;
+	struct SimulationCtx *c = (struct SimulationCtx *)ctx;
+	oqsJumpTrajectoryReset(trajectory, c->initialState, 0.0);
+	oqsAccumulatorSampleTrajectory(accumulator, trajectory, 1, c->decay);
 }
 
 int main(int argn, char **argv)
 {
-	double tmax, t, dt;
+	double tmax, dt;
 	OQS_STATUS stat;
-	OqsJumpTrajectory trajectory;
 	struct OqsAmplitude initialState[2];
-	int i;
-	int numTrajectories = 10;
-
-	stat = oqsJumpTrajectoryCreate(2, &trajectory);
-	assert(stat == OQS_SUCCESS);
+	size_t i;
+	int numTrajectories = 1000;
+	size_t numTimes;
 
 	initialState[0].re = 1.0;
 	initialState[0].im = 0.0;
@@ -105,23 +95,37 @@ int main(int argn, char **argv)
 	ctx.omega = 1.0;
 	ctx.gamma = 0.5;
 	eqn.ctx = &ctx;
-	oqsJumpTrajectorySetSchrodingerEqn(trajectory, &eqn);
+
+	struct OqsObservable excitedStatePopulation;
+	excitedStatePopulation.apply = &excitedStateProjector;
+	excitedStatePopulation.ctx = 0;
 
 	tmax = 20.0;
 	dt = 0.1;
-	for (i = 0; i < numTrajectories; ++i) {
-		t = 0;
-		oqsJumpTrajectoryReset(trajectory, initialState, t);
-		while (t < tmax) {
-			printf("%d %lf %lf %lf\n", i, t,
-			       excitedStatePopulation(trajectory),
-			       nrmSquared(trajectory));
-			advanceTo(trajectory, 1, &decay, t + dt);
-			t = oqsJumpTrajectoryGetTime(trajectory);
-		}
-		printf("%d %lf %lf %lf\n", i, t,
-		       excitedStatePopulation(trajectory),
-		       nrmSquared(trajectory));
+	numTimes = (size_t)(tmax / dt + 0.5) + 1;
+
+	struct SimulationCtx simulation;
+	simulation.eqn = &eqn;
+	simulation.decay = &decay;
+	simulation.initialState = initialState;
+	OqsAccumulator a;
+	stat = oqsAccumulatorCreate(2, 1, &excitedStatePopulation, numTimes,
+				    0.0, dt, &a);
+	assert(stat == OQS_SUCCESS);
+
+	struct OqsSamplingTask task;
+	task.setup = &setupTrajectory;
+	task.sample = &sampleTrajectory;
+	task.ctx = &simulation;
+	stat = oqsSampleTrajectories(2, numTrajectories, 64, NUM_THREADS, 1,
+				     &task, a);
+	assert(stat == OQS_SUCCESS);
+
+	for (i = 0; i < numTimes; ++i) {
+		printf("%lf %lf %lf\n", oqsAccumulatorGetTime(a, i),
+		       oqsAccumulatorGetMean(a, 0, i),
+		       sqrt(oqsAccumulatorGetVariance(a, 0, i) /
+			    oqsAccumulatorGetCount(a, i)));
 	}
-	oqsJumpTrajectoryDestroy(&trajectory);
+	oqsAccumulatorDestroy(&a);
 }
@@ -0,0 +1,99 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <Oqs.h>
+
+struct RabiOscillationsCtx {
+	double omega;
+	double gamma;
+};
+
+static void RabiOscillationsRHS(double t, size_t n,
+				const struct OqsAmplitude *x,
+				struct OqsAmplitude *y, void *ctx)
+{
+	struct RabiOscillationsCtx *c = (struct RabiOscillationsCtx *)ctx;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		const struct OqsAmplitude *xi = x + 2 * i;
+		struct OqsAmplitude *yi = y + 2 * i;
+		yi[0].re = 0.5 * c->omega * xi[1].im;
+		yi[0].im = -0.5 * c->omega * xi[1].re;
+		yi[1].re = 0.5 * c->omega * xi[0].im - 0.5 * c->gamma * xi[1].re;
+		yi[1].im = -0.5 * c->omega * xi[0].re - 0.5 * c->gamma * xi[1].im;
+	}
+}
+
+struct EToGCtx {
+	double gamma;
+};
+
+static void excitedToGroundDecay(const struct OqsAmplitude *x,
+				 struct OqsAmplitude *y, void *ctx)
+{
+	struct EToGCtx *c = (struct EToGCtx *)ctx;
+	double sgamma = sqrt(c->gamma);
+	y[0].re = sgamma * x[1].re;
+	y[0].im = sgamma * x[1].im;
+	y[1].re = 0;
+	y[1].im = 0;
+}
+
+static double excitedStatePopulation(OqsEnsemble ensemble)
+{
+	size_t n = oqsEnsembleGetNumTrajectories(ensemble);
+	double population = 0;
+	double pe, pg;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		struct OqsAmplitude *state = oqsEnsembleGetState(ensemble, i);
+		pe = state[1].re * state[1].re + state[1].im * state[1].im;
+		pg = state[0].re * state[0].re + state[0].im * state[0].im;
+		population += pe / (pe + pg);
+	}
+	return population / n;
+}
+
+int main(int argn, char **argv)
+{
+	double tmax, t, dt;
+	OQS_STATUS stat;
+	OqsEnsemble ensemble;
+	struct OqsAmplitude initialState[2];
+	size_t numTrajectories = 1000;
+
+	stat = oqsEnsembleCreate(2, numTrajectories, &ensemble);
+	assert(stat == OQS_SUCCESS);
+
+	initialState[0].re = 1.0;
+	initialState[0].im = 0.0;
+	initialState[1].re = 0.0;
+	initialState[1].im = 0.0;
+
+	struct OqsDecayOperator decay;
+	decay.apply = &excitedToGroundDecay;
+	struct EToGCtx decayCtx;
+	decayCtx.gamma = 0.5;
+	decay.ctx = &decayCtx;
+	oqsEnsembleSetDecayOperators(ensemble, 1, &decay);
+
+	struct OqsEnsembleSchrodingerEqn eqn;
+	eqn.RHS = &RabiOscillationsRHS;
+	struct RabiOscillationsCtx ctx;
+	ctx.omega = 1.0;
+	ctx.gamma = 0.5;
+	eqn.ctx = &ctx;
+	oqsEnsembleSetSchrodingerEqn(ensemble, &eqn);
+
+	tmax = 20.0;
+	dt = 0.1;
+	t = 0;
+	oqsEnsembleReset(ensemble, initialState, t);
+	while (t < tmax) {
+		printf("%lf %lf\n", t, excitedStatePopulation(ensemble));
+		oqsEnsembleAdvance(ensemble, t + dt);
+		t = oqsEnsembleGetTime(ensemble);
+	}
+	printf("%lf %lf\n", t, excitedStatePopulation(ensemble));
+	oqsEnsembleDestroy(&ensemble);
+}
@@ -21,8 +21,18 @@ with oqs.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <OqsConfig.h>
 
+#include <OqsAccumulator.h>
+#include <OqsAllocator.h>
 #include <OqsAmplitude.h>
+#include <OqsDiffusiveTrajectory.h>
 #include <OqsJumpTrajectory.h>
+#include <OqsEnsemble.h>
+#include <OqsHamiltonian.h>
+#include <OqsMasterEqn.h>
+#include <OqsParallel.h>
+#include <OqsRecorder.h>
+#include <OqsRng.h>
+#include <OqsTrajectoryPool.h>
 #ifdef OQS_WITH_MBO
 #include <OqsMbo.h>
 #endif
@@ -0,0 +1,111 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_ACCUMULATOR_H
+#define OQS_ACCUMULATOR_H
+
+#include <stdlib.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsAmplitude.h>
+#include <OqsJumpTrajectory.h>
+#include <OqsEnsemble.h>
+#include <OqsMasterEqn.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Hermitian operator whose expectation value is to be recorded.
+ *
+ * apply computes y = A x.  The recorded value is Re <x|A x> / <x|x>, so
+ * unnormalized trajectory states can be sampled directly.
+ * */
+struct OqsObservable {
+	void (*apply)(const struct OqsAmplitude *x, struct OqsAmplitude *y,
+		      void *ctx);
+	void *ctx;
+};
+
+/* An accumulator records the running mean and variance (Welford's
+ * algorithm) of a set of observables on the time grid t0 + i * dt, i = 0,
+ * ..., numTimes - 1.  Its memory is independent of the number of
+ * trajectories sampled.  Accumulators filled by different threads can be
+ * combined with oqsAccumulatorMerge.  States in the split layout are
+ * sampled by an accumulator created with dim = OQS_SPLIT_STRIDE(dim) since
+ * the expectation values don't depend on the layout otherwise. */
+struct OqsAccumulator_;
+typedef struct OqsAccumulator_ *OqsAccumulator;
+
+OQS_EXPORT OQS_STATUS
+oqsAccumulatorCreate(size_t dim, int numObservables,
+		     const struct OqsObservable *observables, size_t numTimes,
+		     double t0, double dt, OqsAccumulator *accumulator);
+/* Creates an empty accumulator with the dimension, observables and time
+ * grid of accumulator. */
+OQS_EXPORT OQS_STATUS oqsAccumulatorCreateLike(OqsAccumulator accumulator,
+					       OqsAccumulator *created);
+OQS_EXPORT OQS_STATUS oqsAccumulatorDestroy(OqsAccumulator *accumulator);
+OQS_EXPORT void oqsAccumulatorClear(OqsAccumulator accumulator);
+OQS_EXPORT size_t oqsAccumulatorGetNumTimes(OqsAccumulator accumulator);
+OQS_EXPORT double oqsAccumulatorGetTime(OqsAccumulator accumulator,
+					size_t timeIndex);
+OQS_EXPORT void oqsAccumulatorAddSample(OqsAccumulator accumulator,
+					size_t timeIndex,
+					const struct OqsAmplitude *state);
+/* Evolves the trajectory from its current time to the end of the time
+ * grid, applying jumps with the given decay operators, and samples it at
+ * every grid time not before its current time. */
+OQS_EXPORT void
+oqsAccumulatorSampleTrajectory(OqsAccumulator accumulator,
+			       OqsJumpTrajectory trajectory, int numDecayOps,
+			       struct OqsDecayOperator *decayOps);
+/* Like oqsAccumulatorSampleTrajectory for all members of an ensemble. */
+OQS_EXPORT void oqsAccumulatorSampleEnsemble(OqsAccumulator accumulator,
+					     OqsEnsemble ensemble);
+/* Evolves the density matrix to the end of the time grid and adds its
+ * expectation values as one sample at every grid time not before its
+ * current time.  The accumulator's dimension is that of the states, not of
+ * the density matrix. */
+OQS_EXPORT void oqsAccumulatorSampleMasterEqn(OqsAccumulator accumulator,
+					      OqsMasterEqn master);
+/* Adds the samples of other to accumulator.  Returns
+ * OQS_INVALID_ARGUMENT unless both have the same dimension, time grid and
+ * number of observables. */
+OQS_EXPORT OQS_STATUS oqsAccumulatorMerge(OqsAccumulator accumulator,
+					  OqsAccumulator other);
+OQS_EXPORT double oqsAccumulatorGetCount(OqsAccumulator accumulator,
+					 size_t timeIndex);
+OQS_EXPORT double oqsAccumulatorGetMean(OqsAccumulator accumulator,
+					int observable, size_t timeIndex);
+OQS_EXPORT double oqsAccumulatorGetVariance(OqsAccumulator accumulator,
+					    int observable, size_t timeIndex);
+/* Checkpoint and restart of the accumulated statistics like
+ * oqsJumpTrajectorySave and oqsJumpTrajectoryLoad.  An accumulator can
+ * only load a checkpoint of an accumulator with the same dimension, number
+ * of observables and time grid. */
+OQS_EXPORT OQS_STATUS oqsAccumulatorSave(OqsAccumulator accumulator,
+					 const char *path);
+OQS_EXPORT OQS_STATUS oqsAccumulatorLoad(OqsAccumulator accumulator,
+					 const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,54 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_ALLOCATOR_H
+#define OQS_ALLOCATOR_H
+
+#include <stdlib.h>
+#include <OqsExport.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Hooks for the memory of trajectories, ensembles and integrators.
+ *
+ * Each of these objects obtains its buffers from a single allocation of
+ * the allocator that was installed when it was created, and returns it to
+ * the same allocator.  allocate returns size bytes aligned to alignment,
+ * a power of two, or null.  The memory need not be zeroed.  deallocate
+ * receives the size that was requested, e.g. for releasing huge pages or
+ * memory bound to a NUMA node.
+ * */
+struct OqsAllocator {
+	void *(*allocate)(size_t size, size_t alignment, void *ctx);
+	void (*deallocate)(void *p, size_t size, void *ctx);
+	void *ctx;
+};
+
+/* Installs the allocator for objects created afterwards.  A null allocator
+ * restores the default, aligned malloc.  Not thread safe, so the allocator
+ * should be set before objects are created concurrently. */
+OQS_EXPORT void oqsSetAllocator(const struct OqsAllocator *allocator);
+OQS_EXPORT void oqsGetAllocator(struct OqsAllocator *allocator);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -31,6 +31,26 @@ struct OqsAmplitude {
 	double im; /**< Imaginary part */
 };
 
+/**
+ * @brief Storage layout of state vectors.
+ *
+ * In the split layout a state of dimension dim holds the real parts of all
+ * components followed by their imaginary parts.  Both parts are padded to
+ * OQS_SPLIT_STRIDE(dim) doubles with zeros so that each starts on a 64 byte
+ * boundary.  Callbacks still receive struct OqsAmplitude pointers and use
+ * OQS_SPLIT_RE and OQS_SPLIT_IM to access the parts.  Callbacks must not
+ * write the padding.
+ * */
+enum OqsLayout {
+	OQS_LAYOUT_INTERLEAVED = 0, /**< Array of struct OqsAmplitude */
+	OQS_LAYOUT_SPLIT            /**< Real parts followed by imaginary
+					 parts */
+};
+
+#define OQS_SPLIT_STRIDE(dim) (((dim) + 7) / 8 * 8)
+#define OQS_SPLIT_RE(x) ((double *)(x))
+#define OQS_SPLIT_IM(x, dim) ((double *)(x) + OQS_SPLIT_STRIDE(dim))
+
 #ifdef __cplusplus
 }
 #endif
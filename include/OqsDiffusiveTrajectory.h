@@ -0,0 +1,106 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_DIFFUSIVE_TRAJECTORY_H
+#define OQS_DIFFUSIVE_TRAJECTORY_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsAmplitude.h>
+#include <OqsRng.h>
+#include <OqsJumpTrajectory.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Homodyne (quantum state diffusion) unravelling.
+ *
+ * Instead of jumping, the state diffuses continuously.  With the same
+ * callbacks as OqsJumpTrajectory, i.e. the Schrodinger equation computing
+ * -i H_eff x with H_eff = H - i/2 sum_k c_k^\dagger c_k and the decay
+ * operators applying the c_k, the normalized state obeys the Ito equation
+ *
+ *   d x = [-i H_eff x + sum_k (<X_k> c_k x / 2 - <X_k>^2 x / 8)] dt
+ *         + sum_k (c_k - <X_k> / 2) x dW_k
+ *
+ * with the quadratures X_k = c_k + c_k^\dagger and independent Wiener
+ * processes W_k.  Averages over trajectories reproduce the same master
+ * equation as the jump unravelling.  The state is advanced with fixed
+ * steps, so there is no search for decay times, and it is normalized after
+ * every step.  Only the interleaved layout is supported.
+ * */
+enum OqsDiffusiveScheme {
+	OQS_DIFFUSIVE_EULER_MARUYAMA = 0, /**< Weak order one */
+	OQS_DIFFUSIVE_WEAK2 /**< Explicit weak order two scheme of Platen with
+			         three point distributed increments */
+};
+
+struct OqsDiffusiveTrajectory_;
+typedef struct OqsDiffusiveTrajectory_ *OqsDiffusiveTrajectory;
+
+OQS_EXPORT OQS_STATUS
+oqsDiffusiveTrajectoryCreate(size_t dim, OqsDiffusiveTrajectory *trajectory);
+OQS_EXPORT OQS_STATUS
+oqsDiffusiveTrajectoryDestroy(OqsDiffusiveTrajectory *trajectory);
+OQS_EXPORT OQS_STATUS
+oqsDiffusiveTrajectorySetSchrodingerEqn(OqsDiffusiveTrajectory trajectory,
+					struct OqsSchrodingerEqn *eqn);
+/* The decay operators are not copied and have to outlive their use.  On
+ * failure the previous operators are kept. */
+OQS_EXPORT OQS_STATUS
+oqsDiffusiveTrajectorySetDecayOperators(OqsDiffusiveTrajectory trajectory,
+					int numDecayOps,
+					struct OqsDecayOperator *decayOps);
+OQS_EXPORT OQS_STATUS
+oqsDiffusiveTrajectorySetScheme(OqsDiffusiveTrajectory trajectory,
+				enum OqsDiffusiveScheme scheme);
+OQS_EXPORT void
+oqsDiffusiveTrajectoryTimeStepHint(OqsDiffusiveTrajectory trajectory,
+				   double dt);
+/* Sets the state, which is normalized. */
+OQS_EXPORT OQS_STATUS
+oqsDiffusiveTrajectorySetState(OqsDiffusiveTrajectory trajectory,
+			       const struct OqsAmplitude *state);
+/* The returned array is only valid until the trajectory is advanced. */
+OQS_EXPORT struct OqsAmplitude *
+oqsDiffusiveTrajectoryGetState(OqsDiffusiveTrajectory trajectory);
+OQS_EXPORT size_t
+oqsDiffusiveTrajectoryGetDim(OqsDiffusiveTrajectory trajectory);
+OQS_EXPORT double
+oqsDiffusiveTrajectoryGetTime(OqsDiffusiveTrajectory trajectory);
+OQS_EXPORT void oqsDiffusiveTrajectorySetTime(OqsDiffusiveTrajectory trajectory,
+					      double t);
+/* Seeds and selects the built-in generator like oqsJumpTrajectorySeed. */
+OQS_EXPORT void oqsDiffusiveTrajectorySeed(OqsDiffusiveTrajectory trajectory,
+					   uint64_t seed, uint64_t stream);
+/* Replaces the source of random numbers.  A null rng restores the built-in
+ * generator. */
+OQS_EXPORT void oqsDiffusiveTrajectorySetRng(OqsDiffusiveTrajectory trajectory,
+					     const struct OqsRng *rng);
+/* Advances the state to time t.  The last step is shortened to end at t. */
+OQS_EXPORT void oqsDiffusiveTrajectoryAdvance(OqsDiffusiveTrajectory trajectory,
+					      double t);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
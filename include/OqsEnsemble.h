@@ -0,0 +1,99 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_ENSEMBLE_H
+#define OQS_ENSEMBLE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsAmplitude.h>
+#include <OqsJumpTrajectory.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Batched Schrodinger equation.
+ *
+ * Evaluates the right hand side for n states at once.  The states are
+ * stored one after the other, i.e. x and y are dim x n matrices in column
+ * major order.
+ * */
+struct OqsEnsembleSchrodingerEqn {
+	void (*RHS)(double t, size_t n, const struct OqsAmplitude *x,
+		    struct OqsAmplitude *y, void *ctx);
+	void *ctx;
+};
+
+struct OqsEnsemble_;
+typedef struct OqsEnsemble_ *OqsEnsemble;
+
+OQS_EXPORT OQS_STATUS oqsEnsembleCreate(size_t dim, size_t numTrajectories,
+					OqsEnsemble *ensemble);
+OQS_EXPORT OQS_STATUS oqsEnsembleDestroy(OqsEnsemble *ensemble);
+OQS_EXPORT OQS_STATUS
+oqsEnsembleSetSchrodingerEqn(OqsEnsemble ensemble,
+			     struct OqsEnsembleSchrodingerEqn *eqn);
+OQS_EXPORT OQS_STATUS
+oqsEnsembleSetDecayOperators(OqsEnsemble ensemble, int numDecayOps,
+			     struct OqsDecayOperator *decayOps);
+/* See oqsJumpTrajectorySetDecayRates */
+OQS_EXPORT OQS_STATUS oqsEnsembleSetDecayRates(OqsEnsemble ensemble,
+					       int numDecayOps,
+					       const double *rates);
+/* See oqsJumpTrajectorySetDecayExpectations */
+OQS_EXPORT OQS_STATUS
+oqsEnsembleSetDecayExpectations(OqsEnsemble ensemble, int numDecayOps,
+				const OqsDecayExpectation *expectations);
+OQS_EXPORT size_t oqsEnsembleGetDim(OqsEnsemble ensemble);
+OQS_EXPORT size_t oqsEnsembleGetNumTrajectories(OqsEnsemble ensemble);
+/* The returned states are only valid until the ensemble is advanced. */
+OQS_EXPORT struct OqsAmplitude *oqsEnsembleGetStates(OqsEnsemble ensemble);
+OQS_EXPORT struct OqsAmplitude *oqsEnsembleGetState(OqsEnsemble ensemble,
+						    size_t i);
+OQS_EXPORT double oqsEnsembleGetTime(OqsEnsemble ensemble);
+OQS_EXPORT void oqsEnsembleTimeStepHint(OqsEnsemble ensemble, double dt);
+OQS_EXPORT void oqsEnsembleReset(OqsEnsemble ensemble,
+				 const struct OqsAmplitude *initialState,
+				 double t);
+/* Seeds the random number generators of the trajectories.  Trajectory i
+ * uses stream firstStream + i, so it produces the same sequence as a
+ * single trajectory seeded with (seed, firstStream + i).  Until seeded,
+ * an ensemble uses OQS_PHILOX_DEFAULT_SEED and streams of its own. */
+OQS_EXPORT void oqsEnsembleSeed(OqsEnsemble ensemble, uint64_t seed,
+				uint64_t firstStream);
+OQS_EXPORT size_t oqsEnsembleAdvance(OqsEnsemble ensemble, double t);
+/* Aggregates the work of all trajectories in the ensemble.  A batched
+ * right hand side evaluation counts once per trajectory. */
+OQS_EXPORT void oqsEnsembleGetStats(OqsEnsemble ensemble,
+				    struct OqsTrajectoryStats *stats);
+OQS_EXPORT void oqsEnsembleResetStats(OqsEnsemble ensemble);
+OQS_EXPORT void oqsEnsembleEnableTimers(OqsEnsemble ensemble, int enable);
+/* Checkpoint and restart like oqsJumpTrajectorySave and
+ * oqsJumpTrajectoryLoad.  The states, decay norms and generators of all
+ * trajectories, the time, the time step and the statistics are saved. */
+OQS_EXPORT OQS_STATUS oqsEnsembleSave(OqsEnsemble ensemble, const char *path);
+OQS_EXPORT OQS_STATUS oqsEnsembleLoad(OqsEnsemble ensemble, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
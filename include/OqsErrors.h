@@ -25,7 +25,11 @@ extern "C" {
 
 enum OQS_STATUS {
 	OQS_SUCCESS = 0,
-	OQS_OUT_OF_MEMORY
+	OQS_OUT_OF_MEMORY,
+	OQS_THREAD_ERROR,
+	OQS_INVALID_ARGUMENT,
+	OQS_IO_ERROR,
+	OQS_FORMAT_ERROR
 };
 typedef enum OQS_STATUS OQS_STATUS;
 
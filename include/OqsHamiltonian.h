@@ -0,0 +1,90 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_HAMILTONIAN_H
+#define OQS_HAMILTONIAN_H
+
+#include <stdlib.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsAmplitude.h>
+#include <OqsJumpTrajectory.h>
+#include <OqsEnsemble.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Scalar coefficient f(t) of a term of a Hamiltonian.
+ * */
+struct OqsCoefficient {
+	double (*eval)(double t, void *ctx);
+	void *ctx;
+};
+
+/* Maximum number of time dependent terms.  The coefficients are evaluated
+ * into a buffer of this size on the stack. */
+#define OQS_HAMILTONIAN_MAX_TERMS 64
+
+/**
+ * @brief Hamiltonian H(t) = H_0 + sum_k f_k(t) H_k with sparse H_k.
+ *
+ * The nonzeros of all terms are merged into a single compressed row matrix
+ * in which every entry refers to its term, so a right hand side evaluation
+ * computes the f_k(t) once and then makes a single pass over the matrix and
+ * the state.  The terms need not be Hermitian, e.g. H_0 may contain the
+ * anti-Hermitian part of the effective Hamiltonian of a jump trajectory.
+ * Terms can't be added while an equation obtained from the Hamiltonian is
+ * being evaluated, but the equations may be evaluated from several threads
+ * at once.
+ * */
+struct OqsHamiltonian_;
+typedef struct OqsHamiltonian_ *OqsHamiltonian;
+
+OQS_EXPORT OQS_STATUS oqsHamiltonianCreate(size_t dim,
+					   OqsHamiltonian *hamiltonian);
+OQS_EXPORT OQS_STATUS oqsHamiltonianDestroy(OqsHamiltonian *hamiltonian);
+/* Adds the nnz entries values[i] at (rows[i], cols[i]) times f(t).  A null
+ * f adds them to the static part H_0.  Repeated entries are summed.  Fails
+ * with OQS_INVALID_ARGUMENT if f would be term number
+ * OQS_HAMILTONIAN_MAX_TERMS + 1.  On failure the Hamiltonian is
+ * unchanged. */
+OQS_EXPORT OQS_STATUS oqsHamiltonianAddTerm(OqsHamiltonian hamiltonian,
+					    const struct OqsCoefficient *f,
+					    size_t nnz, const size_t *rows,
+					    const size_t *cols,
+					    const struct OqsAmplitude *values);
+OQS_EXPORT size_t oqsHamiltonianGetDim(OqsHamiltonian hamiltonian);
+/* The number of time dependent terms. */
+OQS_EXPORT int oqsHamiltonianGetNumTerms(OqsHamiltonian hamiltonian);
+/* Fills eqn with the right hand side y = -i H(t) x for states in the given
+ * layout. */
+OQS_EXPORT void oqsHamiltonianGetSchrodingerEqn(OqsHamiltonian hamiltonian,
+						enum OqsLayout layout,
+						struct OqsSchrodingerEqn *eqn);
+/* Batched right hand side for ensembles.  The coefficients are evaluated
+ * once for all states. */
+OQS_EXPORT void
+oqsHamiltonianGetEnsembleSchrodingerEqn(OqsHamiltonian hamiltonian,
+					struct OqsEnsembleSchrodingerEqn *eqn);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -20,9 +20,11 @@ with oqs.  If not, see <http://www.gnu.org/licenses/>.
 #define OQS_JUMP_TRAJECTORY_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <OqsErrors.h>
 #include <OqsExport.h>
 #include <OqsAmplitude.h>
+#include <OqsRng.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,26 +42,127 @@ struct OqsDecayOperator {
 	void *ctx;
 };
 
+/* Computes the jump probability <x|c^\dagger c|x> of a decay operator
+ * without forming c x, e.g. with a precompiled c^\dagger c.  ctx is the
+ * ctx of the decay operator. */
+typedef double (*OqsDecayExpectation)(const struct OqsAmplitude *x,
+				      void *ctx);
+
+enum OqsIntegratorType {
+	OQS_INTEGRATOR_RK4 = 0, /**< Classical fixed step Runge-Kutta */
+	OQS_INTEGRATOR_DOPRI5,  /**< Adaptive Dormand-Prince 5(4) */
+	OQS_INTEGRATOR_KRYLOV,  /**< Adaptive Krylov exponential, requires a
+				     time independent Hamiltonian */
+	OQS_INTEGRATOR_LSRK4    /**< Fixed step low storage Runge-Kutta of
+				     fourth order */
+};
+
+/**
+ * @brief Work done by a trajectory.
+ *
+ * The counters are only collected if the library is built with
+ * OQS_ENABLE_STATS and remain zero otherwise.  The times are only measured
+ * when timers are enabled with oqsJumpTrajectoryEnableTimers.
+ * */
+struct OqsTrajectoryStats {
+	uint64_t steps;          /**< Integrator steps */
+	uint64_t rhsCalls;       /**< Right hand side evaluations */
+	uint64_t rootIterations; /**< Iterations of the decay time search */
+	uint64_t backtracks;     /**< Steps cut back to the target time or to
+				      a decay */
+	uint64_t jumps;          /**< Applied decays */
+	double rhsSeconds;       /**< Wall clock time spent in the right hand
+				      side */
+	double advanceSeconds;   /**< Wall clock time spent advancing,
+				      including the right hand side */
+};
+
+/**
+ * @brief A jump of a trajectory.
+ *
+ * channel is the index returned by the oqsJumpTrajectoryGetDecay call that
+ * selected the applied operator, or -1 if the operator was not selected by
+ * it.
+ * */
+struct OqsJumpRecord {
+	double t;
+	int channel;
+};
+
 struct OqsJumpTrajectory_;
 typedef struct OqsJumpTrajectory_ *OqsJumpTrajectory;
 
 OQS_EXPORT OQS_STATUS
 oqsJumpTrajectoryCreate(size_t dim, OqsJumpTrajectory *trajectory);
+/* Creates a trajectory whose states, including the arguments and results
+ * of all callbacks, are stored in the given layout.  State buffers are 64
+ * byte aligned. */
+OQS_EXPORT OQS_STATUS
+oqsJumpTrajectoryCreateWithLayout(size_t dim, enum OqsLayout layout,
+				  OqsJumpTrajectory *trajectory);
+/* Creates n trajectories, including their integrators, from a single
+ * allocation.  The state buffers aren't written until the state of a
+ * trajectory is first set with oqsJumpTrajectorySetState or
+ * oqsJumpTrajectoryLoad, which has to happen before anything else.  Doing
+ * that on the thread that will use the trajectory places its memory close
+ * to that thread.  The trajectories draw consecutive Philox streams and are
+ * destroyed together with oqsJumpTrajectoryDestroyMany. */
+OQS_EXPORT OQS_STATUS
+oqsJumpTrajectoryCreateMany(size_t dim, enum OqsLayout layout, size_t n,
+			    OqsJumpTrajectory *trajectories);
+/* Fails with OQS_INVALID_ARGUMENT for a trajectory created by
+ * oqsJumpTrajectoryCreateMany. */
 OQS_EXPORT OQS_STATUS oqsJumpTrajectoryDestroy(OqsJumpTrajectory *trajectory);
+OQS_EXPORT OQS_STATUS
+oqsJumpTrajectoryDestroyMany(size_t n, OqsJumpTrajectory *trajectories);
 OQS_STATUS
 OQS_EXPORT oqsJumpTrajectorySetSchrodingerEqn(OqsJumpTrajectory trajectory,
 					      struct OqsSchrodingerEqn *eqn);
 OQS_EXPORT OQS_STATUS
+oqsJumpTrajectorySetIntegrator(OqsJumpTrajectory trajectory,
+			       enum OqsIntegratorType type);
+OQS_EXPORT void oqsJumpTrajectoryTimeStepHint(OqsJumpTrajectory trajectory,
+					      double dt);
+OQS_EXPORT void oqsJumpTrajectorySetTolerances(OqsJumpTrajectory trajectory,
+					       double absTol, double relTol);
+OQS_EXPORT OQS_STATUS
 oqsJumpTrajectorySetState(OqsJumpTrajectory trajectory,
 			  const struct OqsAmplitude *state);
+/* The returned array is only valid until the trajectory is advanced or a
+ * decay is applied. */
 OQS_EXPORT struct OqsAmplitude *
 oqsJumpTrajectoryGetState(OqsJumpTrajectory trajectory);
+OQS_EXPORT size_t oqsJumpTrajectoryGetDim(OqsJumpTrajectory trajectory);
+OQS_EXPORT enum OqsLayout
+oqsJumpTrajectoryGetLayout(OqsJumpTrajectory trajectory);
+/* Whether the trajectory was created by oqsJumpTrajectoryCreateMany and
+ * can only be destroyed together with the others. */
+OQS_EXPORT int oqsJumpTrajectoryIsShared(OqsJumpTrajectory trajectory);
+/* The real and imaginary parts of the state of a split layout trajectory
+ * without copying.  Valid as long as oqsJumpTrajectoryGetState.  Null for
+ * the interleaved layout. */
+OQS_EXPORT double *oqsJumpTrajectoryGetStateRe(OqsJumpTrajectory trajectory);
+OQS_EXPORT double *oqsJumpTrajectoryGetStateIm(OqsJumpTrajectory trajectory);
 OQS_EXPORT double oqsJumpTrajectoryGetTime(OqsJumpTrajectory trajectory);
 OQS_EXPORT void oqsJumpTrajectorySetTime(OqsJumpTrajectory trajectory,
 					 double t);
 OQS_EXPORT int oqsJumpTrajectoryAdvance(OqsJumpTrajectory trajectory, double t);
 OQS_EXPORT double
 oqsJumpTrajectoryGetNextDecayNorm(OqsJumpTrajectory trajectory);
+/* Seeds the trajectory's built-in counter-based random number generator
+ * and makes it the active generator.  Trajectories with the same seed but
+ * different streams produce independent sequences, and a trajectory can be
+ * replayed by seeding it with the same (seed, stream) pair.  Also draws a
+ * new decay norm.  Until seeded, a trajectory uses OQS_PHILOX_DEFAULT_SEED
+ * and a stream of its own. */
+OQS_EXPORT void oqsJumpTrajectorySeed(OqsJumpTrajectory trajectory,
+				      uint64_t seed, uint64_t stream);
+/* Replaces the trajectory's source of random numbers.  A null rng restores
+ * the built-in generator. */
+OQS_EXPORT void oqsJumpTrajectorySetRng(OqsJumpTrajectory trajectory,
+					const struct OqsRng *rng);
+OQS_EXPORT void oqsJumpTrajectorySetNextDecayNorm(OqsJumpTrajectory trajectory,
+						  double z);
 OQS_EXPORT void
 oqsJumpTrajectorySetDecayTimeTolerance(OqsJumpTrajectory trajectory,
 				       double tol);
@@ -68,11 +171,91 @@ oqsJumpTrajectoryGetDecayTimeTolerance(OqsJumpTrajectory trajectory);
 OQS_EXPORT int oqsJumpTrajectoryGetDecay(OqsJumpTrajectory trajectory,
 					 int numDecayOps,
 					 struct OqsDecayOperator *decayOps);
+/* Preallocates the table used by oqsJumpTrajectoryGetDecay for
+ * numDecayOps operators with expectation callbacks, see
+ * oqsJumpTrajectorySetDecayExpectations. */
+OQS_EXPORT OQS_STATUS
+oqsJumpTrajectoryReserveDecayChannels(OqsJumpTrajectory trajectory,
+				      int numDecayOps);
+/* Declares state independent jump probabilities, c_i^\dagger c_i =
+ * rates[i] times the identity.  oqsJumpTrajectoryGetDecay then draws from an
+ * alias table in constant time without evaluating the operators whenever it
+ * is called with numDecayOps operators.  Zero operators clear the rates. */
+OQS_EXPORT OQS_STATUS oqsJumpTrajectorySetDecayRates(
+    OqsJumpTrajectory trajectory, int numDecayOps, const double *rates);
+/* Registers callbacks for the jump probabilities of decay operators.
+ * Whenever oqsJumpTrajectoryGetDecay is called with numDecayOps operators,
+ * expectations[i] is called with the ctx of operator i instead of applying
+ * it; null entries fall back to apply.  If all entries are set the channel
+ * is found by bisection of the cumulative jump probabilities.  The array
+ * is copied.  Zero operators clear the callbacks. */
+OQS_EXPORT OQS_STATUS oqsJumpTrajectorySetDecayExpectations(
+    OqsJumpTrajectory trajectory, int numDecayOps,
+    const OqsDecayExpectation *expectations);
+/* Applies decayOp to the state.  If decayOp is the operator returned by
+ * the preceding oqsJumpTrajectoryGetDecay and the state has not changed
+ * in between, the jumped state computed during the selection is reused. */
 OQS_EXPORT void oqsJumpTrajectoryApplyDecay(OqsJumpTrajectory trajectory,
 					    struct OqsDecayOperator *decayOp);
+/* Starts a new run from initialState at time t: restores the time step
+ * given to oqsJumpTrajectoryTimeStepHint, clears the statistics and draws a
+ * new decay norm.  The integrator, tolerances, equations and waiting time
+ * distribution tables are kept. */
 OQS_EXPORT void oqsJumpTrajectoryReset(OqsJumpTrajectory trajectory,
 				       const struct OqsAmplitude *initialState,
 				       double t);
+/* Enables waiting time distribution sampling for time independent
+ * Hamiltonians.  The evolution of a state after a jump is tabulated on
+ * numPoints grid points spaced by gridSpacing.  Tables for the last
+ * cacheSize states are kept, and states that differ only by a complex
+ * factor share a table.  A cacheSize of zero disables the tables. */
+OQS_EXPORT OQS_STATUS oqsJumpTrajectoryEnableWtd(OqsJumpTrajectory trajectory,
+						 double gridSpacing,
+						 size_t numPoints,
+						 int cacheSize);
+/* Same as oqsJumpTrajectoryAdvance but uses the tabulated norm decay to
+ * jump directly to the grid point preceding the next decay or the target
+ * time.  At most one grid interval is integrated, unless the target time or
+ * the decay lie beyond the end of the table. */
+OQS_EXPORT int oqsJumpTrajectoryAdvanceWtd(OqsJumpTrajectory trajectory,
+					   double t);
+OQS_EXPORT void oqsJumpTrajectoryGetStats(OqsJumpTrajectory trajectory,
+					  struct OqsTrajectoryStats *stats);
+OQS_EXPORT void oqsJumpTrajectoryResetStats(OqsJumpTrajectory trajectory);
+/* Enables or disables measuring wall clock times.  The timers add two clock
+ * reads per right hand side evaluation. */
+OQS_EXPORT void oqsJumpTrajectoryEnableTimers(OqsJumpTrajectory trajectory,
+					      int enable);
+/* Starts or stops appending every applied decay to the trajectory's jump
+ * record, e.g. for counting statistics and correlation functions without
+ * keeping states.  Room for capacity jumps is allocated up front; the
+ * record grows as needed beyond that.  oqsJumpTrajectoryReset clears the
+ * record but keeps its memory. */
+OQS_EXPORT OQS_STATUS
+oqsJumpTrajectoryEnableJumpRecord(OqsJumpTrajectory trajectory, int enable,
+				  size_t capacity);
+/* The recorded jumps in the order they occurred, valid until the next
+ * decay is applied.  Returns OQS_OUT_OF_MEMORY if jumps were dropped
+ * because the record could not grow. */
+OQS_EXPORT OQS_STATUS
+oqsJumpTrajectoryGetJumps(OqsJumpTrajectory trajectory,
+			  const struct OqsJumpRecord **jumps,
+			  size_t *numJumps);
+OQS_EXPORT void oqsJumpTrajectoryClearJumps(OqsJumpTrajectory trajectory);
+/* Writes the state, time, time step, decay norm, built-in random number
+ * generator and statistics to a binary checkpoint.  The file is replaced
+ * atomically.  Callbacks, a custom generator set with
+ * oqsJumpTrajectorySetRng, the configuration and the jump record are not
+ * saved. */
+OQS_EXPORT OQS_STATUS oqsJumpTrajectorySave(OqsJumpTrajectory trajectory,
+					    const char *path);
+/* Restores a checkpoint into a trajectory of the same dimension and layout,
+ * which continues exactly like the saved one.  Returns OQS_IO_ERROR if the
+ * file can't be opened, OQS_FORMAT_ERROR if it isn't a trajectory
+ * checkpoint of this version and OQS_INVALID_ARGUMENT if the dimension or
+ * layout differ.  The trajectory is unchanged on failure. */
+OQS_EXPORT OQS_STATUS oqsJumpTrajectoryLoad(OqsJumpTrajectory trajectory,
+					    const char *path);
 
 #ifdef __cplusplus
 }
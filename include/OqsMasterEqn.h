@@ -0,0 +1,91 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_MASTER_EQN_H
+#define OQS_MASTER_EQN_H
+
+#include <stdlib.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsAmplitude.h>
+#include <OqsJumpTrajectory.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Deterministic evolution of the density matrix.
+ *
+ * Solves the Lindblad master equation whose unravelling is simulated by
+ * OqsJumpTrajectory, with the same callbacks: the Schrodinger equation
+ * computes -i H_eff x with H_eff = H - i/2 sum_k c_k^\dagger c_k, and the
+ * decay operators apply the c_k.  Then
+ *
+ *   d rho / dt = -i H_eff rho + h.c. + sum_k c_k rho c_k^\dagger.
+ *
+ * rho is a Hermitian dim x dim matrix in column major order.  The memory
+ * grows with dim^2 and a right hand side evaluation costs dim Schrodinger
+ * equation and 2 dim decay operator evaluations per operator, so for small
+ * systems this is cheaper than averaging many trajectories.  Only the
+ * interleaved layout is supported.
+ * */
+struct OqsObservable;
+struct OqsMasterEqn_;
+typedef struct OqsMasterEqn_ *OqsMasterEqn;
+
+OQS_EXPORT OQS_STATUS oqsMasterEqnCreate(size_t dim, OqsMasterEqn *master);
+OQS_EXPORT OQS_STATUS oqsMasterEqnDestroy(OqsMasterEqn *master);
+OQS_EXPORT OQS_STATUS
+oqsMasterEqnSetSchrodingerEqn(OqsMasterEqn master,
+			      struct OqsSchrodingerEqn *eqn);
+/* The decay operators are not copied and have to outlive their use. */
+OQS_EXPORT OQS_STATUS
+oqsMasterEqnSetDecayOperators(OqsMasterEqn master, int numDecayOps,
+			      struct OqsDecayOperator *decayOps);
+OQS_EXPORT OQS_STATUS oqsMasterEqnSetIntegrator(OqsMasterEqn master,
+						enum OqsIntegratorType type);
+OQS_EXPORT void oqsMasterEqnTimeStepHint(OqsMasterEqn master, double dt);
+OQS_EXPORT void oqsMasterEqnSetTolerances(OqsMasterEqn master,
+					  double absTol, double relTol);
+OQS_EXPORT size_t oqsMasterEqnGetDim(OqsMasterEqn master);
+/* Sets rho to the given density matrix. */
+OQS_EXPORT void oqsMasterEqnSetDensityMatrix(OqsMasterEqn master,
+					     const struct OqsAmplitude *rho);
+/* Sets rho to the pure state |x><x| / <x|x>. */
+OQS_EXPORT OQS_STATUS oqsMasterEqnSetState(OqsMasterEqn master,
+					   const struct OqsAmplitude *x);
+/* The returned matrix is only valid until the master equation is
+ * advanced. */
+OQS_EXPORT struct OqsAmplitude *
+oqsMasterEqnGetDensityMatrix(OqsMasterEqn master);
+OQS_EXPORT double oqsMasterEqnGetTime(OqsMasterEqn master);
+OQS_EXPORT void oqsMasterEqnSetTime(OqsMasterEqn master, double t);
+/* Advances rho to time t. */
+OQS_EXPORT void oqsMasterEqnAdvance(OqsMasterEqn master, double t);
+/* Re tr(A rho) / tr(rho), i.e. the expectation value an accumulator
+ * records for trajectories, averaged over the ensemble. */
+OQS_EXPORT double
+oqsMasterEqnGetExpectation(OqsMasterEqn master,
+			   const struct OqsObservable *observable);
+OQS_EXPORT double oqsMasterEqnGetTrace(OqsMasterEqn master);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
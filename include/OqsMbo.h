@@ -41,6 +41,36 @@ OQS_EXPORT OQS_STATUS oqsMboCreateSchrodingerEqn(MboTensorOp hamiltonian,
 						 struct OqsSchrodingerEqn *eqn);
 OQS_EXPORT OQS_STATUS
 oqsMboDestroySchrodingerEqn(struct OqsSchrodingerEqn *eqn);
+/* Variants for trajectories with the given state layout.  dim is the
+ * dimension of the Hilbert space, which is only used for the split
+ * layout. */
+OQS_EXPORT OQS_STATUS oqsMboCreateDecayOperatorWithLayout(
+    MboTensorOp op, size_t dim, enum OqsLayout layout,
+    struct OqsDecayOperator *dop);
+OQS_EXPORT OQS_STATUS oqsMboCreateSchrodingerEqnWithLayout(
+    MboTensorOp hamiltonian, size_t dim, enum OqsLayout layout,
+    struct OqsSchrodingerEqn *eqn);
+
+/* Creates the Schrodinger equation with the effective Hamiltonian
+ * H - i/2 sum_k c_k^\dagger c_k of a jump trajectory and the decay
+ * operators c_k.  The effective Hamiltonian is compiled into a single
+ * operator, so a right hand side evaluation costs one matrix vector
+ * product regardless of the number of decay channels.  MBO builds the
+ * adjoints c_k^\dagger from the adjoint elementary operators just like the
+ * c_k, so both are passed in.  decayOps has room for numDecayOps
+ * operators.  Release with oqsMboDestroyEffectiveSchrodingerEqn. */
+OQS_EXPORT OQS_STATUS oqsMboCreateEffectiveSchrodingerEqn(
+    MboTensorOp hamiltonian, int numDecayOps, MboTensorOp *jumpOps,
+    MboTensorOp *jumpOpsAdjoint, struct OqsSchrodingerEqn *eqn,
+    struct OqsDecayOperator *decayOps);
+OQS_EXPORT OQS_STATUS oqsMboCreateEffectiveSchrodingerEqnWithLayout(
+    MboTensorOp hamiltonian, int numDecayOps, MboTensorOp *jumpOps,
+    MboTensorOp *jumpOpsAdjoint, size_t dim, enum OqsLayout layout,
+    struct OqsSchrodingerEqn *eqn, struct OqsDecayOperator *decayOps);
+OQS_EXPORT OQS_STATUS
+oqsMboDestroyEffectiveSchrodingerEqn(struct OqsSchrodingerEqn *eqn,
+				     int numDecayOps,
+				     struct OqsDecayOperator *decayOps);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,91 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_PARALLEL_H
+#define OQS_PARALLEL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsJumpTrajectory.h>
+#include <OqsAccumulator.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Work to be done by oqsRunTrajectories.
+ *
+ * setup is called once per worker thread with that thread's trajectory,
+ * e.g. to install the Schrodinger equation.  It may be null.  run is called
+ * exactly once for every trajectory index.  Before run is called the
+ * trajectory's random number generator is seeded with the run's seed and
+ * the trajectory index, so results only depend on the index and not on
+ * the number of threads or on which thread ran the trajectory.  Which
+ * indices a thread runs depends on the scheduling, however, so reductions
+ * into per-thread storage are not reproducible.  Use
+ * oqsSampleTrajectories for statistics that are.
+ * */
+struct OqsTrajectoryTask {
+	OQS_STATUS (*setup)(OqsJumpTrajectory trajectory, int thread,
+			    void *ctx);
+	void (*run)(OqsJumpTrajectory trajectory, size_t index, int thread,
+		    void *ctx);
+	void *ctx;
+};
+
+/* Runs numTrajectories trajectories of dimension dim on numThreads worker
+ * threads.  If numThreads is less than one the number of online processors
+ * is used.  Trajectory indices are distributed in contiguous blocks; idle
+ * threads steal half of the remaining indices of a busy thread. */
+OQS_EXPORT OQS_STATUS oqsRunTrajectories(size_t dim, size_t numTrajectories,
+					 int numThreads, uint64_t seed,
+					 struct OqsTrajectoryTask *task);
+
+/**
+ * @brief Sampling done by oqsSampleTrajectories.
+ *
+ * Like OqsTrajectoryTask, except that sample records trajectory index into
+ * the given accumulator, e.g. with oqsAccumulatorSampleTrajectory.
+ * */
+struct OqsSamplingTask {
+	OQS_STATUS (*setup)(OqsJumpTrajectory trajectory, int thread,
+			    void *ctx);
+	void (*sample)(OqsJumpTrajectory trajectory, size_t index,
+		       OqsAccumulator accumulator, void *ctx);
+	void *ctx;
+};
+
+/* Runs the trajectories like oqsRunTrajectories and adds their samples to
+ * accumulator.  The indices are divided into blocks of blockSize
+ * consecutive trajectories.  Each block is sampled in index order into an
+ * accumulator of its own, and the blocks are merged into accumulator in
+ * index order.  The result therefore depends on blockSize but is
+ * reproducible for any number of threads.  The block accumulators are
+ * kept until all trajectories have run. */
+OQS_EXPORT OQS_STATUS
+oqsSampleTrajectories(size_t dim, size_t numTrajectories, size_t blockSize,
+		      int numThreads, uint64_t seed,
+		      struct OqsSamplingTask *task, OqsAccumulator accumulator);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
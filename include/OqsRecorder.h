@@ -0,0 +1,108 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_RECORDER_H
+#define OQS_RECORDER_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum OqsRecordKind {
+	OQS_RECORD_JUMPS = 1,
+	OQS_RECORD_SAMPLES
+};
+
+/* A recorder writes jumps and sampled observables of many trajectories to
+ * an append-only binary file.  Records are collected in blocks by streams,
+ * one per producing thread, without locking.  Full blocks are handed to a
+ * writer thread, so integration only waits for a lock once per block and
+ * never for the disk.  Each block is written as a chunk of columns, see
+ * struct OqsRecordChunk. */
+struct OqsRecorder_;
+typedef struct OqsRecorder_ *OqsRecorder;
+struct OqsRecorderStream_;
+typedef struct OqsRecorderStream_ *OqsRecorderStream;
+
+/* Creates path, replacing an existing file.  Samples consist of
+ * numObservables values. */
+OQS_EXPORT OQS_STATUS oqsRecorderCreate(const char *path, int numObservables,
+					OqsRecorder *recorder);
+/* Writes the outstanding blocks and closes the file.  All streams must have
+ * been destroyed.  Returns the first error encountered while writing, after
+ * which no further blocks are written. */
+OQS_EXPORT OQS_STATUS oqsRecorderDestroy(OqsRecorder *recorder);
+/* Waits until all blocks handed to the writer are in the file.  Records
+ * still held by streams are not included. */
+OQS_EXPORT OQS_STATUS oqsRecorderFlush(OqsRecorder recorder);
+
+/* A stream must only be used by one thread at a time. */
+OQS_EXPORT OQS_STATUS oqsRecorderStreamCreate(OqsRecorder recorder,
+					      OqsRecorderStream *stream);
+/* Hands the remaining records to the writer. */
+OQS_EXPORT OQS_STATUS oqsRecorderStreamDestroy(OqsRecorderStream *stream);
+OQS_EXPORT OQS_STATUS oqsRecorderStreamFlush(OqsRecorderStream stream);
+/* Records a jump of the given trajectory at time t through decay channel
+ * channel, e.g. the index returned by oqsJumpTrajectoryGetDecay. */
+OQS_EXPORT OQS_STATUS oqsRecorderStreamJump(OqsRecorderStream stream,
+					    uint64_t trajectory, double t,
+					    int channel);
+/* Records the numObservables values of the given trajectory at time t. */
+OQS_EXPORT OQS_STATUS oqsRecorderStreamSample(OqsRecorderStream stream,
+					      uint64_t trajectory, double t,
+					      const double *values);
+
+/**
+ * @brief Records written from one block.
+ *
+ * The columns point into the mapped file and are 64 byte aligned.  For
+ * samples, observable i of record j is values[i * numRecords + j].
+ * channels is null for samples and values is null for jumps.
+ * */
+struct OqsRecordChunk {
+	enum OqsRecordKind kind;
+	size_t numRecords;
+	const uint64_t *trajectories;
+	const double *times;
+	const int32_t *channels;
+	const double *values;
+};
+
+/* Read-only memory mapping of a recorded file.  A chunk that was cut off,
+ * e.g. because the writing process was killed, and everything after it is
+ * ignored. */
+struct OqsRecording_;
+typedef struct OqsRecording_ *OqsRecording;
+
+OQS_EXPORT OQS_STATUS oqsRecordingOpen(const char *path,
+				       OqsRecording *recording);
+OQS_EXPORT OQS_STATUS oqsRecordingClose(OqsRecording *recording);
+OQS_EXPORT int oqsRecordingGetNumObservables(OqsRecording recording);
+OQS_EXPORT size_t oqsRecordingGetNumChunks(OqsRecording recording);
+OQS_EXPORT void oqsRecordingGetChunk(OqsRecording recording, size_t i,
+				     struct OqsRecordChunk *chunk);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,70 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_RNG_H
+#define OQS_RNG_H
+
+#include <stdint.h>
+#include <OqsExport.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Source of uniformly distributed random numbers in [0, 1).
+ * */
+struct OqsRng {
+	double (*uniform)(void *ctx);
+	void *ctx;
+};
+
+/**
+ * @brief Philox4x32-10 counter-based random number generator.
+ *
+ * The seed is used as the key and the stream as the upper half of the
+ * counter.  Different (seed, stream) pairs yield independent sequences
+ * and each generator is a few words of plain data, so it can be copied,
+ * stored, and replayed.
+ * */
+struct OqsPhilox {
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t output[4];
+	int used; /**< Number of words of output that have been consumed */
+};
+
+/* Key of the generators of objects that were not seeded explicitly.  Each
+ * such object gets its own streams from oqsPhiloxReserveStreams. */
+#define OQS_PHILOX_DEFAULT_SEED UINT64_C(0x5851F42D4C957F2D)
+
+OQS_EXPORT void oqsPhilox4x32(const uint32_t counter[4],
+			      const uint32_t key[2], uint32_t output[4]);
+OQS_EXPORT void oqsPhiloxInit(struct OqsPhilox *rng, uint64_t seed,
+			      uint64_t stream);
+/* Positions the generator at the n-th number of its stream. */
+OQS_EXPORT void oqsPhiloxSetPosition(struct OqsPhilox *rng, uint64_t n);
+OQS_EXPORT double oqsPhiloxUniform(void *rng);
+/* Reserves n consecutive streams that no earlier call in this process
+ * returned and returns the first of them.  Thread-safe. */
+OQS_EXPORT uint64_t oqsPhiloxReserveStreams(uint64_t n);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,71 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OQS_TRAJECTORY_POOL_H
+#define OQS_TRAJECTORY_POOL_H
+
+#include <stdlib.h>
+#include <OqsErrors.h>
+#include <OqsExport.h>
+#include <OqsJumpTrajectory.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Idle trajectories kept for reuse.
+ *
+ * Trajectories are keyed by dimension and layout.  A trajectory handed out
+ * by oqsTrajectoryPoolAcquire keeps the configuration of its previous user,
+ * i.e. integrator, tolerances, equations and waiting time distribution
+ * tables, and should be started with oqsJumpTrajectoryReset.  Once the pool
+ * holds as many trajectories as are in use at a time, acquiring and
+ * releasing them does not allocate memory.  Pools are not thread safe.
+ * */
+struct OqsTrajectoryPool_;
+typedef struct OqsTrajectoryPool_ *OqsTrajectoryPool;
+
+OQS_EXPORT OQS_STATUS oqsTrajectoryPoolCreate(OqsTrajectoryPool *pool);
+/* Destroys the idle trajectories.  Trajectories that have not been released
+ * remain valid and have to be destroyed by the caller. */
+OQS_EXPORT OQS_STATUS oqsTrajectoryPoolDestroy(OqsTrajectoryPool *pool);
+/* Makes sure the pool holds at least n idle trajectories. */
+OQS_EXPORT OQS_STATUS oqsTrajectoryPoolReserve(OqsTrajectoryPool pool,
+					       size_t dim,
+					       enum OqsLayout layout, int n);
+/* Hands out the most recently released idle trajectory, or creates one if
+ * there is none. */
+OQS_EXPORT OQS_STATUS oqsTrajectoryPoolAcquire(OqsTrajectoryPool pool,
+					       size_t dim,
+					       enum OqsLayout layout,
+					       OqsJumpTrajectory *trajectory);
+/* Returns a trajectory to the pool and clears the caller's handle.
+ * Trajectories not obtained from the pool may be released too, except
+ * those created by oqsJumpTrajectoryCreateMany, which fail with
+ * OQS_INVALID_ARGUMENT and stay with the caller.  If the pool can't grow
+ * the trajectory is destroyed and OQS_OUT_OF_MEMORY returned. */
+OQS_EXPORT OQS_STATUS oqsTrajectoryPoolRelease(OqsTrajectoryPool pool,
+					       OqsJumpTrajectory *trajectory);
+/* The number of idle trajectories. */
+OQS_EXPORT int oqsTrajectoryPoolGetNumIdle(OqsTrajectoryPool pool);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,103 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <ChannelTable.h>
+#include <stdlib.h>
+
+int channelSearch(const double *cumulative, int n, double u)
+{
+	int lo = 0, hi = n - 1, mid;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (cumulative[mid] > u) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
+OQS_STATUS aliasTableCreate(struct AliasTable *table, int n,
+			    const double *weights)
+{
+	double total = 0;
+	int *worklist;
+	int i, numSmall, numLarge, s, l;
+
+	for (i = 0; i < n; ++i) {
+		if (!(weights[i] >= 0)) return OQS_INVALID_ARGUMENT;
+		total += weights[i];
+	}
+	if (n <= 0 || !(total > 0)) return OQS_INVALID_ARGUMENT;
+
+	table->n = n;
+	table->prob = (double *)malloc(n * sizeof(*table->prob));
+	table->alias = (int *)malloc(n * sizeof(*table->alias));
+	/* Columns with less than average weight are stacked from the front,
+	 * the others from the back. */
+	worklist = (int *)malloc(n * sizeof(*worklist));
+	if (table->prob == 0 || table->alias == 0 || worklist == 0) {
+		free(worklist);
+		aliasTableDestroy(table);
+		return OQS_OUT_OF_MEMORY;
+	}
+	numSmall = 0;
+	numLarge = 0;
+	for (i = 0; i < n; ++i) {
+		table->prob[i] = weights[i] * n / total;
+		table->alias[i] = i;
+		if (table->prob[i] < 1.0) {
+			worklist[numSmall++] = i;
+		} else {
+			worklist[n - 1 - numLarge++] = i;
+		}
+	}
+	while (numSmall > 0 && numLarge > 0) {
+		s = worklist[--numSmall];
+		l = worklist[n - numLarge];
+		table->alias[s] = l;
+		table->prob[l] -= 1.0 - table->prob[s];
+		if (table->prob[l] < 1.0) {
+			--numLarge;
+			worklist[numSmall++] = l;
+		}
+	}
+	/* What is left over differs from 1 by round off only. */
+	for (i = 0; i < numSmall; ++i) table->prob[worklist[i]] = 1.0;
+	for (i = 0; i < numLarge; ++i) table->prob[worklist[n - 1 - i]] = 1.0;
+	free(worklist);
+	return OQS_SUCCESS;
+}
+
+void aliasTableDestroy(struct AliasTable *table)
+{
+	free(table->prob);
+	free(table->alias);
+	table->prob = 0;
+	table->alias = 0;
+	table->n = 0;
+}
+
+int aliasTableSample(const struct AliasTable *table, double u)
+{
+	double x = u * table->n;
+	int k = (int)x;
+	if (k >= table->n) k = table->n - 1;
+	return x - k < table->prob[k] ? k : table->alias[k];
+}
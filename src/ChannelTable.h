@@ -0,0 +1,53 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CHANNEL_TABLE_H
+#define CHANNEL_TABLE_H
+
+#include <OqsErrors.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the index of the first entry of the nondecreasing array
+ * cumulative[0..n) that exceeds u, or n - 1 if there is none.  O(log n). */
+int channelSearch(const double *cumulative, int n, double u);
+
+/* Walker's alias table for sampling from a fixed discrete distribution in
+ * constant time. */
+struct AliasTable {
+	int n;
+	/* Probability of keeping column k rather than taking alias[k] */
+	double *prob;
+	int *alias;
+};
+
+/* Builds the table for the n nonnegative weights, which need not be
+ * normalized but must not all vanish.  Uses Vose's O(n) construction. */
+OQS_STATUS aliasTableCreate(struct AliasTable *table, int n,
+			    const double *weights);
+void aliasTableDestroy(struct AliasTable *table);
+/* Maps a uniform deviate u in [0, 1) to an index in [0, n). */
+int aliasTableSample(const struct AliasTable *table, double u);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
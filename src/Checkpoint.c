@@ -0,0 +1,144 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Checkpoint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char checkpointMagic[8] = "OQSCKPT";
+static const uint32_t checkpointByteOrder = 0x01020304;
+
+/* Path of the temporary file, to be freed by the caller. */
+static char *temporaryPath(const char *path)
+{
+	size_t n = strlen(path) + sizeof(".tmp");
+	char *tmp = malloc(n);
+	if (tmp) snprintf(tmp, n, "%s.tmp", path);
+	return tmp;
+}
+
+void checkpointMakeHeader(struct CheckpointHeader *header,
+			  enum CheckpointKind kind, const uint64_t shape[4])
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, checkpointMagic, sizeof(header->magic));
+	header->version = CHECKPOINT_VERSION;
+	header->byteOrder = checkpointByteOrder;
+	header->kind = kind;
+	memcpy(header->shape, shape, sizeof(header->shape));
+}
+
+OQS_STATUS checkpointBegin(const char *path, enum CheckpointKind kind,
+			   const uint64_t shape[4], FILE **f)
+{
+	struct CheckpointHeader header;
+	OQS_STATUS stat;
+	char *tmp = temporaryPath(path);
+
+	*f = 0;
+	if (tmp == 0) return OQS_OUT_OF_MEMORY;
+	*f = fopen(tmp, "wb");
+	free(tmp);
+	if (*f == 0) return OQS_IO_ERROR;
+	checkpointMakeHeader(&header, kind, shape);
+	stat = checkpointWrite(*f, &header, sizeof(header));
+	if (stat != OQS_SUCCESS) {
+		checkpointCommit(path, *f, stat);
+		*f = 0;
+	}
+	return stat;
+}
+
+OQS_STATUS checkpointCommit(const char *path, FILE *f, OQS_STATUS stat)
+{
+	char *tmp = temporaryPath(path);
+	if (fclose(f) != 0 && stat == OQS_SUCCESS) stat = OQS_IO_ERROR;
+	if (tmp == 0) return OQS_OUT_OF_MEMORY;
+	if (stat == OQS_SUCCESS && rename(tmp, path) != 0) {
+		stat = OQS_IO_ERROR;
+	}
+	if (stat != OQS_SUCCESS) remove(tmp);
+	free(tmp);
+	return stat;
+}
+
+OQS_STATUS checkpointCheckHeader(const struct CheckpointHeader *header,
+				 enum CheckpointKind kind,
+				 const uint64_t shape[4])
+{
+	struct CheckpointHeader expected;
+	checkpointMakeHeader(&expected, kind, shape);
+	if (memcmp(header->magic, expected.magic, sizeof(header->magic)) ||
+	    header->version != expected.version ||
+	    header->byteOrder != expected.byteOrder ||
+	    header->kind != expected.kind) {
+		return OQS_FORMAT_ERROR;
+	}
+	if (memcmp(header->shape, expected.shape, sizeof(header->shape))) {
+		return OQS_INVALID_ARGUMENT;
+	}
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS checkpointOpen(const char *path, enum CheckpointKind kind,
+			  const uint64_t shape[4], FILE **f)
+{
+	struct CheckpointHeader header;
+	OQS_STATUS stat;
+
+	*f = fopen(path, "rb");
+	if (*f == 0) return OQS_IO_ERROR;
+	stat = checkpointRead(*f, &header, sizeof(header));
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointCheckHeader(&header, kind, shape);
+	}
+	if (stat != OQS_SUCCESS) {
+		fclose(*f);
+		*f = 0;
+	}
+	return stat;
+}
+
+static size_t paddingOf(size_t n)
+{
+	return (CHECKPOINT_ALIGNMENT - n % CHECKPOINT_ALIGNMENT) %
+	       CHECKPOINT_ALIGNMENT;
+}
+
+OQS_STATUS checkpointWrite(FILE *f, const void *data, size_t n)
+{
+	if (fwrite(data, 1, n, f) != n) return OQS_IO_ERROR;
+	return checkpointPad(f, n);
+}
+
+OQS_STATUS checkpointPad(FILE *f, size_t n)
+{
+	static const char zeros[CHECKPOINT_ALIGNMENT];
+	size_t padding = paddingOf(n);
+	if (fwrite(zeros, 1, padding, f) != padding) return OQS_IO_ERROR;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS checkpointRead(FILE *f, void *data, size_t n)
+{
+	char padding[CHECKPOINT_ALIGNMENT];
+	size_t m = paddingOf(n);
+	if (fread(data, 1, n, f) != n) return OQS_FORMAT_ERROR;
+	if (fread(padding, 1, m, f) != m) return OQS_FORMAT_ERROR;
+	return OQS_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <OqsErrors.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Checkpoint files start with a 64 byte header followed by sections.
+ * Every section starts at a multiple of CHECKPOINT_ALIGNMENT bytes, so
+ * that the states in a mapped file are aligned like the buffers of the
+ * objects they are loaded into.  Numbers are stored in the native byte
+ * order, which is recorded in the header. */
+#define CHECKPOINT_ALIGNMENT 64
+#define CHECKPOINT_VERSION 1
+
+enum CheckpointKind {
+	CHECKPOINT_TRAJECTORY = 1,
+	CHECKPOINT_ENSEMBLE,
+	CHECKPOINT_ACCUMULATOR,
+	/* Append-only recording, see OqsRecorder.c */
+	CHECKPOINT_RECORDING
+};
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t kind;
+	uint32_t reserved;
+	/* Sizes the file has to agree with, meaning depends on kind */
+	uint64_t shape[4];
+	char padding[8];
+};
+
+void checkpointMakeHeader(struct CheckpointHeader *header,
+			  enum CheckpointKind kind, const uint64_t shape[4]);
+/* Returns OQS_FORMAT_ERROR if header is not of this kind and version and
+ * OQS_INVALID_ARGUMENT if the shape differs. */
+OQS_STATUS checkpointCheckHeader(const struct CheckpointHeader *header,
+				 enum CheckpointKind kind,
+				 const uint64_t shape[4]);
+/* Opens a temporary file next to path and writes the header.  The
+ * checkpoint only replaces path in checkpointCommit, so an interrupted
+ * save leaves the previous checkpoint intact.  On failure nothing is left
+ * to commit. */
+OQS_STATUS checkpointBegin(const char *path, enum CheckpointKind kind,
+			   const uint64_t shape[4], FILE **f);
+/* Closes f and renames it to path if stat and all writes succeeded,
+ * removes it otherwise.  Returns the resulting status. */
+OQS_STATUS checkpointCommit(const char *path, FILE *f, OQS_STATUS stat);
+/* Opens path and checks its header.  Returns OQS_INVALID_ARGUMENT if the
+ * shape differs. */
+OQS_STATUS checkpointOpen(const char *path, enum CheckpointKind kind,
+			  const uint64_t shape[4], FILE **f);
+/* Write and read one section of n bytes. */
+OQS_STATUS checkpointWrite(FILE *f, const void *data, size_t n);
+/* Ends a section of n bytes that was written piecewise. */
+OQS_STATUS checkpointPad(FILE *f, size_t n);
+OQS_STATUS checkpointRead(FILE *f, void *data, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <DecayTime.h>
+#include <Kernels.h>
+#include <math.h>
+#include <assert.h>
+
+double findDecayTime(struct Integrator *integrator,
+		     const struct OqsAmplitude *x0, struct OqsAmplitude *x,
+		     size_t begin, size_t end, double tLeft, double tRight,
+		     double z, double timeTolerance, double normTolerance,
+		     int *numIterations)
+{
+	double tGuess, normGuess, normLeft, normRight, tState;
+	int side = 0, newSide, repeats = 0, iterations = 0;
+	tState = tRight;
+	assert(tRight > tLeft);
+	normLeft = kernelNormSquared(x0 + begin, end - begin);
+	assert(normLeft >= z);
+	normRight = kernelNormSquared(x + begin, end - begin);
+	assert(normRight <= z);
+
+	while (tRight - tLeft > timeTolerance) {
+		// To find the decay time we assume that the square of the norm
+		// decays exponentially during the integration time interval.
+		// This is typically a better approximation than linear
+		// variation (which would lead to the secant method).
+		// Exponential decay is still monotonically decreasing, so we
+		// maintain the bracketing property of the secand method.  To
+		// find the new guess for the decay time based on the left and
+		// right ends of the interval, we use that
+		//      n(t) = nL exp(-gamma (t - tL))
+		// where nL is the norm at the beginning of the interval, tL.
+		// To find gamma we use that
+		//      n(tR) = nL exp(-gamma * (tR - tL)) == nR
+		//      => gamma = -log(nR / nL) / (tR - tL)
+		// The guess for the decay time is then found by solving
+		//      n(tGuess) == z
+		//      => nL exp(log(nR /nL)(tGuess - tL) / (tR - tL)) == z
+		//      => log(nR / nL)(tGuess - tL)/(tR - tL) = log (z / nL)
+		//      => tGuess = tL + (tR - tL) * log (z / nL) / log(nR / nL)
+		// Like regula falsi this can get stuck on one side of the
+		// interval, in which case we fall back to bisection.
+		if (repeats < 2 && normRight < normLeft) {
+			tGuess = tLeft +
+				 (tRight - tLeft) *
+				     log(z / normLeft) /
+				     log(normRight / normLeft);
+		} else {
+			tGuess = 0.5 * (tLeft + tRight);
+			repeats = 0;
+		}
+
+		integratorInterpolateRange(integrator, tGuess, x0, x, begin,
+					   end);
+		++iterations;
+		tState = tGuess;
+		normGuess = kernelNormSquared(x + begin, end - begin);
+		if (fabs(normGuess - z) <
+		    normTolerance) {
+			tRight = tGuess;
+			break;
+		}
+		if (normGuess > z) {
+			newSide = -1;
+			normLeft = normGuess;
+			tLeft = tGuess;
+		} else {
+			newSide = 1;
+			normRight = normGuess;
+			tRight = tGuess;
+		}
+		repeats = newSide == side ? repeats + 1 : 0;
+		side = newSide;
+	}
+	if (tState != tRight) {
+		integratorInterpolateRange(integrator, tRight, x0, x, begin,
+					   end);
+		++iterations;
+	}
+	if (numIterations) *numIterations = iterations;
+	return tRight;
+}
+
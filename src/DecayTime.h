@@ -0,0 +1,48 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DECAY_TIME_H
+#define DECAY_TIME_H
+
+#include <stdlib.h>
+#include <OqsAmplitude.h>
+#include <Integrator.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Locates the time at which the squared norm of the components [begin, end)
+ * of the state crosses z within the last step taken by integrator, using
+ * the integrator's continuous extension.  x0 holds the state at the start
+ * of the step (time tLeft) and x the state at tRight.  On exit the
+ * components [begin, end) of x hold the state at the returned decay time.
+ * No right hand side evaluations are performed apart from the one the
+ * continuous extension of lsrk4 needs.  If numIterations isn't null the
+ * number of evaluations of the continuous extension is stored there. */
+double findDecayTime(struct Integrator *integrator,
+		     const struct OqsAmplitude *x0, struct OqsAmplitude *x,
+		     size_t begin, size_t end, double tLeft, double tRight,
+		     double z, double timeTolerance, double normTolerance,
+		     int *numIterations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
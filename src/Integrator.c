@@ -17,31 +17,126 @@ You should have received a copy of the GNU General Public License along
 with oqs.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <Integrator.h>
+#include <Kernels.h>
+#include <Memory.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 struct RK4_ctx {
 	struct OqsAmplitude *k1, *k2, *k3, *k4, *work;
+	/* Start time and length of the last step */
+	double t0, h;
+	/* Whether the stages have been zeroed.  That is left to the first step
+	 * so that the thread taking the steps places their pages. */
+	int touched;
+	/* Owns the context and the stages unless they were taken from the
+	 * arena of another object */
+	struct Arena arena;
 };
 
-void rk4_create(struct Integrator *self, size_t dim);
+static void rk4_reserve(struct Arena *arena, size_t dim);
+static void rk4_take(struct Integrator *self, struct Arena *arena,
+		     size_t dim);
+
 void rk4_destroy(struct Integrator *self);
-void rk4_takeStep(struct Integrator *self, struct OqsAmplitude *x, RHS f,
-		  void *ctx);
+double rk4_takeStep(struct Integrator *self, const struct OqsAmplitude *x0,
+		    struct OqsAmplitude *x, RHS f, void *ctx);
 void rk4_advanceBeyond(struct Integrator *self, double t,
 		       struct OqsAmplitude *x, RHS f, void *ctx);
 void rk4_advanceTo(struct Integrator *self, double t, struct OqsAmplitude *x,
 		   RHS f, void *ctx);
+void rk4_interpolate(struct Integrator *self, double t,
+		     const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+		     size_t begin, size_t end);
+
+struct LSRK4_ctx {
+	/* Second register and the right hand side of the current stage.
+	 * After a step k is reused for the slope at its start. */
+	struct OqsAmplitude *dx, *k;
+	/* Whether k holds the slope at the start of the last step */
+	int haveSlope;
+	/* Right hand side of the last step */
+	RHS f;
+	void *fctx;
+	/* Start time and length of the last step */
+	double t0, h;
+	/* Owns the context and the registers */
+	struct Arena arena;
+};
+
+void lsrk4_destroy(struct Integrator *self);
+double lsrk4_takeStep(struct Integrator *self, const struct OqsAmplitude *x0,
+		      struct OqsAmplitude *x, RHS f, void *ctx);
+void lsrk4_advanceBeyond(struct Integrator *self, double t,
+			 struct OqsAmplitude *x, RHS f, void *ctx);
+void lsrk4_advanceTo(struct Integrator *self, double t,
+		     struct OqsAmplitude *x, RHS f, void *ctx);
+void lsrk4_interpolate(struct Integrator *self, double t,
+		       const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+		       size_t begin, size_t end);
+
+struct DOPRI5_ctx {
+	struct OqsAmplitude *k1, *k2, *k3, *k4, *k5, *k6, *k7, *work;
+	/* Whether k1 holds the right hand side at the current state. */
+	int fsal;
+	/* Start time and length of the last accepted step */
+	double t0, h;
+	/* Owns the context and the stages */
+	struct Arena arena;
+};
+
+void dopri5_destroy(struct Integrator *self);
+double dopri5_takeStep(struct Integrator *self,
+		       const struct OqsAmplitude *x0, struct OqsAmplitude *x,
+		       RHS f, void *ctx);
+void dopri5_advanceBeyond(struct Integrator *self, double t,
+			  struct OqsAmplitude *x, RHS f, void *ctx);
+void dopri5_advanceTo(struct Integrator *self, double t,
+		      struct OqsAmplitude *x, RHS f, void *ctx);
+void dopri5_interpolate(struct Integrator *self, double t,
+			const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+			size_t begin, size_t end);
+void dopri5_invalidate(struct Integrator *self);
 
 void integratorCreate(struct Integrator *integrator, size_t dim)
 {
-	integrator->ops.create = &rk4_create;
+	integratorCreateWith(integrator, dim, &rk4_create);
+}
+
+static void integratorInit(struct Integrator *integrator, size_t dim,
+			   void (*create)(struct Integrator *, size_t))
+{
+	memset(&integrator->ops, 0, sizeof(integrator->ops));
+	integrator->ops.create = create;
 	integrator->t = 0;
 	integrator->dt = 1.0e-3;
+	integrator->absTol = 1.0e-8;
+	integrator->relTol = 1.0e-8;
 	integrator->dim = dim;
+	integrator->splitDim = 0;
 	integrator->data = 0;
+}
+
+void integratorCreateWith(struct Integrator *integrator, size_t dim,
+			  void (*create)(struct Integrator *, size_t))
+{
+	integratorInit(integrator, dim, create);
 	integrator->ops.create(integrator, dim);
 }
 
+void integratorReserve(struct Arena *arena, size_t dim)
+{
+	rk4_reserve(arena, dim);
+}
+
+void integratorCreateFrom(struct Integrator *integrator,
+			  struct Arena *arena, size_t dim)
+{
+	integratorInit(integrator, dim, &rk4_create);
+	rk4_take(integrator, arena, dim);
+}
+
 void integratorDestroy(struct Integrator* integrator)
 {
 	if (integrator->ops.destroy) {
@@ -52,6 +147,7 @@ void integratorDestroy(struct Integrator* integrator)
 void integratorSetTime(struct Integrator *integrator, double t)
 {
 	integrator->t = t;
+	integratorInvalidate(integrator);
 }
 
 double integratorGetTime(struct Integrator *integrator)
@@ -64,10 +160,31 @@ void integratorTimeStepHint(struct Integrator *integrator, double dt)
 	integrator->dt = dt;
 }
 
+void integratorSetTolerances(struct Integrator *integrator, double absTol,
+			     double relTol)
+{
+	integrator->absTol = absTol;
+	integrator->relTol = relTol;
+}
+
+void integratorInvalidate(struct Integrator *integrator)
+{
+	if (integrator->ops.invalidate) {
+		integrator->ops.invalidate(integrator);
+	}
+}
+
 void integratorTakeStep(struct Integrator *integrator, struct OqsAmplitude *x,
 			RHS f, void *ctx)
 {
-	integrator->ops.takeStep(integrator, x, f, ctx);
+	integrator->ops.takeStep(integrator, x, x, f, ctx);
+}
+
+double integratorTakeStepFrom(struct Integrator *integrator,
+			      const struct OqsAmplitude *x0,
+			      struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	return integrator->ops.takeStep(integrator, x0, x, f, ctx);
 }
 
 void integratorAdvanceBeyond(struct Integrator *integrator, double t,
@@ -82,78 +199,120 @@ void integratorAdvanceTo(struct Integrator *integrator, double t,
 	integrator->ops.advanceTo(integrator, t, x, f, ctx);
 }
 
+void integratorInterpolate(struct Integrator *integrator, double t,
+			   const struct OqsAmplitude *x0,
+			   struct OqsAmplitude *y)
+{
+	integrator->ops.interpolate(integrator, t, x0, y, 0, integrator->dim);
+}
+
+void integratorInterpolateRange(struct Integrator *integrator, double t,
+				const struct OqsAmplitude *x0,
+				struct OqsAmplitude *y, size_t begin,
+				size_t end)
+{
+	integrator->ops.interpolate(integrator, t, x0, y, begin, end);
+}
+
 /* Implementation of RK4 integrator */
 
-void rk4_create(struct Integrator *self, size_t dim)
+static void rk4_reserve(struct Arena *arena, size_t dim)
+{
+	int i;
+	arenaReserve(arena, 1, sizeof(struct RK4_ctx));
+	for (i = 0; i < 5; ++i) {
+		arenaReserve(arena, dim, sizeof(struct OqsAmplitude));
+	}
+}
+
+/* Takes the context and the stages reserved by rk4_reserve from an
+ * allocated arena, which the integrator doesn't own. */
+static void rk4_take(struct Integrator *self, struct Arena *arena,
+		     size_t dim)
 {
+	struct RK4_ctx *ctx;
+
 	self->ops.destroy = &rk4_destroy;
 	self->ops.takeStep = &rk4_takeStep;
 	self->ops.advanceBeyond = &rk4_advanceBeyond;
 	self->ops.advanceTo = &rk4_advanceTo;
-	struct RK4_ctx *ctx = malloc(sizeof(*ctx));
-	ctx->k1 = malloc(dim * sizeof(*ctx->k1));
-	ctx->k2 = malloc(dim * sizeof(*ctx->k2));
-	ctx->k3 = malloc(dim * sizeof(*ctx->k3));
-	ctx->k4 = malloc(dim * sizeof(*ctx->k4));
-	ctx->work = malloc(dim * sizeof(*ctx->work));
+	self->ops.interpolate = &rk4_interpolate;
+	ctx = arenaTake(arena, 1, sizeof(*ctx));
+	ctx->k1 = arenaTake(arena, dim, sizeof(*ctx->k1));
+	ctx->k2 = arenaTake(arena, dim, sizeof(*ctx->k2));
+	ctx->k3 = arenaTake(arena, dim, sizeof(*ctx->k3));
+	ctx->k4 = arenaTake(arena, dim, sizeof(*ctx->k4));
+	ctx->work = arenaTake(arena, dim, sizeof(*ctx->work));
+	arenaInit(&ctx->arena);
+	ctx->t0 = 0;
+	ctx->h = 0;
+	ctx->touched = 0;
 	self->data = ctx;
 }
 
+void rk4_create(struct Integrator *self, size_t dim)
+{
+	struct Arena arena;
+
+	self->ops.destroy = &rk4_destroy;
+	self->data = 0;
+	arenaInit(&arena);
+	rk4_reserve(&arena, dim);
+	if (!arenaAllocate(&arena)) return;
+	rk4_take(self, &arena, dim);
+	((struct RK4_ctx *)self->data)->arena = arena;
+}
+
+/* Right hand sides don't write the padding of split layout states, so it
+ * has to be zero in the stages. */
+static void rk4_touch(struct Integrator *self, struct RK4_ctx *ctx)
+{
+	size_t bytes = self->dim * sizeof(*ctx->k1);
+	memset(ctx->k1, 0, bytes);
+	memset(ctx->k2, 0, bytes);
+	memset(ctx->k3, 0, bytes);
+	memset(ctx->k4, 0, bytes);
+	memset(ctx->work, 0, bytes);
+	ctx->touched = 1;
+}
+
 void rk4_destroy(struct Integrator* self) {
 	struct RK4_ctx *ctx = (struct RK4_ctx *)self->data;
+	struct Arena arena;
 	if (ctx) {
-		free(ctx->k1);
-		free(ctx->k2);
-		free(ctx->k3);
-		free(ctx->k4);
-		free(ctx->work);
-		free(self->data);
+		arena = ctx->arena;
+		arenaFree(&arena);
 	}
 	self->ops.create = 0;
 	self->ops.destroy = 0;
 	self->ops.takeStep = 0;
 	self->ops.advanceBeyond = 0;
 	self->ops.advanceTo = 0;
+	self->ops.interpolate = 0;
+	self->ops.invalidate = 0;
 	self->data = 0;
 }
 
-static void zaxpy(struct OqsAmplitude *w, double alpha,
-		  const struct OqsAmplitude *x, const struct OqsAmplitude *y,
-		  size_t dim)
-{
-	size_t i;
-	for (i = 0; i < dim; ++i) {
-		w[i].re = alpha * x[i].re + y[i].re;
-		w[i].im = alpha * x[i].im + y[i].im;
-	}
-}
-
-void rk4_takeStep(struct Integrator *self, struct OqsAmplitude *x, RHS f,
-		  void *ctx)
+double rk4_takeStep(struct Integrator *self, const struct OqsAmplitude *x0,
+		    struct OqsAmplitude *x, RHS f, void *ctx)
 {
-	double prefactor;
-	size_t i;
-
 	struct RK4_ctx *rk4ctx = (struct RK4_ctx *)self->data;
-	f(self->t, x, rk4ctx->k1, ctx);
-	zaxpy(rk4ctx->work, 0.5 * self->dt, rk4ctx->k1, x, self->dim);
+	double nrm;
+
+	if (!rk4ctx->touched) rk4_touch(self, rk4ctx);
+	rk4ctx->t0 = self->t;
+	rk4ctx->h = self->dt;
+	f(self->t, x0, rk4ctx->k1, ctx);
+	kernelZaxpy(rk4ctx->work, 0.5 * self->dt, rk4ctx->k1, x0, self->dim);
 	f(self->t + 0.5 * self->dt, rk4ctx->work, rk4ctx->k2, ctx);
-	zaxpy(rk4ctx->work, 0.5 * self->dt, rk4ctx->k2, x, self->dim);
+	kernelZaxpy(rk4ctx->work, 0.5 * self->dt, rk4ctx->k2, x0, self->dim);
 	f(self->t + 0.5 * self->dt, rk4ctx->work, rk4ctx->k3, ctx);
-	zaxpy(rk4ctx->work, self->dt, rk4ctx->k3, x, self->dim);
+	kernelZaxpy(rk4ctx->work, self->dt, rk4ctx->k3, x0, self->dim);
 	f(self->t + self->dt, rk4ctx->work, rk4ctx->k4, ctx);
-	prefactor = self->dt / 6.0;
-	for (i = 0; i < self->dim; ++i) {
-		x[i].re +=
-		    prefactor * (rk4ctx->k1[i].re +
-				 2.0 * (rk4ctx->k2[i].re + rk4ctx->k3[i].re) +
-				 rk4ctx->k4[i].re);
-		x[i].im +=
-		    prefactor * (rk4ctx->k1[i].im +
-				 2.0 * (rk4ctx->k2[i].im + rk4ctx->k3[i].im) +
-				 rk4ctx->k4[i].im);
-	}
+	nrm = kernelRk4Combine(x, x0, self->dt / 6.0, rk4ctx->k1, rk4ctx->k2,
+			       rk4ctx->k3, rk4ctx->k4, self->dim);
 	self->t += self->dt;
+	return nrm;
 }
 
 void rk4_advanceBeyond(struct Integrator *self, double t,
@@ -161,7 +320,7 @@ void rk4_advanceBeyond(struct Integrator *self, double t,
 		       RHS f, void *ctx)
 {
 	while (self->t < t) {
-		rk4_takeStep(self, x, f, ctx);
+		rk4_takeStep(self, x, x, f, ctx);
 	}
 }
 
@@ -171,10 +330,475 @@ void rk4_advanceTo(struct Integrator *self, double t,
 {
 	double saveDt;
 	while (self->t + self->dt < t) {
-		rk4_takeStep(self, x, f, ctx);
+		rk4_takeStep(self, x, x, f, ctx);
+	}
+	saveDt = self->dt;
+	self->dt = t - self->t;
+	rk4_takeStep(self, x, x, f, ctx);
+	self->dt = saveDt;
+}
+
+/* Third order continuous extension of the classical Runge-Kutta method.  It
+ * only uses the stages of the last step. */
+void rk4_interpolate(struct Integrator *self, double t,
+		     const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+		     size_t begin, size_t end)
+{
+	struct RK4_ctx *c = (struct RK4_ctx *)self->data;
+	double theta = (t - c->t0) / c->h;
+	double theta2 = theta * theta;
+	double theta3 = theta2 * theta;
+	double b1 = c->h * (theta - 1.5 * theta2 + 2.0 / 3.0 * theta3);
+	double b23 = c->h * (theta2 - 2.0 / 3.0 * theta3);
+	double b4 = c->h * (-0.5 * theta2 + 2.0 / 3.0 * theta3);
+	size_t i;
+	for (i = begin; i < end; ++i) {
+		y[i].re = x0[i].re + b1 * c->k1[i].re +
+			  b23 * (c->k2[i].re + c->k3[i].re) + b4 * c->k4[i].re;
+		y[i].im = x0[i].im + b1 * c->k1[i].im +
+			  b23 * (c->k2[i].im + c->k3[i].im) + b4 * c->k4[i].im;
+	}
+}
+
+/* Implementation of the low storage Runge-Kutta integrator.
+ *
+ * Five stage fourth order 2N scheme of Carpenter and Kennedy (1994).  Each
+ * stage updates two registers, dx = a * dx + h * f(t + c * h, x) and
+ * x += b * dx, so apart from the state only dx and the output of the right
+ * hand side have to be stored.  The slope at the start of the step needed
+ * by the continuous extension is recomputed when the step is first
+ * interpolated instead of being kept in a third register. */
+
+static const double lsrk_a[5] = {
+	0.0,
+	-567301805773.0 / 1357537059087.0,
+	-2404267990393.0 / 2016746695238.0,
+	-3550918686646.0 / 2091501179385.0,
+	-1275806237668.0 / 842570457699.0
+};
+static const double lsrk_b[5] = {
+	1432997174477.0 / 9575080441755.0,
+	5161836677717.0 / 13612068292357.0,
+	1720146321549.0 / 2090206949498.0,
+	3134564353537.0 / 4481467310338.0,
+	2277821191437.0 / 14882151754819.0
+};
+static const double lsrk_c[5] = {
+	0.0,
+	1432997174477.0 / 9575080441755.0,
+	2526269341429.0 / 6820363962896.0,
+	2006345519317.0 / 3224310063776.0,
+	2802321613138.0 / 2924317926251.0
+};
+
+void lsrk4_create(struct Integrator *self, size_t dim)
+{
+	self->ops.destroy = &lsrk4_destroy;
+	self->ops.takeStep = &lsrk4_takeStep;
+	self->ops.advanceBeyond = &lsrk4_advanceBeyond;
+	self->ops.advanceTo = &lsrk4_advanceTo;
+	self->ops.interpolate = &lsrk4_interpolate;
+	struct LSRK4_ctx *ctx;
+	struct Arena arena;
+	int i;
+
+	arenaInit(&arena);
+	arenaReserve(&arena, 1, sizeof(*ctx));
+	for (i = 0; i < 2; ++i) arenaReserve(&arena, dim, sizeof(*ctx->dx));
+	self->data = 0;
+	if (!arenaAllocate(&arena)) return;
+	ctx = arenaTakeZeroed(&arena, 1, sizeof(*ctx));
+	ctx->dx = arenaTakeZeroed(&arena, dim, sizeof(*ctx->dx));
+	ctx->k = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k));
+	ctx->arena = arena;
+	ctx->haveSlope = 0;
+	ctx->f = 0;
+	ctx->fctx = 0;
+	ctx->t0 = 0;
+	ctx->h = 0;
+	self->data = ctx;
+}
+
+void lsrk4_destroy(struct Integrator *self)
+{
+	struct LSRK4_ctx *ctx = (struct LSRK4_ctx *)self->data;
+	struct Arena arena;
+	if (ctx) {
+		arena = ctx->arena;
+		arenaFree(&arena);
+	}
+	self->ops.create = 0;
+	self->ops.destroy = 0;
+	self->ops.takeStep = 0;
+	self->ops.advanceBeyond = 0;
+	self->ops.advanceTo = 0;
+	self->ops.interpolate = 0;
+	self->ops.invalidate = 0;
+	self->data = 0;
+}
+
+/* The register dx is kept in units of the step size, dx = a * dx + k, so that
+ * the first stage can be evaluated into it directly.  After the step it
+ * holds x - x0 for the continuous extension, which is therefore only
+ * available for steps that don't overwrite x0. */
+double lsrk4_takeStep(struct Integrator *self, const struct OqsAmplitude *x0,
+		      struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	struct LSRK4_ctx *c = (struct LSRK4_ctx *)self->data;
+	const struct OqsAmplitude *k;
+	double h = self->dt;
+	double a, b, nrm = 0;
+	int i;
+
+	c->t0 = self->t;
+	c->h = h;
+	c->haveSlope = 0;
+	c->f = f;
+	c->fctx = ctx;
+	f(self->t, x0, c->dx, ctx);
+	b = lsrk_b[0] * h;
+	k = c->dx;
+	kernelStage(x, x0, 1, &b, &k, self->dim);
+	for (i = 1; i < 5; ++i) {
+		f(self->t + lsrk_c[i] * h, x, c->k, ctx);
+		a = lsrk_a[i];
+		k = c->dx;
+		kernelStage(c->dx, c->k, 1, &a, &k, self->dim);
+		b = lsrk_b[i] * h;
+		k = c->dx;
+		nrm = kernelStage(x, x, 1, &b, &k, self->dim);
+	}
+	kernelZaxpy(c->dx, -1.0, x0, x, self->dim);
+	self->t += h;
+	return nrm;
+}
+
+void lsrk4_advanceBeyond(struct Integrator *self, double t,
+			 struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	while (self->t < t) {
+		lsrk4_takeStep(self, x, x, f, ctx);
+	}
+}
+
+void lsrk4_advanceTo(struct Integrator *self, double t,
+		     struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	double saveDt;
+	while (self->t + self->dt < t) {
+		lsrk4_takeStep(self, x, x, f, ctx);
 	}
 	saveDt = self->dt;
 	self->dt = t - self->t;
-	rk4_takeStep(self, x, f, ctx);
+	lsrk4_takeStep(self, x, x, f, ctx);
 	self->dt = saveDt;
 }
+
+/* Quadratic continuous extension through x0 and x with the slope k at the
+ * start of the step.  Its local error is O(h^3), one order less than the
+ * extension of the classical method.  The slope is evaluated with the
+ * right hand side of the step the first time the step is interpolated. */
+void lsrk4_interpolate(struct Integrator *self, double t,
+		       const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+		       size_t begin, size_t end)
+{
+	struct LSRK4_ctx *c = (struct LSRK4_ctx *)self->data;
+	double theta = (t - c->t0) / c->h;
+	double theta2 = theta * theta;
+	double b1 = c->h * (theta - theta2);
+	size_t i;
+	if (!c->haveSlope) {
+		c->f(c->t0, x0, c->k, c->fctx);
+		c->haveSlope = 1;
+	}
+	for (i = begin; i < end; ++i) {
+		y[i].re = x0[i].re + b1 * c->k[i].re + theta2 * c->dx[i].re;
+		y[i].im = x0[i].im + b1 * c->k[i].im + theta2 * c->dx[i].im;
+	}
+}
+
+/* Implementation of the Dormand-Prince 5(4) integrator.
+ *
+ * This is an embedded Runge-Kutta pair with error control and the first
+ * same as last (FSAL) property: the right hand side evaluated at the end of
+ * an accepted step is reused as the first stage of the next step.  Whenever
+ * the state is modified behind the integrator's back (jumps, backtracking)
+ * the FSAL stage has to be invalidated. */
+
+static const double dp_c2 = 1.0 / 5.0, dp_c3 = 3.0 / 10.0, dp_c4 = 4.0 / 5.0,
+		    dp_c5 = 8.0 / 9.0;
+static const double dp_a21 = 1.0 / 5.0;
+static const double dp_a31 = 3.0 / 40.0, dp_a32 = 9.0 / 40.0;
+static const double dp_a41 = 44.0 / 45.0, dp_a42 = -56.0 / 15.0,
+		    dp_a43 = 32.0 / 9.0;
+static const double dp_a51 = 19372.0 / 6561.0, dp_a52 = -25360.0 / 2187.0,
+		    dp_a53 = 64448.0 / 6561.0, dp_a54 = -212.0 / 729.0;
+static const double dp_a61 = 9017.0 / 3168.0, dp_a62 = -355.0 / 33.0,
+		    dp_a63 = 46732.0 / 5247.0, dp_a64 = 49.0 / 176.0,
+		    dp_a65 = -5103.0 / 18656.0;
+static const double dp_a71 = 35.0 / 384.0, dp_a73 = 500.0 / 1113.0,
+		    dp_a74 = 125.0 / 192.0, dp_a75 = -2187.0 / 6784.0,
+		    dp_a76 = 11.0 / 84.0;
+static const double dp_d1 = -12715105075.0 / 11282082432.0,
+		    dp_d3 = 87487479700.0 / 32700410799.0,
+		    dp_d4 = -10690763975.0 / 1880347072.0,
+		    dp_d5 = 701980252875.0 / 199316789632.0,
+		    dp_d6 = -1453857185.0 / 822651844.0,
+		    dp_d7 = 69997945.0 / 29380423.0;
+static const double dp_e1 = 71.0 / 57600.0, dp_e3 = -71.0 / 16695.0,
+		    dp_e4 = 71.0 / 1920.0, dp_e5 = -17253.0 / 339200.0,
+		    dp_e6 = 22.0 / 525.0, dp_e7 = -1.0 / 40.0;
+
+void dopri5_create(struct Integrator *self, size_t dim)
+{
+	self->ops.destroy = &dopri5_destroy;
+	self->ops.takeStep = &dopri5_takeStep;
+	self->ops.advanceBeyond = &dopri5_advanceBeyond;
+	self->ops.advanceTo = &dopri5_advanceTo;
+	self->ops.interpolate = &dopri5_interpolate;
+	self->ops.invalidate = &dopri5_invalidate;
+	struct DOPRI5_ctx *ctx;
+	struct Arena arena;
+	int i;
+
+	arenaInit(&arena);
+	arenaReserve(&arena, 1, sizeof(*ctx));
+	for (i = 0; i < 8; ++i) arenaReserve(&arena, dim, sizeof(*ctx->k1));
+	self->data = 0;
+	if (!arenaAllocate(&arena)) return;
+	ctx = arenaTakeZeroed(&arena, 1, sizeof(*ctx));
+	ctx->k1 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k1));
+	ctx->k2 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k2));
+	ctx->k3 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k3));
+	ctx->k4 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k4));
+	ctx->k5 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k5));
+	ctx->k6 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k6));
+	ctx->k7 = arenaTakeZeroed(&arena, dim, sizeof(*ctx->k7));
+	ctx->work = arenaTakeZeroed(&arena, dim, sizeof(*ctx->work));
+	ctx->arena = arena;
+	ctx->fsal = 0;
+	ctx->t0 = 0;
+	ctx->h = 0;
+	self->data = ctx;
+}
+
+void dopri5_destroy(struct Integrator *self)
+{
+	struct DOPRI5_ctx *ctx = (struct DOPRI5_ctx *)self->data;
+	struct Arena arena;
+	if (ctx) {
+		arena = ctx->arena;
+		arenaFree(&arena);
+	}
+	self->ops.create = 0;
+	self->ops.destroy = 0;
+	self->ops.takeStep = 0;
+	self->ops.advanceBeyond = 0;
+	self->ops.advanceTo = 0;
+	self->ops.interpolate = 0;
+	self->ops.invalidate = 0;
+	self->data = 0;
+}
+
+void dopri5_invalidate(struct Integrator *self)
+{
+	struct DOPRI5_ctx *ctx = (struct DOPRI5_ctx *)self->data;
+	ctx->fsal = 0;
+}
+
+static double dopri5_scaledError(struct Integrator *self,
+				 const struct OqsAmplitude *x0,
+				 const struct OqsAmplitude *x1)
+{
+	struct DOPRI5_ctx *c = (struct DOPRI5_ctx *)self->data;
+	double h = self->dt;
+	double err = 0, e, sc;
+	size_t i, n;
+	for (i = 0; i < self->dim; ++i) {
+		e = h * (dp_e1 * c->k1[i].re + dp_e3 * c->k3[i].re +
+			 dp_e4 * c->k4[i].re + dp_e5 * c->k5[i].re +
+			 dp_e6 * c->k6[i].re + dp_e7 * c->k7[i].re);
+		sc = self->absTol +
+		     self->relTol * fmax(fabs(x0[i].re), fabs(x1[i].re));
+		err += (e / sc) * (e / sc);
+		e = h * (dp_e1 * c->k1[i].im + dp_e3 * c->k3[i].im +
+			 dp_e4 * c->k4[i].im + dp_e5 * c->k5[i].im +
+			 dp_e6 * c->k6[i].im + dp_e7 * c->k7[i].im);
+		sc = self->absTol +
+		     self->relTol * fmax(fabs(x0[i].im), fabs(x1[i].im));
+		err += (e / sc) * (e / sc);
+	}
+	// The padding of split layout states doesn't count.
+	n = self->splitDim ? self->splitDim : self->dim;
+	return sqrt(err / (2.0 * n));
+}
+
+/* Attempts a single step of size self->dt from x0.  On success the new
+ * state is stored in x, its squared norm in *nrm, and the time is updated.
+ * In either case self->dt is replaced by the step size proposed by the error
+ * controller.  Returns whether the step was accepted. */
+static int dopri5_attemptStep(struct Integrator *self,
+			      const struct OqsAmplitude *x0,
+			      struct OqsAmplitude *x, double *nrm, RHS f,
+			      void *ctx)
+{
+	struct DOPRI5_ctx *c = (struct DOPRI5_ctx *)self->data;
+	// The last stage is formed directly in x unless that would overwrite
+	// x0, which is still needed if the step gets rejected.
+	struct OqsAmplitude *x1 = (x == x0) ? c->work : x;
+	struct OqsAmplitude *tmp;
+	double h = self->dt;
+	double t = self->t;
+	double err, factor;
+	double a[6];
+	const struct OqsAmplitude *k[6];
+
+	if (!c->fsal) {
+		f(t, x0, c->k1, ctx);
+		c->fsal = 1;
+	}
+	k[0] = c->k1;
+	k[1] = c->k2;
+	k[2] = c->k3;
+	k[3] = c->k4;
+	k[4] = c->k5;
+	k[5] = c->k6;
+	a[0] = h * dp_a21;
+	kernelStage(c->work, x0, 1, a, k, self->dim);
+	f(t + dp_c2 * h, c->work, c->k2, ctx);
+	a[0] = h * dp_a31;
+	a[1] = h * dp_a32;
+	kernelStage(c->work, x0, 2, a, k, self->dim);
+	f(t + dp_c3 * h, c->work, c->k3, ctx);
+	a[0] = h * dp_a41;
+	a[1] = h * dp_a42;
+	a[2] = h * dp_a43;
+	kernelStage(c->work, x0, 3, a, k, self->dim);
+	f(t + dp_c4 * h, c->work, c->k4, ctx);
+	a[0] = h * dp_a51;
+	a[1] = h * dp_a52;
+	a[2] = h * dp_a53;
+	a[3] = h * dp_a54;
+	kernelStage(c->work, x0, 4, a, k, self->dim);
+	f(t + dp_c5 * h, c->work, c->k5, ctx);
+	a[0] = h * dp_a61;
+	a[1] = h * dp_a62;
+	a[2] = h * dp_a63;
+	a[3] = h * dp_a64;
+	a[4] = h * dp_a65;
+	kernelStage(c->work, x0, 5, a, k, self->dim);
+	f(t + h, c->work, c->k6, ctx);
+	// The last stage is the new solution; a72 vanishes.
+	a[0] = h * dp_a71;
+	a[1] = 0;
+	a[2] = h * dp_a73;
+	a[3] = h * dp_a74;
+	a[4] = h * dp_a75;
+	a[5] = h * dp_a76;
+	*nrm = kernelStage(x1, x0, 6, a, k, self->dim);
+	f(t + h, x1, c->k7, ctx);
+
+	err = dopri5_scaledError(self, x0, x1);
+	// Standard step size controller with safety factor 0.9 and the
+	// growth of the step size limited to the interval [0.2, 5].
+	if (err > 0) {
+		factor = 0.9 * pow(err, -0.2);
+		factor = fmin(5.0, fmax(0.2, factor));
+	} else {
+		factor = 5.0;
+	}
+	if (err > 1.0) {
+		// Rejected step.  k1 is still valid for the state x.
+		self->dt = h * factor;
+		return 0;
+	}
+	if (x1 != x) {
+		memcpy(x, x1, self->dim * sizeof(*x));
+	}
+	// After the swap k1 holds the right hand side at the end of the step
+	// and k7 the one at the beginning.  The interpolant relies on this.
+	tmp = c->k1;
+	c->k1 = c->k7;
+	c->k7 = tmp;
+	c->t0 = t;
+	c->h = h;
+	self->t += h;
+	self->dt = h * factor;
+	return 1;
+}
+
+double dopri5_takeStep(struct Integrator *self,
+		       const struct OqsAmplitude *x0, struct OqsAmplitude *x,
+		       RHS f, void *ctx)
+{
+	double nrm;
+	while (!dopri5_attemptStep(self, x0, x, &nrm, f, ctx)) {
+	}
+	return nrm;
+}
+
+void dopri5_advanceBeyond(struct Integrator *self, double t,
+			  struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	while (self->t < t) {
+		dopri5_takeStep(self, x, x, f, ctx);
+	}
+}
+
+void dopri5_advanceTo(struct Integrator *self, double t,
+		      struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	double proposedDt, nrm;
+	int clipped;
+	while (self->t < t) {
+		proposedDt = self->dt;
+		clipped = self->t + proposedDt >= t;
+		if (clipped) {
+			self->dt = t - self->t;
+		}
+		if (dopri5_attemptStep(self, x, x, &nrm, f, ctx) && clipped) {
+			// The step size was limited by the target time rather
+			// than by the error controller.  Don't let that
+			// shrink the step size for subsequent steps.
+			self->t = t;
+			self->dt = proposedDt;
+		}
+	}
+}
+
+/* Fourth order continuous extension of the Dormand-Prince method (see
+ * Hairer, Norsett, and Wanner, Solving Ordinary Differential Equations I).
+ * It uses the stages of the last accepted step, which remain valid until the
+ * next step is attempted. */
+void dopri5_interpolate(struct Integrator *self, double t,
+			const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+			size_t begin, size_t end)
+{
+	struct DOPRI5_ctx *c = (struct DOPRI5_ctx *)self->data;
+	const struct OqsAmplitude *f0 = c->k7;
+	const struct OqsAmplitude *f1 = c->k1;
+	double h = c->h;
+	double theta = (t - c->t0) / h;
+	double theta1 = 1.0 - theta;
+	double ydiff, bspl, r4, r5;
+	size_t i;
+
+#define DOPRI5_DENSE(part)                                                     \
+	ydiff = h * (dp_a71 * f0[i].part + dp_a73 * c->k3[i].part +           \
+		     dp_a74 * c->k4[i].part + dp_a75 * c->k5[i].part +        \
+		     dp_a76 * c->k6[i].part);                                  \
+	bspl = h * f0[i].part - ydiff;                                         \
+	r4 = ydiff - h * f1[i].part - bspl;                                    \
+	r5 = h * (dp_d1 * f0[i].part + dp_d3 * c->k3[i].part +                \
+		  dp_d4 * c->k4[i].part + dp_d5 * c->k5[i].part +             \
+		  dp_d6 * c->k6[i].part + dp_d7 * f1[i].part);                 \
+	y[i].part =                                                            \
+	    x0[i].part +                                                       \
+	    theta * (ydiff + theta1 * (bspl + theta * (r4 + theta1 * r5)));
+
+	for (i = begin; i < end; ++i) {
+		DOPRI5_DENSE(re)
+		DOPRI5_DENSE(im)
+	}
+#undef DOPRI5_DENSE
+}
@@ -27,17 +27,25 @@ extern "C" {
 #endif
 
 struct Integrator;
+struct Arena;
 typedef void (*RHS)(double, const struct OqsAmplitude *, struct OqsAmplitude *,
 		 void *);
 
 struct IntegratorOps {
 	void (*create)(struct Integrator *self, size_t dim);
-	void (*takeStep)(struct Integrator *self, struct OqsAmplitude *x, RHS f,
-			 void *ctx);
+	/* Steps from x0 to x and returns the squared norm of x.  x0 and x
+	 * may be the same array. */
+	double (*takeStep)(struct Integrator *self,
+			   const struct OqsAmplitude *x0,
+			   struct OqsAmplitude *x, RHS f, void *ctx);
 	void (*advanceBeyond)(struct Integrator *self, double t,
 			      struct OqsAmplitude *x, RHS f, void *ctx);
 	void (*advanceTo)(struct Integrator *self, double t,
 			  struct OqsAmplitude *x, RHS f, void *ctx);
+	void (*interpolate)(struct Integrator *self, double t,
+			    const struct OqsAmplitude *x0,
+			    struct OqsAmplitude *y, size_t begin, size_t end);
+	void (*invalidate)(struct Integrator *self);
 	void (*destroy)(struct Integrator *self);
 };
 
@@ -45,21 +53,73 @@ struct Integrator {
 	struct IntegratorOps ops;
 	double t;
 	double dt;
+	double absTol;
+	double relTol;
 	size_t dim;
+	/* Zero for the interleaved layout.  Otherwise states are stored in
+	 * the split layout (see enum OqsLayout): the real parts of splitDim
+	 * components padded with zeros to dim doubles, followed by the
+	 * imaginary parts. */
+	size_t splitDim;
 	void *data;
 };
 
+void rk4_create(struct Integrator *self, size_t dim);
+/* Fourth order low storage Runge-Kutta with two registers instead of the
+ * five vectors of rk4.  Its continuous extension is quadratic with a local
+ * error of O(h^3), and the first interpolation of a step evaluates the
+ * right hand side once at the start of the step.  Steps that overwrite x0
+ * (x0 == x, e.g. integratorAdvanceTo) can't be interpolated. */
+void lsrk4_create(struct Integrator *self, size_t dim);
+void dopri5_create(struct Integrator *self, size_t dim);
+/* Krylov subspace exponential integrator for time independent linear right
+ * hand sides. */
+void krylov_create(struct Integrator *self, size_t dim);
+
+/* The buffers of an integrator are allocated from a single arena (see
+ * Memory.h).  If that fails data is null and the integrator must only be
+ * destroyed. */
 void integratorCreate(struct Integrator* integrator, size_t dim);
+void integratorCreateWith(struct Integrator *integrator, size_t dim,
+			  void (*create)(struct Integrator *, size_t));
+/* Reserves the buffers of the default integrator in an arena owned by the
+ * caller, who creates the integrator from the allocated arena with
+ * integratorCreateFrom.  The arena has to outlive the integrator. */
+void integratorReserve(struct Arena *arena, size_t dim);
+void integratorCreateFrom(struct Integrator *integrator,
+			  struct Arena *arena, size_t dim);
 void integratorDestroy(struct Integrator* integrator);
 void integratorSetTime(struct Integrator* integrator, double t);
 double integratorGetTime(struct Integrator* integrator);
 void integratorTimeStepHint(struct Integrator* integrator, double dt);
+void integratorSetTolerances(struct Integrator *integrator, double absTol,
+			     double relTol);
+void integratorInvalidate(struct Integrator *integrator);
 void integratorTakeStep(struct Integrator *integrator, struct OqsAmplitude *x,
 			RHS f, void *ctx);
+/* Takes a step from x0 without modifying it and stores the result in x.
+ * Returns the squared norm of x, which is computed in the same sweep that
+ * forms the new state. */
+double integratorTakeStepFrom(struct Integrator *integrator,
+			      const struct OqsAmplitude *x0,
+			      struct OqsAmplitude *x, RHS f, void *ctx);
 void integratorAdvanceBeyond(struct Integrator *integrator, double t,
 			     struct OqsAmplitude *x, RHS f, void *ctx);
 void integratorAdvanceTo(struct Integrator *integrator, double t,
 			 struct OqsAmplitude *x, RHS f, void *ctx);
+/* Evaluates the continuous extension of the last step at time t, where t
+ * lies between the start and the end of that step.  x0 is the state at the
+ * start of the step.  No right hand side evaluations are performed, except
+ * for one per step by lsrk4. */
+void integratorInterpolate(struct Integrator *integrator, double t,
+			   const struct OqsAmplitude *x0,
+			   struct OqsAmplitude *y);
+/* Like integratorInterpolate but only the components in [begin, end) are
+ * computed. */
+void integratorInterpolateRange(struct Integrator *integrator, double t,
+				const struct OqsAmplitude *x0,
+				struct OqsAmplitude *y, size_t begin,
+				size_t end);
 
 #ifdef __cplusplus
 }
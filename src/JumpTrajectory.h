@@ -0,0 +1,45 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef JUMP_TRAJECTORY_H
+#define JUMP_TRAJECTORY_H
+
+#include <stdlib.h>
+#include <OqsJumpTrajectory.h>
+#include <Memory.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reserves a trajectory, including its integrator, in an arena owned by
+ * the caller so that an object can keep it with its own buffers.  The
+ * trajectory is created from the allocated arena with
+ * jumpTrajectoryCreateFrom and destroyed with oqsJumpTrajectoryDestroy,
+ * which leaves the arena alone.  The arena has to outlive the
+ * trajectory. */
+void jumpTrajectoryReserve(struct Arena *arena, size_t dim,
+			   enum OqsLayout layout);
+OqsJumpTrajectory jumpTrajectoryCreateFrom(struct Arena *arena, size_t dim,
+					   enum OqsLayout layout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,462 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Kernels.h>
+#include <pthread.h>
+#include <assert.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+struct KernelTable {
+	enum KernelIsa isa;
+	void (*axpy)(double *w, double alpha, const double *x, const double *y,
+		     size_t n);
+	double (*stage)(double *w, const double *x, int m, const double *c,
+			const double *const *k, size_t n);
+	double (*rk4Combine)(double *w, const double *x, double prefactor,
+			     const double *k1, const double *k2,
+			     const double *k3, const double *k4, size_t n);
+	double (*normSquared)(const double *x, size_t n);
+};
+
+/* Scalar kernels */
+
+static void axpyScalar(double *w, double alpha, const double *x,
+		       const double *y, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		w[i] = alpha * x[i] + y[i];
+	}
+}
+
+static double stageScalar(double *w, const double *x, int m,
+			  const double *c, const double *const *k, size_t n)
+{
+	double nrm = 0, s;
+	size_t i;
+	int j;
+	for (i = 0; i < n; ++i) {
+		s = x[i];
+		for (j = 0; j < m; ++j) {
+			s += c[j] * k[j][i];
+		}
+		w[i] = s;
+		nrm += s * s;
+	}
+	return nrm;
+}
+
+static double rk4CombineScalar(double *w, const double *x, double prefactor,
+			       const double *k1, const double *k2,
+			       const double *k3, const double *k4, size_t n)
+{
+	double nrm = 0, s;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		s = x[i] + prefactor * (k1[i] + 2.0 * (k2[i] + k3[i]) + k4[i]);
+		w[i] = s;
+		nrm += s * s;
+	}
+	return nrm;
+}
+
+static double normSquaredScalar(const double *x, size_t n)
+{
+	double nrm = 0;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		nrm += x[i] * x[i];
+	}
+	return nrm;
+}
+
+static const struct KernelTable scalarKernels = {
+    KERNEL_ISA_SCALAR, &axpyScalar, &stageScalar, &rk4CombineScalar,
+    &normSquaredScalar};
+
+#ifdef KERNELS_X86
+
+/* AVX2 kernels */
+
+__attribute__((target("avx2,fma"))) static void
+axpyAvx2(double *w, double alpha, const double *x, const double *y, size_t n)
+{
+	__m256d a = _mm256_set1_pd(alpha);
+	size_t i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(w + i,
+				 _mm256_fmadd_pd(a, _mm256_loadu_pd(x + i),
+						 _mm256_loadu_pd(y + i)));
+	}
+	axpyScalar(w + i, alpha, x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static double
+stageAvx2(double *w, const double *x, int m, const double *c,
+	  const double *const *k, size_t n)
+{
+	__m256d cv[KERNEL_MAX_STAGES];
+	__m256d s;
+	__m256d nrm = _mm256_setzero_pd();
+	const double *kTail[KERNEL_MAX_STAGES];
+	double partial[4];
+	size_t i;
+	int j;
+	for (j = 0; j < m; ++j) {
+		cv[j] = _mm256_set1_pd(c[j]);
+	}
+	for (i = 0; i + 4 <= n; i += 4) {
+		s = _mm256_loadu_pd(x + i);
+		for (j = 0; j < m; ++j) {
+			s = _mm256_fmadd_pd(cv[j], _mm256_loadu_pd(k[j] + i),
+					    s);
+		}
+		_mm256_storeu_pd(w + i, s);
+		nrm = _mm256_fmadd_pd(s, s, nrm);
+	}
+	for (j = 0; j < m; ++j) {
+		kTail[j] = k[j] + i;
+	}
+	_mm256_storeu_pd(partial, nrm);
+	return partial[0] + partial[1] + partial[2] + partial[3] +
+	       stageScalar(w + i, x + i, m, c, kTail, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static double
+rk4CombineAvx2(double *w, const double *x, double prefactor, const double *k1,
+	       const double *k2, const double *k3, const double *k4, size_t n)
+{
+	__m256d p = _mm256_set1_pd(prefactor);
+	__m256d two = _mm256_set1_pd(2.0);
+	__m256d nrm = _mm256_setzero_pd();
+	__m256d s;
+	double partial[4];
+	size_t i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		s = _mm256_add_pd(_mm256_loadu_pd(k2 + i),
+				  _mm256_loadu_pd(k3 + i));
+		s = _mm256_fmadd_pd(two, s,
+				    _mm256_add_pd(_mm256_loadu_pd(k1 + i),
+						  _mm256_loadu_pd(k4 + i)));
+		s = _mm256_fmadd_pd(p, s, _mm256_loadu_pd(x + i));
+		_mm256_storeu_pd(w + i, s);
+		nrm = _mm256_fmadd_pd(s, s, nrm);
+	}
+	_mm256_storeu_pd(partial, nrm);
+	return partial[0] + partial[1] + partial[2] + partial[3] +
+	       rk4CombineScalar(w + i, x + i, prefactor, k1 + i, k2 + i,
+				k3 + i, k4 + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static double
+normSquaredAvx2(const double *x, size_t n)
+{
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	__m256d v;
+	double partial[4];
+	size_t i;
+	for (i = 0; i + 8 <= n; i += 8) {
+		v = _mm256_loadu_pd(x + i);
+		acc0 = _mm256_fmadd_pd(v, v, acc0);
+		v = _mm256_loadu_pd(x + i + 4);
+		acc1 = _mm256_fmadd_pd(v, v, acc1);
+	}
+	_mm256_storeu_pd(partial, _mm256_add_pd(acc0, acc1));
+	return partial[0] + partial[1] + partial[2] + partial[3] +
+	       normSquaredScalar(x + i, n - i);
+}
+
+static const struct KernelTable avx2Kernels = {
+    KERNEL_ISA_AVX2, &axpyAvx2, &stageAvx2, &rk4CombineAvx2,
+    &normSquaredAvx2};
+
+/* AVX-512 kernels */
+
+__attribute__((target("avx512f"))) static void
+axpyAvx512(double *w, double alpha, const double *x, const double *y,
+	   size_t n)
+{
+	__m512d a = _mm512_set1_pd(alpha);
+	size_t i;
+	for (i = 0; i + 8 <= n; i += 8) {
+		_mm512_storeu_pd(w + i,
+				 _mm512_fmadd_pd(a, _mm512_loadu_pd(x + i),
+						 _mm512_loadu_pd(y + i)));
+	}
+	axpyScalar(w + i, alpha, x + i, y + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static double
+stageAvx512(double *w, const double *x, int m, const double *c,
+	    const double *const *k, size_t n)
+{
+	__m512d cv[KERNEL_MAX_STAGES];
+	__m512d s;
+	__m512d nrm = _mm512_setzero_pd();
+	const double *kTail[KERNEL_MAX_STAGES];
+	size_t i;
+	int j;
+	for (j = 0; j < m; ++j) {
+		cv[j] = _mm512_set1_pd(c[j]);
+	}
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = _mm512_loadu_pd(x + i);
+		for (j = 0; j < m; ++j) {
+			s = _mm512_fmadd_pd(cv[j], _mm512_loadu_pd(k[j] + i),
+					    s);
+		}
+		_mm512_storeu_pd(w + i, s);
+		nrm = _mm512_fmadd_pd(s, s, nrm);
+	}
+	for (j = 0; j < m; ++j) {
+		kTail[j] = k[j] + i;
+	}
+	return _mm512_reduce_add_pd(nrm) +
+	       stageScalar(w + i, x + i, m, c, kTail, n - i);
+}
+
+__attribute__((target("avx512f"))) static double
+rk4CombineAvx512(double *w, const double *x, double prefactor,
+		 const double *k1, const double *k2, const double *k3,
+		 const double *k4, size_t n)
+{
+	__m512d p = _mm512_set1_pd(prefactor);
+	__m512d two = _mm512_set1_pd(2.0);
+	__m512d nrm = _mm512_setzero_pd();
+	__m512d s;
+	size_t i;
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = _mm512_add_pd(_mm512_loadu_pd(k2 + i),
+				  _mm512_loadu_pd(k3 + i));
+		s = _mm512_fmadd_pd(two, s,
+				    _mm512_add_pd(_mm512_loadu_pd(k1 + i),
+						  _mm512_loadu_pd(k4 + i)));
+		s = _mm512_fmadd_pd(p, s, _mm512_loadu_pd(x + i));
+		_mm512_storeu_pd(w + i, s);
+		nrm = _mm512_fmadd_pd(s, s, nrm);
+	}
+	return _mm512_reduce_add_pd(nrm) +
+	       rk4CombineScalar(w + i, x + i, prefactor, k1 + i, k2 + i,
+				k3 + i, k4 + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static double
+normSquaredAvx512(const double *x, size_t n)
+{
+	__m512d acc0 = _mm512_setzero_pd();
+	__m512d acc1 = _mm512_setzero_pd();
+	__m512d v;
+	size_t i;
+	for (i = 0; i + 16 <= n; i += 16) {
+		v = _mm512_loadu_pd(x + i);
+		acc0 = _mm512_fmadd_pd(v, v, acc0);
+		v = _mm512_loadu_pd(x + i + 8);
+		acc1 = _mm512_fmadd_pd(v, v, acc1);
+	}
+	return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1)) +
+	       normSquaredScalar(x + i, n - i);
+}
+
+static const struct KernelTable avx512Kernels = {
+    KERNEL_ISA_AVX512, &axpyAvx512, &stageAvx512, &rk4CombineAvx512,
+    &normSquaredAvx512};
+
+#endif
+
+static const struct KernelTable *kernelTable = 0;
+static pthread_once_t kernelTableOnce = PTHREAD_ONCE_INIT;
+
+int kernelsIsaSupported(enum KernelIsa isa)
+{
+	switch (isa) {
+	case KERNEL_ISA_SCALAR:
+		return 1;
+#ifdef KERNELS_X86
+	case KERNEL_ISA_AVX2:
+		return __builtin_cpu_supports("avx2") &&
+		       __builtin_cpu_supports("fma");
+	case KERNEL_ISA_AVX512:
+		return __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return 0;
+	}
+}
+
+static int setIsa(enum KernelIsa isa)
+{
+	if (!kernelsIsaSupported(isa)) return 0;
+	switch (isa) {
+#ifdef KERNELS_X86
+	case KERNEL_ISA_AVX2:
+		kernelTable = &avx2Kernels;
+		break;
+	case KERNEL_ISA_AVX512:
+		kernelTable = &avx512Kernels;
+		break;
+#endif
+	default:
+		kernelTable = &scalarKernels;
+		break;
+	}
+	return 1;
+}
+
+static void selectDefaultIsa(void)
+{
+	if (!setIsa(KERNEL_ISA_AVX512) && !setIsa(KERNEL_ISA_AVX2)) {
+		setIsa(KERNEL_ISA_SCALAR);
+	}
+}
+
+/* Worker threads make their first kernel calls concurrently. */
+static const struct KernelTable *kernels(void)
+{
+	pthread_once(&kernelTableOnce, &selectDefaultIsa);
+	return kernelTable;
+}
+
+int kernelsSelectIsa(enum KernelIsa isa)
+{
+	// The default is selected first so that it can't replace isa later.
+	kernels();
+	return setIsa(isa);
+}
+
+enum KernelIsa kernelsGetIsa(void)
+{
+	return kernels()->isa;
+}
+
+void kernelZaxpy(struct OqsAmplitude *w, double alpha,
+		 const struct OqsAmplitude *x, const struct OqsAmplitude *y,
+		 size_t dim)
+{
+	kernels()->axpy((double *)w, alpha, (const double *)x,
+			(const double *)y, 2 * dim);
+}
+
+double kernelStage(struct OqsAmplitude *w, const struct OqsAmplitude *x,
+		   int n, const double *c,
+		   const struct OqsAmplitude *const *k, size_t dim)
+{
+	const double *kd[KERNEL_MAX_STAGES];
+	int j;
+	assert(n <= KERNEL_MAX_STAGES);
+	for (j = 0; j < n; ++j) {
+		kd[j] = (const double *)k[j];
+	}
+	return kernels()->stage((double *)w, (const double *)x, n, c, kd,
+				2 * dim);
+}
+
+double kernelRk4Combine(struct OqsAmplitude *w, const struct OqsAmplitude *x,
+			double prefactor, const struct OqsAmplitude *k1,
+			const struct OqsAmplitude *k2,
+			const struct OqsAmplitude *k3,
+			const struct OqsAmplitude *k4, size_t dim)
+{
+	return kernels()->rk4Combine((double *)w, (const double *)x,
+				     prefactor, (const double *)k1,
+				     (const double *)k2, (const double *)k3,
+				     (const double *)k4, 2 * dim);
+}
+
+double kernelNormSquared(const struct OqsAmplitude *x, size_t dim)
+{
+	return kernels()->normSquared((const double *)x, 2 * dim);
+}
+
+struct OqsAmplitude kernelZdotc(const struct OqsAmplitude *x,
+				const struct OqsAmplitude *y, size_t n,
+				int split)
+{
+	const double *xr = (const double *)x, *yr = (const double *)y;
+	const double *xi, *yi;
+	struct OqsAmplitude result = {0, 0};
+	size_t i;
+	if (split) {
+		xi = xr + n;
+		yi = yr + n;
+		for (i = 0; i < n; ++i) {
+			result.re += xr[i] * yr[i] + xi[i] * yi[i];
+			result.im += xr[i] * yi[i] - xi[i] * yr[i];
+		}
+	} else {
+		for (i = 0; i < n; ++i) {
+			result.re += x[i].re * y[i].re + x[i].im * y[i].im;
+			result.im += x[i].re * y[i].im - x[i].im * y[i].re;
+		}
+	}
+	return result;
+}
+
+void kernelZaxpyc(struct OqsAmplitude a, const struct OqsAmplitude *x,
+		  struct OqsAmplitude *y, size_t n, int split)
+{
+	const double *xr = (const double *)x, *xi;
+	double *yr = (double *)y, *yi;
+	double re, im;
+	size_t i;
+	if (split) {
+		xi = xr + n;
+		yi = yr + n;
+		for (i = 0; i < n; ++i) {
+			yr[i] += a.re * xr[i] - a.im * xi[i];
+			yi[i] += a.re * xi[i] + a.im * xr[i];
+		}
+	} else {
+		for (i = 0; i < n; ++i) {
+			re = a.re * x[i].re - a.im * x[i].im;
+			im = a.re * x[i].im + a.im * x[i].re;
+			y[i].re += re;
+			y[i].im += im;
+		}
+	}
+}
+
+void kernelZscalc(struct OqsAmplitude a, const struct OqsAmplitude *x,
+		  struct OqsAmplitude *y, size_t n, int split)
+{
+	const double *xr = (const double *)x, *xi;
+	double *yr = (double *)y, *yi;
+	double re, im;
+	size_t i;
+	if (split) {
+		xi = xr + n;
+		yi = yr + n;
+		for (i = 0; i < n; ++i) {
+			re = a.re * xr[i] - a.im * xi[i];
+			im = a.re * xi[i] + a.im * xr[i];
+			yr[i] = re;
+			yi[i] = im;
+		}
+	} else {
+		for (i = 0; i < n; ++i) {
+			re = a.re * x[i].re - a.im * x[i].im;
+			im = a.re * x[i].im + a.im * x[i].re;
+			y[i].re = re;
+			y[i].im = im;
+		}
+	}
+}
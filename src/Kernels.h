@@ -0,0 +1,88 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdlib.h>
+#include <OqsAmplitude.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Vector kernels used in the inner loops of the integrators and
+ * trajectories.  All of them are linear in the real and imaginary parts and
+ * therefore operate on the amplitudes as arrays of 2 * dim doubles.  An
+ * implementation for the best instruction set supported by the processor
+ * is selected the first time a kernel is called. */
+
+enum KernelIsa {
+	KERNEL_ISA_SCALAR = 0,
+	KERNEL_ISA_AVX2,
+	KERNEL_ISA_AVX512
+};
+
+/* Returns whether the kernels for isa are compiled in and supported by the
+ * processor. */
+int kernelsIsaSupported(enum KernelIsa isa);
+/* Selects the kernels for isa, e.g. for testing.  Returns 0 if isa isn't
+ * supported.  Must not run concurrently with the kernels. */
+int kernelsSelectIsa(enum KernelIsa isa);
+enum KernelIsa kernelsGetIsa(void);
+
+/* w = alpha * x + y */
+void kernelZaxpy(struct OqsAmplitude *w, double alpha,
+		 const struct OqsAmplitude *x, const struct OqsAmplitude *y,
+		 size_t dim);
+/* Maximum number of stages combined by kernelStage */
+#define KERNEL_MAX_STAGES 8
+
+/* w = x + sum_j c[j] * k[j] for j = 0, ..., n - 1 with
+ * n <= KERNEL_MAX_STAGES.  Returns the squared norm of w. */
+double kernelStage(struct OqsAmplitude *w, const struct OqsAmplitude *x,
+		   int n, const double *c,
+		   const struct OqsAmplitude *const *k, size_t dim);
+/* w = x + prefactor * (k1 + 2 * (k2 + k3) + k4).  w may be the same array
+ * as x.  Returns the squared norm of w. */
+double kernelRk4Combine(struct OqsAmplitude *w, const struct OqsAmplitude *x,
+			double prefactor, const struct OqsAmplitude *k1,
+			const struct OqsAmplitude *k2,
+			const struct OqsAmplitude *k3,
+			const struct OqsAmplitude *k4, size_t dim);
+double kernelNormSquared(const struct OqsAmplitude *x, size_t dim);
+
+/* Complex arithmetic on vectors of n complex numbers.  Unlike the kernels
+ * above these depend on the layout: if split is nonzero the n real parts
+ * are followed by the n imaginary parts, otherwise they are interleaved. */
+/* Returns <x|y> */
+struct OqsAmplitude kernelZdotc(const struct OqsAmplitude *x,
+				const struct OqsAmplitude *y, size_t n,
+				int split);
+/* y += a * x */
+void kernelZaxpyc(struct OqsAmplitude a, const struct OqsAmplitude *x,
+		  struct OqsAmplitude *y, size_t n, int split);
+/* y = a * x */
+void kernelZscalc(struct OqsAmplitude a, const struct OqsAmplitude *x,
+		  struct OqsAmplitude *y, size_t n, int split);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
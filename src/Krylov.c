@@ -0,0 +1,409 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Integrator.h>
+#include <Kernels.h>
+#include <Memory.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Implementation of a Krylov subspace exponential integrator.
+ *
+ * For a time independent linear right hand side f(t, x) = A x the exact
+ * solution is x(t0 + h) = exp(h A) x0.  The integrator builds an orthonormal
+ * basis V of the Krylov subspace span{x0, A x0, ..., A^(m-1) x0} with the
+ * Arnoldi process, which only requires the matrix vector products provided
+ * by the right hand side, and approximates
+ *
+ *     exp(h A) x0 ~ beta V exp(h H) e1,
+ *
+ * where H = V^+ A V is the small upper Hessenberg projection of A and
+ * beta = |x0|.  Because the basis does not depend on h, a rejected step is
+ * retried with a smaller h without further right hand side evaluations, and
+ * the state anywhere inside the last step is available without evaluating
+ * the right hand side either.  The local error is estimated by
+ * beta |h_{m+1,m}| |e_m^T exp(h H) e1| (Saad, SIAM J. Numer. Anal. 29, 209
+ * (1992)).
+ *
+ * The right hand side is always evaluated at the start of the step so the
+ * integrator is only correct for time independent problems. */
+
+#define KRYLOV_MAX_DIM 30
+
+struct Krylov_ctx {
+	/* Maximum dimension of the Krylov subspace */
+	size_t maxDim;
+	/* Dimension of the subspace built for the last step */
+	size_t numVecs;
+	/* maxDim + 1 basis vectors */
+	struct OqsAmplitude *V;
+	/* (maxDim + 1) x maxDim Hessenberg matrix, column major */
+	struct OqsAmplitude *H;
+	/* beta * exp(tau H) e1 for the last evaluated tau */
+	struct OqsAmplitude *u;
+	/* maxDim x maxDim scratch matrices for the exponential */
+	struct OqsAmplitude *E, *B, *T, *work;
+	double beta;
+	/* |h_{m+1,m}|, zero if the Krylov space is invariant */
+	double hLast;
+	/* Start time and length of the last accepted step */
+	double t0, h;
+	/* Owns the context, the basis and the small matrices */
+	struct Arena arena;
+};
+
+void krylov_destroy(struct Integrator *self);
+double krylov_takeStep(struct Integrator *self, const struct OqsAmplitude *x0,
+		       struct OqsAmplitude *x, RHS f, void *ctx);
+void krylov_advanceBeyond(struct Integrator *self, double t,
+			  struct OqsAmplitude *x, RHS f, void *ctx);
+void krylov_advanceTo(struct Integrator *self, double t,
+		      struct OqsAmplitude *x, RHS f, void *ctx);
+void krylov_interpolate(struct Integrator *self, double t,
+			const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+			size_t begin, size_t end);
+
+void krylov_create(struct Integrator *self, size_t dim)
+{
+	size_t m = dim < KRYLOV_MAX_DIM ? dim : KRYLOV_MAX_DIM;
+	self->ops.destroy = &krylov_destroy;
+	self->ops.takeStep = &krylov_takeStep;
+	self->ops.advanceBeyond = &krylov_advanceBeyond;
+	self->ops.advanceTo = &krylov_advanceTo;
+	self->ops.interpolate = &krylov_interpolate;
+	struct Krylov_ctx *ctx;
+	struct Arena arena;
+
+	arenaInit(&arena);
+	arenaReserve(&arena, 1, sizeof(*ctx));
+	arenaReserve(&arena, (m + 1) * dim, sizeof(*ctx->V));
+	arenaReserve(&arena, (m + 1) * m, sizeof(*ctx->H));
+	arenaReserve(&arena, m, sizeof(*ctx->u));
+	arenaReserve(&arena, m * m, sizeof(*ctx->E));
+	arenaReserve(&arena, m * m, sizeof(*ctx->B));
+	arenaReserve(&arena, m * m, sizeof(*ctx->T));
+	arenaReserve(&arena, m * m, sizeof(*ctx->work));
+	self->data = 0;
+	if (!arenaAllocate(&arena)) return;
+	ctx = arenaTakeZeroed(&arena, 1, sizeof(*ctx));
+	ctx->maxDim = m;
+	ctx->numVecs = 0;
+	// The basis is zeroed, which matters because right hand sides may
+	// skip components that vanish identically.
+	ctx->V = arenaTakeZeroed(&arena, (m + 1) * dim, sizeof(*ctx->V));
+	ctx->H = arenaTakeZeroed(&arena, (m + 1) * m, sizeof(*ctx->H));
+	ctx->u = arenaTakeZeroed(&arena, m, sizeof(*ctx->u));
+	ctx->E = arenaTakeZeroed(&arena, m * m, sizeof(*ctx->E));
+	ctx->B = arenaTakeZeroed(&arena, m * m, sizeof(*ctx->B));
+	ctx->T = arenaTakeZeroed(&arena, m * m, sizeof(*ctx->T));
+	ctx->work = arenaTakeZeroed(&arena, m * m, sizeof(*ctx->work));
+	ctx->arena = arena;
+	ctx->beta = 0;
+	ctx->hLast = 0;
+	ctx->t0 = 0;
+	ctx->h = 0;
+	self->data = ctx;
+}
+
+void krylov_destroy(struct Integrator *self)
+{
+	struct Krylov_ctx *ctx = (struct Krylov_ctx *)self->data;
+	struct Arena arena;
+	if (ctx) {
+		arena = ctx->arena;
+		arenaFree(&arena);
+	}
+	self->ops.create = 0;
+	self->ops.destroy = 0;
+	self->ops.takeStep = 0;
+	self->ops.advanceBeyond = 0;
+	self->ops.advanceTo = 0;
+	self->ops.interpolate = 0;
+	self->ops.invalidate = 0;
+	self->data = 0;
+}
+
+/* Arnoldi process with modified Gram-Schmidt orthogonalization.  Stops early
+ * when the Krylov space turns out to be invariant under A. */
+static void krylovArnoldi(struct Integrator *self,
+			  const struct OqsAmplitude *x0, RHS f, void *ctx)
+{
+	struct Krylov_ctx *c = (struct Krylov_ctx *)self->data;
+	size_t dim = self->dim;
+	size_t ldh = c->maxDim + 1;
+	struct OqsAmplitude *v, *w, *hij, minusHij;
+	double nrm = 0, wNorm;
+	size_t i, j, k;
+
+	memset(c->H, 0, ldh * c->maxDim * sizeof(*c->H));
+	c->beta = sqrt(kernelNormSquared(x0, dim));
+	c->hLast = 0;
+	c->numVecs = 0;
+	if (c->beta == 0) return;
+	for (k = 0; k < dim; ++k) {
+		c->V[k].re = x0[k].re / c->beta;
+		c->V[k].im = x0[k].im / c->beta;
+	}
+	for (j = 0; j < c->maxDim; ++j) {
+		w = c->V + (j + 1) * dim;
+		f(self->t, c->V + j * dim, w, ctx);
+		wNorm = sqrt(kernelNormSquared(w, dim));
+		for (i = 0; i <= j; ++i) {
+			v = c->V + i * dim;
+			hij = c->H + j * ldh + i;
+			*hij = kernelZdotc(v, w, dim, self->splitDim != 0);
+			minusHij.re = -hij->re;
+			minusHij.im = -hij->im;
+			kernelZaxpyc(minusHij, v, w, dim, self->splitDim != 0);
+		}
+		nrm = sqrt(kernelNormSquared(w, dim));
+		c->numVecs = j + 1;
+		if (nrm <= 1.0e-12 * wNorm) {
+			return;
+		}
+		c->H[j * ldh + j + 1].re = nrm;
+		for (k = 0; k < dim; ++k) {
+			w[k].re /= nrm;
+			w[k].im /= nrm;
+		}
+	}
+	c->hLast = nrm;
+}
+
+/* c = a * b for m x m matrices in column major order */
+static void matMul(size_t m, const struct OqsAmplitude *a,
+		   const struct OqsAmplitude *b, struct OqsAmplitude *c)
+{
+	size_t i, j, k;
+	const struct OqsAmplitude *bkj;
+	memset(c, 0, m * m * sizeof(*c));
+	for (j = 0; j < m; ++j) {
+		for (k = 0; k < m; ++k) {
+			bkj = b + j * m + k;
+			for (i = 0; i < m; ++i) {
+				c[j * m + i].re += a[k * m + i].re * bkj->re -
+						   a[k * m + i].im * bkj->im;
+				c[j * m + i].im += a[k * m + i].re * bkj->im +
+						   a[k * m + i].im * bkj->re;
+			}
+		}
+	}
+}
+
+static double norm1(size_t m, const struct OqsAmplitude *a)
+{
+	double nrm = 0, colSum;
+	size_t i, j;
+	for (j = 0; j < m; ++j) {
+		colSum = 0;
+		for (i = 0; i < m; ++i) {
+			colSum += hypot(a[j * m + i].re, a[j * m + i].im);
+		}
+		if (colSum > nrm) nrm = colSum;
+	}
+	return nrm;
+}
+
+/* Computes u = beta exp(tau H) e1 by scaling and squaring with a truncated
+ * Taylor series and returns the error estimate for the step of length
+ * tau. */
+static double krylovExp(struct Krylov_ctx *c, double tau)
+{
+	size_t m = c->numVecs;
+	size_t ldh = c->maxDim + 1;
+	struct OqsAmplitude *tmp;
+	double scale;
+	int s = 0, k;
+	size_t i, j;
+
+	if (m == 0) return 0;
+	for (j = 0; j < m; ++j) {
+		for (i = 0; i < m; ++i) {
+			c->B[j * m + i].re = tau * c->H[j * ldh + i].re;
+			c->B[j * m + i].im = tau * c->H[j * ldh + i].im;
+		}
+	}
+	scale = norm1(m, c->B);
+	while (scale > 0.5) {
+		scale *= 0.5;
+		++s;
+	}
+	scale = ldexp(1.0, -s);
+	for (i = 0; i < m * m; ++i) {
+		c->B[i].re *= scale;
+		c->B[i].im *= scale;
+	}
+	// With |B| <= 1/2 the series converges to machine precision in less
+	// than 18 terms.
+	memset(c->E, 0, m * m * sizeof(*c->E));
+	memset(c->T, 0, m * m * sizeof(*c->T));
+	for (i = 0; i < m; ++i) {
+		c->E[i * m + i].re = 1.0;
+		c->T[i * m + i].re = 1.0;
+	}
+	for (k = 1; k < 18; ++k) {
+		matMul(m, c->T, c->B, c->work);
+		tmp = c->T;
+		c->T = c->work;
+		c->work = tmp;
+		for (i = 0; i < m * m; ++i) {
+			c->T[i].re /= k;
+			c->T[i].im /= k;
+			c->E[i].re += c->T[i].re;
+			c->E[i].im += c->T[i].im;
+		}
+		if (norm1(m, c->T) < 1.0e-17) break;
+	}
+	for (k = 0; k < s; ++k) {
+		matMul(m, c->E, c->E, c->work);
+		tmp = c->E;
+		c->E = c->work;
+		c->work = tmp;
+	}
+	for (i = 0; i < m; ++i) {
+		c->u[i].re = c->beta * c->E[i].re;
+		c->u[i].im = c->beta * c->E[i].im;
+	}
+	return c->hLast * hypot(c->u[m - 1].re, c->u[m - 1].im);
+}
+
+/* Split layout version of krylovCombine.  The amplitude slots [begin, end)
+ * are the doubles [2 begin, 2 end), which are real parts below dim and
+ * imaginary parts above. */
+static double krylovCombineSplit(struct Integrator *self,
+				 struct OqsAmplitude *y, size_t begin,
+				 size_t end)
+{
+	struct Krylov_ctx *c = (struct Krylov_ctx *)self->data;
+	size_t dim = self->dim;
+	double *yd = (double *)y;
+	const double *v;
+	const struct OqsAmplitude *u = c->u;
+	double nrm = 0, sum;
+	size_t d, j;
+	for (d = 2 * begin; d < 2 * end; ++d) {
+		sum = 0;
+		for (j = 0; j < c->numVecs; ++j) {
+			v = (const double *)(c->V + j * dim);
+			if (d < dim) {
+				sum += u[j].re * v[d] - u[j].im * v[d + dim];
+			} else {
+				sum += u[j].re * v[d] + u[j].im * v[d - dim];
+			}
+		}
+		yd[d] = sum;
+		nrm += sum * sum;
+	}
+	return nrm;
+}
+
+/* y = V u for the components in [begin, end).  Returns the squared norm of
+ * those components. */
+static double krylovCombine(struct Integrator *self, struct OqsAmplitude *y,
+			    size_t begin, size_t end)
+{
+	struct Krylov_ctx *c = (struct Krylov_ctx *)self->data;
+	const struct OqsAmplitude *v;
+	double nrm = 0, re, im;
+	size_t i, j;
+	if (self->splitDim) return krylovCombineSplit(self, y, begin, end);
+	for (i = begin; i < end; ++i) {
+		re = 0;
+		im = 0;
+		for (j = 0; j < c->numVecs; ++j) {
+			v = c->V + j * self->dim + i;
+			re += c->u[j].re * v->re - c->u[j].im * v->im;
+			im += c->u[j].re * v->im + c->u[j].im * v->re;
+		}
+		y[i].re = re;
+		y[i].im = im;
+		nrm += re * re + im * im;
+	}
+	return nrm;
+}
+
+double krylov_takeStep(struct Integrator *self, const struct OqsAmplitude *x0,
+		       struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	struct Krylov_ctx *c = (struct Krylov_ctx *)self->data;
+	double h, err, tol, factor;
+
+	krylovArnoldi(self, x0, f, ctx);
+	tol = self->absTol + self->relTol * c->beta;
+	while (1) {
+		h = self->dt;
+		err = krylovExp(c, h);
+		// The error of the Krylov approximation behaves like h^m.
+		if (err > 0) {
+			factor = 0.9 * pow(tol / err, 1.0 / c->numVecs);
+			factor = fmin(5.0, fmax(0.2, factor));
+		} else {
+			factor = 5.0;
+		}
+		self->dt = h * factor;
+		if (err <= tol) break;
+	}
+	c->t0 = self->t;
+	c->h = h;
+	self->t += h;
+	return krylovCombine(self, x, 0, self->dim);
+}
+
+void krylov_advanceBeyond(struct Integrator *self, double t,
+			  struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	while (self->t < t) {
+		krylov_takeStep(self, x, x, f, ctx);
+	}
+}
+
+void krylov_advanceTo(struct Integrator *self, double t,
+		      struct OqsAmplitude *x, RHS f, void *ctx)
+{
+	struct Krylov_ctx *c = (struct Krylov_ctx *)self->data;
+	double proposedDt, h;
+	int clipped;
+	while (self->t < t) {
+		proposedDt = self->dt;
+		clipped = self->t + proposedDt >= t;
+		if (clipped) {
+			self->dt = t - self->t;
+		}
+		h = self->dt;
+		krylov_takeStep(self, x, x, f, ctx);
+		if (clipped && c->h == h) {
+			// As in dopri5_advanceTo the target time rather than
+			// the error limited the step.
+			self->t = t;
+			self->dt = proposedDt;
+		}
+	}
+}
+
+/* The Krylov approximation itself is the continuous extension of the last
+ * step.  x0 isn't needed because the basis of the last step is kept. */
+void krylov_interpolate(struct Integrator *self, double t,
+			const struct OqsAmplitude *x0, struct OqsAmplitude *y,
+			size_t begin, size_t end)
+{
+	struct Krylov_ctx *c = (struct Krylov_ctx *)self->data;
+	(void)x0;
+	krylovExp(c, t - c->t0);
+	krylovCombine(self, y, begin, end);
+}
@@ -0,0 +1,124 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <Memory.h>
+#include <string.h>
+#include <stdint.h>
+
+static void *defaultAllocate(size_t size, size_t alignment, void *ctx)
+{
+	void *p;
+	(void)ctx;
+	if (posix_memalign(&p, alignment, size) != 0) return 0;
+	return p;
+}
+
+static void defaultDeallocate(void *p, size_t size, void *ctx)
+{
+	(void)size;
+	(void)ctx;
+	free(p);
+}
+
+static struct OqsAllocator currentAllocator = {&defaultAllocate,
+					       &defaultDeallocate, 0};
+
+void oqsSetAllocator(const struct OqsAllocator *allocator)
+{
+	if (allocator) {
+		currentAllocator = *allocator;
+	} else {
+		currentAllocator.allocate = &defaultAllocate;
+		currentAllocator.deallocate = &defaultDeallocate;
+		currentAllocator.ctx = 0;
+	}
+}
+
+void oqsGetAllocator(struct OqsAllocator *allocator)
+{
+	*allocator = currentAllocator;
+}
+
+/* Size of n elements rounded up to the alignment, or SIZE_MAX on
+ * overflow. */
+static size_t alignedSize(size_t n, size_t size)
+{
+	size_t bytes;
+	if (size != 0 && n > SIZE_MAX / size) return SIZE_MAX;
+	bytes = n * size;
+	if (bytes > SIZE_MAX - (MEMORY_ALIGNMENT - 1)) return SIZE_MAX;
+	return (bytes + MEMORY_ALIGNMENT - 1) / MEMORY_ALIGNMENT *
+	       MEMORY_ALIGNMENT;
+}
+
+void arenaInit(struct Arena *arena)
+{
+	arena->allocator = currentAllocator;
+	arena->base = 0;
+	arena->capacity = 0;
+	arena->used = 0;
+	arena->overflow = 0;
+}
+
+void arenaReserve(struct Arena *arena, size_t n, size_t size)
+{
+	size_t bytes = alignedSize(n, size);
+	if (bytes == SIZE_MAX || arena->capacity > SIZE_MAX - bytes) {
+		arena->overflow = 1;
+		return;
+	}
+	arena->capacity += bytes;
+}
+
+int arenaAllocate(struct Arena *arena)
+{
+	if (arena->overflow) return 0;
+	// Allocators may return null for zero bytes.
+	if (arena->capacity == 0) arena->capacity = MEMORY_ALIGNMENT;
+	arena->base = (char *)arena->allocator.allocate(
+	    arena->capacity, MEMORY_ALIGNMENT, arena->allocator.ctx);
+	if (arena->base == 0) return 0;
+	arena->used = 0;
+	return 1;
+}
+
+void *arenaTake(struct Arena *arena, size_t n, size_t size)
+{
+	void *p = arena->base + arena->used;
+	arena->used += alignedSize(n, size);
+	return p;
+}
+
+void *arenaTakeZeroed(struct Arena *arena, size_t n, size_t size)
+{
+	void *p = arenaTake(arena, n, size);
+	memset(p, 0, n * size);
+	return p;
+}
+
+void arenaFree(struct Arena *arena)
+{
+	if (arena->base) {
+		arena->allocator.deallocate(arena->base, arena->capacity,
+					    arena->allocator.ctx);
+	}
+	arena->base = 0;
+	arena->capacity = 0;
+	arena->used = 0;
+}
@@ -0,0 +1,71 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdlib.h>
+#include <OqsAllocator.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Alignment of all buffers in bytes, a cache line and an AVX-512
+ * register. */
+#define MEMORY_ALIGNMENT 64
+
+/* An arena hands out the buffers of an object from a single allocation of
+ * the user's allocator.  The buffers are reserved first, then allocated
+ * together, and then taken in the order in which they were reserved:
+ *
+ *     arenaInit(&arena);
+ *     arenaReserve(&arena, 1, sizeof(*ctx));
+ *     arenaReserve(&arena, dim, sizeof(*ctx->k1));
+ *     if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+ *     ctx = arenaTake(&arena, 1, sizeof(*ctx));
+ *     ctx->k1 = arenaTake(&arena, dim, sizeof(*ctx->k1));
+ *
+ * Every buffer is aligned to MEMORY_ALIGNMENT.  Allocating doesn't write
+ * the memory, so the pages of a buffer are placed by the thread that first
+ * writes it; take buffers that have to start out zero with
+ * arenaTakeZeroed.  Since the arena is usually stored in memory it owns,
+ * copy it before freeing. */
+struct Arena {
+	struct OqsAllocator allocator;
+	char *base;
+	size_t capacity;
+	size_t used;
+	/* Whether a reserved size overflowed */
+	int overflow;
+};
+
+/* Starts an empty arena using the current allocator. */
+void arenaInit(struct Arena *arena);
+void arenaReserve(struct Arena *arena, size_t n, size_t size);
+/* Returns 0 if the allocation failed. */
+int arenaAllocate(struct Arena *arena);
+void *arenaTake(struct Arena *arena, size_t n, size_t size);
+void *arenaTakeZeroed(struct Arena *arena, size_t n, size_t size);
+void arenaFree(struct Arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
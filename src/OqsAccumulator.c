@@ -0,0 +1,351 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsAccumulator.h>
+#include <Kernels.h>
+#include <Checkpoint.h>
+#include <string.h>
+
+struct OqsAccumulator_ {
+	size_t dim;
+	int numObservables;
+	struct OqsObservable *observables;
+	size_t numTimes;
+	double t0;
+	double dt;
+	/* Number of samples per time, and mean and sum of squared deviations
+	 * per time and observable (observable index runs fastest). */
+	double *count;
+	double *mean;
+	double *m2;
+	struct OqsAmplitude *work;
+};
+
+OQS_STATUS oqsAccumulatorCreate(size_t dim, int numObservables,
+				const struct OqsObservable *observables,
+				size_t numTimes, double t0, double dt,
+				OqsAccumulator *accumulator)
+{
+	OqsAccumulator a = (OqsAccumulator)malloc(sizeof(*a));
+	if (a == 0) return OQS_OUT_OF_MEMORY;
+	a->dim = dim;
+	a->numObservables = numObservables;
+	a->numTimes = numTimes;
+	a->t0 = t0;
+	a->dt = dt;
+	a->observables = (struct OqsObservable *)malloc(
+	    numObservables * sizeof(*a->observables));
+	a->count = (double *)malloc(numTimes * sizeof(*a->count));
+	a->mean = (double *)malloc(numTimes * numObservables * sizeof(*a->mean));
+	a->m2 = (double *)malloc(numTimes * numObservables * sizeof(*a->m2));
+	// Zeroed since observables don't write the padding of split layout
+	// states.
+	a->work = (struct OqsAmplitude *)calloc(dim, sizeof(*a->work));
+	if (a->observables == 0 || a->count == 0 || a->mean == 0 ||
+	    a->m2 == 0 || a->work == 0) {
+		oqsAccumulatorDestroy(&a);
+		return OQS_OUT_OF_MEMORY;
+	}
+	memcpy(a->observables, observables,
+	       numObservables * sizeof(*observables));
+	oqsAccumulatorClear(a);
+	*accumulator = a;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsAccumulatorCreateLike(OqsAccumulator accumulator,
+				    OqsAccumulator *created)
+{
+	return oqsAccumulatorCreate(accumulator->dim,
+				    accumulator->numObservables,
+				    accumulator->observables,
+				    accumulator->numTimes, accumulator->t0,
+				    accumulator->dt, created);
+}
+
+OQS_STATUS oqsAccumulatorDestroy(OqsAccumulator *accumulator)
+{
+	if (*accumulator) {
+		free((*accumulator)->observables);
+		free((*accumulator)->count);
+		free((*accumulator)->mean);
+		free((*accumulator)->m2);
+		free((*accumulator)->work);
+		free(*accumulator);
+	}
+	*accumulator = 0;
+	return OQS_SUCCESS;
+}
+
+void oqsAccumulatorClear(OqsAccumulator accumulator)
+{
+	size_t n = accumulator->numTimes * accumulator->numObservables;
+	memset(accumulator->count, 0,
+	       accumulator->numTimes * sizeof(*accumulator->count));
+	memset(accumulator->mean, 0, n * sizeof(*accumulator->mean));
+	memset(accumulator->m2, 0, n * sizeof(*accumulator->m2));
+}
+
+size_t oqsAccumulatorGetNumTimes(OqsAccumulator accumulator)
+{
+	return accumulator->numTimes;
+}
+
+double oqsAccumulatorGetTime(OqsAccumulator accumulator, size_t timeIndex)
+{
+	return accumulator->t0 + timeIndex * accumulator->dt;
+}
+
+static double expectationValue(OqsAccumulator accumulator,
+			       const struct OqsObservable *observable,
+			       const struct OqsAmplitude *x, double nrm)
+{
+	double result = 0;
+	size_t i;
+	observable->apply(x, accumulator->work, observable->ctx);
+	for (i = 0; i < accumulator->dim; ++i) {
+		result += x[i].re * accumulator->work[i].re +
+			  x[i].im * accumulator->work[i].im;
+	}
+	return result / nrm;
+}
+
+/* Welford update of the mean and the sum of squared deviations with the
+ * n-th value. */
+static void addValue(double *mean, double *m2, double n, double value)
+{
+	double delta = value - *mean;
+	*mean += delta / n;
+	*m2 += delta * (value - *mean);
+}
+
+void oqsAccumulatorAddSample(OqsAccumulator accumulator, size_t timeIndex,
+			     const struct OqsAmplitude *state)
+{
+	double *mean = accumulator->mean + timeIndex * accumulator->numObservables;
+	double *m2 = accumulator->m2 + timeIndex * accumulator->numObservables;
+	double nrm, n, value;
+	int j;
+
+	nrm = kernelNormSquared(state, accumulator->dim);
+	n = accumulator->count[timeIndex] += 1.0;
+	for (j = 0; j < accumulator->numObservables; ++j) {
+		value = expectationValue(accumulator,
+					 accumulator->observables + j, state,
+					 nrm);
+		addValue(mean + j, m2 + j, n, value);
+	}
+}
+
+/* Index of the first grid time not before t. */
+static size_t firstTimeIndex(OqsAccumulator accumulator, double t)
+{
+	size_t i = 0;
+	while (i < accumulator->numTimes &&
+	       oqsAccumulatorGetTime(accumulator, i) < t) {
+		++i;
+	}
+	return i;
+}
+
+void oqsAccumulatorSampleTrajectory(OqsAccumulator accumulator,
+				    OqsJumpTrajectory trajectory,
+				    int numDecayOps,
+				    struct OqsDecayOperator *decayOps)
+{
+	double t;
+	size_t i;
+	int decay;
+
+	i = firstTimeIndex(accumulator, oqsJumpTrajectoryGetTime(trajectory));
+	for (; i < accumulator->numTimes; ++i) {
+		t = oqsAccumulatorGetTime(accumulator, i);
+		while (oqsJumpTrajectoryGetTime(trajectory) < t &&
+		       oqsJumpTrajectoryAdvance(trajectory, t)) {
+			decay = oqsJumpTrajectoryGetDecay(trajectory,
+							  numDecayOps, decayOps);
+			oqsJumpTrajectoryApplyDecay(trajectory,
+						    decayOps + decay);
+		}
+		oqsAccumulatorAddSample(accumulator, i,
+					oqsJumpTrajectoryGetState(trajectory));
+	}
+}
+
+void oqsAccumulatorSampleEnsemble(OqsAccumulator accumulator,
+				  OqsEnsemble ensemble)
+{
+	size_t numTrajectories = oqsEnsembleGetNumTrajectories(ensemble);
+	size_t i, j;
+
+	i = firstTimeIndex(accumulator, oqsEnsembleGetTime(ensemble));
+	for (; i < accumulator->numTimes; ++i) {
+		oqsEnsembleAdvance(ensemble,
+				   oqsAccumulatorGetTime(accumulator, i));
+		for (j = 0; j < numTrajectories; ++j) {
+			oqsAccumulatorAddSample(
+			    accumulator, i, oqsEnsembleGetState(ensemble, j));
+		}
+	}
+}
+
+void oqsAccumulatorSampleMasterEqn(OqsAccumulator accumulator,
+				   OqsMasterEqn master)
+{
+	double *mean, *m2;
+	double n, value;
+	size_t i;
+	int j;
+
+	i = firstTimeIndex(accumulator, oqsMasterEqnGetTime(master));
+	for (; i < accumulator->numTimes; ++i) {
+		oqsMasterEqnAdvance(master,
+				    oqsAccumulatorGetTime(accumulator, i));
+		mean = accumulator->mean + i * accumulator->numObservables;
+		m2 = accumulator->m2 + i * accumulator->numObservables;
+		n = accumulator->count[i] += 1.0;
+		for (j = 0; j < accumulator->numObservables; ++j) {
+			value = oqsMasterEqnGetExpectation(
+			    master, accumulator->observables + j);
+			addValue(mean + j, m2 + j, n, value);
+		}
+	}
+}
+
+OQS_STATUS oqsAccumulatorMerge(OqsAccumulator accumulator,
+			       OqsAccumulator other)
+{
+	double na, nb, n, delta;
+	size_t i, k;
+	int j;
+
+	if (accumulator->dim != other->dim ||
+	    accumulator->numTimes != other->numTimes ||
+	    accumulator->t0 != other->t0 || accumulator->dt != other->dt ||
+	    accumulator->numObservables != other->numObservables) {
+		return OQS_INVALID_ARGUMENT;
+	}
+	for (i = 0; i < accumulator->numTimes; ++i) {
+		na = accumulator->count[i];
+		nb = other->count[i];
+		n = na + nb;
+		if (nb == 0) continue;
+		for (j = 0; j < accumulator->numObservables; ++j) {
+			k = i * accumulator->numObservables + j;
+			delta = other->mean[k] - accumulator->mean[k];
+			accumulator->mean[k] += delta * nb / n;
+			accumulator->m2[k] +=
+			    other->m2[k] + delta * delta * na * nb / n;
+		}
+		accumulator->count[i] = n;
+	}
+	return OQS_SUCCESS;
+}
+
+double oqsAccumulatorGetCount(OqsAccumulator accumulator, size_t timeIndex)
+{
+	return accumulator->count[timeIndex];
+}
+
+double oqsAccumulatorGetMean(OqsAccumulator accumulator, int observable,
+			     size_t timeIndex)
+{
+	return accumulator
+	    ->mean[timeIndex * accumulator->numObservables + observable];
+}
+
+double oqsAccumulatorGetVariance(OqsAccumulator accumulator, int observable,
+				 size_t timeIndex)
+{
+	double n = accumulator->count[timeIndex];
+	if (n < 2) return 0;
+	return accumulator
+		   ->m2[timeIndex * accumulator->numObservables + observable] /
+	       (n - 1);
+}
+
+OQS_STATUS oqsAccumulatorSave(OqsAccumulator accumulator, const char *path)
+{
+	size_t n = accumulator->numTimes;
+	size_t m = n * accumulator->numObservables;
+	uint64_t shape[4] = {accumulator->dim, accumulator->numObservables, n,
+			     0};
+	double grid[2];
+	OQS_STATUS stat;
+	FILE *f;
+
+	grid[0] = accumulator->t0;
+	grid[1] = accumulator->dt;
+	stat = checkpointBegin(path, CHECKPOINT_ACCUMULATOR, shape, &f);
+	if (stat != OQS_SUCCESS) return stat;
+	stat = checkpointWrite(f, grid, sizeof(grid));
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, accumulator->count,
+				       n * sizeof(*accumulator->count));
+	}
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, accumulator->mean,
+				       m * sizeof(*accumulator->mean));
+	}
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, accumulator->m2,
+				       m * sizeof(*accumulator->m2));
+	}
+	return checkpointCommit(path, f, stat);
+}
+
+OQS_STATUS oqsAccumulatorLoad(OqsAccumulator accumulator, const char *path)
+{
+	size_t n = accumulator->numTimes;
+	size_t m = n * accumulator->numObservables;
+	uint64_t shape[4] = {accumulator->dim, accumulator->numObservables, n,
+			     0};
+	double grid[2];
+	double *data;
+	OQS_STATUS stat;
+	FILE *f;
+
+	data = malloc((n + 2 * m) * sizeof(*data));
+	if (data == 0) return OQS_OUT_OF_MEMORY;
+	stat = checkpointOpen(path, CHECKPOINT_ACCUMULATOR, shape, &f);
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointRead(f, grid, sizeof(grid));
+		if (stat == OQS_SUCCESS && (grid[0] != accumulator->t0 ||
+					    grid[1] != accumulator->dt)) {
+			stat = OQS_INVALID_ARGUMENT;
+		}
+		if (stat == OQS_SUCCESS) {
+			stat = checkpointRead(f, data, n * sizeof(*data));
+		}
+		if (stat == OQS_SUCCESS) {
+			stat = checkpointRead(f, data + n, m * sizeof(*data));
+		}
+		if (stat == OQS_SUCCESS) {
+			stat = checkpointRead(f, data + n + m,
+					      m * sizeof(*data));
+		}
+		fclose(f);
+	}
+	if (stat == OQS_SUCCESS) {
+		memcpy(accumulator->count, data, n * sizeof(*data));
+		memcpy(accumulator->mean, data + n, m * sizeof(*data));
+		memcpy(accumulator->m2, data + n + m, m * sizeof(*data));
+	}
+	free(data);
+	return stat;
+}
@@ -0,0 +1,418 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsDiffusiveTrajectory.h>
+#include <math.h>
+#include <string.h>
+#include <Kernels.h>
+#include <Memory.h>
+
+/* The drift a and the diffusion coefficients b_k of the stochastic
+ * Schrodinger equation are evaluated together since both need c_k x.  The
+ * expectation values in them are taken in the normalized state, so the
+ * coefficients can be evaluated at the unnormalized support points of the
+ * weak order two scheme. */
+struct OqsDiffusiveTrajectory_ {
+	size_t dim;
+	double t;
+	double dt;
+	enum OqsDiffusiveScheme scheme;
+	struct OqsAmplitude *state;
+	struct OqsAmplitude *next;
+	/* Drift at the state, a support point and its drift or diffusion, and
+	 * the decay operator applied to a support point */
+	struct OqsAmplitude *drift;
+	struct OqsAmplitude *u;
+	struct OqsAmplitude *v;
+	struct OqsAmplitude *w;
+	struct OqsSchrodingerEqn *schrodingerEqn;
+	int numDecayOps;
+	struct OqsDecayOperator *decayOps;
+	/* Diffusion coefficients at the state, one vector per operator, the
+	 * Wiener increments and the numDecayOps x numDecayOps auxiliary
+	 * increments of the weak order two scheme */
+	struct OqsAmplitude *diffusion;
+	double *dW;
+	double *aux;
+	struct OqsPhilox philox;
+	struct OqsRng rng;
+	/* Second normal deviate of the last Box-Muller transform */
+	double spareNormal;
+	int haveSpareNormal;
+	/* Owns the trajectory and the state buffers */
+	struct Arena arena;
+	/* Owns the per operator buffers */
+	struct Arena opsArena;
+};
+
+static double uniform(OqsDiffusiveTrajectory trajectory)
+{
+	return trajectory->rng.uniform(trajectory->rng.ctx);
+}
+
+static double normal(OqsDiffusiveTrajectory trajectory)
+{
+	double r, phi;
+	if (trajectory->haveSpareNormal) {
+		trajectory->haveSpareNormal = 0;
+		return trajectory->spareNormal;
+	}
+	r = sqrt(-2.0 * log(1.0 - uniform(trajectory)));
+	phi = 6.283185307179586 * uniform(trajectory);
+	trajectory->spareNormal = r * sin(phi);
+	trajectory->haveSpareNormal = 1;
+	return r * cos(phi);
+}
+
+/* <X> = 2 Re <x|c x> / <x|x> given cx = c x. */
+static double quadrature(const struct OqsAmplitude *x,
+			 const struct OqsAmplitude *cx, double nrm, size_t dim)
+{
+	return 2.0 * kernelZdotc(x, cx, dim, 0).re / nrm;
+}
+
+/* Computes the drift a(x) and, unless b is null, the diffusion
+ * coefficients b_k(x) = (c_k - <X_k> / 2) x. */
+static void coefficients(OqsDiffusiveTrajectory trajectory, double t,
+			 const struct OqsAmplitude *x, struct OqsAmplitude *a,
+			 struct OqsAmplitude *b)
+{
+	struct OqsSchrodingerEqn *eqn = trajectory->schrodingerEqn;
+	struct OqsDecayOperator *op;
+	struct OqsAmplitude *cx;
+	size_t dim = trajectory->dim;
+	double nrm = kernelNormSquared(x, dim);
+	double e;
+	int k;
+
+	if (eqn) {
+		eqn->RHS(t, x, a, eqn->ctx);
+	} else {
+		memset(a, 0, dim * sizeof(*a));
+	}
+	for (k = 0; k < trajectory->numDecayOps; ++k) {
+		op = trajectory->decayOps + k;
+		cx = b ? b + k * dim : trajectory->w;
+		op->apply(x, cx, op->ctx);
+		e = quadrature(x, cx, nrm, dim);
+		kernelZaxpy(a, 0.5 * e, cx, a, dim);
+		kernelZaxpy(a, -0.125 * e * e, x, a, dim);
+		if (b) kernelZaxpy(cx, -0.5 * e, x, cx, dim);
+	}
+}
+
+/* b_k(x) */
+static void diffusion(OqsDiffusiveTrajectory trajectory, int k,
+		      const struct OqsAmplitude *x, struct OqsAmplitude *b)
+{
+	struct OqsDecayOperator *op = trajectory->decayOps + k;
+	size_t dim = trajectory->dim;
+	double e;
+	op->apply(x, b, op->ctx);
+	e = quadrature(x, b, kernelNormSquared(x, dim), dim);
+	kernelZaxpy(b, -0.5 * e, x, b, dim);
+}
+
+static void eulerMaruyamaStep(OqsDiffusiveTrajectory trajectory, double h)
+{
+	size_t dim = trajectory->dim;
+	double sh = sqrt(h);
+	int k;
+
+	coefficients(trajectory, trajectory->t, trajectory->state,
+		     trajectory->drift, trajectory->diffusion);
+	kernelZaxpy(trajectory->next, h, trajectory->drift, trajectory->state,
+		    dim);
+	for (k = 0; k < trajectory->numDecayOps; ++k) {
+		kernelZaxpy(trajectory->next, sh * normal(trajectory),
+			    trajectory->diffusion + k * dim, trajectory->next,
+			    dim);
+	}
+}
+
+/* Three point distributed Wiener increments, +-sqrt(3 h) with probability
+ * 1/6 each and 0 otherwise, and the auxiliary increments V_{r,k} = +-h for
+ * r > k, V_{k,r} = -V_{r,k}. */
+static void drawWeak2Increments(OqsDiffusiveTrajectory trajectory, double h)
+{
+	int m = trajectory->numDecayOps;
+	double s = sqrt(3.0 * h);
+	double z;
+	int r, k;
+	for (k = 0; k < m; ++k) {
+		z = uniform(trajectory);
+		trajectory->dW[k] = z < 1.0 / 6.0 ? s : z < 1.0 / 3.0 ? -s : 0;
+	}
+	for (r = 0; r < m; ++r) {
+		trajectory->aux[r * m + r] = -h;
+		for (k = 0; k < r; ++k) {
+			z = uniform(trajectory) < 0.5 ? h : -h;
+			trajectory->aux[r * m + k] = z;
+			trajectory->aux[k * m + r] = -z;
+		}
+	}
+}
+
+/* Explicit order 2.0 weak scheme, Kloeden and Platen (15.1.3).  It needs
+ * 2 m^2 + 1 diffusion coefficients and two drift evaluations per step for
+ * m decay operators. */
+static void weak2Step(OqsDiffusiveTrajectory trajectory, double h)
+{
+	const struct OqsAmplitude *x = trajectory->state;
+	struct OqsAmplitude *next = trajectory->next;
+	struct OqsAmplitude *u = trajectory->u;
+	struct OqsAmplitude *v = trajectory->v;
+	struct OqsAmplitude *b = trajectory->diffusion;
+	size_t dim = trajectory->dim;
+	int m = trajectory->numDecayOps;
+	double sh = sqrt(h);
+	double *dW = trajectory->dW;
+	double c, s;
+	int r, k;
+
+	drawWeak2Increments(trajectory, h);
+	coefficients(trajectory, trajectory->t, x, trajectory->drift, b);
+	// Terms with the coefficients at the state
+	kernelZaxpy(next, 0.5 * h, trajectory->drift, x, dim);
+	for (k = 0; k < m; ++k) {
+		kernelZaxpy(next, 0.5 * (2 - m) * dW[k], b + k * dim, next,
+			    dim);
+	}
+	// Drift at the supporting value x + a h + sum_k b_k dW_k
+	kernelZaxpy(u, h, trajectory->drift, x, dim);
+	for (k = 0; k < m; ++k) {
+		kernelZaxpy(u, dW[k], b + k * dim, u, dim);
+	}
+	coefficients(trajectory, trajectory->t + h, u, v, 0);
+	kernelZaxpy(next, 0.5 * h, v, next, dim);
+	// b_k at x + a h +- b_k sqrt(h)
+	for (k = 0; k < m; ++k) {
+		c = 0.25 * (dW[k] * dW[k] - h) / sh;
+		for (s = -1.0; s <= 1.0; s += 2.0) {
+			kernelZaxpy(u, h, trajectory->drift, x, dim);
+			kernelZaxpy(u, s * sh, b + k * dim, u, dim);
+			diffusion(trajectory, k, u, v);
+			kernelZaxpy(next, 0.25 * dW[k] + s * c, v, next, dim);
+		}
+	}
+	// b_k at x +- b_r sqrt(h) for k != r
+	for (r = 0; r < m; ++r) {
+		for (s = -1.0; s <= 1.0; s += 2.0) {
+			kernelZaxpy(u, s * sh, b + r * dim, x, dim);
+			for (k = 0; k < m; ++k) {
+				if (k == r) continue;
+				c = 0.25 * (dW[k] * dW[r] +
+					    trajectory->aux[r * m + k]) / sh;
+				diffusion(trajectory, k, u, v);
+				kernelZaxpy(next, 0.25 * dW[k] + s * c, v,
+					    next, dim);
+			}
+		}
+	}
+}
+
+static void normalize(struct OqsAmplitude *x, size_t dim)
+{
+	struct OqsAmplitude a;
+	a.re = 1.0 / sqrt(kernelNormSquared(x, dim));
+	a.im = 0;
+	kernelZscalc(a, x, x, dim, 0);
+}
+
+static void takeStep(OqsDiffusiveTrajectory trajectory, double h)
+{
+	struct OqsAmplitude *tmp;
+	if (trajectory->scheme == OQS_DIFFUSIVE_WEAK2) {
+		weak2Step(trajectory, h);
+	} else {
+		eulerMaruyamaStep(trajectory, h);
+	}
+	normalize(trajectory->next, trajectory->dim);
+	tmp = trajectory->state;
+	trajectory->state = trajectory->next;
+	trajectory->next = tmp;
+	trajectory->t += h;
+}
+
+OQS_STATUS oqsDiffusiveTrajectoryCreate(size_t dim,
+					OqsDiffusiveTrajectory *trajectory)
+{
+	OqsDiffusiveTrajectory t;
+	struct Arena arena;
+	int i;
+
+	if (dim == 0) return OQS_INVALID_ARGUMENT;
+	arenaInit(&arena);
+	arenaReserve(&arena, 1, sizeof(*t));
+	for (i = 0; i < 6; ++i) arenaReserve(&arena, dim, sizeof(*t->state));
+	if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+	t = arenaTakeZeroed(&arena, 1, sizeof(*t));
+	t->dim = dim;
+	t->state = arenaTakeZeroed(&arena, dim, sizeof(*t->state));
+	t->next = arenaTakeZeroed(&arena, dim, sizeof(*t->next));
+	t->drift = arenaTakeZeroed(&arena, dim, sizeof(*t->drift));
+	t->u = arenaTakeZeroed(&arena, dim, sizeof(*t->u));
+	t->v = arenaTakeZeroed(&arena, dim, sizeof(*t->v));
+	t->w = arenaTakeZeroed(&arena, dim, sizeof(*t->w));
+	t->arena = arena;
+	arenaInit(&t->opsArena);
+	t->t = 0;
+	t->dt = 1.0e-3;
+	t->scheme = OQS_DIFFUSIVE_EULER_MARUYAMA;
+	t->schrodingerEqn = 0;
+	t->numDecayOps = 0;
+	t->decayOps = 0;
+	t->diffusion = 0;
+	t->dW = 0;
+	t->aux = 0;
+	oqsDiffusiveTrajectorySeed(t, OQS_PHILOX_DEFAULT_SEED,
+				   oqsPhiloxReserveStreams(1));
+	*trajectory = t;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsDiffusiveTrajectoryDestroy(OqsDiffusiveTrajectory *trajectory)
+{
+	struct Arena arena;
+	if (*trajectory) {
+		arenaFree(&(*trajectory)->opsArena);
+		arena = (*trajectory)->arena;
+		arenaFree(&arena);
+	}
+	*trajectory = 0;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS
+oqsDiffusiveTrajectorySetSchrodingerEqn(OqsDiffusiveTrajectory trajectory,
+					struct OqsSchrodingerEqn *eqn)
+{
+	trajectory->schrodingerEqn = eqn;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS
+oqsDiffusiveTrajectorySetDecayOperators(OqsDiffusiveTrajectory trajectory,
+					int numDecayOps,
+					struct OqsDecayOperator *decayOps)
+{
+	struct Arena arena;
+	size_t m;
+
+	if (numDecayOps < 0) return OQS_INVALID_ARGUMENT;
+	m = numDecayOps;
+	arenaInit(&arena);
+	arenaReserve(&arena, m * trajectory->dim,
+		     sizeof(*trajectory->diffusion));
+	arenaReserve(&arena, m, sizeof(*trajectory->dW));
+	arenaReserve(&arena, m * m, sizeof(*trajectory->aux));
+	if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+	arenaFree(&trajectory->opsArena);
+	trajectory->diffusion = arenaTakeZeroed(&arena, m * trajectory->dim,
+					  sizeof(*trajectory->diffusion));
+	trajectory->dW = arenaTakeZeroed(&arena, m, sizeof(*trajectory->dW));
+	trajectory->aux =
+	    arenaTakeZeroed(&arena, m * m, sizeof(*trajectory->aux));
+	trajectory->opsArena = arena;
+	trajectory->numDecayOps = numDecayOps;
+	trajectory->decayOps = decayOps;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS
+oqsDiffusiveTrajectorySetScheme(OqsDiffusiveTrajectory trajectory,
+				enum OqsDiffusiveScheme scheme)
+{
+	if (scheme != OQS_DIFFUSIVE_EULER_MARUYAMA &&
+	    scheme != OQS_DIFFUSIVE_WEAK2) {
+		return OQS_INVALID_ARGUMENT;
+	}
+	trajectory->scheme = scheme;
+	return OQS_SUCCESS;
+}
+
+void oqsDiffusiveTrajectoryTimeStepHint(OqsDiffusiveTrajectory trajectory,
+					double dt)
+{
+	trajectory->dt = dt;
+}
+
+OQS_STATUS
+oqsDiffusiveTrajectorySetState(OqsDiffusiveTrajectory trajectory,
+			       const struct OqsAmplitude *state)
+{
+	if (kernelNormSquared(state, trajectory->dim) == 0) {
+		return OQS_INVALID_ARGUMENT;
+	}
+	memcpy(trajectory->state, state, trajectory->dim * sizeof(*state));
+	normalize(trajectory->state, trajectory->dim);
+	return OQS_SUCCESS;
+}
+
+struct OqsAmplitude *
+oqsDiffusiveTrajectoryGetState(OqsDiffusiveTrajectory trajectory)
+{
+	return trajectory->state;
+}
+
+size_t oqsDiffusiveTrajectoryGetDim(OqsDiffusiveTrajectory trajectory)
+{
+	return trajectory->dim;
+}
+
+double oqsDiffusiveTrajectoryGetTime(OqsDiffusiveTrajectory trajectory)
+{
+	return trajectory->t;
+}
+
+void oqsDiffusiveTrajectorySetTime(OqsDiffusiveTrajectory trajectory,
+				   double t)
+{
+	trajectory->t = t;
+}
+
+void oqsDiffusiveTrajectorySeed(OqsDiffusiveTrajectory trajectory,
+				uint64_t seed, uint64_t stream)
+{
+	oqsPhiloxInit(&trajectory->philox, seed, stream);
+	oqsDiffusiveTrajectorySetRng(trajectory, 0);
+}
+
+void oqsDiffusiveTrajectorySetRng(OqsDiffusiveTrajectory trajectory,
+				  const struct OqsRng *rng)
+{
+	if (rng) {
+		trajectory->rng = *rng;
+	} else {
+		trajectory->rng.uniform = &oqsPhiloxUniform;
+		trajectory->rng.ctx = &trajectory->philox;
+	}
+	trajectory->haveSpareNormal = 0;
+}
+
+void oqsDiffusiveTrajectoryAdvance(OqsDiffusiveTrajectory trajectory,
+				   double t)
+{
+	while (trajectory->t + trajectory->dt < t) {
+		takeStep(trajectory, trajectory->dt);
+	}
+	if (trajectory->t < t) {
+		takeStep(trajectory, t - trajectory->t);
+		trajectory->t = t;
+	}
+}
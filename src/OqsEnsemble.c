@@ -0,0 +1,440 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsEnsemble.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Integrator.h>
+#include <DecayTime.h>
+#include <Kernels.h>
+#include <Stats.h>
+#include <Memory.h>
+#include <JumpTrajectory.h>
+#include <Checkpoint.h>
+
+/* The states of all trajectories are stored in a single dim x
+ * numTrajectories block and are advanced together by one integrator with a
+ * batched right hand side.  Trajectories whose norm drops below their
+ * decay norm during a step are located on the continuous extension of the
+ * step.  The jump and the remainder of the step are then handled by a
+ * scratch trajectory that evolves only that one state, drawing from the
+ * random number generator of the trajectory it stands in for. */
+struct OqsEnsemble_ {
+	size_t dim;
+	size_t numTrajectories;
+	struct OqsAmplitude *states;
+	struct OqsAmplitude *previousStates;
+	double *z;
+	struct OqsPhilox *rngs;
+	struct Integrator integrator;
+	struct OqsEnsembleSchrodingerEqn *schrodingerEqn;
+	int numDecayOps;
+	struct OqsDecayOperator *decayOps;
+	double decayTimeTolerance;
+	double decayNormTolerance;
+	OqsJumpTrajectory scratch;
+	struct OqsSchrodingerEqn scratchEqn;
+	struct OqsTrajectoryStats stats;
+	int timers;
+	/* Owns the ensemble, the states, the decay norms, the generators, the
+	 * scratch trajectory and the integrator */
+	struct Arena arena;
+};
+
+static void ensembleRHS(double t, const struct OqsAmplitude *x,
+			struct OqsAmplitude *y, void *ctx)
+{
+	OqsEnsemble ensemble = (OqsEnsemble)ctx;
+#ifdef OQS_ENABLE_STATS
+	double t0 = 0;
+	ensemble->stats.rhsCalls += ensemble->numTrajectories;
+	if (ensemble->timers) t0 = statsWallTime();
+#endif
+	ensemble->schrodingerEqn->RHS(t, ensemble->numTrajectories, x, y,
+				      ensemble->schrodingerEqn->ctx);
+#ifdef OQS_ENABLE_STATS
+	if (ensemble->timers) {
+		ensemble->stats.rhsSeconds += statsWallTime() - t0;
+	}
+#endif
+}
+
+static void singleRHS(double t, const struct OqsAmplitude *x,
+		      struct OqsAmplitude *y, void *ctx)
+{
+	OqsEnsemble ensemble = (OqsEnsemble)ctx;
+	ensemble->schrodingerEqn->RHS(t, 1, x, y,
+				      ensemble->schrodingerEqn->ctx);
+}
+
+OQS_STATUS oqsEnsembleCreate(size_t dim, size_t numTrajectories,
+			     OqsEnsemble *ensemble)
+{
+	OqsEnsemble e;
+	struct Arena arena;
+	size_t size = dim * numTrajectories;
+
+	arenaInit(&arena);
+	arenaReserve(&arena, 1, sizeof(*e));
+	arenaReserve(&arena, size, sizeof(*e->states));
+	arenaReserve(&arena, size, sizeof(*e->previousStates));
+	arenaReserve(&arena, numTrajectories, sizeof(*e->z));
+	arenaReserve(&arena, numTrajectories, sizeof(*e->rngs));
+	jumpTrajectoryReserve(&arena, dim, OQS_LAYOUT_INTERLEAVED);
+	integratorReserve(&arena, size);
+	if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+	e = arenaTakeZeroed(&arena, 1, sizeof(*e));
+	e->dim = dim;
+	e->numTrajectories = numTrajectories;
+	e->states = arenaTakeZeroed(&arena, size, sizeof(*e->states));
+	e->previousStates =
+	    arenaTakeZeroed(&arena, size, sizeof(*e->previousStates));
+	e->z = arenaTakeZeroed(&arena, numTrajectories, sizeof(*e->z));
+	e->rngs = arenaTakeZeroed(&arena, numTrajectories, sizeof(*e->rngs));
+	e->scratch = jumpTrajectoryCreateFrom(&arena, dim,
+					     OQS_LAYOUT_INTERLEAVED);
+	integratorCreateFrom(&e->integrator, &arena, size);
+	e->arena = arena;
+	e->scratchEqn.RHS = &singleRHS;
+	e->scratchEqn.ctx = e;
+	oqsJumpTrajectorySetSchrodingerEqn(e->scratch, &e->scratchEqn);
+	e->schrodingerEqn = 0;
+	e->numDecayOps = 0;
+	e->decayOps = 0;
+	e->decayTimeTolerance = 1.0e-7;
+	e->decayNormTolerance = 1.0e-12;
+	memset(&e->stats, 0, sizeof(e->stats));
+	e->timers = 0;
+	oqsEnsembleSeed(e, OQS_PHILOX_DEFAULT_SEED,
+			oqsPhiloxReserveStreams(numTrajectories));
+	*ensemble = e;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsEnsembleDestroy(OqsEnsemble *ensemble)
+{
+	struct Arena arena;
+	if (*ensemble) {
+		integratorDestroy(&(*ensemble)->integrator);
+		oqsJumpTrajectoryDestroy(&(*ensemble)->scratch);
+		arena = (*ensemble)->arena;
+		arenaFree(&arena);
+	}
+	*ensemble = 0;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsEnsembleSetSchrodingerEqn(OqsEnsemble ensemble,
+					struct OqsEnsembleSchrodingerEqn *eqn)
+{
+	ensemble->schrodingerEqn = eqn;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsEnsembleSetDecayOperators(OqsEnsemble ensemble,
+					int numDecayOps,
+					struct OqsDecayOperator *decayOps)
+{
+	ensemble->numDecayOps = numDecayOps;
+	ensemble->decayOps = decayOps;
+	return oqsJumpTrajectoryReserveDecayChannels(ensemble->scratch,
+						     numDecayOps);
+}
+
+OQS_STATUS oqsEnsembleSetDecayRates(OqsEnsemble ensemble, int numDecayOps,
+				    const double *rates)
+{
+	return oqsJumpTrajectorySetDecayRates(ensemble->scratch, numDecayOps,
+					      rates);
+}
+
+OQS_STATUS
+oqsEnsembleSetDecayExpectations(OqsEnsemble ensemble, int numDecayOps,
+				const OqsDecayExpectation *expectations)
+{
+	return oqsJumpTrajectorySetDecayExpectations(ensemble->scratch,
+						     numDecayOps, expectations);
+}
+
+size_t oqsEnsembleGetDim(OqsEnsemble ensemble)
+{
+	return ensemble->dim;
+}
+
+size_t oqsEnsembleGetNumTrajectories(OqsEnsemble ensemble)
+{
+	return ensemble->numTrajectories;
+}
+
+struct OqsAmplitude *oqsEnsembleGetStates(OqsEnsemble ensemble)
+{
+	return ensemble->states;
+}
+
+struct OqsAmplitude *oqsEnsembleGetState(OqsEnsemble ensemble, size_t i)
+{
+	return ensemble->states + i * ensemble->dim;
+}
+
+double oqsEnsembleGetTime(OqsEnsemble ensemble)
+{
+	return integratorGetTime(&ensemble->integrator);
+}
+
+void oqsEnsembleTimeStepHint(OqsEnsemble ensemble, double dt)
+{
+	integratorTimeStepHint(&ensemble->integrator, dt);
+	oqsJumpTrajectoryTimeStepHint(ensemble->scratch, dt);
+}
+
+void oqsEnsembleReset(OqsEnsemble ensemble,
+		      const struct OqsAmplitude *initialState, double t)
+{
+	size_t i;
+	for (i = 0; i < ensemble->numTrajectories; ++i) {
+		memcpy(ensemble->states + i * ensemble->dim, initialState,
+		       ensemble->dim * sizeof(*initialState));
+		ensemble->z[i] = oqsPhiloxUniform(ensemble->rngs + i);
+	}
+	integratorSetTime(&ensemble->integrator, t);
+}
+
+void oqsEnsembleSeed(OqsEnsemble ensemble, uint64_t seed,
+		     uint64_t firstStream)
+{
+	size_t i;
+	for (i = 0; i < ensemble->numTrajectories; ++i) {
+		oqsPhiloxInit(ensemble->rngs + i, seed, firstStream + i);
+		ensemble->z[i] = oqsPhiloxUniform(ensemble->rngs + i);
+	}
+}
+
+/* Handles the jumps of trajectory i during the last step from tLeft to
+ * tRight.  Returns the number of jumps. */
+static size_t processJumps(OqsEnsemble ensemble, size_t i, double tLeft,
+			   double tRight)
+{
+	OqsJumpTrajectory scratch = ensemble->scratch;
+	struct OqsAmplitude *state = ensemble->states + i * ensemble->dim;
+	size_t begin = i * ensemble->dim;
+	size_t numJumps = 0;
+	double tDecay;
+	int decay, iterations;
+	struct OqsRng rng;
+
+	tDecay = findDecayTime(&ensemble->integrator, ensemble->previousStates,
+			       ensemble->states, begin, begin + ensemble->dim,
+			       tLeft, tRight, ensemble->z[i],
+			       ensemble->decayTimeTolerance,
+			       ensemble->decayNormTolerance, &iterations);
+	OQS_STATS_ADD(ensemble->stats, rootIterations, iterations);
+	OQS_STATS_ADD(ensemble->stats, backtracks, 1);
+	rng.uniform = &oqsPhiloxUniform;
+	rng.ctx = ensemble->rngs + i;
+	oqsJumpTrajectorySetRng(scratch, &rng);
+	oqsJumpTrajectorySetState(scratch, state);
+	oqsJumpTrajectorySetTime(scratch, tDecay);
+	do {
+		decay = oqsJumpTrajectoryGetDecay(scratch, ensemble->numDecayOps,
+						  ensemble->decayOps);
+		oqsJumpTrajectoryApplyDecay(scratch,
+					    ensemble->decayOps + decay);
+		++numJumps;
+	} while (oqsJumpTrajectoryGetTime(scratch) < tRight &&
+		 oqsJumpTrajectoryAdvance(scratch, tRight));
+	memcpy(state, oqsJumpTrajectoryGetState(scratch),
+	       ensemble->dim * sizeof(*state));
+	ensemble->z[i] = oqsJumpTrajectoryGetNextDecayNorm(scratch);
+	return numJumps;
+}
+
+static size_t advance(OqsEnsemble ensemble, double t)
+{
+	struct Integrator *integrator = &ensemble->integrator;
+	struct OqsAmplitude *tmp;
+	size_t numJumps = 0;
+	double currentTime, previousTime;
+	size_t i;
+
+	currentTime = integratorGetTime(integrator);
+	while (currentTime < t) {
+		// Double buffered like the states of a single trajectory.
+		tmp = ensemble->previousStates;
+		ensemble->previousStates = ensemble->states;
+		ensemble->states = tmp;
+		previousTime = currentTime;
+		integratorTakeStepFrom(integrator, ensemble->previousStates,
+				       ensemble->states, &ensembleRHS,
+				       ensemble);
+		OQS_STATS_ADD(ensemble->stats, steps,
+			      ensemble->numTrajectories);
+		currentTime = integratorGetTime(integrator);
+		if (currentTime > t) {
+			OQS_STATS_ADD(ensemble->stats, backtracks,
+				      ensemble->numTrajectories);
+			integratorInterpolate(integrator, t,
+					      ensemble->previousStates,
+					      ensemble->states);
+			currentTime = t;
+			integratorSetTime(integrator, t);
+		}
+		for (i = 0; i < ensemble->numTrajectories; ++i) {
+			if (kernelNormSquared(ensemble->states +
+						  i * ensemble->dim,
+					      ensemble->dim) < ensemble->z[i]) {
+				numJumps += processJumps(ensemble, i,
+							 previousTime,
+							 currentTime);
+			}
+		}
+	}
+	return numJumps;
+}
+
+size_t oqsEnsembleAdvance(OqsEnsemble ensemble, double t)
+{
+#ifdef OQS_ENABLE_STATS
+	double t0;
+	size_t numJumps;
+	if (ensemble->timers) {
+		t0 = statsWallTime();
+		numJumps = advance(ensemble, t);
+		ensemble->stats.advanceSeconds += statsWallTime() - t0;
+		return numJumps;
+	}
+#endif
+	return advance(ensemble, t);
+}
+
+void oqsEnsembleGetStats(OqsEnsemble ensemble,
+			 struct OqsTrajectoryStats *stats)
+{
+	struct OqsTrajectoryStats scratch;
+
+	/* The work of the scratch trajectory happens inside of the ensemble
+	 * advance so its advance time is already accounted for. */
+	oqsJumpTrajectoryGetStats(ensemble->scratch, &scratch);
+	*stats = ensemble->stats;
+	stats->steps += scratch.steps;
+	stats->rhsCalls += scratch.rhsCalls;
+	stats->rootIterations += scratch.rootIterations;
+	stats->backtracks += scratch.backtracks;
+	stats->jumps += scratch.jumps;
+	stats->rhsSeconds += scratch.rhsSeconds;
+}
+
+void oqsEnsembleResetStats(OqsEnsemble ensemble)
+{
+	memset(&ensemble->stats, 0, sizeof(ensemble->stats));
+	oqsJumpTrajectoryResetStats(ensemble->scratch);
+}
+
+void oqsEnsembleEnableTimers(OqsEnsemble ensemble, int enable)
+{
+	ensemble->timers = enable;
+	oqsJumpTrajectoryEnableTimers(ensemble->scratch, enable);
+}
+
+struct EnsembleCheckpoint {
+	double t;
+	double dt;
+	struct OqsTrajectoryStats stats;
+};
+
+OQS_STATUS oqsEnsembleSave(OqsEnsemble ensemble, const char *path)
+{
+	size_t n = ensemble->numTrajectories;
+	uint64_t shape[4] = {ensemble->dim, n, 0, 0};
+	struct EnsembleCheckpoint record;
+	OQS_STATUS stat;
+	FILE *f;
+
+	memset(&record, 0, sizeof(record));
+	record.t = integratorGetTime(&ensemble->integrator);
+	record.dt = ensemble->integrator.dt;
+	oqsEnsembleGetStats(ensemble, &record.stats);
+	stat = checkpointBegin(path, CHECKPOINT_ENSEMBLE, shape, &f);
+	if (stat != OQS_SUCCESS) return stat;
+	stat = checkpointWrite(f, &record, sizeof(record));
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, ensemble->states,
+				       ensemble->dim * n *
+					   sizeof(*ensemble->states));
+	}
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, ensemble->z,
+				       n * sizeof(*ensemble->z));
+	}
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, ensemble->rngs,
+				       n * sizeof(*ensemble->rngs));
+	}
+	return checkpointCommit(path, f, stat);
+}
+
+OQS_STATUS oqsEnsembleLoad(OqsEnsemble ensemble, const char *path)
+{
+	size_t n = ensemble->numTrajectories;
+	uint64_t shape[4] = {ensemble->dim, n, 0, 0};
+	struct EnsembleCheckpoint record;
+	struct OqsAmplitude *tmp;
+	double *z;
+	struct OqsPhilox *rngs;
+	OQS_STATUS stat;
+	FILE *f;
+
+	z = malloc(n * sizeof(*z));
+	rngs = malloc(n * sizeof(*rngs));
+	if (z == 0 || rngs == 0) {
+		free(z);
+		free(rngs);
+		return OQS_OUT_OF_MEMORY;
+	}
+	stat = checkpointOpen(path, CHECKPOINT_ENSEMBLE, shape, &f);
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointRead(f, &record, sizeof(record));
+		// The previous states are only used during a step, so they can
+		// hold the states until the whole file has been read.
+		if (stat == OQS_SUCCESS) {
+			stat = checkpointRead(f, ensemble->previousStates,
+					      ensemble->dim * n *
+						  sizeof(*ensemble->states));
+		}
+		if (stat == OQS_SUCCESS) {
+			stat = checkpointRead(f, z, n * sizeof(*z));
+		}
+		if (stat == OQS_SUCCESS) {
+			stat = checkpointRead(f, rngs, n * sizeof(*rngs));
+		}
+		fclose(f);
+	}
+	if (stat == OQS_SUCCESS) {
+		tmp = ensemble->states;
+		ensemble->states = ensemble->previousStates;
+		ensemble->previousStates = tmp;
+		memcpy(ensemble->z, z, n * sizeof(*z));
+		memcpy(ensemble->rngs, rngs, n * sizeof(*rngs));
+		integratorSetTime(&ensemble->integrator, record.t);
+		integratorTimeStepHint(&ensemble->integrator, record.dt);
+		oqsJumpTrajectoryResetStats(ensemble->scratch);
+		ensemble->stats = record.stats;
+	}
+	free(z);
+	free(rngs);
+	return stat;
+}
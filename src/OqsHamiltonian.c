@@ -0,0 +1,322 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsHamiltonian.h>
+#include <string.h>
+#include <Memory.h>
+
+/* A nonzero of one of the terms as it was added */
+struct HamiltonianEntry {
+	size_t row;
+	size_t col;
+	int term;
+	struct OqsAmplitude value;
+};
+
+/* The entries of all terms are kept as added and merged into a compressed
+ * row matrix whose entries carry the index of their term.  Term 0 is the
+ * static part with coefficient 1, term k > 0 has coefficient
+ * coefficients[k - 1]. */
+struct OqsHamiltonian_ {
+	size_t dim;
+	int numTerms;
+	struct OqsCoefficient *coefficients;
+	struct HamiltonianEntry *entries;
+	size_t numEntries;
+	size_t entriesCapacity;
+	/* Compressed rows: the entries of row i are rowStart[i], ...,
+	 * rowStart[i + 1] - 1, sorted by column and term */
+	size_t *rowStart;
+	size_t *cols;
+	int *terms;
+	struct OqsAmplitude *values;
+	/* Owns the compressed rows */
+	struct Arena arena;
+};
+
+static void evaluateCoefficients(OqsHamiltonian hamiltonian, double t,
+				 double *c)
+{
+	const struct OqsCoefficient *f;
+	int k;
+	c[0] = 1.0;
+	for (k = 1; k <= hamiltonian->numTerms; ++k) {
+		f = hamiltonian->coefficients + k - 1;
+		c[k] = f->eval(t, f->ctx);
+	}
+}
+
+/* y = -i H x for interleaved x and y given the coefficients c. */
+static void applyInterleaved(OqsHamiltonian hamiltonian, const double *c,
+			     const struct OqsAmplitude *x,
+			     struct OqsAmplitude *y)
+{
+	const struct OqsAmplitude *v;
+	const struct OqsAmplitude *xc;
+	double re, im, a;
+	size_t i, e;
+	for (i = 0; i < hamiltonian->dim; ++i) {
+		re = 0;
+		im = 0;
+		for (e = hamiltonian->rowStart[i];
+		     e < hamiltonian->rowStart[i + 1]; ++e) {
+			a = c[hamiltonian->terms[e]];
+			v = hamiltonian->values + e;
+			xc = x + hamiltonian->cols[e];
+			re += a * (v->re * xc->re - v->im * xc->im);
+			im += a * (v->re * xc->im + v->im * xc->re);
+		}
+		y[i].re = im;
+		y[i].im = -re;
+	}
+}
+
+/* Same as applyInterleaved for the split layout. */
+static void applySplit(OqsHamiltonian hamiltonian, const double *c,
+		       const struct OqsAmplitude *x, struct OqsAmplitude *y)
+{
+	size_t dim = hamiltonian->dim;
+	const double *xr = OQS_SPLIT_RE(x);
+	const double *xi = OQS_SPLIT_IM(x, dim);
+	double *yr = OQS_SPLIT_RE(y);
+	double *yi = OQS_SPLIT_IM(y, dim);
+	const struct OqsAmplitude *v;
+	double re, im, a;
+	size_t i, e, j;
+	for (i = 0; i < dim; ++i) {
+		re = 0;
+		im = 0;
+		for (e = hamiltonian->rowStart[i];
+		     e < hamiltonian->rowStart[i + 1]; ++e) {
+			a = c[hamiltonian->terms[e]];
+			v = hamiltonian->values + e;
+			j = hamiltonian->cols[e];
+			re += a * (v->re * xr[j] - v->im * xi[j]);
+			im += a * (v->re * xi[j] + v->im * xr[j]);
+		}
+		yr[i] = im;
+		yi[i] = -re;
+	}
+}
+
+/* The coefficients are kept on the stack so that the equations can be
+ * evaluated concurrently. */
+static void interleavedRHS(double t, const struct OqsAmplitude *x,
+			   struct OqsAmplitude *y, void *ctx)
+{
+	OqsHamiltonian hamiltonian = (OqsHamiltonian)ctx;
+	double c[OQS_HAMILTONIAN_MAX_TERMS + 1];
+	evaluateCoefficients(hamiltonian, t, c);
+	applyInterleaved(hamiltonian, c, x, y);
+}
+
+static void splitRHS(double t, const struct OqsAmplitude *x,
+		     struct OqsAmplitude *y, void *ctx)
+{
+	OqsHamiltonian hamiltonian = (OqsHamiltonian)ctx;
+	double c[OQS_HAMILTONIAN_MAX_TERMS + 1];
+	evaluateCoefficients(hamiltonian, t, c);
+	applySplit(hamiltonian, c, x, y);
+}
+
+static void ensembleRHS(double t, size_t n, const struct OqsAmplitude *x,
+			struct OqsAmplitude *y, void *ctx)
+{
+	OqsHamiltonian hamiltonian = (OqsHamiltonian)ctx;
+	size_t dim = hamiltonian->dim;
+	double c[OQS_HAMILTONIAN_MAX_TERMS + 1];
+	size_t j;
+	evaluateCoefficients(hamiltonian, t, c);
+	for (j = 0; j < n; ++j) {
+		applyInterleaved(hamiltonian, c, x + j * dim, y + j * dim);
+	}
+}
+
+/* Orders entries by row, column and term. */
+static int compareEntries(const void *a, const void *b)
+{
+	const struct HamiltonianEntry *x = (const struct HamiltonianEntry *)a;
+	const struct HamiltonianEntry *y = (const struct HamiltonianEntry *)b;
+	if (x->row != y->row) return x->row < y->row ? -1 : 1;
+	if (x->col != y->col) return x->col < y->col ? -1 : 1;
+	if (x->term != y->term) return x->term < y->term ? -1 : 1;
+	return 0;
+}
+
+/* Builds the compressed rows from the entries.  Returns 0 if the memory
+ * can't be allocated, in which case the previous rows are kept. */
+static int compress(OqsHamiltonian hamiltonian)
+{
+	struct OqsHamiltonian_ h = *hamiltonian;
+	struct HamiltonianEntry *sorted;
+	const struct HamiltonianEntry *entry;
+	size_t nnz = hamiltonian->numEntries;
+	size_t i, e, out;
+
+	arenaInit(&h.arena);
+	arenaReserve(&h.arena, h.dim + 1, sizeof(*h.rowStart));
+	arenaReserve(&h.arena, nnz, sizeof(*h.cols));
+	arenaReserve(&h.arena, nnz, sizeof(*h.terms));
+	arenaReserve(&h.arena, nnz, sizeof(*h.values));
+	if (!arenaAllocate(&h.arena)) return 0;
+	sorted = (struct HamiltonianEntry *)malloc(nnz * sizeof(*sorted) + 1);
+	if (sorted == 0) {
+		arenaFree(&h.arena);
+		return 0;
+	}
+	h.rowStart = arenaTakeZeroed(&h.arena, h.dim + 1, sizeof(*h.rowStart));
+	h.cols = arenaTake(&h.arena, nnz, sizeof(*h.cols));
+	h.terms = arenaTake(&h.arena, nnz, sizeof(*h.terms));
+	h.values = arenaTake(&h.arena, nnz, sizeof(*h.values));
+
+	// Sort a copy, since the entries are kept as added, and sum repeated
+	// entries.  Afterwards rowStart[i + 1] is the length of row i.
+	if (nnz > 0) memcpy(sorted, h.entries, nnz * sizeof(*sorted));
+	qsort(sorted, nnz, sizeof(*sorted), &compareEntries);
+	out = 0;
+	for (e = 0; e < nnz; ++e) {
+		entry = sorted + e;
+		if (e > 0 && compareEntries(entry - 1, entry) == 0) {
+			h.values[out - 1].re += entry->value.re;
+			h.values[out - 1].im += entry->value.im;
+		} else {
+			h.cols[out] = entry->col;
+			h.terms[out] = entry->term;
+			h.values[out] = entry->value;
+			++h.rowStart[entry->row + 1];
+			++out;
+		}
+	}
+	for (i = 0; i < h.dim; ++i) h.rowStart[i + 1] += h.rowStart[i];
+	free(sorted);
+
+	arenaFree(&hamiltonian->arena);
+	*hamiltonian = h;
+	return 1;
+}
+
+OQS_STATUS oqsHamiltonianCreate(size_t dim, OqsHamiltonian *hamiltonian)
+{
+	OqsHamiltonian h;
+	if (dim == 0) return OQS_INVALID_ARGUMENT;
+	h = (OqsHamiltonian)malloc(sizeof(*h));
+	if (h == 0) return OQS_OUT_OF_MEMORY;
+	h->dim = dim;
+	h->numTerms = 0;
+	h->coefficients = 0;
+	h->entries = 0;
+	h->numEntries = 0;
+	h->entriesCapacity = 0;
+	arenaInit(&h->arena);
+	if (!compress(h)) {
+		free(h);
+		return OQS_OUT_OF_MEMORY;
+	}
+	*hamiltonian = h;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsHamiltonianDestroy(OqsHamiltonian *hamiltonian)
+{
+	if (*hamiltonian) {
+		arenaFree(&(*hamiltonian)->arena);
+		free((*hamiltonian)->coefficients);
+		free((*hamiltonian)->entries);
+		free(*hamiltonian);
+	}
+	*hamiltonian = 0;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsHamiltonianAddTerm(OqsHamiltonian hamiltonian,
+				 const struct OqsCoefficient *f, size_t nnz,
+				 const size_t *rows, const size_t *cols,
+				 const struct OqsAmplitude *values)
+{
+	struct HamiltonianEntry *entries;
+	struct OqsCoefficient *coefficients;
+	size_t capacity, i;
+	int term = f ? hamiltonian->numTerms + 1 : 0;
+
+	if (term > OQS_HAMILTONIAN_MAX_TERMS) return OQS_INVALID_ARGUMENT;
+	for (i = 0; i < nnz; ++i) {
+		if (rows[i] >= hamiltonian->dim ||
+		    cols[i] >= hamiltonian->dim) {
+			return OQS_INVALID_ARGUMENT;
+		}
+	}
+	if (f) {
+		coefficients = realloc(hamiltonian->coefficients,
+				       term * sizeof(*coefficients));
+		if (coefficients == 0) return OQS_OUT_OF_MEMORY;
+		hamiltonian->coefficients = coefficients;
+	}
+	if (hamiltonian->numEntries + nnz > hamiltonian->entriesCapacity) {
+		capacity = 2 * hamiltonian->entriesCapacity;
+		if (capacity < hamiltonian->numEntries + nnz) {
+			capacity = hamiltonian->numEntries + nnz;
+		}
+		entries = realloc(hamiltonian->entries,
+				  capacity * sizeof(*entries));
+		if (entries == 0) return OQS_OUT_OF_MEMORY;
+		hamiltonian->entries = entries;
+		hamiltonian->entriesCapacity = capacity;
+	}
+	entries = hamiltonian->entries + hamiltonian->numEntries;
+	for (i = 0; i < nnz; ++i) {
+		entries[i].row = rows[i];
+		entries[i].col = cols[i];
+		entries[i].term = term;
+		entries[i].value = values[i];
+	}
+	hamiltonian->numEntries += nnz;
+	if (!compress(hamiltonian)) {
+		hamiltonian->numEntries -= nnz;
+		return OQS_OUT_OF_MEMORY;
+	}
+	if (f) {
+		hamiltonian->coefficients[term - 1] = *f;
+		hamiltonian->numTerms = term;
+	}
+	return OQS_SUCCESS;
+}
+
+size_t oqsHamiltonianGetDim(OqsHamiltonian hamiltonian)
+{
+	return hamiltonian->dim;
+}
+
+int oqsHamiltonianGetNumTerms(OqsHamiltonian hamiltonian)
+{
+	return hamiltonian->numTerms;
+}
+
+void oqsHamiltonianGetSchrodingerEqn(OqsHamiltonian hamiltonian,
+				     enum OqsLayout layout,
+				     struct OqsSchrodingerEqn *eqn)
+{
+	eqn->RHS = layout == OQS_LAYOUT_SPLIT ? &splitRHS : &interleavedRHS;
+	eqn->ctx = hamiltonian;
+}
+
+void oqsHamiltonianGetEnsembleSchrodingerEqn(
+    OqsHamiltonian hamiltonian, struct OqsEnsembleSchrodingerEqn *eqn)
+{
+	eqn->RHS = &ensembleRHS;
+	eqn->ctx = hamiltonian;
+}
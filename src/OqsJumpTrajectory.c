@@ -17,86 +17,402 @@ You should have received a copy of the GNU General Public License along
 with oqs.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <OqsJumpTrajectory.h>
+#include <JumpTrajectory.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <OqsAmplitude.h>
 #include <Integrator.h>
+#include <DecayTime.h>
+#include <ChannelTable.h>
+#include <Kernels.h>
+#include <Stats.h>
+#include <Memory.h>
+#include <Checkpoint.h>
+
+/* Tabulated evolution of a state under the effective Hamiltonian, used for
+ * sampling the waiting time distribution. */
+struct WtdTable {
+	/* numPoints states at times k * gridSpacing, k = 0, 1, ... */
+	struct OqsAmplitude *states;
+	/* Squared norms of the states */
+	double *norms;
+};
 
 struct OqsJumpTrajectory_ {
 	struct OqsAmplitude *state;
 	size_t dim;
+	/* Number of amplitudes in a state buffer, which exceeds dim for the
+	 * padded split layout */
+	size_t size;
+	enum OqsLayout layout;
 	struct OqsSchrodingerEqn *schrodingerEqn;
 	double z;
 	struct Integrator integrator;
+	/* Initial time step restored by oqsJumpTrajectoryReset */
+	double dtHint;
 	struct OqsAmplitude *previousState;
 	double previousTime;
 	double decayTimeTolerance;
 	double decayNormTolerance;
   struct OqsAmplitude *work;
+	/* c x for the decay operator jumpOp selected last, if not null */
+	struct OqsAmplitude *jumpState;
+	const struct OqsDecayOperator *jumpOp;
+	double jumpNorm;
+	/* Cumulative jump probabilities, grown as needed */
+	double *cumulative;
+	int cumulativeCapacity;
+	/* Operator and index returned by the last oqsJumpTrajectoryGetDecay,
+	 * which identify the channel of a jump */
+	const struct OqsDecayOperator *selectedOp;
+	int selectedChannel;
+	/* Jump record, only appended to if recordJumps is set */
+	int recordJumps;
+	struct OqsJumpRecord *jumps;
+	size_t numJumps;
+	size_t jumpsCapacity;
+	/* Whether records were dropped because the record couldn't grow */
+	int jumpsLost;
+	/* Expectation callbacks of numExpectations decay operators */
+	OqsDecayExpectation *expectations;
+	int numExpectations;
+	/* Alias table for state independent decay rates, empty if n == 0 */
+	struct AliasTable decayRates;
+	struct OqsPhilox philox;
+	struct OqsRng rng;
+	/* Cache of waiting time distribution tables, filled round robin */
+	struct WtdTable *wtdCache;
+	int wtdCacheSize;
+	int wtdNumCached;
+	int wtdNextSlot;
+	size_t wtdNumPoints;
+	double wtdGridSpacing;
+	/* The table for the current state or null.  The state is wtdPhase
+	 * times the tabulated state at time t - wtdOrigin. */
+	struct WtdTable *wtdTable;
+	struct OqsAmplitude wtdPhase;
+	double wtdOrigin;
+	struct OqsTrajectoryStats stats;
+	int timers;
+	/* Whether the state buffers have been zeroed, which trajectories
+	 * created together leave to the first oqsJumpTrajectorySetState or
+	 * oqsJumpTrajectoryLoad */
+	int touched;
+	/* Whether the trajectory was created by oqsJumpTrajectoryCreateMany */
+	int shared;
+	/* Owns the trajectory, its state buffers and its initial integrator,
+	 * or all trajectories created together if this is the first of them */
+	struct Arena arena;
+	/* Owns the waiting time distribution tables */
+	struct Arena wtdArena;
 };
 
-OQS_STATUS oqsJumpTrajectoryCreate(size_t dim, OqsJumpTrajectory *trajectory)
+static double uniform(OqsJumpTrajectory trajectory)
 {
-	*trajectory = (OqsJumpTrajectory)malloc(sizeof(**trajectory));
-	if (*trajectory == 0) return OQS_OUT_OF_MEMORY;
-	(*trajectory)->state =
-	    (struct OqsAmplitude *)malloc(dim * sizeof(*(*trajectory)->state));
-	if ((*trajectory)->state == 0) {
-		free(*trajectory);
-		*trajectory = 0;
-		return OQS_OUT_OF_MEMORY;
+	return trajectory->rng.uniform(trajectory->rng.ctx);
+}
+
+#ifdef OQS_ENABLE_STATS
+/* Counts and optionally times the right hand side evaluations. */
+static void countingRHS(double t, const struct OqsAmplitude *x,
+			struct OqsAmplitude *y, void *ctx)
+{
+	OqsJumpTrajectory trajectory = (OqsJumpTrajectory)ctx;
+	struct OqsSchrodingerEqn *eqn = trajectory->schrodingerEqn;
+	double t0;
+	++trajectory->stats.rhsCalls;
+	if (trajectory->timers) {
+		t0 = statsWallTime();
+		eqn->RHS(t, x, y, eqn->ctx);
+		trajectory->stats.rhsSeconds += statsWallTime() - t0;
+	} else {
+		eqn->RHS(t, x, y, eqn->ctx);
 	}
-	(*trajectory)->previousState = (struct OqsAmplitude *)malloc(
-	    dim * sizeof(*(*trajectory)->previousState));
-	if ((*trajectory)->previousState == 0) {
-		free(*trajectory);
-		*trajectory = 0;
-		return OQS_OUT_OF_MEMORY;
+}
+#define TRAJECTORY_RHS(trajectory) (&countingRHS)
+#define TRAJECTORY_RHS_CTX(trajectory) (trajectory)
+#else
+#define TRAJECTORY_RHS(trajectory) ((trajectory)->schrodingerEqn->RHS)
+#define TRAJECTORY_RHS_CTX(trajectory) ((trajectory)->schrodingerEqn->ctx)
+#endif
+
+OQS_STATUS oqsJumpTrajectoryCreate(size_t dim, OqsJumpTrajectory *trajectory)
+{
+	return oqsJumpTrajectoryCreateWithLayout(dim, OQS_LAYOUT_INTERLEAVED,
+						 trajectory);
+}
+
+static void reserveTrajectory(struct Arena *arena, size_t size)
+{
+	int i;
+	arenaReserve(arena, 1, sizeof(struct OqsJumpTrajectory_));
+	for (i = 0; i < 4; ++i) {
+		arenaReserve(arena, size, sizeof(struct OqsAmplitude));
 	}
-	(*trajectory)->dim = dim;
-	(*trajectory)->schrodingerEqn = 0;
-	(*trajectory)->z = (double)rand() / RAND_MAX;
-	integratorCreate(&(*trajectory)->integrator, dim);
-	(*trajectory)->decayTimeTolerance = 1.0e-7;
-	(*trajectory)->decayNormTolerance = 1.0e-12;
-	(*trajectory)->work =
-	    (struct OqsAmplitude *)malloc(dim * sizeof(*(*trajectory)->work));
-	if ((*trajectory)->work == 0) {
-		free(*trajectory);
-		*trajectory = 0;
-		return OQS_OUT_OF_MEMORY;
+	integratorReserve(arena, size);
+}
+
+/* Takes a trajectory reserved by reserveTrajectory from an allocated
+ * arena without writing its state buffers. */
+static OqsJumpTrajectory takeTrajectory(struct Arena *arena, size_t dim,
+					enum OqsLayout layout, size_t size,
+					uint64_t stream)
+{
+	OqsJumpTrajectory t = arenaTakeZeroed(arena, 1, sizeof(*t));
+	t->state = arenaTake(arena, size, sizeof(*t->state));
+	t->previousState = arenaTake(arena, size, sizeof(*t->state));
+	t->work = arenaTake(arena, size, sizeof(*t->state));
+	t->jumpState = arenaTake(arena, size, sizeof(*t->state));
+	integratorCreateFrom(&t->integrator, arena, size);
+	if (layout == OQS_LAYOUT_SPLIT) t->integrator.splitDim = dim;
+	arenaInit(&t->arena);
+	arenaInit(&t->wtdArena);
+	t->dtHint = t->integrator.dt;
+	t->dim = dim;
+	t->size = size;
+	t->layout = layout;
+	t->schrodingerEqn = 0;
+	t->wtdCache = 0;
+	t->wtdCacheSize = 0;
+	t->wtdNumCached = 0;
+	t->wtdNextSlot = 0;
+	t->wtdTable = 0;
+	memset(&t->stats, 0, sizeof(t->stats));
+	t->timers = 0;
+	t->touched = 0;
+	t->shared = 0;
+	oqsJumpTrajectorySeed(t, OQS_PHILOX_DEFAULT_SEED, stream);
+	t->decayTimeTolerance = 1.0e-7;
+	t->decayNormTolerance = 1.0e-12;
+	t->jumpOp = 0;
+	t->cumulative = 0;
+	t->selectedOp = 0;
+	t->selectedChannel = -1;
+	t->recordJumps = 0;
+	t->jumps = 0;
+	t->numJumps = 0;
+	t->jumpsCapacity = 0;
+	t->jumpsLost = 0;
+	t->cumulativeCapacity = 0;
+	t->expectations = 0;
+	t->numExpectations = 0;
+	t->decayRates.n = 0;
+	t->decayRates.prob = 0;
+	t->decayRates.alias = 0;
+	return t;
+}
+
+/* Zeroes the state buffers, so that the padding of split layout states is
+ * zero, on the thread that first sets the state. */
+static void touchStates(OqsJumpTrajectory trajectory)
+{
+	size_t bytes = trajectory->size * sizeof(*trajectory->state);
+	if (trajectory->touched) return;
+	memset(trajectory->state, 0, bytes);
+	memset(trajectory->previousState, 0, bytes);
+	memset(trajectory->work, 0, bytes);
+	memset(trajectory->jumpState, 0, bytes);
+	trajectory->touched = 1;
+}
+
+OQS_STATUS oqsJumpTrajectoryCreateWithLayout(size_t dim,
+					     enum OqsLayout layout,
+					     OqsJumpTrajectory *trajectory)
+{
+	OqsJumpTrajectory t;
+	size_t size = layout == OQS_LAYOUT_SPLIT ? OQS_SPLIT_STRIDE(dim) : dim;
+	struct Arena arena;
+
+	*trajectory = 0;
+	arenaInit(&arena);
+	reserveTrajectory(&arena, size);
+	if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+	t = takeTrajectory(&arena, dim, layout, size,
+			   oqsPhiloxReserveStreams(1));
+	touchStates(t);
+	t->arena = arena;
+	*trajectory = t;
+	return OQS_SUCCESS;
+}
+
+void jumpTrajectoryReserve(struct Arena *arena, size_t dim,
+			   enum OqsLayout layout)
+{
+	reserveTrajectory(arena, layout == OQS_LAYOUT_SPLIT ?
+					 OQS_SPLIT_STRIDE(dim) : dim);
+}
+
+OqsJumpTrajectory jumpTrajectoryCreateFrom(struct Arena *arena, size_t dim,
+					   enum OqsLayout layout)
+{
+	size_t size = layout == OQS_LAYOUT_SPLIT ? OQS_SPLIT_STRIDE(dim) : dim;
+	OqsJumpTrajectory t = takeTrajectory(arena, dim, layout, size,
+					     oqsPhiloxReserveStreams(1));
+	touchStates(t);
+	return t;
+}
+
+OQS_STATUS oqsJumpTrajectoryCreateMany(size_t dim, enum OqsLayout layout,
+				       size_t n,
+				       OqsJumpTrajectory *trajectories)
+{
+	size_t size = layout == OQS_LAYOUT_SPLIT ? OQS_SPLIT_STRIDE(dim) : dim;
+	struct Arena arena;
+	uint64_t stream;
+	size_t i;
+
+	if (n == 0) return OQS_INVALID_ARGUMENT;
+	for (i = 0; i < n; ++i) trajectories[i] = 0;
+	arenaInit(&arena);
+	for (i = 0; i < n; ++i) reserveTrajectory(&arena, size);
+	if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+	stream = oqsPhiloxReserveStreams(n);
+	for (i = 0; i < n; ++i) {
+		trajectories[i] =
+		    takeTrajectory(&arena, dim, layout, size, stream + i);
+		trajectories[i]->shared = 1;
 	}
+	trajectories[0]->arena = arena;
 	return OQS_SUCCESS;
 }
 
+static void wtdFreeCache(OqsJumpTrajectory trajectory)
+{
+	arenaFree(&trajectory->wtdArena);
+	trajectory->wtdCache = 0;
+	trajectory->wtdCacheSize = 0;
+	trajectory->wtdNumCached = 0;
+	trajectory->wtdNextSlot = 0;
+	trajectory->wtdTable = 0;
+}
+
+/* Frees everything but the arena. */
+static void releaseTrajectory(OqsJumpTrajectory trajectory)
+{
+	wtdFreeCache(trajectory);
+	free(trajectory->cumulative);
+	free(trajectory->jumps);
+	free(trajectory->expectations);
+	aliasTableDestroy(&trajectory->decayRates);
+	integratorDestroy(&trajectory->integrator);
+}
+
 OQS_STATUS oqsJumpTrajectoryDestroy(OqsJumpTrajectory *trajectory)
 {
+	struct Arena arena;
 	if (*trajectory) {
-		free((*trajectory)->state);
-		free((*trajectory)->previousState);
-		free((*trajectory)->work);
+		if ((*trajectory)->shared) return OQS_INVALID_ARGUMENT;
+		releaseTrajectory(*trajectory);
+		arena = (*trajectory)->arena;
+		arenaFree(&arena);
 	}
-	integratorDestroy(&(*trajectory)->integrator);
-	free(*trajectory);
 	*trajectory = 0;
 	return OQS_SUCCESS;
 }
 
+OQS_STATUS oqsJumpTrajectoryDestroyMany(size_t n,
+					OqsJumpTrajectory *trajectories)
+{
+	struct Arena arena;
+	size_t i;
+	if (n == 0 || trajectories[0] == 0) return OQS_SUCCESS;
+	for (i = 0; i < n; ++i) releaseTrajectory(trajectories[i]);
+	arena = trajectories[0]->arena;
+	arenaFree(&arena);
+	for (i = 0; i < n; ++i) trajectories[i] = 0;
+	return OQS_SUCCESS;
+}
+
 OQS_STATUS
 oqsJumpTrajectorySetSchrodingerEqn(OqsJumpTrajectory trajectory,
 				   struct OqsSchrodingerEqn *eqn)
 {
   trajectory->schrodingerEqn = eqn;
+  // Tables computed with another Hamiltonian are useless.
+  trajectory->wtdNumCached = 0;
+  trajectory->wtdNextSlot = 0;
+  trajectory->wtdTable = 0;
   return OQS_SUCCESS;
 }
 
+OQS_STATUS
+oqsJumpTrajectorySetIntegrator(OqsJumpTrajectory trajectory,
+			       enum OqsIntegratorType type)
+{
+	struct Integrator *integrator = &trajectory->integrator;
+	double t = integratorGetTime(integrator);
+	double dt = integrator->dt;
+	double absTol = integrator->absTol;
+	double relTol = integrator->relTol;
+
+	struct Integrator created;
+
+	switch (type) {
+	case OQS_INTEGRATOR_DOPRI5:
+		integratorCreateWith(&created, trajectory->size,
+				     &dopri5_create);
+		break;
+	case OQS_INTEGRATOR_KRYLOV:
+		integratorCreateWith(&created, trajectory->size,
+				     &krylov_create);
+		break;
+	case OQS_INTEGRATOR_LSRK4:
+		integratorCreateWith(&created, trajectory->size,
+				     &lsrk4_create);
+		break;
+	case OQS_INTEGRATOR_RK4:
+	default:
+		integratorCreateWith(&created, trajectory->size, &rk4_create);
+		break;
+	}
+	// Keep the old integrator if the new one can't be allocated.
+	if (created.data == 0) {
+		integratorDestroy(&created);
+		return OQS_OUT_OF_MEMORY;
+	}
+	integratorDestroy(integrator);
+	*integrator = created;
+	if (trajectory->layout == OQS_LAYOUT_SPLIT) {
+		integrator->splitDim = trajectory->dim;
+	}
+	integratorSetTime(integrator, t);
+	integratorTimeStepHint(integrator, dt);
+	integratorSetTolerances(integrator, absTol, relTol);
+	return OQS_SUCCESS;
+}
+
+void oqsJumpTrajectoryTimeStepHint(OqsJumpTrajectory trajectory, double dt)
+{
+	trajectory->dtHint = dt;
+	integratorTimeStepHint(&trajectory->integrator, dt);
+}
+
+void oqsJumpTrajectorySetTolerances(OqsJumpTrajectory trajectory,
+				    double absTol, double relTol)
+{
+	integratorSetTolerances(&trajectory->integrator, absTol, relTol);
+}
+
 OQS_STATUS
 oqsJumpTrajectorySetState(OqsJumpTrajectory trajectory,
 			  const struct OqsAmplitude *state)
 {
-	memcpy(trajectory->state, state, trajectory->dim * sizeof(*state));
+	size_t dim = trajectory->dim;
+	touchStates(trajectory);
+	if (trajectory->layout == OQS_LAYOUT_SPLIT) {
+		// The padding of the argument isn't trusted to be zero.
+		memcpy(OQS_SPLIT_RE(trajectory->state), OQS_SPLIT_RE(state),
+		       dim * sizeof(double));
+		memcpy(OQS_SPLIT_IM(trajectory->state, dim),
+		       OQS_SPLIT_IM(state, dim), dim * sizeof(double));
+	} else {
+		memcpy(trajectory->state, state, dim * sizeof(*state));
+	}
+	integratorInvalidate(&trajectory->integrator);
+	trajectory->wtdTable = 0;
+	trajectory->jumpOp = 0;
 	return OQS_SUCCESS;
 }
 
@@ -105,6 +421,33 @@ struct OqsAmplitude *oqsJumpTrajectoryGetState(OqsJumpTrajectory trajectory)
 	return trajectory->state;
 }
 
+size_t oqsJumpTrajectoryGetDim(OqsJumpTrajectory trajectory)
+{
+	return trajectory->dim;
+}
+
+enum OqsLayout oqsJumpTrajectoryGetLayout(OqsJumpTrajectory trajectory)
+{
+	return trajectory->layout;
+}
+
+int oqsJumpTrajectoryIsShared(OqsJumpTrajectory trajectory)
+{
+	return trajectory->shared;
+}
+
+double *oqsJumpTrajectoryGetStateRe(OqsJumpTrajectory trajectory)
+{
+	if (trajectory->layout != OQS_LAYOUT_SPLIT) return 0;
+	return OQS_SPLIT_RE(trajectory->state);
+}
+
+double *oqsJumpTrajectoryGetStateIm(OqsJumpTrajectory trajectory)
+{
+	if (trajectory->layout != OQS_LAYOUT_SPLIT) return 0;
+	return OQS_SPLIT_IM(trajectory->state, trajectory->dim);
+}
+
 double oqsJumpTrajectoryGetTime(OqsJumpTrajectory trajectory)
 {
 	return integratorGetTime(&trajectory->integrator);
@@ -113,6 +456,7 @@ double oqsJumpTrajectoryGetTime(OqsJumpTrajectory trajectory)
 void oqsJumpTrajectorySetTime(OqsJumpTrajectory trajectory, double t)
 {
 	integratorSetTime(&trajectory->integrator, t);
+	trajectory->wtdTable = 0;
 }
 
 void oqsJumpTrajectorySetDecayTimeTolerance(OqsJumpTrajectory trajectory,
@@ -126,172 +470,318 @@ double oqsJumpTrajectoryGetDecayTimeTolerance(OqsJumpTrajectory trajectory)
 	return trajectory->decayTimeTolerance;
 }
 
-static void copyArray(struct OqsAmplitude *out, struct OqsAmplitude *in,
-		      int dim)
+/* The current and the previous state are double buffered.  Swapping them
+ * turns the current state into the starting point of the next step without
+ * copying. */
+static void swapStates(OqsJumpTrajectory trajectory)
 {
-	int i;
-	for (i = 0; i < dim; ++i) {
-		out[i].re = in[i].re;
-		out[i].im = in[i].im;
-	}
-}
-
-static double normSquared(int dim, struct OqsAmplitude* x)
-{
-	double nrm = 0.0;
-	for (int i = 0; i < dim; ++i) {
-		nrm += x[i].re * x[i].re + x[i].im * x[i].im;
-	}
-	return nrm;
-}
-static int decayHappened(OqsJumpTrajectory trajectory)
-{
-	return normSquared(trajectory->dim, trajectory->state) < trajectory->z;
-}
-
-static void backTrack(OqsJumpTrajectory trajectory)
-{
-	copyArray(trajectory->state, trajectory->previousState,
-		  trajectory->dim);
-	integratorSetTime(&trajectory->integrator, trajectory->previousTime);
-}
-
-static void findDecayTime(OqsJumpTrajectory trajectory)
-{
-	double tGuess, tLeft, tRight, normGuess, normLeft, normRight;
-	tLeft = trajectory->previousTime;
-	tRight = integratorGetTime(&trajectory->integrator);
-	assert(tRight > tLeft);
-
-	while (tRight - tLeft > trajectory->decayTimeTolerance) {
-		normLeft =
-		    normSquared(trajectory->dim, trajectory->previousState);
-		assert(normLeft >= trajectory->z);
-		normRight = normSquared(trajectory->dim, trajectory->state);
-		assert(normRight <= trajectory->z);
-		// To find the decay time we assume that the square of the norm
-		// decays exponentially during the integration time interval.
-		// This is typically a better approximation than linear
-		// variation (which would lead to the secant method).
-		// Exponential decay is still monotonically decreasing, so we
-		// maintain the bracketing property of the secand method.  To
-		// find the new guess for the decay time based on the left and
-		// right ends of the interval, we use that
-		//      n(t) = nL exp(-gamma (t - tL))
-		// where nL is the norm at the beginning of the interval, tL.
-		// To find gamma we use that
-		//      n(tR) = nL exp(-gamma * (tR - tL)) == nR
-		//      => gamma = -log(nR / nL) / (tR - tL)
-		// The guess for the decay time is then found by solving
-		//      n(tGuess) == z
-		//      => nL exp(log(nR /nL)(tGuess - tL) / (tR - tL)) == z
-		//      => log(nR / nL)(tGuess - tL)/(tR - tL) = log (z / nL)
-		//      => tGuess = tL + (tR - tL) * log (z / nL) / log(nR / nL)
-		tGuess = tLeft +
-			 (tRight - tLeft) * log(trajectory->z / normLeft) /
-			     log(normRight / normLeft);
-
-		backTrack(trajectory);
-		integratorAdvanceTo(&trajectory->integrator, tGuess,
-				    trajectory->state,
-				    trajectory->schrodingerEqn->RHS,
-				    trajectory->schrodingerEqn->ctx);
-		normGuess = normSquared(trajectory->dim, trajectory->state);
-		if (abs(normGuess - trajectory->z) <
-		    trajectory->decayNormTolerance) {
-			return;
-		}
-		if (normGuess > trajectory->z) {
-			normLeft = normGuess;
-			copyArray(trajectory->previousState, trajectory->state,
-				  trajectory->dim);
-			trajectory->previousTime =
-			    integratorGetTime(&trajectory->integrator);
-			tLeft = trajectory->previousTime;
-		} else {
-			normRight = normGuess;
-			tRight = integratorGetTime(&trajectory->integrator);
-		}
-	}
+	struct OqsAmplitude *tmp = trajectory->previousState;
+	trajectory->previousState = trajectory->state;
+	trajectory->state = tmp;
 }
 
-int oqsJumpTrajectoryAdvance(OqsJumpTrajectory trajectory, double t)
+static void interpolateState(OqsJumpTrajectory trajectory, double t)
+{
+	integratorInterpolate(&trajectory->integrator, t,
+			      trajectory->previousState, trajectory->state);
+}
+
+static int advance(OqsJumpTrajectory trajectory, double t)
 {
-	double currentTime;
-	int decayed = 0;
+	double startTime, currentTime, nrm;
+	int decayed = 0, backtracked, iterations;
 
+	trajectory->jumpOp = 0;
 	currentTime = integratorGetTime(&trajectory->integrator);
 	if (currentTime > t) return decayed;
+	startTime = currentTime;
 
 	while (1) {
-		copyArray(trajectory->previousState, trajectory->state,
-			  trajectory->dim);
+		swapStates(trajectory);
 		trajectory->previousTime = currentTime;
-		integratorTakeStep(&trajectory->integrator, trajectory->state,
-				   trajectory->schrodingerEqn->RHS,
-				   trajectory->schrodingerEqn->ctx);
-		decayed = decayHappened(trajectory);
-		if (decayed) break;
+		nrm = integratorTakeStepFrom(
+		    &trajectory->integrator, trajectory->previousState,
+		    trajectory->state, TRAJECTORY_RHS(trajectory),
+		    TRAJECTORY_RHS_CTX(trajectory));
+		OQS_STATS_ADD(trajectory->stats, steps, 1);
 		currentTime = integratorGetTime(&trajectory->integrator);
-		if (currentTime > t) break;
+		if (nrm < trajectory->z) break;
+		if (currentTime >= t) break;
 	}
+	backtracked = currentTime > t;
 	if (currentTime > t) {
-		backTrack(trajectory);
-		integratorAdvanceTo(&trajectory->integrator, t,
-				    trajectory->state,
-				    trajectory->schrodingerEqn->RHS,
-				    trajectory->schrodingerEqn->ctx);
+		// The last step overshot the target time.  Use the continuous
+		// extension of the step to get the state at the target time.
+		// If the decay happened only after the target time we're done.
+		interpolateState(trajectory, t);
+		currentTime = t;
+		integratorSetTime(&trajectory->integrator, t);
+		nrm = kernelNormSquared(trajectory->state, trajectory->size);
+	}
+	decayed = nrm < trajectory->z;
+	if (decayed && trajectory->previousTime == startTime &&
+	    kernelNormSquared(trajectory->previousState, trajectory->size) <
+		trajectory->z) {
+		// The norm was below the decay norm before the first step,
+		// e.g. after setting a subnormalized state, so the decay is
+		// due right away.
+		swapStates(trajectory);
+		integratorSetTime(&trajectory->integrator, startTime);
+		integratorInvalidate(&trajectory->integrator);
+		OQS_STATS_ADD(trajectory->stats, backtracks, 1);
+		return decayed;
 	}
-	decayed = decayHappened(trajectory);
 	if (decayed) {
-		findDecayTime(trajectory);
+		currentTime = findDecayTime(
+		    &trajectory->integrator, trajectory->previousState,
+		    trajectory->state, 0, trajectory->size,
+		    trajectory->previousTime, currentTime, trajectory->z,
+		    trajectory->decayTimeTolerance,
+		    trajectory->decayNormTolerance, &iterations);
+		integratorSetTime(&trajectory->integrator, currentTime);
+		OQS_STATS_ADD(trajectory->stats, rootIterations, iterations);
+		backtracked = 1;
 	}
+	OQS_STATS_ADD(trajectory->stats, backtracks, backtracked);
 	return decayed;
 }
 
+int oqsJumpTrajectoryAdvance(OqsJumpTrajectory trajectory, double t)
+{
+#ifdef OQS_ENABLE_STATS
+	double t0;
+	int decayed;
+	if (trajectory->timers) {
+		t0 = statsWallTime();
+		decayed = advance(trajectory, t);
+		trajectory->stats.advanceSeconds += statsWallTime() - t0;
+		return decayed;
+	}
+#endif
+	return advance(trajectory, t);
+}
+
 double oqsJumpTrajectoryGetNextDecayNorm(OqsJumpTrajectory trajectory)
 {
 	return trajectory->z;
 }
 
-int oqsJumpTrajectoryGetDecay(OqsJumpTrajectory trajectory, int numDecayOps,
-			      struct OqsDecayOperator *decayOps)
+void oqsJumpTrajectorySeed(OqsJumpTrajectory trajectory, uint64_t seed,
+			   uint64_t stream)
 {
-	double probabilities[numDecayOps + 1];
-	double z;
+	oqsPhiloxInit(&trajectory->philox, seed, stream);
+	oqsJumpTrajectorySetRng(trajectory, 0);
+	trajectory->z = uniform(trajectory);
+}
+
+void oqsJumpTrajectorySetRng(OqsJumpTrajectory trajectory,
+			     const struct OqsRng *rng)
+{
+	if (rng) {
+		trajectory->rng = *rng;
+	} else {
+		trajectory->rng.uniform = &oqsPhiloxUniform;
+		trajectory->rng.ctx = &trajectory->philox;
+	}
+}
+
+void oqsJumpTrajectorySetNextDecayNorm(OqsJumpTrajectory trajectory, double z)
+{
+	trajectory->z = z;
+}
+
+OQS_STATUS oqsJumpTrajectoryReserveDecayChannels(OqsJumpTrajectory trajectory,
+						int numDecayOps)
+{
+	double *cumulative;
+	if (numDecayOps <= trajectory->cumulativeCapacity) return OQS_SUCCESS;
+	cumulative = (double *)realloc(trajectory->cumulative,
+				       numDecayOps * sizeof(*cumulative));
+	if (cumulative == 0) return OQS_OUT_OF_MEMORY;
+	trajectory->cumulative = cumulative;
+	trajectory->cumulativeCapacity = numDecayOps;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsJumpTrajectorySetDecayRates(OqsJumpTrajectory trajectory,
+					  int numDecayOps, const double *rates)
+{
+	aliasTableDestroy(&trajectory->decayRates);
+	if (numDecayOps == 0 || rates == 0) return OQS_SUCCESS;
+	return aliasTableCreate(&trajectory->decayRates, numDecayOps, rates);
+}
+
+OQS_STATUS
+oqsJumpTrajectorySetDecayExpectations(OqsJumpTrajectory trajectory,
+				      int numDecayOps,
+				      const OqsDecayExpectation *expectations)
+{
+	OqsDecayExpectation *copy;
+	OQS_STATUS stat;
+
+	if (numDecayOps < 0) return OQS_INVALID_ARGUMENT;
+	free(trajectory->expectations);
+	trajectory->expectations = 0;
+	trajectory->numExpectations = 0;
+	if (numDecayOps == 0 || expectations == 0) return OQS_SUCCESS;
+	stat = oqsJumpTrajectoryReserveDecayChannels(trajectory, numDecayOps);
+	if (stat != OQS_SUCCESS) return stat;
+	copy = (OqsDecayExpectation *)malloc(numDecayOps * sizeof(*copy));
+	if (copy == 0) return OQS_OUT_OF_MEMORY;
+	memcpy(copy, expectations, numDecayOps * sizeof(*copy));
+	trajectory->expectations = copy;
+	trajectory->numExpectations = numDecayOps;
+	return OQS_SUCCESS;
+}
+
+/* With expectation callbacks for all operators the jump probabilities are
+ * accumulated into a table and the channel is found by bisection. */
+static int getDecayByExpectation(OqsJumpTrajectory trajectory,
+				 int numDecayOps,
+				 struct OqsDecayOperator *decayOps,
+				 const OqsDecayExpectation *expectations)
+{
+	double total = 0;
 	int i;
-	probabilities[0] = 0;
 	for (i = 0; i < numDecayOps; ++i) {
-		decayOps[i].apply(trajectory->state, trajectory->work,
-				  decayOps[i].ctx);
-		probabilities[i + 1] =
-		    probabilities[i] +
-		    normSquared(trajectory->dim, trajectory->work);
+		total += expectations[i](trajectory->state, decayOps[i].ctx);
+		trajectory->cumulative[i] = total;
+	}
+	return channelSearch(trajectory->cumulative, numDecayOps,
+			     uniform(trajectory) * total);
+}
+
+/* Otherwise the channel is selected in a single pass over the decay
+ * operators by weighted reservoir sampling.  Operator i replaces the
+ * current candidate with probability p_i / (p_0 + ... + p_i), which selects
+ * each channel with probability proportional to p_i.  The uniform deviate
+ * is rescaled after every decision so that one deviate suffices.  The
+ * jumped state of the candidate is kept in jumpState so that
+ * oqsJumpTrajectoryApplyDecay does not have to apply the operator again. */
+static int selectDecay(OqsJumpTrajectory trajectory, int numDecayOps,
+		       struct OqsDecayOperator *decayOps)
+{
+	const OqsDecayExpectation *expectations = 0;
+	double u, total = 0, p, q;
+	struct OqsAmplitude *tmp;
+	int i, decay = 0;
+
+	trajectory->jumpOp = 0;
+	if (numDecayOps > 0 && numDecayOps == trajectory->decayRates.n) {
+		return aliasTableSample(&trajectory->decayRates,
+					uniform(trajectory));
+	}
+	if (numDecayOps > 0 && numDecayOps == trajectory->numExpectations) {
+		expectations = trajectory->expectations;
+		for (i = 0; i < numDecayOps; ++i) {
+			if (expectations[i] == 0) break;
+		}
+		if (i == numDecayOps) {
+			return getDecayByExpectation(trajectory, numDecayOps,
+						     decayOps, expectations);
+		}
+	}
+
+	u = uniform(trajectory);
+	for (i = 0; i < numDecayOps; ++i) {
+		if (expectations && expectations[i]) {
+			p = expectations[i](trajectory->state,
+					    decayOps[i].ctx);
+		} else {
+			decayOps[i].apply(trajectory->state, trajectory->work,
+					  decayOps[i].ctx);
+			p = kernelNormSquared(trajectory->work,
+					      trajectory->size);
+		}
+		if (p <= 0) continue;
+		total += p;
+		q = p / total;
+		if (u >= q) {
+			u = (u - q) / (1.0 - q);
+			continue;
+		}
+		u /= q;
+		decay = i;
+		if (expectations && expectations[i]) {
+			trajectory->jumpOp = 0;
+		} else {
+			tmp = trajectory->jumpState;
+			trajectory->jumpState = trajectory->work;
+			trajectory->work = tmp;
+			trajectory->jumpOp = decayOps + i;
+			trajectory->jumpNorm = p;
+		}
 	}
-	z = (double)rand() / RAND_MAX * probabilities[numDecayOps];
-	i = 0;
-	while (probabilities[i + 1] < z) {
-		++i;
+	return decay;
+}
+
+int oqsJumpTrajectoryGetDecay(OqsJumpTrajectory trajectory, int numDecayOps,
+			      struct OqsDecayOperator *decayOps)
+{
+	int decay = selectDecay(trajectory, numDecayOps, decayOps);
+	trajectory->selectedOp = decayOps + decay;
+	trajectory->selectedChannel = decay;
+	return decay;
+}
+
+/* Appends a jump through decayOp at the current time to the jump
+ * record. */
+static void recordJump(OqsJumpTrajectory trajectory,
+		       const struct OqsDecayOperator *decayOp)
+{
+	struct OqsJumpRecord *jumps;
+	struct OqsJumpRecord *jump;
+	size_t capacity;
+
+	if (trajectory->numJumps == trajectory->jumpsCapacity) {
+		capacity = trajectory->jumpsCapacity
+			       ? 2 * trajectory->jumpsCapacity
+			       : 64;
+		jumps = realloc(trajectory->jumps, capacity * sizeof(*jumps));
+		if (jumps == 0) {
+			trajectory->jumpsLost = 1;
+			return;
+		}
+		trajectory->jumps = jumps;
+		trajectory->jumpsCapacity = capacity;
 	}
-	return i;
+	jump = trajectory->jumps + trajectory->numJumps++;
+	jump->t = integratorGetTime(&trajectory->integrator);
+	jump->channel = decayOp == trajectory->selectedOp
+			    ? trajectory->selectedChannel
+			    : -1;
 }
 
 void oqsJumpTrajectoryApplyDecay(OqsJumpTrajectory trajectory,
 				 struct OqsDecayOperator *decayOp)
 {
+	struct OqsAmplitude *tmp;
 	double nrm;
-	int i;
+	size_t i;
 
-	decayOp->apply(trajectory->state, trajectory->previousState,
-		       decayOp->ctx);
-	nrm = sqrt(normSquared(trajectory->dim, trajectory->previousState));
-	for (i = 0; i < trajectory->dim; ++i) {
-		trajectory->previousState[i].re /= nrm;
-		trajectory->previousState[i].im /= nrm;
+	if (trajectory->recordJumps) recordJump(trajectory, decayOp);
+	if (decayOp == trajectory->jumpOp) {
+		tmp = trajectory->state;
+		trajectory->state = trajectory->jumpState;
+		trajectory->jumpState = tmp;
+		nrm = sqrt(trajectory->jumpNorm);
+	} else {
+		decayOp->apply(trajectory->state, trajectory->previousState,
+			       decayOp->ctx);
+		swapStates(trajectory);
+		nrm = sqrt(kernelNormSquared(trajectory->state,
+					     trajectory->size));
+	}
+	trajectory->jumpOp = 0;
+	trajectory->selectedOp = 0;
+	for (i = 0; i < trajectory->size; ++i) {
+		trajectory->state[i].re /= nrm;
+		trajectory->state[i].im /= nrm;
 	}
-	copyArray(trajectory->state, trajectory->previousState,
-		  trajectory->dim);
-	trajectory->z = (double)rand() / RAND_MAX;
+	integratorInvalidate(&trajectory->integrator);
+	trajectory->wtdTable = 0;
+	trajectory->z = uniform(trajectory);
+	OQS_STATS_ADD(trajectory->stats, jumps, 1);
 }
 
 void oqsJumpTrajectoryReset(OqsJumpTrajectory trajectory,
@@ -299,5 +789,273 @@ void oqsJumpTrajectoryReset(OqsJumpTrajectory trajectory,
 {
 	oqsJumpTrajectorySetState(trajectory, initialState);
 	oqsJumpTrajectorySetTime(trajectory, t);
-	trajectory->z = (double)rand() / RAND_MAX;
+	// Forget the step size adapted to the previous run.
+	integratorTimeStepHint(&trajectory->integrator, trajectory->dtHint);
+	oqsJumpTrajectoryResetStats(trajectory);
+	oqsJumpTrajectoryClearJumps(trajectory);
+	trajectory->z = uniform(trajectory);
+}
+
+OQS_STATUS oqsJumpTrajectoryEnableWtd(OqsJumpTrajectory trajectory,
+				      double gridSpacing, size_t numPoints,
+				      int cacheSize)
+{
+	struct WtdTable *table;
+	struct Arena *arena;
+	int i;
+
+	wtdFreeCache(trajectory);
+	if (cacheSize == 0) return OQS_SUCCESS;
+	if (gridSpacing <= 0 || numPoints < 2 || cacheSize < 0) {
+		return OQS_INVALID_ARGUMENT;
+	}
+	arena = &trajectory->wtdArena;
+	arenaInit(arena);
+	arenaReserve(arena, cacheSize, sizeof(*trajectory->wtdCache));
+	for (i = 0; i < cacheSize; ++i) {
+		arenaReserve(arena, numPoints * trajectory->size,
+			     sizeof(*table->states));
+		arenaReserve(arena, numPoints, sizeof(*table->norms));
+	}
+	if (!arenaAllocate(arena)) return OQS_OUT_OF_MEMORY;
+	trajectory->wtdCache =
+	    arenaTakeZeroed(arena, cacheSize, sizeof(*trajectory->wtdCache));
+	trajectory->wtdCacheSize = cacheSize;
+	for (i = 0; i < cacheSize; ++i) {
+		table = trajectory->wtdCache + i;
+		table->states =
+		    arenaTakeZeroed(arena, numPoints * trajectory->size,
+				    sizeof(*table->states));
+		table->norms =
+		    arenaTakeZeroed(arena, numPoints, sizeof(*table->norms));
+	}
+	trajectory->wtdNumPoints = numPoints;
+	trajectory->wtdGridSpacing = gridSpacing;
+	return OQS_SUCCESS;
+}
+
+/* Tabulates the evolution of the current state. */
+static void wtdBuild(OqsJumpTrajectory trajectory, struct WtdTable *table)
+{
+	struct Integrator *integrator = &trajectory->integrator;
+	double t = integratorGetTime(integrator);
+	size_t size = trajectory->size;
+	struct OqsAmplitude *row;
+	size_t k;
+
+	memcpy(table->states, trajectory->state, size * sizeof(*table->states));
+	table->norms[0] = kernelNormSquared(table->states, size);
+	integratorSetTime(integrator, 0);
+	for (k = 1; k < trajectory->wtdNumPoints; ++k) {
+		row = table->states + k * size;
+		memcpy(row, row - size, size * sizeof(*row));
+		integratorAdvanceTo(integrator, k * trajectory->wtdGridSpacing,
+				    row, TRAJECTORY_RHS(trajectory),
+				    TRAJECTORY_RHS_CTX(trajectory));
+		table->norms[k] = kernelNormSquared(row, size);
+	}
+	integratorSetTime(integrator, t);
+}
+
+/* Finds the table of a state that agrees with the current state up to a
+ * complex factor, e.g. the ground state after spontaneous emission, or
+ * computes a new one. */
+static void wtdFindTable(OqsJumpTrajectory trajectory)
+{
+	const struct OqsAmplitude *x = trajectory->state;
+	struct WtdTable *table;
+	double xx = kernelNormSquared(x, trajectory->size);
+	struct OqsAmplitude overlap;
+	int j;
+
+	for (j = 0; j < trajectory->wtdNumCached; ++j) {
+		table = trajectory->wtdCache + j;
+		overlap = kernelZdotc(table->states, x, trajectory->size,
+				      trajectory->layout == OQS_LAYOUT_SPLIT);
+		// Equality in the Cauchy-Schwarz inequality means the states
+		// are parallel.
+		if (table->norms[0] > 0 &&
+		    overlap.re * overlap.re + overlap.im * overlap.im >=
+			(1.0 - 1.0e-12) * table->norms[0] * xx) {
+			trajectory->wtdTable = table;
+			trajectory->wtdPhase.re = overlap.re / table->norms[0];
+			trajectory->wtdPhase.im = overlap.im / table->norms[0];
+			return;
+		}
+	}
+	table = trajectory->wtdCache + trajectory->wtdNextSlot;
+	trajectory->wtdNextSlot =
+	    (trajectory->wtdNextSlot + 1) % trajectory->wtdCacheSize;
+	if (trajectory->wtdNumCached < trajectory->wtdCacheSize) {
+		++trajectory->wtdNumCached;
+	}
+	wtdBuild(trajectory, table);
+	trajectory->wtdTable = table;
+	trajectory->wtdPhase.re = 1.0;
+	trajectory->wtdPhase.im = 0.0;
+}
+
+int oqsJumpTrajectoryAdvanceWtd(OqsJumpTrajectory trajectory, double t)
+{
+	struct WtdTable *table;
+	struct OqsAmplitude *row;
+	struct OqsAmplitude phase;
+	double currentTime, scale;
+	size_t lo, hi, mid, k;
+
+	currentTime = integratorGetTime(&trajectory->integrator);
+	if (trajectory->wtdCache == 0 || currentTime > t) {
+		return oqsJumpTrajectoryAdvance(trajectory, t);
+	}
+	if (trajectory->wtdTable == 0) {
+		wtdFindTable(trajectory);
+		trajectory->wtdOrigin = currentTime;
+	}
+	table = trajectory->wtdTable;
+	phase = trajectory->wtdPhase;
+	scale = phase.re * phase.re + phase.im * phase.im;
+
+	// The norm is non-increasing so the first grid point below the decay
+	// norm can be found by bisection.
+	lo = 0;
+	hi = trajectory->wtdNumPoints;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (scale * table->norms[mid] < trajectory->z) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	// The norm was already below the decay norm at the start of the
+	// table, so there is no grid point before the decay to jump to.
+	if (lo == 0) return oqsJumpTrajectoryAdvance(trajectory, t);
+	k = (size_t)floor((t - trajectory->wtdOrigin) /
+			  trajectory->wtdGridSpacing);
+	if (k > trajectory->wtdNumPoints - 1) k = trajectory->wtdNumPoints - 1;
+	if (lo - 1 < k) k = lo - 1;
+
+	// Jump to the last grid point before the decay or the target time
+	// and integrate only the remainder.
+	if (trajectory->wtdOrigin + k * trajectory->wtdGridSpacing >
+	    currentTime) {
+		row = table->states + k * trajectory->size;
+		kernelZscalc(phase, row, trajectory->state, trajectory->size,
+			     trajectory->layout == OQS_LAYOUT_SPLIT);
+		integratorSetTime(&trajectory->integrator,
+				  trajectory->wtdOrigin +
+				      k * trajectory->wtdGridSpacing);
+	}
+	return oqsJumpTrajectoryAdvance(trajectory, t);
+}
+
+void oqsJumpTrajectoryGetStats(OqsJumpTrajectory trajectory,
+			       struct OqsTrajectoryStats *stats)
+{
+	*stats = trajectory->stats;
+}
+
+void oqsJumpTrajectoryResetStats(OqsJumpTrajectory trajectory)
+{
+	memset(&trajectory->stats, 0, sizeof(trajectory->stats));
+}
+
+void oqsJumpTrajectoryEnableTimers(OqsJumpTrajectory trajectory, int enable)
+{
+	trajectory->timers = enable;
+}
+
+OQS_STATUS oqsJumpTrajectoryEnableJumpRecord(OqsJumpTrajectory trajectory,
+					     int enable, size_t capacity)
+{
+	struct OqsJumpRecord *jumps;
+	trajectory->recordJumps = enable;
+	if (enable && capacity > trajectory->jumpsCapacity) {
+		jumps = realloc(trajectory->jumps, capacity * sizeof(*jumps));
+		if (jumps == 0) return OQS_OUT_OF_MEMORY;
+		trajectory->jumps = jumps;
+		trajectory->jumpsCapacity = capacity;
+	}
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsJumpTrajectoryGetJumps(OqsJumpTrajectory trajectory,
+				     const struct OqsJumpRecord **jumps,
+				     size_t *numJumps)
+{
+	*jumps = trajectory->jumps;
+	*numJumps = trajectory->numJumps;
+	return trajectory->jumpsLost ? OQS_OUT_OF_MEMORY : OQS_SUCCESS;
+}
+
+void oqsJumpTrajectoryClearJumps(OqsJumpTrajectory trajectory)
+{
+	trajectory->numJumps = 0;
+	trajectory->jumpsLost = 0;
+}
+
+/* Everything but the state that a checkpoint restores */
+struct TrajectoryCheckpoint {
+	double t;
+	double dt;
+	double z;
+	struct OqsPhilox philox;
+	struct OqsTrajectoryStats stats;
+};
+
+OQS_STATUS oqsJumpTrajectorySave(OqsJumpTrajectory trajectory,
+				 const char *path)
+{
+	uint64_t shape[4] = {trajectory->dim, trajectory->layout, 0, 0};
+	struct TrajectoryCheckpoint record;
+	OQS_STATUS stat;
+	FILE *f;
+
+	memset(&record, 0, sizeof(record));
+	record.t = integratorGetTime(&trajectory->integrator);
+	record.dt = trajectory->integrator.dt;
+	record.z = trajectory->z;
+	record.philox = trajectory->philox;
+	record.stats = trajectory->stats;
+	stat = checkpointBegin(path, CHECKPOINT_TRAJECTORY, shape, &f);
+	if (stat != OQS_SUCCESS) return stat;
+	stat = checkpointWrite(f, &record, sizeof(record));
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(f, trajectory->state,
+				       trajectory->size *
+					   sizeof(*trajectory->state));
+	}
+	return checkpointCommit(path, f, stat);
+}
+
+OQS_STATUS oqsJumpTrajectoryLoad(OqsJumpTrajectory trajectory,
+				 const char *path)
+{
+	uint64_t shape[4] = {trajectory->dim, trajectory->layout, 0, 0};
+	struct TrajectoryCheckpoint record;
+	OQS_STATUS stat;
+	FILE *f;
+
+	stat = checkpointOpen(path, CHECKPOINT_TRAJECTORY, shape, &f);
+	if (stat != OQS_SUCCESS) return stat;
+	touchStates(trajectory);
+	stat = checkpointRead(f, &record, sizeof(record));
+	// Read into the work buffer so that a truncated file leaves the
+	// trajectory unchanged.
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointRead(f, trajectory->work,
+				      trajectory->size *
+					  sizeof(*trajectory->work));
+	}
+	fclose(f);
+	if (stat != OQS_SUCCESS) return stat;
+	memcpy(trajectory->state, trajectory->work,
+	       trajectory->size * sizeof(*trajectory->state));
+	trajectory->jumpOp = 0;
+	oqsJumpTrajectorySetTime(trajectory, record.t);
+	integratorTimeStepHint(&trajectory->integrator, record.dt);
+	trajectory->z = record.z;
+	trajectory->philox = record.philox;
+	trajectory->stats = record.stats;
+	return OQS_SUCCESS;
 }
@@ -0,0 +1,334 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsMasterEqn.h>
+#include <OqsAccumulator.h>
+#include <stdint.h>
+#include <string.h>
+#include <Integrator.h>
+#include <Kernels.h>
+#include <Memory.h>
+
+/* Edge length of the square tiles in which rho is traversed when it is
+ * combined with its adjoint.  Two tiles of 32 x 32 amplitudes fit in a 32
+ * KiB level 1 cache. */
+#define MASTER_EQN_TILE 32
+
+/* The columns of rho are evolved by the Schrodinger equation and the decay
+ * operators one at a time, so the callbacks see contiguous vectors.  The
+ * remaining terms are adjoints of these products, which are formed tile by
+ * tile. */
+struct OqsMasterEqn_ {
+	size_t dim;
+	struct OqsAmplitude *rho;
+	/* c_k rho and its adjoint */
+	struct OqsAmplitude *work;
+	/* Result of a single column evaluation */
+	struct OqsAmplitude *column;
+	struct Integrator integrator;
+	struct OqsSchrodingerEqn *schrodingerEqn;
+	int numDecayOps;
+	struct OqsDecayOperator *decayOps;
+	/* Owns the master equation, rho and the work space */
+	struct Arena arena;
+};
+
+static size_t tileEnd(size_t begin, size_t dim)
+{
+	return begin + MASTER_EQN_TILE < dim ? begin + MASTER_EQN_TILE : dim;
+}
+
+/* y = y + y^\dagger */
+static void addAdjoint(struct OqsAmplitude *y, size_t dim)
+{
+	struct OqsAmplitude *a, *b;
+	size_t ib, jb, i, j, iEnd, jEnd;
+	double re, im;
+	for (jb = 0; jb < dim; jb += MASTER_EQN_TILE) {
+		jEnd = tileEnd(jb, dim);
+		for (ib = jb; ib < dim; ib += MASTER_EQN_TILE) {
+			iEnd = tileEnd(ib, dim);
+			for (j = jb; j < jEnd; ++j) {
+				i = ib == jb ? j : ib;
+				for (; i < iEnd; ++i) {
+					a = y + j * dim + i;
+					b = y + i * dim + j;
+					re = a->re + b->re;
+					im = a->im - b->im;
+					a->re = re;
+					a->im = im;
+					b->re = re;
+					b->im = -im;
+				}
+			}
+		}
+	}
+}
+
+/* y = y^\dagger */
+static void adjoint(struct OqsAmplitude *y, size_t dim)
+{
+	struct OqsAmplitude *a, *b, tmp;
+	size_t ib, jb, i, j, iEnd, jEnd;
+	for (jb = 0; jb < dim; jb += MASTER_EQN_TILE) {
+		jEnd = tileEnd(jb, dim);
+		for (ib = jb; ib < dim; ib += MASTER_EQN_TILE) {
+			iEnd = tileEnd(ib, dim);
+			for (j = jb; j < jEnd; ++j) {
+				i = ib == jb ? j : ib;
+				for (; i < iEnd; ++i) {
+					a = y + j * dim + i;
+					b = y + i * dim + j;
+					tmp = *a;
+					a->re = b->re;
+					a->im = -b->im;
+					b->re = tmp.re;
+					b->im = -tmp.im;
+				}
+			}
+		}
+	}
+}
+
+/* Since rho is Hermitian, c rho c^\dagger = c (c rho)^\dagger and the
+ * dissipator only needs the decay operators applied to columns. */
+static void lindbladRHS(double t, const struct OqsAmplitude *x,
+			struct OqsAmplitude *y, void *ctx)
+{
+	OqsMasterEqn master = (OqsMasterEqn)ctx;
+	struct OqsSchrodingerEqn *eqn = master->schrodingerEqn;
+	struct OqsDecayOperator *op;
+	size_t dim = master->dim;
+	size_t j;
+	int k;
+
+	if (eqn == 0) {
+		memset(y, 0, dim * dim * sizeof(*y));
+	} else {
+		for (j = 0; j < dim; ++j) {
+			eqn->RHS(t, x + j * dim, y + j * dim, eqn->ctx);
+		}
+		addAdjoint(y, dim);
+	}
+	for (k = 0; k < master->numDecayOps; ++k) {
+		op = master->decayOps + k;
+		for (j = 0; j < dim; ++j) {
+			op->apply(x + j * dim, master->work + j * dim, op->ctx);
+		}
+		adjoint(master->work, dim);
+		for (j = 0; j < dim; ++j) {
+			op->apply(master->work + j * dim, master->column,
+				  op->ctx);
+			kernelZaxpy(y + j * dim, 1.0, master->column,
+				    y + j * dim, dim);
+		}
+	}
+}
+
+OQS_STATUS oqsMasterEqnCreate(size_t dim, OqsMasterEqn *master)
+{
+	OqsMasterEqn m;
+	struct Arena arena;
+	size_t size;
+
+	if (dim == 0 || dim > SIZE_MAX / dim) return OQS_INVALID_ARGUMENT;
+	size = dim * dim;
+	arenaInit(&arena);
+	arenaReserve(&arena, 1, sizeof(*m));
+	arenaReserve(&arena, size, sizeof(*m->rho));
+	arenaReserve(&arena, size, sizeof(*m->work));
+	arenaReserve(&arena, dim, sizeof(*m->column));
+	if (!arenaAllocate(&arena)) return OQS_OUT_OF_MEMORY;
+	m = arenaTakeZeroed(&arena, 1, sizeof(*m));
+	m->dim = dim;
+	m->rho = arenaTakeZeroed(&arena, size, sizeof(*m->rho));
+	m->work = arenaTakeZeroed(&arena, size, sizeof(*m->work));
+	m->column = arenaTakeZeroed(&arena, dim, sizeof(*m->column));
+	m->arena = arena;
+	integratorCreate(&m->integrator, size);
+	if (m->integrator.data == 0) {
+		integratorDestroy(&m->integrator);
+		arenaFree(&arena);
+		return OQS_OUT_OF_MEMORY;
+	}
+	m->schrodingerEqn = 0;
+	m->numDecayOps = 0;
+	m->decayOps = 0;
+	*master = m;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsMasterEqnDestroy(OqsMasterEqn *master)
+{
+	struct Arena arena;
+	if (*master) {
+		integratorDestroy(&(*master)->integrator);
+		arena = (*master)->arena;
+		arenaFree(&arena);
+	}
+	*master = 0;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsMasterEqnSetSchrodingerEqn(OqsMasterEqn master,
+					 struct OqsSchrodingerEqn *eqn)
+{
+	master->schrodingerEqn = eqn;
+	integratorInvalidate(&master->integrator);
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsMasterEqnSetDecayOperators(OqsMasterEqn master,
+					 int numDecayOps,
+					 struct OqsDecayOperator *decayOps)
+{
+	if (numDecayOps < 0) return OQS_INVALID_ARGUMENT;
+	master->numDecayOps = numDecayOps;
+	master->decayOps = decayOps;
+	integratorInvalidate(&master->integrator);
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsMasterEqnSetIntegrator(OqsMasterEqn master,
+				     enum OqsIntegratorType type)
+{
+	struct Integrator *integrator = &master->integrator;
+	size_t size = master->dim * master->dim;
+	double t = integratorGetTime(integrator);
+	double dt = integrator->dt;
+	double absTol = integrator->absTol;
+	double relTol = integrator->relTol;
+	struct Integrator created;
+
+	switch (type) {
+	case OQS_INTEGRATOR_DOPRI5:
+		integratorCreateWith(&created, size, &dopri5_create);
+		break;
+	case OQS_INTEGRATOR_KRYLOV:
+		integratorCreateWith(&created, size, &krylov_create);
+		break;
+	case OQS_INTEGRATOR_LSRK4:
+		integratorCreateWith(&created, size, &lsrk4_create);
+		break;
+	case OQS_INTEGRATOR_RK4:
+	default:
+		integratorCreateWith(&created, size, &rk4_create);
+		break;
+	}
+	if (created.data == 0) {
+		integratorDestroy(&created);
+		return OQS_OUT_OF_MEMORY;
+	}
+	integratorDestroy(integrator);
+	*integrator = created;
+	integratorSetTime(integrator, t);
+	integratorTimeStepHint(integrator, dt);
+	integratorSetTolerances(integrator, absTol, relTol);
+	return OQS_SUCCESS;
+}
+
+void oqsMasterEqnTimeStepHint(OqsMasterEqn master, double dt)
+{
+	integratorTimeStepHint(&master->integrator, dt);
+}
+
+void oqsMasterEqnSetTolerances(OqsMasterEqn master, double absTol,
+			       double relTol)
+{
+	integratorSetTolerances(&master->integrator, absTol, relTol);
+}
+
+size_t oqsMasterEqnGetDim(OqsMasterEqn master)
+{
+	return master->dim;
+}
+
+void oqsMasterEqnSetDensityMatrix(OqsMasterEqn master,
+				  const struct OqsAmplitude *rho)
+{
+	memcpy(master->rho, rho, master->dim * master->dim * sizeof(*rho));
+	integratorInvalidate(&master->integrator);
+}
+
+OQS_STATUS oqsMasterEqnSetState(OqsMasterEqn master,
+				const struct OqsAmplitude *x)
+{
+	struct OqsAmplitude *rho = master->rho;
+	size_t dim = master->dim;
+	double nrm = kernelNormSquared(x, dim);
+	size_t i, j;
+
+	if (nrm == 0) return OQS_INVALID_ARGUMENT;
+	for (j = 0; j < dim; ++j) {
+		for (i = 0; i < dim; ++i) {
+			rho[j * dim + i].re =
+			    (x[i].re * x[j].re + x[i].im * x[j].im) / nrm;
+			rho[j * dim + i].im =
+			    (x[i].im * x[j].re - x[i].re * x[j].im) / nrm;
+		}
+	}
+	integratorInvalidate(&master->integrator);
+	return OQS_SUCCESS;
+}
+
+struct OqsAmplitude *oqsMasterEqnGetDensityMatrix(OqsMasterEqn master)
+{
+	return master->rho;
+}
+
+double oqsMasterEqnGetTime(OqsMasterEqn master)
+{
+	return integratorGetTime(&master->integrator);
+}
+
+void oqsMasterEqnSetTime(OqsMasterEqn master, double t)
+{
+	integratorSetTime(&master->integrator, t);
+}
+
+void oqsMasterEqnAdvance(OqsMasterEqn master, double t)
+{
+	if (t <= integratorGetTime(&master->integrator)) return;
+	integratorAdvanceTo(&master->integrator, t, master->rho, &lindbladRHS,
+			    master);
+}
+
+double oqsMasterEqnGetExpectation(OqsMasterEqn master,
+				  const struct OqsObservable *observable)
+{
+	size_t dim = master->dim;
+	double result = 0;
+	size_t j;
+	for (j = 0; j < dim; ++j) {
+		observable->apply(master->rho + j * dim, master->column,
+				  observable->ctx);
+		result += master->column[j].re;
+	}
+	return result / oqsMasterEqnGetTrace(master);
+}
+
+double oqsMasterEqnGetTrace(OqsMasterEqn master)
+{
+	size_t dim = master->dim;
+	double result = 0;
+	size_t j;
+	for (j = 0; j < dim; ++j) {
+		result += master->rho[j * dim + j].re;
+	}
+	return result;
+}
@@ -19,37 +19,102 @@ with oqs.  If not, see <http://www.gnu.org/licenses/>.
 #include <OqsMbo.h>
 #include <MboNumOp.h>
 #include <MboAmplitude.h>
+#include <MboProdSpace.h>
 
 struct OqsMboOperator {
 	MboNumOp op;
+	enum OqsLayout layout;
+	/* For the split layout the states are converted to and from the
+	 * interleaved layout used by MBO in these dim dimensional vectors. */
+	size_t dim;
+	struct MboAmplitude *x, *y;
 };
 
+static void oqsMboMatVec(struct OqsMboOperator *opCtx,
+			 struct MboAmplitude alpha,
+			 const struct OqsAmplitude *x, struct OqsAmplitude *y)
+{
+	static const struct MboAmplitude beta = {0};
+	size_t dim = opCtx->dim;
+	size_t i;
+
+	if (opCtx->layout != OQS_LAYOUT_SPLIT) {
+		mboNumOpMatVec(alpha, opCtx->op, (struct MboAmplitude *)x,
+			       beta, (struct MboAmplitude *)y);
+		return;
+	}
+	for (i = 0; i < dim; ++i) {
+		opCtx->x[i].re = OQS_SPLIT_RE(x)[i];
+		opCtx->x[i].im = OQS_SPLIT_IM(x, dim)[i];
+	}
+	mboNumOpMatVec(alpha, opCtx->op, opCtx->x, beta, opCtx->y);
+	for (i = 0; i < dim; ++i) {
+		OQS_SPLIT_RE(y)[i] = opCtx->y[i].re;
+		OQS_SPLIT_IM(y, dim)[i] = opCtx->y[i].im;
+	}
+}
+
 static void oqsMboApply(const struct OqsAmplitude *x, struct OqsAmplitude *y,
 			void *ctx)
 {
 	static const struct MboAmplitude alpha = {1, 0};
-	static const struct MboAmplitude beta = {0};
-	struct OqsMboOperator *opCtx = ctx;
-	mboNumOpMatVec(alpha, opCtx->op, (struct MboAmplitude *)x, beta,
-		       (struct MboAmplitude *)y);
+	oqsMboMatVec((struct OqsMboOperator *)ctx, alpha, x, y);
 }
 
 static void oqsMboSchEqnApply(double t, const struct OqsAmplitude *x,
 			      struct OqsAmplitude *y, void *ctx)
 {
 	static const struct MboAmplitude alpha = {0, -1.0};
-	static const struct MboAmplitude beta = {0};
-	struct OqsMboOperator *opCtx = ctx;
-	mboNumOpMatVec(alpha, opCtx->op, (struct MboAmplitude *)x, beta,
-		       (struct MboAmplitude *)y);
+	oqsMboMatVec((struct OqsMboOperator *)ctx, alpha, x, y);
+}
+
+static OQS_STATUS oqsMboOperatorCreate(MboTensorOp op, size_t dim,
+				       enum OqsLayout layout,
+				       struct OqsMboOperator **opCtx)
+{
+	struct OqsMboOperator *c = malloc(sizeof(*c));
+	if (!c) return OQS_OUT_OF_MEMORY;
+	c->layout = layout;
+	c->dim = dim;
+	c->x = 0;
+	c->y = 0;
+	if (layout == OQS_LAYOUT_SPLIT) {
+		c->x = malloc(dim * sizeof(*c->x));
+		c->y = malloc(dim * sizeof(*c->y));
+		if (!c->x || !c->y) {
+			free(c->x);
+			free(c->y);
+			free(c);
+			return OQS_OUT_OF_MEMORY;
+		}
+	}
+	mboNumOpCompile(op, &c->op);
+	*opCtx = c;
+	return OQS_SUCCESS;
+}
+
+static void oqsMboOperatorDestroy(struct OqsMboOperator *opCtx)
+{
+	mboNumOpDestroy(&opCtx->op);
+	free(opCtx->x);
+	free(opCtx->y);
+	free(opCtx);
 }
 
 OQS_STATUS oqsMboCreateDecayOperator(MboTensorOp op,
 				     struct OqsDecayOperator *dop)
 {
-	struct OqsMboOperator *opCtx = malloc(sizeof(opCtx));
-	if (!opCtx) return OQS_OUT_OF_MEMORY;
-	mboNumOpCompile(op, &opCtx->op);
+	return oqsMboCreateDecayOperatorWithLayout(op, 0,
+						   OQS_LAYOUT_INTERLEAVED, dop);
+}
+
+OQS_STATUS oqsMboCreateDecayOperatorWithLayout(MboTensorOp op, size_t dim,
+					       enum OqsLayout layout,
+					       struct OqsDecayOperator *dop)
+{
+	struct OqsMboOperator *opCtx;
+	OQS_STATUS stat = oqsMboOperatorCreate(op, dim, layout, &opCtx);
+	if (stat != OQS_SUCCESS) return stat;
 	dop->ctx = opCtx;
 	dop->apply = oqsMboApply;
 	return OQS_SUCCESS;
@@ -57,18 +122,26 @@ OQS_STATUS oqsMboCreateDecayOperator(MboTensorOp op,
 
 OQS_STATUS oqsMboDestroyDecayOperator(struct OqsDecayOperator *dop)
 {
-	struct OqsMboOperator *opCtx = dop->ctx;
-	mboNumOpDestroy(&opCtx->op);
-	free(opCtx);
+	oqsMboOperatorDestroy(dop->ctx);
 	return OQS_SUCCESS;
 }
 
 OQS_STATUS oqsMboCreateSchrodingerEqn(MboTensorOp hamiltonian,
 				     struct OqsSchrodingerEqn *eqn)
 {
-	struct OqsMboOperator *opCtx = malloc(sizeof(opCtx));
-	if (!opCtx) return OQS_OUT_OF_MEMORY;
-	mboNumOpCompile(hamiltonian, &opCtx->op);
+	return oqsMboCreateSchrodingerEqnWithLayout(
+	    hamiltonian, 0, OQS_LAYOUT_INTERLEAVED, eqn);
+}
+
+OQS_STATUS oqsMboCreateSchrodingerEqnWithLayout(MboTensorOp hamiltonian,
+						size_t dim,
+						enum OqsLayout layout,
+						struct OqsSchrodingerEqn *eqn)
+{
+	struct OqsMboOperator *opCtx;
+	OQS_STATUS stat;
+	stat = oqsMboOperatorCreate(hamiltonian, dim, layout, &opCtx);
+	if (stat != OQS_SUCCESS) return stat;
 	eqn->ctx = opCtx;
 	eqn->RHS = oqsMboSchEqnApply;
 	return OQS_SUCCESS;
@@ -76,8 +149,63 @@ OQS_STATUS oqsMboCreateSchrodingerEqn(MboTensorOp hamiltonian,
 
 OQS_STATUS oqsMboDestroySchrodingerEqn(struct OqsSchrodingerEqn *eqn)
 {
-	struct OqsMboOperator *opCtx = eqn->ctx;
-	mboNumOpDestroy(&opCtx->op);
-	free(opCtx);
+	oqsMboOperatorDestroy(eqn->ctx);
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsMboCreateEffectiveSchrodingerEqn(
+    MboTensorOp hamiltonian, int numDecayOps, MboTensorOp *jumpOps,
+    MboTensorOp *jumpOpsAdjoint, struct OqsSchrodingerEqn *eqn,
+    struct OqsDecayOperator *decayOps)
+{
+	return oqsMboCreateEffectiveSchrodingerEqnWithLayout(
+	    hamiltonian, numDecayOps, jumpOps, jumpOpsAdjoint, 0,
+	    OQS_LAYOUT_INTERLEAVED, eqn, decayOps);
+}
+
+OQS_STATUS oqsMboCreateEffectiveSchrodingerEqnWithLayout(
+    MboTensorOp hamiltonian, int numDecayOps, MboTensorOp *jumpOps,
+    MboTensorOp *jumpOpsAdjoint, size_t dim, enum OqsLayout layout,
+    struct OqsSchrodingerEqn *eqn, struct OqsDecayOperator *decayOps)
+{
+	static struct MboAmplitude minusHalfI = {0, -0.5};
+	MboProdSpace h = mboTensorOpGetSpace(hamiltonian);
+	MboTensorOp heff, jumpRate;
+	OQS_STATUS stat;
+	int i;
+
+	if (numDecayOps < 0) return OQS_INVALID_ARGUMENT;
+	mboTensorOpNull(h, &heff);
+	mboTensorOpPlus(hamiltonian, &heff);
+	for (i = 0; i < numDecayOps; ++i) {
+		mboTensorOpNull(h, &jumpRate);
+		mboTensorOpMul(jumpOpsAdjoint[i], jumpOps[i], &jumpRate);
+		mboTensorOpScale(&minusHalfI, &jumpRate);
+		mboTensorOpPlus(jumpRate, &heff);
+		mboTensorOpDestroy(&jumpRate);
+	}
+	stat = oqsMboCreateSchrodingerEqnWithLayout(heff, dim, layout, eqn);
+	mboTensorOpDestroy(&heff);
+	if (stat != OQS_SUCCESS) return stat;
+	for (i = 0; i < numDecayOps; ++i) {
+		stat = oqsMboCreateDecayOperatorWithLayout(jumpOps[i], dim,
+							   layout,
+							   decayOps + i);
+		if (stat != OQS_SUCCESS) {
+			oqsMboDestroyEffectiveSchrodingerEqn(eqn, i, decayOps);
+			return stat;
+		}
+	}
 	return OQS_SUCCESS;
 }
+
+OQS_STATUS oqsMboDestroyEffectiveSchrodingerEqn(
+    struct OqsSchrodingerEqn *eqn, int numDecayOps,
+    struct OqsDecayOperator *decayOps)
+{
+	int i;
+	for (i = 0; i < numDecayOps; ++i) {
+		oqsMboDestroyDecayOperator(decayOps + i);
+	}
+	return oqsMboDestroySchrodingerEqn(eqn);
+}
@@ -0,0 +1,271 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsParallel.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* Trajectories are handed out in blocks of blockSize consecutive indices.
+ * Each worker owns a contiguous range [next, end) of blocks.  The owner
+ * takes blocks from the front of its range.  A worker whose range is
+ * exhausted steals the upper half of another worker's range.  Since no new
+ * work is created while the pool runs, a worker can stop as soon as a
+ * sweep over all other workers comes up empty. */
+struct WorkRange {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t end;
+};
+
+struct Pool;
+
+struct Worker {
+	struct Pool *pool;
+	int id;
+	pthread_t thread;
+	int started;
+	OQS_STATUS status;
+};
+
+struct Pool {
+	size_t dim;
+	uint64_t seed;
+	size_t numTrajectories;
+	size_t blockSize;
+	struct OqsTrajectoryTask *task;
+	int numThreads;
+	struct WorkRange *ranges;
+	struct Worker *workers;
+};
+
+static int takeLocal(struct WorkRange *range, size_t *index)
+{
+	int found = 0;
+	pthread_mutex_lock(&range->lock);
+	if (range->next < range->end) {
+		*index = range->next++;
+		found = 1;
+	}
+	pthread_mutex_unlock(&range->lock);
+	return found;
+}
+
+static int steal(struct Pool *pool, int thief, size_t *index)
+{
+	struct WorkRange *victim;
+	struct WorkRange *own = pool->ranges + thief;
+	size_t remaining, begin, end;
+	int i;
+
+	for (i = 1; i < pool->numThreads; ++i) {
+		victim = pool->ranges + (thief + i) % pool->numThreads;
+		pthread_mutex_lock(&victim->lock);
+		remaining = victim->end - victim->next;
+		if (remaining == 0) {
+			pthread_mutex_unlock(&victim->lock);
+			continue;
+		}
+		end = victim->end;
+		begin = end - (remaining + 1) / 2;
+		victim->end = begin;
+		pthread_mutex_unlock(&victim->lock);
+
+		pthread_mutex_lock(&own->lock);
+		own->next = begin + 1;
+		own->end = end;
+		pthread_mutex_unlock(&own->lock);
+		*index = begin;
+		return 1;
+	}
+	return 0;
+}
+
+static void *workerRun(void *arg)
+{
+	struct Worker *worker = (struct Worker *)arg;
+	struct Pool *pool = worker->pool;
+	struct OqsTrajectoryTask *task = pool->task;
+	OqsJumpTrajectory trajectory;
+	size_t block, index, end;
+
+	worker->status = oqsJumpTrajectoryCreate(pool->dim, &trajectory);
+	if (worker->status != OQS_SUCCESS) return 0;
+	if (task->setup) {
+		worker->status = task->setup(trajectory, worker->id, task->ctx);
+	}
+	if (worker->status == OQS_SUCCESS) {
+		while (takeLocal(pool->ranges + worker->id, &block) ||
+		       steal(pool, worker->id, &block)) {
+			index = block * pool->blockSize;
+			end = index + pool->blockSize;
+			if (end > pool->numTrajectories) {
+				end = pool->numTrajectories;
+			}
+			for (; index < end; ++index) {
+				oqsJumpTrajectorySeed(trajectory, pool->seed,
+						      index);
+				task->run(trajectory, index, worker->id,
+					  task->ctx);
+			}
+		}
+	}
+	oqsJumpTrajectoryDestroy(&trajectory);
+	return 0;
+}
+
+static OQS_STATUS runPool(size_t dim, size_t numTrajectories,
+			  size_t blockSize, int numThreads, uint64_t seed,
+			  struct OqsTrajectoryTask *task)
+{
+	struct Pool pool;
+	OQS_STATUS stat = OQS_SUCCESS;
+	size_t numBlocks = (numTrajectories + blockSize - 1) / blockSize;
+	int i;
+
+	if (numThreads < 1) {
+		long numProcs = sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads = numProcs > 0 ? (int)numProcs : 1;
+	}
+	pool.dim = dim;
+	pool.seed = seed;
+	pool.numTrajectories = numTrajectories;
+	pool.blockSize = blockSize;
+	pool.task = task;
+	pool.numThreads = numThreads;
+	pool.ranges = malloc(numThreads * sizeof(*pool.ranges));
+	pool.workers = malloc(numThreads * sizeof(*pool.workers));
+	if (pool.ranges == 0 || pool.workers == 0) {
+		free(pool.ranges);
+		free(pool.workers);
+		return OQS_OUT_OF_MEMORY;
+	}
+	for (i = 0; i < numThreads; ++i) {
+		pthread_mutex_init(&pool.ranges[i].lock, 0);
+		pool.ranges[i].next = numBlocks * i / numThreads;
+		pool.ranges[i].end = numBlocks * (i + 1) / numThreads;
+		pool.workers[i].pool = &pool;
+		pool.workers[i].id = i;
+		pool.workers[i].started = 0;
+		pool.workers[i].status = OQS_SUCCESS;
+	}
+
+	// Worker 0 runs on the calling thread.  If a thread can't be
+	// started its work is picked up by the other workers.
+	for (i = 1; i < numThreads; ++i) {
+		pool.workers[i].started =
+		    pthread_create(&pool.workers[i].thread, 0, &workerRun,
+				   pool.workers + i) == 0;
+	}
+	workerRun(pool.workers);
+	for (i = 1; i < numThreads; ++i) {
+		if (pool.workers[i].started) {
+			pthread_join(pool.workers[i].thread, 0);
+		}
+	}
+
+	for (i = 0; i < numThreads; ++i) {
+		if (pool.workers[i].status != OQS_SUCCESS) {
+			stat = pool.workers[i].status;
+		}
+		pthread_mutex_destroy(&pool.ranges[i].lock);
+	}
+	free(pool.ranges);
+	free(pool.workers);
+	return stat;
+}
+
+OQS_STATUS oqsRunTrajectories(size_t dim, size_t numTrajectories,
+			      int numThreads, uint64_t seed,
+			      struct OqsTrajectoryTask *task)
+{
+	return runPool(dim, numTrajectories, 1, numThreads, seed, task);
+}
+
+struct Sampling {
+	struct OqsSamplingTask *task;
+	OqsAccumulator accumulator;
+	size_t blockSize;
+	/* One accumulator per block, null until the block is started or if
+	 * it couldn't be created */
+	OqsAccumulator *blocks;
+};
+
+static OQS_STATUS setupSampling(OqsJumpTrajectory trajectory, int thread,
+				void *ctx)
+{
+	struct Sampling *sampling = (struct Sampling *)ctx;
+	if (sampling->task->setup == 0) return OQS_SUCCESS;
+	return sampling->task->setup(trajectory, thread,
+				     sampling->task->ctx);
+}
+
+/* The trajectories of a block run on one thread in the order of their
+ * indices, so the block's accumulator doesn't depend on the scheduling.
+ * It is created by that thread when the block starts. */
+static void runSampling(OqsJumpTrajectory trajectory, size_t index,
+			int thread, void *ctx)
+{
+	struct Sampling *sampling = (struct Sampling *)ctx;
+	OqsAccumulator *accumulator =
+	    sampling->blocks + index / sampling->blockSize;
+	if (index % sampling->blockSize == 0) {
+		oqsAccumulatorCreateLike(sampling->accumulator, accumulator);
+	}
+	if (*accumulator == 0) return;
+	sampling->task->sample(trajectory, index, *accumulator,
+			       sampling->task->ctx);
+}
+
+OQS_STATUS oqsSampleTrajectories(size_t dim, size_t numTrajectories,
+				 size_t blockSize, int numThreads,
+				 uint64_t seed, struct OqsSamplingTask *task,
+				 OqsAccumulator accumulator)
+{
+	struct Sampling sampling;
+	struct OqsTrajectoryTask poolTask;
+	size_t numBlocks, i;
+	OQS_STATUS stat;
+
+	if (blockSize == 0) return OQS_INVALID_ARGUMENT;
+	numBlocks = (numTrajectories + blockSize - 1) / blockSize;
+	sampling.task = task;
+	sampling.accumulator = accumulator;
+	sampling.blockSize = blockSize;
+	sampling.blocks = calloc(numBlocks, sizeof(*sampling.blocks));
+	if (numBlocks > 0 && sampling.blocks == 0) return OQS_OUT_OF_MEMORY;
+	poolTask.setup = &setupSampling;
+	poolTask.run = &runSampling;
+	poolTask.ctx = &sampling;
+	stat = runPool(dim, numTrajectories, blockSize, numThreads, seed,
+		       &poolTask);
+
+	// If all workers succeeded every block was started, so a missing
+	// accumulator couldn't be allocated.
+	for (i = 0; i < numBlocks && stat == OQS_SUCCESS; ++i) {
+		if (sampling.blocks[i] == 0) stat = OQS_OUT_OF_MEMORY;
+	}
+	// Combine the blocks in the order of their indices.
+	for (i = 0; i < numBlocks; ++i) {
+		if (stat == OQS_SUCCESS) {
+			oqsAccumulatorMerge(accumulator, sampling.blocks[i]);
+		}
+		oqsAccumulatorDestroy(sampling.blocks + i);
+	}
+	free(sampling.blocks);
+	return stat;
+}
@@ -0,0 +1,554 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <OqsRecorder.h>
+#include <Checkpoint.h>
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* A recording is a checkpoint header of kind CHECKPOINT_RECORDING with
+ * shape {numObservables, 0, 0, 0} followed by chunks.  A chunk is a
+ * ChunkHeader followed by the trajectory and time columns and either the
+ * channel column or the value columns, each section padded to
+ * CHECKPOINT_ALIGNMENT bytes. */
+
+#define RECORDER_BLOCK_SIZE 4096
+
+static const char chunkMagic[8] = "OQSCHNK";
+
+struct ChunkHeader {
+	char magic[8];
+	uint32_t kind;
+	uint32_t reserved;
+	uint64_t numRecords;
+	char padding[40];
+};
+
+struct RecorderBlock {
+	struct RecorderBlock *next;
+	enum OqsRecordKind kind;
+	size_t numRecords;
+	uint64_t *trajectories;
+	double *times;
+	int32_t *channels;
+	/* numObservables columns of RECORDER_BLOCK_SIZE values */
+	double *values;
+};
+
+struct OqsRecorder_ {
+	FILE *file;
+	int numObservables;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	/* Signaled when a block is queued or the writer has to stop */
+	pthread_cond_t queued;
+	/* Signaled when the writer has run out of blocks */
+	pthread_cond_t idle;
+	struct RecorderBlock *head, *tail;
+	/* Written blocks for reuse, by kind */
+	struct RecorderBlock *spare[2];
+	int writing;
+	int stop;
+	OQS_STATUS status;
+};
+
+struct OqsRecorderStream_ {
+	OqsRecorder recorder;
+	/* The blocks being filled, by kind, or null */
+	struct RecorderBlock *blocks[2];
+};
+
+static struct RecorderBlock *allocateBlock(OqsRecorder recorder,
+					   enum OqsRecordKind kind)
+{
+	struct RecorderBlock *block;
+	size_t n = RECORDER_BLOCK_SIZE;
+	size_t numColumns = kind == OQS_RECORD_JUMPS ? 0
+						     : recorder->numObservables;
+
+	block = malloc(sizeof(*block));
+	if (block == 0) return 0;
+	block->trajectories = malloc(n * sizeof(*block->trajectories));
+	block->times = malloc(n * sizeof(*block->times));
+	block->channels = kind == OQS_RECORD_JUMPS
+			      ? malloc(n * sizeof(*block->channels))
+			      : 0;
+	block->values = numColumns ? malloc(numColumns * n *
+					    sizeof(*block->values))
+				   : 0;
+	if (block->trajectories == 0 || block->times == 0 ||
+	    (kind == OQS_RECORD_JUMPS && block->channels == 0) ||
+	    (numColumns && block->values == 0)) {
+		free(block->trajectories);
+		free(block->times);
+		free(block->channels);
+		free(block->values);
+		free(block);
+		return 0;
+	}
+	block->next = 0;
+	block->kind = kind;
+	block->numRecords = 0;
+	return block;
+}
+
+static void freeBlocks(struct RecorderBlock *block)
+{
+	struct RecorderBlock *next;
+	while (block) {
+		next = block->next;
+		free(block->trajectories);
+		free(block->times);
+		free(block->channels);
+		free(block->values);
+		free(block);
+		block = next;
+	}
+}
+
+static OQS_STATUS writeBlock(OqsRecorder recorder,
+			     const struct RecorderBlock *block)
+{
+	struct ChunkHeader header;
+	size_t n = block->numRecords;
+	OQS_STATUS stat;
+	int i;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, chunkMagic, sizeof(header.magic));
+	header.kind = block->kind;
+	header.numRecords = n;
+	stat = checkpointWrite(recorder->file, &header, sizeof(header));
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(recorder->file, block->trajectories,
+				       n * sizeof(*block->trajectories));
+	}
+	if (stat == OQS_SUCCESS) {
+		stat = checkpointWrite(recorder->file, block->times,
+				       n * sizeof(*block->times));
+	}
+	if (stat == OQS_SUCCESS && block->kind == OQS_RECORD_JUMPS) {
+		stat = checkpointWrite(recorder->file, block->channels,
+				       n * sizeof(*block->channels));
+	}
+	if (stat == OQS_SUCCESS && block->kind == OQS_RECORD_SAMPLES) {
+		// The columns are contiguous in the file.
+		for (i = 0; i < recorder->numObservables; ++i) {
+			if (fwrite(block->values + i * RECORDER_BLOCK_SIZE,
+				   sizeof(*block->values), n,
+				   recorder->file) != n) {
+				return OQS_IO_ERROR;
+			}
+		}
+		stat = checkpointPad(recorder->file,
+				     recorder->numObservables * n *
+					 sizeof(*block->values));
+	}
+	return stat;
+}
+
+static void *writerMain(void *ctx)
+{
+	OqsRecorder recorder = (OqsRecorder)ctx;
+	struct RecorderBlock *block;
+	OQS_STATUS stat;
+	int failed;
+
+	pthread_mutex_lock(&recorder->lock);
+	for (;;) {
+		while (recorder->head == 0 && !recorder->stop) {
+			pthread_cond_wait(&recorder->queued, &recorder->lock);
+		}
+		if (recorder->head == 0) break;
+		block = recorder->head;
+		recorder->head = block->next;
+		if (recorder->head == 0) recorder->tail = 0;
+		recorder->writing = 1;
+		failed = recorder->status != OQS_SUCCESS;
+		pthread_mutex_unlock(&recorder->lock);
+
+		// After a failed write the file may end in a partial chunk,
+		// which hides any chunk appended to it, so the remaining
+		// blocks are dropped.
+		stat = failed ? OQS_SUCCESS : writeBlock(recorder, block);
+
+		pthread_mutex_lock(&recorder->lock);
+		if (recorder->status == OQS_SUCCESS) recorder->status = stat;
+		block->numRecords = 0;
+		block->next = recorder->spare[block->kind - 1];
+		recorder->spare[block->kind - 1] = block;
+		recorder->writing = 0;
+		if (recorder->head == 0) {
+			pthread_cond_broadcast(&recorder->idle);
+		}
+	}
+	pthread_mutex_unlock(&recorder->lock);
+	return 0;
+}
+
+OQS_STATUS oqsRecorderCreate(const char *path, int numObservables,
+			     OqsRecorder *recorder)
+{
+	struct CheckpointHeader header;
+	uint64_t shape[4] = {0, 0, 0, 0};
+	OqsRecorder r;
+	OQS_STATUS stat;
+
+	*recorder = 0;
+	if (numObservables < 0) return OQS_INVALID_ARGUMENT;
+	r = (OqsRecorder)malloc(sizeof(*r));
+	if (r == 0) return OQS_OUT_OF_MEMORY;
+	r->file = fopen(path, "wb");
+	if (r->file == 0) {
+		free(r);
+		return OQS_IO_ERROR;
+	}
+	r->numObservables = numObservables;
+	shape[0] = numObservables;
+	checkpointMakeHeader(&header, CHECKPOINT_RECORDING, shape);
+	stat = checkpointWrite(r->file, &header, sizeof(header));
+	if (stat != OQS_SUCCESS) {
+		fclose(r->file);
+		free(r);
+		return stat;
+	}
+	r->head = 0;
+	r->tail = 0;
+	r->spare[0] = 0;
+	r->spare[1] = 0;
+	r->writing = 0;
+	r->stop = 0;
+	r->status = OQS_SUCCESS;
+	pthread_mutex_init(&r->lock, 0);
+	pthread_cond_init(&r->queued, 0);
+	pthread_cond_init(&r->idle, 0);
+	if (pthread_create(&r->writer, 0, &writerMain, r) != 0) {
+		pthread_cond_destroy(&r->idle);
+		pthread_cond_destroy(&r->queued);
+		pthread_mutex_destroy(&r->lock);
+		fclose(r->file);
+		free(r);
+		return OQS_THREAD_ERROR;
+	}
+	*recorder = r;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsRecorderDestroy(OqsRecorder *recorder)
+{
+	OqsRecorder r = *recorder;
+	OQS_STATUS stat;
+
+	if (r == 0) return OQS_SUCCESS;
+	pthread_mutex_lock(&r->lock);
+	r->stop = 1;
+	pthread_cond_signal(&r->queued);
+	pthread_mutex_unlock(&r->lock);
+	pthread_join(r->writer, 0);
+	stat = r->status;
+	if (fclose(r->file) != 0 && stat == OQS_SUCCESS) stat = OQS_IO_ERROR;
+	freeBlocks(r->spare[0]);
+	freeBlocks(r->spare[1]);
+	pthread_cond_destroy(&r->idle);
+	pthread_cond_destroy(&r->queued);
+	pthread_mutex_destroy(&r->lock);
+	free(r);
+	*recorder = 0;
+	return stat;
+}
+
+OQS_STATUS oqsRecorderFlush(OqsRecorder recorder)
+{
+	OQS_STATUS stat;
+	pthread_mutex_lock(&recorder->lock);
+	while (recorder->head || recorder->writing) {
+		pthread_cond_wait(&recorder->idle, &recorder->lock);
+	}
+	if (fflush(recorder->file) != 0 && recorder->status == OQS_SUCCESS) {
+		recorder->status = OQS_IO_ERROR;
+	}
+	stat = recorder->status;
+	pthread_mutex_unlock(&recorder->lock);
+	return stat;
+}
+
+OQS_STATUS oqsRecorderStreamCreate(OqsRecorder recorder,
+				   OqsRecorderStream *stream)
+{
+	OqsRecorderStream s = (OqsRecorderStream)malloc(sizeof(*s));
+	*stream = 0;
+	if (s == 0) return OQS_OUT_OF_MEMORY;
+	s->recorder = recorder;
+	s->blocks[0] = 0;
+	s->blocks[1] = 0;
+	*stream = s;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsRecorderStreamDestroy(OqsRecorderStream *stream)
+{
+	OQS_STATUS stat = OQS_SUCCESS;
+	if (*stream) {
+		stat = oqsRecorderStreamFlush(*stream);
+		freeBlocks((*stream)->blocks[0]);
+		freeBlocks((*stream)->blocks[1]);
+		free(*stream);
+	}
+	*stream = 0;
+	return stat;
+}
+
+/* Queues the stream's block of the given kind and takes a spare block in
+ * the same critical section. */
+static void submit(OqsRecorderStream stream, enum OqsRecordKind kind)
+{
+	OqsRecorder recorder = stream->recorder;
+	struct RecorderBlock *block = stream->blocks[kind - 1];
+
+	pthread_mutex_lock(&recorder->lock);
+	if (block && block->numRecords) {
+		block->next = 0;
+		if (recorder->tail) {
+			recorder->tail->next = block;
+		} else {
+			recorder->head = block;
+		}
+		recorder->tail = block;
+		pthread_cond_signal(&recorder->queued);
+		block = 0;
+	}
+	if (block == 0 && recorder->spare[kind - 1]) {
+		block = recorder->spare[kind - 1];
+		recorder->spare[kind - 1] = block->next;
+		block->next = 0;
+	}
+	pthread_mutex_unlock(&recorder->lock);
+	stream->blocks[kind - 1] = block;
+}
+
+OQS_STATUS oqsRecorderStreamFlush(OqsRecorderStream stream)
+{
+	OqsRecorder recorder = stream->recorder;
+	struct RecorderBlock *block;
+	OQS_STATUS stat;
+	int kind;
+
+	for (kind = OQS_RECORD_JUMPS; kind <= OQS_RECORD_SAMPLES; ++kind) {
+		block = stream->blocks[kind - 1];
+		if (block && block->numRecords) submit(stream, kind);
+	}
+	pthread_mutex_lock(&recorder->lock);
+	stat = recorder->status;
+	pthread_mutex_unlock(&recorder->lock);
+	return stat;
+}
+
+/* Returns the block of the given kind with room for one more record or
+ * null if none could be allocated. */
+static struct RecorderBlock *blockWithRoom(OqsRecorderStream stream,
+					   enum OqsRecordKind kind)
+{
+	struct RecorderBlock *block = stream->blocks[kind - 1];
+	if (block && block->numRecords < RECORDER_BLOCK_SIZE) return block;
+	submit(stream, kind);
+	if (stream->blocks[kind - 1] == 0) {
+		stream->blocks[kind - 1] =
+		    allocateBlock(stream->recorder, kind);
+	}
+	return stream->blocks[kind - 1];
+}
+
+OQS_STATUS oqsRecorderStreamJump(OqsRecorderStream stream,
+				 uint64_t trajectory, double t, int channel)
+{
+	struct RecorderBlock *block = blockWithRoom(stream, OQS_RECORD_JUMPS);
+	size_t j;
+	if (block == 0) return OQS_OUT_OF_MEMORY;
+	j = block->numRecords++;
+	block->trajectories[j] = trajectory;
+	block->times[j] = t;
+	block->channels[j] = channel;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsRecorderStreamSample(OqsRecorderStream stream,
+				   uint64_t trajectory, double t,
+				   const double *values)
+{
+	struct RecorderBlock *block =
+	    blockWithRoom(stream, OQS_RECORD_SAMPLES);
+	size_t j;
+	int i;
+	if (block == 0) return OQS_OUT_OF_MEMORY;
+	j = block->numRecords++;
+	block->trajectories[j] = trajectory;
+	block->times[j] = t;
+	for (i = 0; i < stream->recorder->numObservables; ++i) {
+		block->values[i * RECORDER_BLOCK_SIZE + j] = values[i];
+	}
+	return OQS_SUCCESS;
+}
+
+struct OqsRecording_ {
+	const char *base;
+	size_t size;
+	int numObservables;
+	size_t numChunks;
+	/* Offsets of the chunk headers */
+	size_t *offsets;
+};
+
+static size_t padded(size_t n)
+{
+	return (n + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT *
+	       CHECKPOINT_ALIGNMENT;
+}
+
+/* Size of a chunk including its header, or 0 if the header is invalid. */
+static size_t chunkSize(const struct ChunkHeader *header, int numObservables)
+{
+	uint64_t n = header->numRecords;
+	size_t size = sizeof(*header);
+	if (memcmp(header->magic, chunkMagic, sizeof(header->magic))) return 0;
+	if (n > SIZE_MAX / (sizeof(double) * ((size_t)numObservables + 2))) {
+		return 0;
+	}
+	size += padded(n * sizeof(uint64_t)) + padded(n * sizeof(double));
+	if (header->kind == OQS_RECORD_JUMPS) {
+		size += padded(n * sizeof(int32_t));
+	} else if (header->kind == OQS_RECORD_SAMPLES) {
+		size += padded(n * numObservables * sizeof(double));
+	} else {
+		return 0;
+	}
+	return size;
+}
+
+OQS_STATUS oqsRecordingOpen(const char *path, OqsRecording *recording)
+{
+	const struct CheckpointHeader *header;
+	struct OqsRecording_ *r;
+	struct stat st;
+	size_t offset, size, capacity = 0;
+	size_t *offsets;
+	void *map;
+	int fd;
+	uint64_t shape[4] = {0, 0, 0, 0};
+
+	*recording = 0;
+	fd = open(path, O_RDONLY);
+	if (fd < 0) return OQS_IO_ERROR;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return OQS_IO_ERROR;
+	}
+	if ((size_t)st.st_size < sizeof(*header)) {
+		close(fd);
+		return OQS_FORMAT_ERROR;
+	}
+	map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return OQS_IO_ERROR;
+	r = malloc(sizeof(*r));
+	if (r == 0) {
+		munmap(map, st.st_size);
+		return OQS_OUT_OF_MEMORY;
+	}
+	r->base = map;
+	r->size = st.st_size;
+	r->numChunks = 0;
+	r->offsets = 0;
+	header = (const struct CheckpointHeader *)r->base;
+	shape[0] = header->shape[0];
+	if (checkpointCheckHeader(header, CHECKPOINT_RECORDING, shape) !=
+		OQS_SUCCESS ||
+	    header->shape[0] > INT32_MAX) {
+		oqsRecordingClose(&r);
+		return OQS_FORMAT_ERROR;
+	}
+	r->numObservables = header->shape[0];
+	offset = sizeof(*header);
+	while (offset + sizeof(struct ChunkHeader) <= r->size) {
+		size = chunkSize((const struct ChunkHeader *)(r->base + offset),
+				 r->numObservables);
+		if (size == 0 || size > r->size - offset) break;
+		if (r->numChunks == capacity) {
+			capacity = capacity ? 2 * capacity : 16;
+			offsets = realloc(r->offsets,
+					  capacity * sizeof(*offsets));
+			if (offsets == 0) {
+				oqsRecordingClose(&r);
+				return OQS_OUT_OF_MEMORY;
+			}
+			r->offsets = offsets;
+		}
+		r->offsets[r->numChunks++] = offset;
+		offset += size;
+	}
+	*recording = r;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsRecordingClose(OqsRecording *recording)
+{
+	if (*recording) {
+		munmap((void *)(*recording)->base, (*recording)->size);
+		free((*recording)->offsets);
+		free(*recording);
+	}
+	*recording = 0;
+	return OQS_SUCCESS;
+}
+
+int oqsRecordingGetNumObservables(OqsRecording recording)
+{
+	return recording->numObservables;
+}
+
+size_t oqsRecordingGetNumChunks(OqsRecording recording)
+{
+	return recording->numChunks;
+}
+
+void oqsRecordingGetChunk(OqsRecording recording, size_t i,
+			  struct OqsRecordChunk *chunk)
+{
+	const char *p = recording->base + recording->offsets[i];
+	const struct ChunkHeader *header = (const struct ChunkHeader *)p;
+	size_t n = header->numRecords;
+
+	chunk->kind = (enum OqsRecordKind)header->kind;
+	chunk->numRecords = n;
+	p += sizeof(*header);
+	chunk->trajectories = (const uint64_t *)p;
+	p += padded(n * sizeof(uint64_t));
+	chunk->times = (const double *)p;
+	p += padded(n * sizeof(double));
+	chunk->channels = 0;
+	chunk->values = 0;
+	if (chunk->kind == OQS_RECORD_JUMPS) {
+		chunk->channels = (const int32_t *)p;
+	} else {
+		chunk->values = (const double *)p;
+	}
+}
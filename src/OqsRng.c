@@ -0,0 +1,104 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsRng.h>
+#include <pthread.h>
+
+static const uint32_t philoxM0 = UINT32_C(0xD2511F53);
+static const uint32_t philoxM1 = UINT32_C(0xCD9E8D57);
+static const uint32_t philoxW0 = UINT32_C(0x9E3779B9);
+static const uint32_t philoxW1 = UINT32_C(0xBB67AE85);
+
+/* Next stream handed out by oqsPhiloxReserveStreams */
+static uint64_t nextStream = 0;
+static pthread_mutex_t nextStreamLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void philoxRound(uint32_t ctr[4], const uint32_t key[2])
+{
+	uint64_t p0 = (uint64_t)philoxM0 * ctr[0];
+	uint64_t p1 = (uint64_t)philoxM1 * ctr[2];
+	uint32_t c1 = ctr[1];
+	uint32_t c3 = ctr[3];
+	ctr[0] = (uint32_t)(p1 >> 32) ^ c1 ^ key[0];
+	ctr[1] = (uint32_t)p1;
+	ctr[2] = (uint32_t)(p0 >> 32) ^ c3 ^ key[1];
+	ctr[3] = (uint32_t)p0;
+}
+
+void oqsPhilox4x32(const uint32_t counter[4], const uint32_t key[2],
+		   uint32_t output[4])
+{
+	uint32_t k[2];
+	int i;
+	k[0] = key[0];
+	k[1] = key[1];
+	for (i = 0; i < 4; ++i) {
+		output[i] = counter[i];
+	}
+	for (i = 0; i < 10; ++i) {
+		if (i > 0) {
+			k[0] += philoxW0;
+			k[1] += philoxW1;
+		}
+		philoxRound(output, k);
+	}
+}
+
+void oqsPhiloxInit(struct OqsPhilox *rng, uint64_t seed, uint64_t stream)
+{
+	rng->key[0] = (uint32_t)seed;
+	rng->key[1] = (uint32_t)(seed >> 32);
+	rng->counter[2] = (uint32_t)stream;
+	rng->counter[3] = (uint32_t)(stream >> 32);
+	oqsPhiloxSetPosition(rng, 0);
+}
+
+/* Every block of output yields two numbers. */
+void oqsPhiloxSetPosition(struct OqsPhilox *rng, uint64_t n)
+{
+	uint64_t block = n / 2;
+	rng->counter[0] = (uint32_t)block;
+	rng->counter[1] = (uint32_t)(block >> 32);
+	oqsPhilox4x32(rng->counter, rng->key, rng->output);
+	rng->used = 2 * (int)(n % 2);
+}
+
+double oqsPhiloxUniform(void *ctx)
+{
+	struct OqsPhilox *rng = (struct OqsPhilox *)ctx;
+	uint64_t bits;
+	if (rng->used == 4) {
+		if (++rng->counter[0] == 0) ++rng->counter[1];
+		oqsPhilox4x32(rng->counter, rng->key, rng->output);
+		rng->used = 0;
+	}
+	bits = ((uint64_t)rng->output[rng->used] << 32) |
+	       rng->output[rng->used + 1];
+	rng->used += 2;
+	return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint64_t oqsPhiloxReserveStreams(uint64_t n)
+{
+	uint64_t first;
+	pthread_mutex_lock(&nextStreamLock);
+	first = nextStream;
+	nextStream += n;
+	pthread_mutex_unlock(&nextStreamLock);
+	return first;
+}
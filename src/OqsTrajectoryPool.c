@@ -0,0 +1,148 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <OqsTrajectoryPool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct PoolEntry {
+	size_t dim;
+	enum OqsLayout layout;
+	OqsJumpTrajectory trajectory;
+};
+
+/* The idle trajectories are a stack so that the most recently used and
+ * therefore cache warm trajectory is handed out first. */
+struct OqsTrajectoryPool_ {
+	struct PoolEntry *entries;
+	int numEntries;
+	int capacity;
+};
+
+OQS_STATUS oqsTrajectoryPoolCreate(OqsTrajectoryPool *pool)
+{
+	OqsTrajectoryPool p = (OqsTrajectoryPool)malloc(sizeof(*p));
+	*pool = 0;
+	if (p == 0) return OQS_OUT_OF_MEMORY;
+	p->entries = 0;
+	p->numEntries = 0;
+	p->capacity = 0;
+	*pool = p;
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsTrajectoryPoolDestroy(OqsTrajectoryPool *pool)
+{
+	int i;
+	if (*pool) {
+		for (i = 0; i < (*pool)->numEntries; ++i) {
+			oqsJumpTrajectoryDestroy(
+			    &(*pool)->entries[i].trajectory);
+		}
+		free((*pool)->entries);
+		free(*pool);
+	}
+	*pool = 0;
+	return OQS_SUCCESS;
+}
+
+static OQS_STATUS grow(OqsTrajectoryPool pool, int capacity)
+{
+	struct PoolEntry *entries;
+	if (capacity <= pool->capacity) return OQS_SUCCESS;
+	if (capacity < 2 * pool->capacity) capacity = 2 * pool->capacity;
+	entries = realloc(pool->entries, capacity * sizeof(*entries));
+	if (entries == 0) return OQS_OUT_OF_MEMORY;
+	pool->entries = entries;
+	pool->capacity = capacity;
+	return OQS_SUCCESS;
+}
+
+static void push(OqsTrajectoryPool pool, OqsJumpTrajectory trajectory)
+{
+	struct PoolEntry *entry = pool->entries + pool->numEntries++;
+	entry->trajectory = trajectory;
+	entry->dim = oqsJumpTrajectoryGetDim(trajectory);
+	entry->layout = oqsJumpTrajectoryGetLayout(trajectory);
+}
+
+OQS_STATUS oqsTrajectoryPoolReserve(OqsTrajectoryPool pool, size_t dim,
+				    enum OqsLayout layout, int n)
+{
+	OqsJumpTrajectory trajectory;
+	OQS_STATUS stat;
+	int i, numIdle = 0;
+
+	for (i = 0; i < pool->numEntries; ++i) {
+		if (pool->entries[i].dim == dim &&
+		    pool->entries[i].layout == layout) {
+			++numIdle;
+		}
+	}
+	if (numIdle >= n) return OQS_SUCCESS;
+	stat = grow(pool, pool->numEntries + n - numIdle);
+	if (stat != OQS_SUCCESS) return stat;
+	for (; numIdle < n; ++numIdle) {
+		stat = oqsJumpTrajectoryCreateWithLayout(dim, layout,
+							 &trajectory);
+		if (stat != OQS_SUCCESS) return stat;
+		push(pool, trajectory);
+	}
+	return OQS_SUCCESS;
+}
+
+OQS_STATUS oqsTrajectoryPoolAcquire(OqsTrajectoryPool pool, size_t dim,
+				    enum OqsLayout layout,
+				    OqsJumpTrajectory *trajectory)
+{
+	int i;
+	for (i = pool->numEntries - 1; i >= 0; --i) {
+		if (pool->entries[i].dim == dim &&
+		    pool->entries[i].layout == layout) {
+			*trajectory = pool->entries[i].trajectory;
+			--pool->numEntries;
+			memmove(pool->entries + i, pool->entries + i + 1,
+				(pool->numEntries - i) *
+				    sizeof(*pool->entries));
+			return OQS_SUCCESS;
+		}
+	}
+	return oqsJumpTrajectoryCreateWithLayout(dim, layout, trajectory);
+}
+
+OQS_STATUS oqsTrajectoryPoolRelease(OqsTrajectoryPool pool,
+				    OqsJumpTrajectory *trajectory)
+{
+	OQS_STATUS stat;
+	if (*trajectory == 0) return OQS_SUCCESS;
+	// The pool destroys its trajectories one by one.
+	if (oqsJumpTrajectoryIsShared(*trajectory)) return OQS_INVALID_ARGUMENT;
+	stat = grow(pool, pool->numEntries + 1);
+	if (stat != OQS_SUCCESS) {
+		oqsJumpTrajectoryDestroy(trajectory);
+		return stat;
+	}
+	push(pool, *trajectory);
+	*trajectory = 0;
+	return OQS_SUCCESS;
+}
+
+int oqsTrajectoryPoolGetNumIdle(OqsTrajectoryPool pool)
+{
+	return pool->numEntries;
+}
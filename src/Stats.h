@@ -0,0 +1,43 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <OqsConfig.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Helpers for the optional hot path statistics.  Without OQS_ENABLE_STATS
+ * the counters compile to nothing. */
+#ifdef OQS_ENABLE_STATS
+#define OQS_STATS_ADD(stats, field, n) ((stats).field += (n))
+#else
+#define OQS_STATS_ADD(stats, field, n) ((void)(n))
+#endif
+
+/* Monotonic wall clock time in seconds */
+double statsWallTime(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
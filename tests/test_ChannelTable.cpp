@@ -0,0 +1,69 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include <ChannelTable.h>
+
+TEST(ChannelTable, Search) {
+  const double cumulative[] = {0.0, 1.0, 1.0, 3.0, 6.0};
+  EXPECT_EQ(1, channelSearch(cumulative, 5, 0.0));
+  EXPECT_EQ(1, channelSearch(cumulative, 5, 0.5));
+  EXPECT_EQ(3, channelSearch(cumulative, 5, 1.0));
+  EXPECT_EQ(3, channelSearch(cumulative, 5, 2.9));
+  EXPECT_EQ(4, channelSearch(cumulative, 5, 3.0));
+  EXPECT_EQ(4, channelSearch(cumulative, 5, 5.99));
+  EXPECT_EQ(0, channelSearch(cumulative, 1, 0.5));
+}
+
+TEST(ChannelTable, AliasTableInvalid) {
+  struct AliasTable table;
+  const double zeros[] = {0.0, 0.0};
+  const double negative[] = {1.0, -1.0};
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, aliasTableCreate(&table, 2, zeros));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, aliasTableCreate(&table, 2, negative));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, aliasTableCreate(&table, 0, zeros));
+}
+
+TEST(ChannelTable, AliasTableDistribution) {
+  const double weights[] = {0.5, 0.0, 3.0, 1.5, 2.0, 0.25, 0.75};
+  const int n = sizeof(weights) / sizeof(weights[0]);
+  struct AliasTable table;
+  ASSERT_EQ(OQS_SUCCESS, aliasTableCreate(&table, n, weights));
+  double total = 0;
+  for (int i = 0; i < n; ++i) total += weights[i];
+
+  // Integrating over a fine grid of deviates recovers the probabilities
+  // up to the grid resolution.
+  const int numSamples = 70000;
+  std::vector<int> counts(n, 0);
+  for (int j = 0; j < numSamples; ++j) {
+    int k = aliasTableSample(&table, (j + 0.5) / numSamples);
+    ASSERT_GE(k, 0);
+    ASSERT_LT(k, n);
+    ++counts[k];
+  }
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(weights[i] / total, counts[i] / (double)numSamples,
+                2.0 * n / numSamples);
+  }
+  EXPECT_EQ(0, counts[1]);
+  aliasTableDestroy(&table);
+  EXPECT_EQ(0, table.n);
+}
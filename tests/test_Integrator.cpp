@@ -17,7 +17,9 @@ You should have received a copy of the GNU General Public License along
 with oqs.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
+#include <vector>
 #include <Integrator.h>
 
 TEST(Integrator, Create) {
@@ -103,3 +105,339 @@ TEST(Integrator, AdvanceTo) {
   integratorDestroy(&integrator);
 }
 
+
+TEST(Dopri5, TakeStep) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, 1, &dopri5_create);
+  integratorTimeStepHint(&integrator, 1.0e-2);
+  struct OqsAmplitude x;
+  x.re = 1.0;
+  x.im = 0.0;
+  struct DecayCtx ctx;
+  ctx.gamma = 1.0;
+  integratorTakeStep(&integrator, &x, &exponentialDecay, &ctx);
+  double t = integratorGetTime(&integrator);
+  EXPECT_LT(0, t);
+  EXPECT_FLOAT_EQ(exp(-ctx.gamma * t), x.re);
+  EXPECT_FLOAT_EQ(0, x.im);
+  integratorDestroy(&integrator);
+}
+
+TEST(Dopri5, AdvanceTo) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, 1, &dopri5_create);
+  integratorSetTolerances(&integrator, 1.0e-10, 1.0e-10);
+  struct OqsAmplitude x;
+  x.re = 1.0;
+  x.im = 0.0;
+  struct DecayCtx ctx;
+  ctx.gamma = 1.0;
+  double targetTime = 3.3458;
+  integratorAdvanceTo(&integrator, targetTime, &x, &exponentialDecay, &ctx);
+  double finalTime = integratorGetTime(&integrator);
+  EXPECT_FLOAT_EQ(targetTime, finalTime);
+  EXPECT_NEAR(exp(-finalTime * ctx.gamma), x.re, 1.0e-9);
+  integratorDestroy(&integrator);
+}
+
+struct CountingCtx {
+  double gamma;
+  int numCalls;
+};
+void countingDecay(double t, const struct OqsAmplitude* x,
+                   struct OqsAmplitude* y, void* ctx) {
+  struct CountingCtx* c = (struct CountingCtx*)ctx;
+  ++c->numCalls;
+  y[0].re = -c->gamma * x[0].re;
+  y[0].im = -c->gamma * x[0].im;
+}
+
+TEST(Dopri5, AdaptsStepSize) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, 1, &dopri5_create);
+  integratorSetTolerances(&integrator, 1.0e-8, 1.0e-8);
+  struct OqsAmplitude x;
+  x.re = 1.0;
+  x.im = 0.0;
+  struct CountingCtx ctx;
+  ctx.gamma = 1.0;
+  ctx.numCalls = 0;
+  integratorAdvanceTo(&integrator, 10.0, &x, &countingDecay, &ctx);
+  EXPECT_NEAR(exp(-10.0), x.re, 1.0e-8);
+  // Fixed step RK4 with the default time step would need 40000 right
+  // hand side evaluations.
+  EXPECT_GT(1000, ctx.numCalls);
+  integratorDestroy(&integrator);
+}
+
+TEST(Dopri5, Invalidate) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, 1, &dopri5_create);
+  integratorTimeStepHint(&integrator, 1.0e-2);
+  struct OqsAmplitude x;
+  x.re = 1.0;
+  x.im = 0.0;
+  struct DecayCtx ctx;
+  ctx.gamma = 1.0;
+  integratorTakeStep(&integrator, &x, &exponentialDecay, &ctx);
+  double t = integratorGetTime(&integrator);
+  x.re = 2.0;
+  integratorInvalidate(&integrator);
+  integratorTakeStep(&integrator, &x, &exponentialDecay, &ctx);
+  double tFinal = integratorGetTime(&integrator);
+  EXPECT_FLOAT_EQ(2.0 * exp(-ctx.gamma * (tFinal - t)), x.re);
+  integratorDestroy(&integrator);
+}
+
+TEST(Integrator, Interpolate) {
+  struct Integrator integrator;
+  integratorCreate(&integrator, 1);
+  double dt = 1.0e-2;
+  integratorTimeStepHint(&integrator, dt);
+  struct OqsAmplitude x0, x, y;
+  x0.re = 1.0;
+  x0.im = 0.5;
+  x = x0;
+  struct CountingCtx ctx;
+  ctx.gamma = 1.0;
+  ctx.numCalls = 0;
+  integratorTakeStep(&integrator, &x, &countingDecay, &ctx);
+  int numCalls = ctx.numCalls;
+  double t = 0.37 * dt;
+  integratorInterpolate(&integrator, t, &x0, &y);
+  EXPECT_EQ(numCalls, ctx.numCalls);
+  EXPECT_NEAR(exp(-ctx.gamma * t) * x0.re, y.re, 1.0e-9);
+  EXPECT_NEAR(exp(-ctx.gamma * t) * x0.im, y.im, 1.0e-9);
+  integratorInterpolate(&integrator, dt, &x0, &y);
+  EXPECT_FLOAT_EQ(x.re, y.re);
+  EXPECT_FLOAT_EQ(x.im, y.im);
+  integratorDestroy(&integrator);
+}
+
+TEST(Dopri5, Interpolate) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, 1, &dopri5_create);
+  integratorSetTolerances(&integrator, 1.0e-10, 1.0e-10);
+  integratorTimeStepHint(&integrator, 1.0e-1);
+  struct OqsAmplitude x0, x, y;
+  x0.re = 1.0;
+  x0.im = -0.5;
+  x = x0;
+  struct CountingCtx ctx;
+  ctx.gamma = 1.0;
+  ctx.numCalls = 0;
+  integratorTakeStep(&integrator, &x, &countingDecay, &ctx);
+  int numCalls = ctx.numCalls;
+  double tEnd = integratorGetTime(&integrator);
+  for (int i = 0; i <= 10; ++i) {
+    double t = 0.1 * i * tEnd;
+    integratorInterpolate(&integrator, t, &x0, &y);
+    EXPECT_NEAR(exp(-ctx.gamma * t) * x0.re, y.re, 1.0e-9);
+    EXPECT_NEAR(exp(-ctx.gamma * t) * x0.im, y.im, 1.0e-9);
+  }
+  EXPECT_EQ(numCalls, ctx.numCalls);
+  integratorDestroy(&integrator);
+}
+
+TEST(Integrator, TakeStepFrom) {
+  void (*creators[])(struct Integrator*, size_t) = {
+      &rk4_create, &dopri5_create, &lsrk4_create};
+  for (auto create : creators) {
+    struct Integrator inPlace, outOfPlace;
+    integratorCreateWith(&inPlace, 1, create);
+    integratorCreateWith(&outOfPlace, 1, create);
+    struct OqsAmplitude x0 = {1.0, -0.5};
+    struct OqsAmplitude x = x0;
+    struct OqsAmplitude y = {0.0, 0.0};
+    struct DecayCtx ctx;
+    ctx.gamma = 1.0;
+    integratorTakeStep(&inPlace, &x, &exponentialDecay, &ctx);
+    double nrm = integratorTakeStepFrom(&outOfPlace, &x0, &y,
+                                        &exponentialDecay, &ctx);
+    EXPECT_EQ(1.0, x0.re);
+    EXPECT_EQ(-0.5, x0.im);
+    EXPECT_EQ(x.re, y.re);
+    EXPECT_EQ(x.im, y.im);
+    EXPECT_DOUBLE_EQ(y.re * y.re + y.im * y.im, nrm);
+    EXPECT_EQ(integratorGetTime(&inPlace), integratorGetTime(&outOfPlace));
+    integratorDestroy(&inPlace);
+    integratorDestroy(&outOfPlace);
+  }
+}
+
+TEST(Krylov, TakeStep) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, 1, &krylov_create);
+  integratorTimeStepHint(&integrator, 0.5);
+  struct OqsAmplitude x = {1.0, 0.0};
+  struct CountingCtx ctx;
+  ctx.gamma = 1.0;
+  ctx.numCalls = 0;
+  integratorTakeStep(&integrator, &x, &countingDecay, &ctx);
+  // The one dimensional Krylov space is invariant so the step is exact.
+  EXPECT_FLOAT_EQ(0.5, integratorGetTime(&integrator));
+  EXPECT_FLOAT_EQ(exp(-0.5 * ctx.gamma), x.re);
+  EXPECT_EQ(1, ctx.numCalls);
+  integratorDestroy(&integrator);
+}
+
+// Diagonal generator with eigenvalues -(0.1 + i) * (k + 1) * (1 + 0.05 k)
+static const size_t spectrumDim = 50;
+static void diagonalRHS(double t, const struct OqsAmplitude* x,
+                        struct OqsAmplitude* y, void* ctx) {
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    double s = (k + 1) * 0.05;
+    y[k].re = -s * (0.1 * x[k].re - x[k].im);
+    y[k].im = -s * (0.1 * x[k].im + x[k].re);
+  }
+}
+
+static void diagonalExact(double t, const struct OqsAmplitude* x0,
+                          struct OqsAmplitude* x) {
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    double s = (k + 1) * 0.05;
+    double a = exp(-0.1 * s * t);
+    x[k].re = a * (cos(s * t) * x0[k].re + sin(s * t) * x0[k].im);
+    x[k].im = a * (cos(s * t) * x0[k].im - sin(s * t) * x0[k].re);
+  }
+}
+
+TEST(Krylov, AdvanceTo) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, spectrumDim, &krylov_create);
+  integratorSetTolerances(&integrator, 1.0e-10, 1.0e-10);
+  integratorTimeStepHint(&integrator, 1.0);
+  std::vector<OqsAmplitude> x0(spectrumDim), x(spectrumDim),
+      expected(spectrumDim), y(spectrumDim);
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    x0[k].re = 1.0 / sqrt(spectrumDim);
+    x0[k].im = 0.1 * sin(k);
+  }
+  x = x0;
+  integratorAdvanceTo(&integrator, 3.0, &x[0], &diagonalRHS, 0);
+  EXPECT_DOUBLE_EQ(3.0, integratorGetTime(&integrator));
+  diagonalExact(3.0, &x0[0], &expected[0]);
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    EXPECT_NEAR(expected[k].re, x[k].re, 1.0e-8);
+    EXPECT_NEAR(expected[k].im, x[k].im, 1.0e-8);
+  }
+  integratorDestroy(&integrator);
+}
+
+TEST(Krylov, Interpolate) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, spectrumDim, &krylov_create);
+  integratorSetTolerances(&integrator, 1.0e-10, 1.0e-10);
+  integratorTimeStepHint(&integrator, 1.0);
+  std::vector<OqsAmplitude> x0(spectrumDim), x(spectrumDim),
+      expected(spectrumDim), y(spectrumDim);
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    x0[k].re = cos(k);
+    x0[k].im = sin(2.0 * k);
+  }
+  double nrm = integratorTakeStepFrom(&integrator, &x0[0], &x[0],
+                                      &diagonalRHS, 0);
+  double tEnd = integratorGetTime(&integrator);
+  EXPECT_LT(0, tEnd);
+  double expectedNorm = 0;
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    expectedNorm += x[k].re * x[k].re + x[k].im * x[k].im;
+  }
+  EXPECT_NEAR(expectedNorm, nrm, 1.0e-12 * expectedNorm);
+  for (int i = 0; i <= 4; ++i) {
+    double t = 0.25 * i * tEnd;
+    integratorInterpolate(&integrator, t, &x0[0], &y[0]);
+    diagonalExact(t, &x0[0], &expected[0]);
+    for (size_t k = 0; k < spectrumDim; ++k) {
+      EXPECT_NEAR(expected[k].re, y[k].re, 1.0e-8);
+      EXPECT_NEAR(expected[k].im, y[k].im, 1.0e-8);
+    }
+  }
+  integratorDestroy(&integrator);
+}
+
+static double diagonalError(void (*create)(struct Integrator*, size_t),
+                            double dt) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, spectrumDim, create);
+  integratorTimeStepHint(&integrator, dt);
+  std::vector<OqsAmplitude> x0(spectrumDim), x(spectrumDim),
+      expected(spectrumDim);
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    x0[k].re = cos(k);
+    x0[k].im = sin(2.0 * k);
+  }
+  x = x0;
+  integratorAdvanceTo(&integrator, 2.0, &x[0], &diagonalRHS, 0);
+  diagonalExact(2.0, &x0[0], &expected[0]);
+  integratorDestroy(&integrator);
+  double error = 0;
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    error = std::max(error, std::abs(expected[k].re - x[k].re));
+    error = std::max(error, std::abs(expected[k].im - x[k].im));
+  }
+  return error;
+}
+
+TEST(Lsrk4, FourthOrder) {
+  double coarse = diagonalError(&lsrk4_create, 0.1);
+  double fine = diagonalError(&lsrk4_create, 0.05);
+  EXPECT_NEAR(4.0, log2(coarse / fine), 0.2);
+  // At least as accurate as the classical method for the same step.
+  EXPECT_LT(fine, diagonalError(&rk4_create, 0.05));
+}
+
+TEST(Lsrk4, Interpolate) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, spectrumDim, &lsrk4_create);
+  double dt = 1.0e-2;
+  integratorTimeStepHint(&integrator, dt);
+  std::vector<OqsAmplitude> x0(spectrumDim), x(spectrumDim),
+      expected(spectrumDim), y(spectrumDim);
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    x0[k].re = cos(k);
+    x0[k].im = sin(2.0 * k);
+  }
+  integratorTakeStepFrom(&integrator, &x0[0], &x[0], &diagonalRHS, 0);
+  for (int i = 0; i <= 4; ++i) {
+    double t = 0.25 * i * dt;
+    integratorInterpolate(&integrator, t, &x0[0], &y[0]);
+    diagonalExact(t, &x0[0], &expected[0]);
+    for (size_t k = 0; k < spectrumDim; ++k) {
+      EXPECT_NEAR(expected[k].re, y[k].re, 1.0e-6);
+      EXPECT_NEAR(expected[k].im, y[k].im, 1.0e-6);
+    }
+  }
+  integratorInterpolate(&integrator, dt, &x0[0], &y[0]);
+  for (size_t k = 0; k < spectrumDim; ++k) {
+    EXPECT_DOUBLE_EQ(x[k].re, y[k].re);
+    EXPECT_DOUBLE_EQ(x[k].im, y[k].im);
+  }
+  integratorDestroy(&integrator);
+}
+
+static void countingDiagonalRHS(double t, const struct OqsAmplitude* x,
+                                struct OqsAmplitude* y, void* ctx) {
+  ++*(int*)ctx;
+  diagonalRHS(t, x, y, 0);
+}
+
+TEST(Lsrk4, InterpolationEvaluatesSlopeOnce) {
+  struct Integrator integrator;
+  integratorCreateWith(&integrator, spectrumDim, &lsrk4_create);
+  integratorTimeStepHint(&integrator, 1.0e-2);
+  std::vector<OqsAmplitude> x0(spectrumDim, OqsAmplitude{1.0, 0.0}),
+      x(spectrumDim), y(spectrumDim);
+  int numCalls = 0;
+  integratorTakeStepFrom(&integrator, &x0[0], &x[0], &countingDiagonalRHS,
+                         &numCalls);
+  EXPECT_EQ(5, numCalls);
+  integratorInterpolate(&integrator, 2.0e-3, &x0[0], &y[0]);
+  integratorInterpolate(&integrator, 7.0e-3, &x0[0], &y[0]);
+  EXPECT_EQ(6, numCalls);
+  integratorTakeStepFrom(&integrator, &x[0], &x0[0], &countingDiagonalRHS,
+                         &numCalls);
+  integratorInterpolate(&integrator, 1.5e-2, &x[0], &y[0]);
+  EXPECT_EQ(12, numCalls);
+  integratorDestroy(&integrator);
+}
@@ -0,0 +1,207 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include <Kernels.h>
+
+namespace {
+
+// Odd lengths exercise the scalar remainder loops of the vector kernels.
+const size_t lengths[] = {0, 1, 2, 3, 5, 8, 13, 31};
+const KernelIsa isas[] = {KERNEL_ISA_AVX2, KERNEL_ISA_AVX512};
+
+std::vector<OqsAmplitude> makeVector(size_t dim, double offset) {
+  std::vector<OqsAmplitude> x(dim + 1);
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i].re = sin(1.3 * i + offset);
+    x[i].im = cos(0.7 * i - offset);
+  }
+  return x;
+}
+
+void expectEqual(const std::vector<OqsAmplitude> &a,
+                 const std::vector<OqsAmplitude> &b) {
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_NEAR(a[i].re, b[i].re, 1.0e-14);
+    EXPECT_NEAR(a[i].im, b[i].im, 1.0e-14);
+  }
+}
+
+class Kernels : public ::testing::Test {
+ protected:
+  void TearDown() {
+    kernelsSelectIsa(KERNEL_ISA_SCALAR);
+  }
+};
+
+}
+
+TEST_F(Kernels, SelectScalar) {
+  EXPECT_TRUE(kernelsIsaSupported(KERNEL_ISA_SCALAR));
+  EXPECT_TRUE(kernelsSelectIsa(KERNEL_ISA_SCALAR));
+  EXPECT_EQ(KERNEL_ISA_SCALAR, kernelsGetIsa());
+}
+
+TEST_F(Kernels, Zaxpy) {
+  for (KernelIsa isa : isas) {
+    if (!kernelsIsaSupported(isa)) continue;
+    for (size_t dim : lengths) {
+      std::vector<OqsAmplitude> x = makeVector(dim, 0.1);
+      std::vector<OqsAmplitude> y = makeVector(dim, 0.2);
+      std::vector<OqsAmplitude> expected = makeVector(dim, 0.3);
+      std::vector<OqsAmplitude> actual = expected;
+      kernelsSelectIsa(KERNEL_ISA_SCALAR);
+      kernelZaxpy(&expected[0], 0.37, &x[0], &y[0], dim);
+      kernelsSelectIsa(isa);
+      kernelZaxpy(&actual[0], 0.37, &x[0], &y[0], dim);
+      expectEqual(expected, actual);
+      // The element past dim must not be touched.
+      EXPECT_EQ(makeVector(dim, 0.3)[dim].re, actual[dim].re);
+    }
+  }
+}
+
+TEST_F(Kernels, Stage) {
+  const double c[] = {0.5, -1.5, 2.0, 0.25, -0.75, 1.0};
+  for (KernelIsa isa : isas) {
+    if (!kernelsIsaSupported(isa)) continue;
+    for (size_t dim : lengths) {
+      std::vector<std::vector<OqsAmplitude> > k;
+      const OqsAmplitude *kp[6];
+      for (int j = 0; j < 6; ++j) {
+        k.push_back(makeVector(dim, j));
+        kp[j] = &k[j][0];
+      }
+      std::vector<OqsAmplitude> x = makeVector(dim, -1.0);
+      for (int n = 1; n <= 6; ++n) {
+        std::vector<OqsAmplitude> expected = makeVector(dim, 0.3);
+        std::vector<OqsAmplitude> actual = expected;
+        kernelsSelectIsa(KERNEL_ISA_SCALAR);
+        double expectedNorm = kernelStage(&expected[0], &x[0], n, c, kp, dim);
+        kernelsSelectIsa(isa);
+        double actualNorm = kernelStage(&actual[0], &x[0], n, c, kp, dim);
+        expectEqual(expected, actual);
+        EXPECT_NEAR(expectedNorm, actualNorm, 1.0e-12);
+        EXPECT_NEAR(kernelNormSquared(&actual[0], dim), actualNorm, 1.0e-12);
+      }
+    }
+  }
+}
+
+TEST_F(Kernels, Rk4Combine) {
+  for (KernelIsa isa : isas) {
+    if (!kernelsIsaSupported(isa)) continue;
+    for (size_t dim : lengths) {
+      std::vector<OqsAmplitude> k1 = makeVector(dim, 1.0);
+      std::vector<OqsAmplitude> k2 = makeVector(dim, 2.0);
+      std::vector<OqsAmplitude> k3 = makeVector(dim, 3.0);
+      std::vector<OqsAmplitude> k4 = makeVector(dim, 4.0);
+      std::vector<OqsAmplitude> expected = makeVector(dim, 0.3);
+      std::vector<OqsAmplitude> actual = expected;
+      std::vector<OqsAmplitude> outOfPlace(expected.size());
+      kernelsSelectIsa(KERNEL_ISA_SCALAR);
+      double expectedNorm = kernelRk4Combine(
+          &expected[0], &expected[0], 0.1, &k1[0], &k2[0], &k3[0], &k4[0], dim);
+      kernelsSelectIsa(isa);
+      double actualNorm = kernelRk4Combine(
+          &outOfPlace[0], &actual[0], 0.1, &k1[0], &k2[0], &k3[0], &k4[0], dim);
+      kernelRk4Combine(&actual[0], &actual[0], 0.1, &k1[0], &k2[0], &k3[0],
+                       &k4[0], dim);
+      expectEqual(expected, actual);
+      outOfPlace[dim] = actual[dim];
+      expectEqual(expected, outOfPlace);
+      EXPECT_NEAR(expectedNorm, actualNorm, 1.0e-12);
+    }
+  }
+}
+
+TEST_F(Kernels, NormSquared) {
+  for (KernelIsa isa : isas) {
+    if (!kernelsIsaSupported(isa)) continue;
+    kernelsSelectIsa(isa);
+    for (size_t dim : lengths) {
+      std::vector<OqsAmplitude> x = makeVector(dim, 0.5);
+      double expected = 0;
+      for (size_t i = 0; i < dim; ++i) {
+        expected += x[i].re * x[i].re + x[i].im * x[i].im;
+      }
+      EXPECT_NEAR(expected, kernelNormSquared(&x[0], dim), 1.0e-13);
+    }
+  }
+}
+
+namespace {
+
+// Converts an interleaved vector of n complex numbers to the split layout.
+std::vector<OqsAmplitude> toSplit(const std::vector<OqsAmplitude> &x,
+                                  size_t n) {
+  std::vector<OqsAmplitude> s(n);
+  double *d = (double *)&s[0];
+  for (size_t i = 0; i < n; ++i) {
+    d[i] = x[i].re;
+    d[n + i] = x[i].im;
+  }
+  return s;
+}
+
+}
+
+TEST_F(Kernels, ComplexLayouts) {
+  const OqsAmplitude a = {0.3, -1.1};
+  for (size_t n : lengths) {
+    if (n == 0) continue;
+    std::vector<OqsAmplitude> x = makeVector(n, 0.1);
+    std::vector<OqsAmplitude> y = makeVector(n, 0.2);
+    std::vector<OqsAmplitude> xs = toSplit(x, n);
+    std::vector<OqsAmplitude> ys = toSplit(y, n);
+
+    OqsAmplitude dot = kernelZdotc(&x[0], &y[0], n, 0);
+    OqsAmplitude dotSplit = kernelZdotc(&xs[0], &ys[0], n, 1);
+    double re = 0, im = 0;
+    for (size_t i = 0; i < n; ++i) {
+      re += x[i].re * y[i].re + x[i].im * y[i].im;
+      im += x[i].re * y[i].im - x[i].im * y[i].re;
+    }
+    EXPECT_NEAR(re, dot.re, 1.0e-13);
+    EXPECT_NEAR(im, dot.im, 1.0e-13);
+    EXPECT_NEAR(re, dotSplit.re, 1.0e-13);
+    EXPECT_NEAR(im, dotSplit.im, 1.0e-13);
+
+    std::vector<OqsAmplitude> expected = y;
+    for (size_t i = 0; i < n; ++i) {
+      expected[i].re += a.re * x[i].re - a.im * x[i].im;
+      expected[i].im += a.re * x[i].im + a.im * x[i].re;
+    }
+    kernelZaxpyc(a, &x[0], &y[0], n, 0);
+    kernelZaxpyc(a, &xs[0], &ys[0], n, 1);
+    expectEqual(expected, y);
+    expectEqual(toSplit(expected, n), ys);
+
+    for (size_t i = 0; i < n; ++i) {
+      expected[i].re = a.re * x[i].re - a.im * x[i].im;
+      expected[i].im = a.re * x[i].im + a.im * x[i].re;
+    }
+    kernelZscalc(a, &x[0], &y[0], n, 0);
+    kernelZscalc(a, &xs[0], &ys[0], n, 1);
+    expectEqual(expected, y);
+    expectEqual(toSplit(expected, n), ys);
+  }
+}
@@ -0,0 +1,200 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsAccumulator.h>
+#include <cmath>
+#include <vector>
+
+static void excitedStateProjector(const struct OqsAmplitude* x,
+                                  struct OqsAmplitude* y, void* ctx) {
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1] = x[1];
+}
+
+static void identity(const struct OqsAmplitude* x, struct OqsAmplitude* y,
+                     void* ctx) {
+  y[0] = x[0];
+  y[1] = x[1];
+}
+
+class Accumulator : public ::testing::Test {
+ public:
+  OqsAccumulator accumulator;
+  struct OqsObservable observables[2];
+  void SetUp() {
+    observables[0].apply = &excitedStateProjector;
+    observables[0].ctx = 0;
+    observables[1].apply = &identity;
+    observables[1].ctx = 0;
+    OQS_STATUS stat =
+        oqsAccumulatorCreate(2, 2, observables, 11, 0.0, 0.1, &accumulator);
+    ASSERT_EQ(OQS_SUCCESS, stat);
+  }
+  void TearDown() { oqsAccumulatorDestroy(&accumulator); }
+};
+
+TEST_F(Accumulator, Create) {
+  EXPECT_TRUE(0 != accumulator);
+  EXPECT_EQ(11u, oqsAccumulatorGetNumTimes(accumulator));
+  EXPECT_FLOAT_EQ(0.3, oqsAccumulatorGetTime(accumulator, 3));
+  EXPECT_EQ(0, oqsAccumulatorGetCount(accumulator, 3));
+}
+
+TEST_F(Accumulator, MeanAndVariance) {
+  double populations[] = {0.1, 0.7, 0.4, 0.25};
+  double mean = 0;
+  for (int i = 0; i < 4; ++i) {
+    // Unnormalized state with excited state population populations[i].
+    struct OqsAmplitude state[2] = {{0.0, 2.0 * sqrt(1.0 - populations[i])},
+                                    {2.0 * sqrt(populations[i]), 0.0}};
+    oqsAccumulatorAddSample(accumulator, 2, state);
+    mean += populations[i];
+  }
+  mean /= 4;
+  double variance = 0;
+  for (int i = 0; i < 4; ++i) {
+    variance += (populations[i] - mean) * (populations[i] - mean);
+  }
+  variance /= 3;
+  EXPECT_EQ(4, oqsAccumulatorGetCount(accumulator, 2));
+  EXPECT_FLOAT_EQ(mean, oqsAccumulatorGetMean(accumulator, 0, 2));
+  EXPECT_FLOAT_EQ(variance, oqsAccumulatorGetVariance(accumulator, 0, 2));
+  EXPECT_FLOAT_EQ(1.0, oqsAccumulatorGetMean(accumulator, 1, 2));
+  EXPECT_NEAR(0.0, oqsAccumulatorGetVariance(accumulator, 1, 2), 1.0e-15);
+}
+
+TEST_F(Accumulator, Merge) {
+  OqsAccumulator other;
+  OQS_STATUS stat =
+      oqsAccumulatorCreate(2, 2, observables, 11, 0.0, 0.1, &other);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  OqsAccumulator all;
+  stat = oqsAccumulatorCreate(2, 2, observables, 11, 0.0, 0.1, &all);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  for (int i = 0; i < 7; ++i) {
+    double p = 0.1 * i;
+    struct OqsAmplitude state[2] = {{sqrt(1.0 - p), 0.0}, {sqrt(p), 0.0}};
+    oqsAccumulatorAddSample(i < 3 ? accumulator : other, 5, state);
+    oqsAccumulatorAddSample(all, 5, state);
+  }
+  stat = oqsAccumulatorMerge(accumulator, other);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  EXPECT_EQ(7, oqsAccumulatorGetCount(accumulator, 5));
+  EXPECT_FLOAT_EQ(oqsAccumulatorGetMean(all, 0, 5),
+                  oqsAccumulatorGetMean(accumulator, 0, 5));
+  EXPECT_FLOAT_EQ(oqsAccumulatorGetVariance(all, 0, 5),
+                  oqsAccumulatorGetVariance(accumulator, 0, 5));
+  oqsAccumulatorDestroy(&other);
+  oqsAccumulatorDestroy(&all);
+}
+
+TEST_F(Accumulator, MergeIncompatible) {
+  OqsAccumulator other;
+  OQS_STATUS stat =
+      oqsAccumulatorCreate(2, 2, observables, 12, 0.0, 0.1, &other);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsAccumulatorMerge(accumulator, other));
+  oqsAccumulatorDestroy(&other);
+  // Same number of times on a different grid or for another dimension
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsAccumulatorCreate(2, 2, observables, 11, 0.5, 0.1, &other));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsAccumulatorMerge(accumulator, other));
+  oqsAccumulatorDestroy(&other);
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsAccumulatorCreate(2, 2, observables, 11, 0.0, 0.2, &other));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsAccumulatorMerge(accumulator, other));
+  oqsAccumulatorDestroy(&other);
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsAccumulatorCreate(3, 2, observables, 11, 0.0, 0.1, &other));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsAccumulatorMerge(accumulator, other));
+  oqsAccumulatorDestroy(&other);
+}
+
+TEST_F(Accumulator, Checkpoint) {
+  for (int i = 0; i < 5; ++i) {
+    double p = 0.15 * i;
+    struct OqsAmplitude state[2] = {{sqrt(1.0 - p), 0.0}, {sqrt(p), 0.0}};
+    oqsAccumulatorAddSample(accumulator, i % 3, state);
+  }
+  std::string path = ::testing::TempDir() + "oqs_accumulator.ckpt";
+  ASSERT_EQ(OQS_SUCCESS, oqsAccumulatorSave(accumulator, path.c_str()));
+  OqsAccumulator restarted;
+  ASSERT_EQ(OQS_SUCCESS, oqsAccumulatorCreate(2, 2, observables, 11, 0.0, 0.1,
+                                              &restarted));
+  ASSERT_EQ(OQS_SUCCESS, oqsAccumulatorLoad(restarted, path.c_str()));
+  for (size_t t = 0; t < 11; ++t) {
+    EXPECT_EQ(oqsAccumulatorGetCount(accumulator, t),
+              oqsAccumulatorGetCount(restarted, t));
+    for (int o = 0; o < 2; ++o) {
+      EXPECT_EQ(oqsAccumulatorGetMean(accumulator, o, t),
+                oqsAccumulatorGetMean(restarted, o, t));
+      EXPECT_EQ(oqsAccumulatorGetVariance(accumulator, o, t),
+                oqsAccumulatorGetVariance(restarted, o, t));
+    }
+  }
+  oqsAccumulatorDestroy(&restarted);
+  ASSERT_EQ(OQS_SUCCESS, oqsAccumulatorCreate(2, 2, observables, 11, 0.0, 0.2,
+                                              &restarted));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsAccumulatorLoad(restarted, path.c_str()));
+  oqsAccumulatorDestroy(&restarted);
+  remove(path.c_str());
+}
+
+static void ExcitedStateDecayRHS(double t, const struct OqsAmplitude* x,
+                                 struct OqsAmplitude* y, void* ctx) {
+  double gamma = *(double*)ctx;
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1].re = -0.5 * gamma * x[1].re;
+  y[1].im = -0.5 * gamma * x[1].im;
+}
+
+static void excitedToGroundDecay(const struct OqsAmplitude* x,
+                                 struct OqsAmplitude* y, void* ctx) {
+  double sgamma = sqrt(*(double*)ctx);
+  y[0].re = sgamma * x[1].re;
+  y[0].im = sgamma * x[1].im;
+  y[1].re = 0;
+  y[1].im = 0;
+}
+
+TEST_F(Accumulator, SampleTrajectory) {
+  double gamma = 1.0;
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(2, &trajectory));
+  struct OqsSchrodingerEqn eqn = {&ExcitedStateDecayRHS, &gamma};
+  oqsJumpTrajectorySetSchrodingerEqn(trajectory, &eqn);
+  struct OqsDecayOperator decay = {&excitedToGroundDecay, &gamma};
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  int numTrajectories = 400;
+  for (int i = 0; i < numTrajectories; ++i) {
+    oqsJumpTrajectorySeed(trajectory, 1, i);
+    oqsJumpTrajectoryReset(trajectory, initialState, 0.0);
+    oqsAccumulatorSampleTrajectory(accumulator, trajectory, 1, &decay);
+  }
+  for (size_t i = 0; i < oqsAccumulatorGetNumTimes(accumulator); ++i) {
+    EXPECT_EQ(numTrajectories, oqsAccumulatorGetCount(accumulator, i));
+    double p = exp(-gamma * oqsAccumulatorGetTime(accumulator, i));
+    double sigma = sqrt(p * (1.0 - p) / numTrajectories);
+    EXPECT_NEAR(p, oqsAccumulatorGetMean(accumulator, 0, i),
+                5.0 * sigma + 1.0e-12);
+  }
+  oqsJumpTrajectoryDestroy(&trajectory);
+}
@@ -0,0 +1,236 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsDiffusiveTrajectory.h>
+#include <OqsAccumulator.h>
+#include <cmath>
+
+// Two level atom driven with Rabi frequency omega that decays with rate
+// gamma from |1> to |0> and dephases with rate kappa.
+struct AtomCtx {
+  double omega;
+  double gamma;
+  double kappa;
+};
+
+static void atomRHS(double t, const struct OqsAmplitude* x,
+                    struct OqsAmplitude* y, void* ctx) {
+  struct AtomCtx* c = (struct AtomCtx*)ctx;
+  // -i (omega / 2 sigma_x - i gamma / 2 |1><1| - i kappa / 2) x
+  y[0].re = 0.5 * c->omega * x[1].im - 0.5 * c->kappa * x[0].re;
+  y[0].im = -0.5 * c->omega * x[1].re - 0.5 * c->kappa * x[0].im;
+  y[1].re = 0.5 * c->omega * x[0].im - 0.5 * (c->gamma + c->kappa) * x[1].re;
+  y[1].im = -0.5 * c->omega * x[0].re - 0.5 * (c->gamma + c->kappa) * x[1].im;
+}
+
+static void atomDecay(const struct OqsAmplitude* x, struct OqsAmplitude* y,
+                      void* ctx) {
+  struct AtomCtx* c = (struct AtomCtx*)ctx;
+  double sgamma = sqrt(c->gamma);
+  y[0].re = sgamma * x[1].re;
+  y[0].im = sgamma * x[1].im;
+  y[1].re = 0;
+  y[1].im = 0;
+}
+
+static void atomDephasing(const struct OqsAmplitude* x,
+                          struct OqsAmplitude* y, void* ctx) {
+  struct AtomCtx* c = (struct AtomCtx*)ctx;
+  double skappa = sqrt(c->kappa);
+  y[0].re = skappa * x[0].re;
+  y[0].im = skappa * x[0].im;
+  y[1].re = -skappa * x[1].re;
+  y[1].im = -skappa * x[1].im;
+}
+
+static void excitedStateProjector(const struct OqsAmplitude* x,
+                                  struct OqsAmplitude* y, void* ctx) {
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1] = x[1];
+}
+
+class Atom : public ::testing::TestWithParam<OqsDiffusiveScheme> {
+ public:
+  OqsDiffusiveTrajectory trajectory;
+  struct AtomCtx ctx;
+  struct OqsSchrodingerEqn eqn;
+  struct OqsDecayOperator decayOps[2];
+  void SetUp() {
+    ctx.omega = 1.0;
+    ctx.gamma = 0.0;
+    ctx.kappa = 0.0;
+    ASSERT_EQ(OQS_SUCCESS, oqsDiffusiveTrajectoryCreate(2, &trajectory));
+    ASSERT_EQ(OQS_SUCCESS,
+              oqsDiffusiveTrajectorySetScheme(trajectory, GetParam()));
+    eqn.RHS = &atomRHS;
+    eqn.ctx = &ctx;
+    oqsDiffusiveTrajectorySetSchrodingerEqn(trajectory, &eqn);
+    decayOps[0].apply = &atomDecay;
+    decayOps[0].ctx = &ctx;
+    decayOps[1].apply = &atomDephasing;
+    decayOps[1].ctx = &ctx;
+  }
+  void TearDown() { oqsDiffusiveTrajectoryDestroy(&trajectory); }
+
+  // Without decay operators the drift is the normalized evolution with the
+  // non-Hermitian H_eff.
+  void noClickEvolution(OqsDiffusiveTrajectory t, double dt,
+                        struct OqsAmplitude* y) {
+    struct OqsAmplitude x[2] = {{1.0, 0.0}, {0.0, 0.0}};
+    oqsDiffusiveTrajectorySetState(t, x);
+    oqsDiffusiveTrajectorySetTime(t, 0.0);
+    oqsDiffusiveTrajectoryTimeStepHint(t, dt);
+    oqsDiffusiveTrajectoryAdvance(t, 1.0);
+    y[0] = oqsDiffusiveTrajectoryGetState(t)[0];
+    y[1] = oqsDiffusiveTrajectoryGetState(t)[1];
+  }
+  double noClickError(double dt, const struct OqsAmplitude* reference) {
+    struct OqsAmplitude y[2];
+    noClickEvolution(trajectory, dt, y);
+    double error = 0;
+    for (int i = 0; i < 2; ++i) {
+      error += std::abs(y[i].re - reference[i].re) +
+               std::abs(y[i].im - reference[i].im);
+    }
+    return error;
+  }
+};
+
+TEST_P(Atom, DeterministicOrder) {
+  ctx.gamma = 0.5;
+  OqsDiffusiveTrajectory fine;
+  ASSERT_EQ(OQS_SUCCESS, oqsDiffusiveTrajectoryCreate(2, &fine));
+  oqsDiffusiveTrajectorySetScheme(fine, OQS_DIFFUSIVE_WEAK2);
+  oqsDiffusiveTrajectorySetSchrodingerEqn(fine, &eqn);
+  struct OqsAmplitude reference[2];
+  noClickEvolution(fine, 1.0e-4, reference);
+  oqsDiffusiveTrajectoryDestroy(&fine);
+  double coarseError = noClickError(0.02, reference);
+  double fineError = noClickError(0.01, reference);
+  EXPECT_DOUBLE_EQ(1.0, oqsDiffusiveTrajectoryGetTime(trajectory));
+  int order = GetParam() == OQS_DIFFUSIVE_WEAK2 ? 2 : 1;
+  EXPECT_NEAR(order, log2(coarseError / fineError), 0.2);
+}
+
+TEST_P(Atom, Normalized) {
+  ctx.gamma = 0.5;
+  ctx.kappa = 0.3;
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsDiffusiveTrajectorySetDecayOperators(trajectory, 2, decayOps));
+  struct OqsAmplitude x[2] = {{0.0, 0.0}, {3.0, 0.0}};
+  ASSERT_EQ(OQS_SUCCESS, oqsDiffusiveTrajectorySetState(trajectory, x));
+  const struct OqsAmplitude* y = oqsDiffusiveTrajectoryGetState(trajectory);
+  EXPECT_DOUBLE_EQ(1.0, y[1].re);
+  for (int i = 1; i <= 10; ++i) {
+    oqsDiffusiveTrajectoryAdvance(trajectory, 0.1 * i);
+    y = oqsDiffusiveTrajectoryGetState(trajectory);
+    EXPECT_NEAR(1.0,
+                y[0].re * y[0].re + y[0].im * y[0].im + y[1].re * y[1].re +
+                    y[1].im * y[1].im,
+                1.0e-12);
+  }
+}
+
+TEST_P(Atom, Reproducible) {
+  ctx.gamma = 0.5;
+  ctx.kappa = 0.3;
+  OqsDiffusiveTrajectory other;
+  ASSERT_EQ(OQS_SUCCESS, oqsDiffusiveTrajectoryCreate(2, &other));
+  oqsDiffusiveTrajectorySetScheme(other, GetParam());
+  oqsDiffusiveTrajectorySetSchrodingerEqn(other, &eqn);
+  oqsDiffusiveTrajectorySetDecayOperators(trajectory, 2, decayOps);
+  oqsDiffusiveTrajectorySetDecayOperators(other, 2, decayOps);
+  struct OqsAmplitude x[2] = {{0.6, 0.0}, {0.0, 0.8}};
+  oqsDiffusiveTrajectorySetState(trajectory, x);
+  oqsDiffusiveTrajectorySetState(other, x);
+  oqsDiffusiveTrajectorySeed(trajectory, 5, 3);
+  oqsDiffusiveTrajectorySeed(other, 5, 3);
+  oqsDiffusiveTrajectoryAdvance(trajectory, 1.0);
+  oqsDiffusiveTrajectoryAdvance(other, 1.0);
+  const struct OqsAmplitude* y = oqsDiffusiveTrajectoryGetState(trajectory);
+  const struct OqsAmplitude* z = oqsDiffusiveTrajectoryGetState(other);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(y[i].re, z[i].re);
+    EXPECT_EQ(y[i].im, z[i].im);
+  }
+  oqsDiffusiveTrajectorySetState(other, x);
+  oqsDiffusiveTrajectorySetTime(other, 0.0);
+  oqsDiffusiveTrajectorySeed(other, 5, 4);
+  oqsDiffusiveTrajectoryAdvance(other, 1.0);
+  EXPECT_NE(y[1].re, z[1].re);
+  oqsDiffusiveTrajectoryDestroy(&other);
+}
+
+// Dephasing doesn't affect the populations, so the excited state
+// population averaged over trajectories decays like exp(-gamma t).
+TEST_P(Atom, AverageDecay) {
+  ctx.omega = 0.0;
+  ctx.gamma = 1.0;
+  ctx.kappa = 0.3;
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsDiffusiveTrajectorySetDecayOperators(trajectory, 2, decayOps));
+  oqsDiffusiveTrajectoryTimeStepHint(trajectory, 0.01);
+  struct OqsObservable excited = {&excitedStateProjector, 0};
+  OqsAccumulator accumulator;
+  ASSERT_EQ(OQS_SUCCESS, oqsAccumulatorCreate(2, 1, &excited, 3, 0.0, 0.5,
+                                              &accumulator));
+  struct OqsAmplitude x[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  const int numTrajectories = 1000;
+  for (int i = 0; i < numTrajectories; ++i) {
+    oqsDiffusiveTrajectorySeed(trajectory, 17, i);
+    oqsDiffusiveTrajectorySetState(trajectory, x);
+    oqsDiffusiveTrajectorySetTime(trajectory, 0.0);
+    for (size_t j = 0; j < 3; ++j) {
+      oqsDiffusiveTrajectoryAdvance(trajectory,
+                                    oqsAccumulatorGetTime(accumulator, j));
+      oqsAccumulatorAddSample(accumulator, j,
+                              oqsDiffusiveTrajectoryGetState(trajectory));
+    }
+  }
+  for (size_t j = 0; j < 3; ++j) {
+    double t = oqsAccumulatorGetTime(accumulator, j);
+    double error = sqrt(oqsAccumulatorGetVariance(accumulator, 0, j) /
+                        numTrajectories);
+    EXPECT_NEAR(exp(-ctx.gamma * t), oqsAccumulatorGetMean(accumulator, 0, j),
+                4.0 * error + 0.01);
+  }
+  oqsAccumulatorDestroy(&accumulator);
+}
+
+INSTANTIATE_TEST_CASE_P(Schemes, Atom,
+                        ::testing::Values(OQS_DIFFUSIVE_EULER_MARUYAMA,
+                                          OQS_DIFFUSIVE_WEAK2));
+
+TEST(DiffusiveTrajectory, InvalidArguments) {
+  OqsDiffusiveTrajectory trajectory;
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsDiffusiveTrajectoryCreate(0, &trajectory));
+  ASSERT_EQ(OQS_SUCCESS, oqsDiffusiveTrajectoryCreate(3, &trajectory));
+  EXPECT_EQ(3u, oqsDiffusiveTrajectoryGetDim(trajectory));
+  struct OqsAmplitude zero[3] = {{0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}};
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsDiffusiveTrajectorySetState(trajectory, zero));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsDiffusiveTrajectorySetDecayOperators(trajectory, -1, 0));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsDiffusiveTrajectorySetScheme(trajectory,
+                                            (enum OqsDiffusiveScheme)7));
+  oqsDiffusiveTrajectoryDestroy(&trajectory);
+  EXPECT_TRUE(0 == trajectory);
+}
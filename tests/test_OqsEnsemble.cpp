@@ -0,0 +1,268 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsEnsemble.h>
+#include <OqsAllocator.h>
+#include <OqsConfig.h>
+#include <cmath>
+#include <vector>
+
+static double normSquared(const struct OqsAmplitude* v, int n) {
+  double result = 0;
+  for (int i = 0; i < n; ++i) {
+    result += v[i].re * v[i].re + v[i].im * v[i].im;
+  }
+  return result;
+}
+
+static const size_t numTrajectories = 500;
+
+class Ensemble : public ::testing::Test {
+  public:
+    OqsEnsemble ensemble;
+    void SetUp() {
+      OQS_STATUS stat = oqsEnsembleCreate(2, numTrajectories, &ensemble);
+      ASSERT_EQ(OQS_SUCCESS, stat);
+    }
+    void TearDown() {
+      oqsEnsembleDestroy(&ensemble);
+    }
+};
+
+TEST_F(Ensemble, Create) {
+  EXPECT_TRUE(0 != ensemble);
+  EXPECT_EQ(2u, oqsEnsembleGetDim(ensemble));
+  EXPECT_EQ(numTrajectories, oqsEnsembleGetNumTrajectories(ensemble));
+}
+
+TEST_F(Ensemble, Reset) {
+  struct OqsAmplitude initialState[2] = {{1.0, 2.0}, {3.0, 4.0}};
+  oqsEnsembleReset(ensemble, initialState, 0.7);
+  EXPECT_FLOAT_EQ(0.7, oqsEnsembleGetTime(ensemble));
+  for (size_t i = 0; i < numTrajectories; ++i) {
+    struct OqsAmplitude* s = oqsEnsembleGetState(ensemble, i);
+    EXPECT_FLOAT_EQ(initialState[0].re, s[0].re);
+    EXPECT_FLOAT_EQ(initialState[1].im, s[1].im);
+  }
+  EXPECT_EQ(oqsEnsembleGetState(ensemble, 3),
+            oqsEnsembleGetStates(ensemble) + 6);
+}
+
+struct BatchCtx {
+  double omega;
+  double gamma;
+  int numCalls;
+};
+
+static void batchedRHS(double t, size_t n, const struct OqsAmplitude* x,
+                       struct OqsAmplitude* y, void* ctx) {
+  struct BatchCtx* c = (struct BatchCtx*)ctx;
+  ++c->numCalls;
+  for (size_t i = 0; i < n; ++i) {
+    const struct OqsAmplitude* xi = x + 2 * i;
+    struct OqsAmplitude* yi = y + 2 * i;
+    yi[0].re = 0.5 * c->omega * xi[1].im;
+    yi[0].im = -0.5 * c->omega * xi[1].re;
+    yi[1].re = 0.5 * c->omega * xi[0].im - 0.5 * c->gamma * xi[1].re;
+    yi[1].im = -0.5 * c->omega * xi[0].re - 0.5 * c->gamma * xi[1].im;
+  }
+}
+
+struct EToGCtx {
+  double gamma;
+};
+
+static void excitedToGroundDecay(const struct OqsAmplitude* x,
+                                 struct OqsAmplitude* y, void* ctx) {
+  struct EToGCtx* c = (struct EToGCtx*)ctx;
+  double sgamma = sqrt(c->gamma);
+  y[0].re = sgamma * x[1].re;
+  y[0].im = sgamma * x[1].im;
+  y[1].re = 0;
+  y[1].im = 0;
+}
+
+TEST_F(Ensemble, RabiOscillations) {
+  struct BatchCtx ctx = {1.0, 0.0, 0};
+  struct OqsEnsembleSchrodingerEqn eqn = {&batchedRHS, &ctx};
+  oqsEnsembleSetSchrodingerEqn(ensemble, &eqn);
+  struct OqsAmplitude initialState[2] = {{1.0, 0.0}, {0.0, 0.0}};
+  oqsEnsembleReset(ensemble, initialState, 0);
+  double t = 0.3;
+  size_t numJumps = oqsEnsembleAdvance(ensemble, t);
+  EXPECT_EQ(0u, numJumps);
+  EXPECT_FLOAT_EQ(t, oqsEnsembleGetTime(ensemble));
+  double c = cos(0.5 * ctx.omega * t);
+  for (size_t i = 0; i < numTrajectories; ++i) {
+    struct OqsAmplitude* s = oqsEnsembleGetState(ensemble, i);
+    EXPECT_FLOAT_EQ(c * c, s[0].re * s[0].re);
+  }
+  // One batched evaluation per stage for all trajectories.
+  EXPECT_EQ(4 * 300, ctx.numCalls);
+}
+
+TEST_F(Ensemble, ExcitedStateDecay) {
+  struct BatchCtx ctx = {0.0, 1.0, 0};
+  struct OqsEnsembleSchrodingerEqn eqn = {&batchedRHS, &ctx};
+  oqsEnsembleSetSchrodingerEqn(ensemble, &eqn);
+  struct EToGCtx decayCtx = {1.0};
+  struct OqsDecayOperator decay = {&excitedToGroundDecay, &decayCtx};
+  oqsEnsembleSetDecayOperators(ensemble, 1, &decay);
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  oqsEnsembleReset(ensemble, initialState, 0);
+  double t = 0.7;
+  size_t numJumps = oqsEnsembleAdvance(ensemble, t);
+  size_t numDecayed = 0;
+  for (size_t i = 0; i < numTrajectories; ++i) {
+    struct OqsAmplitude* s = oqsEnsembleGetState(ensemble, i);
+    if (s[1].re == 0) {
+      ++numDecayed;
+      EXPECT_FLOAT_EQ(1.0, normSquared(s, 2));
+    } else {
+      EXPECT_NEAR(exp(-ctx.gamma * t), normSquared(s, 2), 1.0e-9);
+    }
+  }
+  EXPECT_EQ(numDecayed, numJumps);
+  double p = 1.0 - exp(-ctx.gamma * t);
+  double sigma = sqrt(numTrajectories * p * (1.0 - p));
+  EXPECT_NEAR(p * numTrajectories, numDecayed, 5.0 * sigma);
+}
+
+TEST_F(Ensemble, Seed) {
+  struct BatchCtx ctx = {1.0, 1.0, 0};
+  struct OqsEnsembleSchrodingerEqn eqn = {&batchedRHS, &ctx};
+  oqsEnsembleSetSchrodingerEqn(ensemble, &eqn);
+  struct EToGCtx decayCtx = {1.0};
+  struct OqsDecayOperator decay = {&excitedToGroundDecay, &decayCtx};
+  oqsEnsembleSetDecayOperators(ensemble, 1, &decay);
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+
+  oqsEnsembleSeed(ensemble, 3, 0);
+  oqsEnsembleReset(ensemble, initialState, 0);
+  oqsEnsembleAdvance(ensemble, 2.0);
+  std::vector<OqsAmplitude> states(oqsEnsembleGetStates(ensemble),
+                                   oqsEnsembleGetStates(ensemble) +
+                                       2 * numTrajectories);
+
+  oqsEnsembleSeed(ensemble, 3, 0);
+  oqsEnsembleReset(ensemble, initialState, 0);
+  oqsEnsembleAdvance(ensemble, 2.0);
+  struct OqsAmplitude* replayed = oqsEnsembleGetStates(ensemble);
+  for (size_t i = 0; i < 2 * numTrajectories; ++i) {
+    EXPECT_EQ(states[i].re, replayed[i].re);
+    EXPECT_EQ(states[i].im, replayed[i].im);
+  }
+}
+
+TEST_F(Ensemble, Stats) {
+  struct BatchCtx ctx = {0.0, 1.0, 0};
+  struct OqsEnsembleSchrodingerEqn eqn = {&batchedRHS, &ctx};
+  oqsEnsembleSetSchrodingerEqn(ensemble, &eqn);
+  struct EToGCtx decayCtx = {1.0};
+  struct OqsDecayOperator decay = {&excitedToGroundDecay, &decayCtx};
+  oqsEnsembleSetDecayOperators(ensemble, 1, &decay);
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  oqsEnsembleReset(ensemble, initialState, 0);
+  oqsEnsembleEnableTimers(ensemble, 1);
+  size_t numJumps = oqsEnsembleAdvance(ensemble, 0.7);
+  struct OqsTrajectoryStats stats;
+  oqsEnsembleGetStats(ensemble, &stats);
+#ifdef OQS_ENABLE_STATS
+  EXPECT_EQ(numJumps, stats.jumps);
+  EXPECT_GE(stats.steps, 700 * numTrajectories);
+  EXPECT_EQ(4 * stats.steps, stats.rhsCalls);
+  EXPECT_GE(stats.backtracks, numJumps);
+  EXPECT_GT(stats.rootIterations, 0u);
+  EXPECT_GE(stats.advanceSeconds, stats.rhsSeconds);
+#else
+  (void)numJumps;
+  EXPECT_EQ(0u, stats.jumps);
+  EXPECT_EQ(0u, stats.rhsCalls);
+#endif
+  oqsEnsembleResetStats(ensemble);
+  oqsEnsembleGetStats(ensemble, &stats);
+  EXPECT_EQ(0u, stats.steps);
+  EXPECT_EQ(0u, stats.jumps);
+}
+
+TEST_F(Ensemble, Checkpoint) {
+  struct BatchCtx ctx = {1.0, 1.0, 0};
+  struct OqsEnsembleSchrodingerEqn eqn = {&batchedRHS, &ctx};
+  oqsEnsembleSetSchrodingerEqn(ensemble, &eqn);
+  struct EToGCtx decayCtx = {1.0};
+  struct OqsDecayOperator decay = {&excitedToGroundDecay, &decayCtx};
+  oqsEnsembleSetDecayOperators(ensemble, 1, &decay);
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  std::string path = ::testing::TempDir() + "oqs_ensemble.ckpt";
+
+  oqsEnsembleSeed(ensemble, 3, 0);
+  oqsEnsembleReset(ensemble, initialState, 0);
+  oqsEnsembleAdvance(ensemble, 0.5);
+  ASSERT_EQ(OQS_SUCCESS, oqsEnsembleSave(ensemble, path.c_str()));
+  oqsEnsembleAdvance(ensemble, 2.0);
+  std::vector<OqsAmplitude> states(oqsEnsembleGetStates(ensemble),
+                                   oqsEnsembleGetStates(ensemble) +
+                                       2 * numTrajectories);
+
+  OqsEnsemble restarted;
+  ASSERT_EQ(OQS_SUCCESS, oqsEnsembleCreate(2, numTrajectories, &restarted));
+  oqsEnsembleSetSchrodingerEqn(restarted, &eqn);
+  oqsEnsembleSetDecayOperators(restarted, 1, &decay);
+  ASSERT_EQ(OQS_SUCCESS, oqsEnsembleLoad(restarted, path.c_str()));
+  EXPECT_EQ(0.5, oqsEnsembleGetTime(restarted));
+  oqsEnsembleAdvance(restarted, 2.0);
+  struct OqsAmplitude* resumed = oqsEnsembleGetStates(restarted);
+  for (size_t i = 0; i < 2 * numTrajectories; ++i) {
+    EXPECT_EQ(states[i].re, resumed[i].re);
+    EXPECT_EQ(states[i].im, resumed[i].im);
+  }
+  oqsEnsembleDestroy(&restarted);
+
+  ASSERT_EQ(OQS_SUCCESS, oqsEnsembleCreate(2, numTrajectories + 1,
+                                           &restarted));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsEnsembleLoad(restarted, path.c_str()));
+  oqsEnsembleDestroy(&restarted);
+  remove(path.c_str());
+}
+
+static void* countingAllocate(size_t size, size_t alignment, void* ctx) {
+  void* p = 0;
+  if (posix_memalign(&p, alignment, size) != 0) return 0;
+  ++*static_cast<int*>(ctx);
+  return p;
+}
+
+static void countingDeallocate(void* p, size_t size, void* ctx) {
+  --*static_cast<int*>(ctx);
+  free(p);
+}
+
+TEST(EnsembleAllocator, OneArena) {
+  int numLive = 0;
+  struct OqsAllocator allocator = {&countingAllocate, &countingDeallocate,
+                                   &numLive};
+  oqsSetAllocator(&allocator);
+  OqsEnsemble ensemble;
+  ASSERT_EQ(OQS_SUCCESS, oqsEnsembleCreate(3, 10, &ensemble));
+  // Including the scratch trajectory and the integrator.
+  EXPECT_EQ(1, numLive);
+  oqsEnsembleDestroy(&ensemble);
+  EXPECT_EQ(0, numLive);
+  oqsSetAllocator(0);
+}
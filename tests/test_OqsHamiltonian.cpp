@@ -0,0 +1,269 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsHamiltonian.h>
+#include <cmath>
+#include <vector>
+
+struct CountingCoefficient {
+  double omega;
+  int numCalls;
+};
+
+static double cosine(double t, void* ctx) {
+  struct CountingCoefficient* c = (struct CountingCoefficient*)ctx;
+  ++c->numCalls;
+  return cos(c->omega * t);
+}
+
+// Two level atom with H_0 = -i gamma / 2 |1><1| and H_1 = 1 / 2 sigma_x with
+// coefficient cos(omega t).
+class Hamiltonian : public ::testing::Test {
+ public:
+  OqsHamiltonian hamiltonian;
+  struct CountingCoefficient drive;
+  double gamma;
+  void SetUp() {
+    gamma = 0.4;
+    drive.omega = 1.0;
+    drive.numCalls = 0;
+    ASSERT_EQ(OQS_SUCCESS, oqsHamiltonianCreate(2, &hamiltonian));
+    size_t decayRow = 1;
+    struct OqsAmplitude decayValue = {0.0, -0.5 * gamma};
+    ASSERT_EQ(OQS_SUCCESS, oqsHamiltonianAddTerm(hamiltonian, 0, 1, &decayRow,
+                                                 &decayRow, &decayValue));
+    struct OqsCoefficient f = {&cosine, &drive};
+    size_t rows[] = {0, 1};
+    size_t cols[] = {1, 0};
+    struct OqsAmplitude values[] = {{0.5, 0.0}, {0.5, 0.0}};
+    ASSERT_EQ(OQS_SUCCESS,
+              oqsHamiltonianAddTerm(hamiltonian, &f, 2, rows, cols, values));
+  }
+  void TearDown() { oqsHamiltonianDestroy(&hamiltonian); }
+  void expectedRHS(double t, const struct OqsAmplitude* x,
+                   struct OqsAmplitude* y) {
+    double a = 0.5 * cos(drive.omega * t);
+    y[0].re = a * x[1].im;
+    y[0].im = -a * x[1].re;
+    y[1].re = a * x[0].im - 0.5 * gamma * x[1].re;
+    y[1].im = -a * x[0].re - 0.5 * gamma * x[1].im;
+  }
+};
+
+TEST_F(Hamiltonian, Accessors) {
+  EXPECT_EQ(2u, oqsHamiltonianGetDim(hamiltonian));
+  EXPECT_EQ(1, oqsHamiltonianGetNumTerms(hamiltonian));
+}
+
+TEST_F(Hamiltonian, Interleaved) {
+  struct OqsSchrodingerEqn eqn;
+  oqsHamiltonianGetSchrodingerEqn(hamiltonian, OQS_LAYOUT_INTERLEAVED, &eqn);
+  struct OqsAmplitude x[2] = {{0.3, -0.2}, {0.7, 0.4}};
+  struct OqsAmplitude y[2], expected[2];
+  eqn.RHS(0.8, x, y, eqn.ctx);
+  EXPECT_EQ(1, drive.numCalls);
+  expectedRHS(0.8, x, expected);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i].re, y[i].re);
+    EXPECT_DOUBLE_EQ(expected[i].im, y[i].im);
+  }
+}
+
+TEST_F(Hamiltonian, Split) {
+  struct OqsSchrodingerEqn eqn;
+  oqsHamiltonianGetSchrodingerEqn(hamiltonian, OQS_LAYOUT_SPLIT, &eqn);
+  struct OqsAmplitude x[2] = {{0.3, -0.2}, {0.7, 0.4}};
+  struct OqsAmplitude expected[2];
+  expectedRHS(0.8, x, expected);
+  size_t stride = OQS_SPLIT_STRIDE(2);
+  std::vector<double> xs(2 * stride, 0.0), ys(2 * stride, -1.0);
+  for (int i = 0; i < 2; ++i) {
+    xs[i] = x[i].re;
+    xs[stride + i] = x[i].im;
+  }
+  eqn.RHS(0.8, (struct OqsAmplitude*)&xs[0], (struct OqsAmplitude*)&ys[0],
+          eqn.ctx);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i].re, ys[i]);
+    EXPECT_DOUBLE_EQ(expected[i].im, ys[stride + i]);
+  }
+  // The padding isn't written.
+  for (size_t i = 2; i < stride; ++i) {
+    EXPECT_EQ(-1.0, ys[i]);
+    EXPECT_EQ(-1.0, ys[stride + i]);
+  }
+}
+
+TEST_F(Hamiltonian, EnsembleEvaluatesCoefficientsOnce) {
+  struct OqsEnsembleSchrodingerEqn eqn;
+  oqsHamiltonianGetEnsembleSchrodingerEqn(hamiltonian, &eqn);
+  const size_t n = 5;
+  std::vector<OqsAmplitude> x(2 * n), y(2 * n);
+  for (size_t i = 0; i < 2 * n; ++i) {
+    x[i].re = cos(1.0 + i);
+    x[i].im = sin(2.0 * i);
+  }
+  eqn.RHS(1.3, n, &x[0], &y[0], eqn.ctx);
+  EXPECT_EQ(1, drive.numCalls);
+  struct OqsAmplitude expected[2];
+  for (size_t j = 0; j < n; ++j) {
+    expectedRHS(1.3, &x[2 * j], expected);
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_DOUBLE_EQ(expected[i].re, y[2 * j + i].re);
+      EXPECT_DOUBLE_EQ(expected[i].im, y[2 * j + i].im);
+    }
+  }
+}
+
+TEST_F(Hamiltonian, RepeatedEntriesAreSummed) {
+  // The static decay entry and the drive, each split into two halves.
+  oqsHamiltonianDestroy(&hamiltonian);
+  ASSERT_EQ(OQS_SUCCESS, oqsHamiltonianCreate(2, &hamiltonian));
+  size_t decayRows[] = {1, 1};
+  struct OqsAmplitude decayValues[] = {{0.0, -0.25 * gamma},
+                                       {0.0, -0.25 * gamma}};
+  ASSERT_EQ(OQS_SUCCESS, oqsHamiltonianAddTerm(hamiltonian, 0, 2, decayRows,
+                                               decayRows, decayValues));
+  struct OqsCoefficient f = {&cosine, &drive};
+  size_t rows[] = {0, 1, 0, 1};
+  size_t cols[] = {1, 0, 1, 0};
+  struct OqsAmplitude values[] = {
+      {0.25, 0.0}, {0.25, 0.0}, {0.25, 0.0}, {0.25, 0.0}};
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsHamiltonianAddTerm(hamiltonian, &f, 4, rows, cols, values));
+  struct OqsSchrodingerEqn eqn;
+  oqsHamiltonianGetSchrodingerEqn(hamiltonian, OQS_LAYOUT_INTERLEAVED, &eqn);
+  struct OqsAmplitude x[2] = {{0.3, -0.2}, {0.7, 0.4}};
+  struct OqsAmplitude y[2], expected[2];
+  eqn.RHS(0.8, x, y, eqn.ctx);
+  expectedRHS(0.8, x, expected);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_DOUBLE_EQ(expected[i].re, y[i].re);
+    EXPECT_DOUBLE_EQ(expected[i].im, y[i].im);
+  }
+}
+
+TEST_F(Hamiltonian, InvalidEntry) {
+  size_t row = 2, col = 0;
+  struct OqsAmplitude value = {1.0, 0.0};
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsHamiltonianAddTerm(hamiltonian, 0, 1, &row, &col, &value));
+  OqsHamiltonian empty;
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsHamiltonianCreate(0, &empty));
+}
+
+TEST_F(Hamiltonian, TooManyTerms) {
+  struct OqsCoefficient f = {&cosine, &drive};
+  size_t row = 0;
+  struct OqsAmplitude value = {1.0, 0.0};
+  while (oqsHamiltonianGetNumTerms(hamiltonian) < OQS_HAMILTONIAN_MAX_TERMS) {
+    ASSERT_EQ(OQS_SUCCESS,
+              oqsHamiltonianAddTerm(hamiltonian, &f, 1, &row, &row, &value));
+  }
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsHamiltonianAddTerm(hamiltonian, &f, 1, &row, &row, &value));
+  EXPECT_EQ(OQS_HAMILTONIAN_MAX_TERMS, oqsHamiltonianGetNumTerms(hamiltonian));
+  EXPECT_EQ(OQS_SUCCESS,
+            oqsHamiltonianAddTerm(hamiltonian, 0, 1, &row, &row, &value));
+}
+
+static double constantCoefficient(double t, void* ctx) {
+  return *static_cast<double*>(ctx);
+}
+
+// Dense terms added in reverse column order with every entry repeated.
+TEST(DenseHamiltonian, AgreesWithDenseProduct) {
+  const size_t dim = 40;
+  OqsHamiltonian hamiltonian;
+  ASSERT_EQ(OQS_SUCCESS, oqsHamiltonianCreate(dim, &hamiltonian));
+  double a[3] = {1.0, 0.5, -2.0};
+  std::vector<struct OqsAmplitude> dense(dim * dim);
+  for (int k = 0; k < 3; ++k) {
+    std::vector<size_t> rows, cols;
+    std::vector<struct OqsAmplitude> values;
+    for (int repeat = 0; repeat < 2; ++repeat) {
+      for (size_t i = 0; i < dim; ++i) {
+        for (size_t j = dim; j-- > 0;) {
+          struct OqsAmplitude v = {0.01 * (i + 2 * j + k),
+                                   0.02 * (3.0 * i - j)};
+          rows.push_back(i);
+          cols.push_back(j);
+          values.push_back(v);
+          dense[i * dim + j].re += a[k] * v.re;
+          dense[i * dim + j].im += a[k] * v.im;
+        }
+      }
+    }
+    struct OqsCoefficient f = {&constantCoefficient, &a[k]};
+    ASSERT_EQ(OQS_SUCCESS,
+              oqsHamiltonianAddTerm(hamiltonian, k == 0 ? 0 : &f,
+                                    values.size(), &rows[0], &cols[0],
+                                    &values[0]));
+  }
+  std::vector<struct OqsAmplitude> x(dim), y(dim);
+  for (size_t i = 0; i < dim; ++i) {
+    x[i].re = sin(1.0 + i);
+    x[i].im = cos(2.0 * i);
+  }
+  struct OqsSchrodingerEqn eqn;
+  oqsHamiltonianGetSchrodingerEqn(hamiltonian, OQS_LAYOUT_INTERLEAVED, &eqn);
+  eqn.RHS(0.0, &x[0], &y[0], eqn.ctx);
+  for (size_t i = 0; i < dim; ++i) {
+    double re = 0, im = 0;
+    for (size_t j = 0; j < dim; ++j) {
+      const struct OqsAmplitude& h = dense[i * dim + j];
+      re += h.re * x[j].re - h.im * x[j].im;
+      im += h.re * x[j].im + h.im * x[j].re;
+    }
+    EXPECT_NEAR(im, y[i].re, 1.0e-10);
+    EXPECT_NEAR(-re, y[i].im, 1.0e-10);
+  }
+  oqsHamiltonianDestroy(&hamiltonian);
+}
+
+// Drives a trajectory without decay operators with H = cos(t) / 2 sigma_x,
+// which rotates |0> by the angle sin(t) / 2.
+TEST(HamiltonianTrajectory, Rabi) {
+  OqsHamiltonian hamiltonian;
+  ASSERT_EQ(OQS_SUCCESS, oqsHamiltonianCreate(2, &hamiltonian));
+  struct CountingCoefficient drive = {1.0, 0};
+  struct OqsCoefficient f = {&cosine, &drive};
+  size_t rows[] = {0, 1};
+  size_t cols[] = {1, 0};
+  struct OqsAmplitude values[] = {{0.5, 0.0}, {0.5, 0.0}};
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsHamiltonianAddTerm(hamiltonian, &f, 2, rows, cols, values));
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(2, &trajectory));
+  struct OqsSchrodingerEqn eqn;
+  oqsHamiltonianGetSchrodingerEqn(hamiltonian, OQS_LAYOUT_INTERLEAVED, &eqn);
+  oqsJumpTrajectorySetSchrodingerEqn(trajectory, &eqn);
+  oqsJumpTrajectoryTimeStepHint(trajectory, 1.0e-2);
+  struct OqsAmplitude x[2] = {{1.0, 0.0}, {0.0, 0.0}};
+  oqsJumpTrajectorySetState(trajectory, x);
+  oqsJumpTrajectoryAdvance(trajectory, 2.0);
+  const struct OqsAmplitude* y = oqsJumpTrajectoryGetState(trajectory);
+  double theta = 0.5 * sin(oqsJumpTrajectoryGetTime(trajectory));
+  EXPECT_NEAR(cos(theta), y[0].re, 1.0e-8);
+  EXPECT_NEAR(0.0, y[0].im, 1.0e-8);
+  EXPECT_NEAR(0.0, y[1].re, 1.0e-8);
+  EXPECT_NEAR(-sin(theta), y[1].im, 1.0e-8);
+  oqsJumpTrajectoryDestroy(&trajectory);
+  oqsHamiltonianDestroy(&hamiltonian);
+}
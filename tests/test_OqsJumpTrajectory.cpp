@@ -18,6 +18,8 @@ with oqs.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <gtest/gtest.h>
 #include <OqsJumpTrajectory.h>
+#include <OqsAllocator.h>
+#include <OqsConfig.h>
 #include <cmath>
 
 static double normSquared(const struct OqsAmplitude* a) {
@@ -101,6 +103,38 @@ TEST_F(JumpTrajectory, Reset) {
   EXPECT_NE(oldZ, newZ);
 }
 
+TEST_F(JumpTrajectory, Seed) {
+  oqsJumpTrajectorySeed(trajectory, 13, 2);
+  double z = oqsJumpTrajectoryGetNextDecayNorm(trajectory);
+  oqsJumpTrajectorySeed(trajectory, 13, 3);
+  EXPECT_NE(z, oqsJumpTrajectoryGetNextDecayNorm(trajectory));
+  oqsJumpTrajectorySeed(trajectory, 13, 2);
+  EXPECT_EQ(z, oqsJumpTrajectoryGetNextDecayNorm(trajectory));
+}
+
+TEST_F(JumpTrajectory, DefaultStreamsDiffer) {
+  OqsJumpTrajectory other;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(2, &other));
+  EXPECT_NE(oqsJumpTrajectoryGetNextDecayNorm(trajectory),
+            oqsJumpTrajectoryGetNextDecayNorm(other));
+  oqsJumpTrajectoryDestroy(&other);
+}
+
+static double constantUniform(void* ctx) {
+  return *(double*)ctx;
+}
+
+TEST_F(JumpTrajectory, SetRng) {
+  double u = 0.25;
+  struct OqsRng rng = {&constantUniform, &u};
+  oqsJumpTrajectorySetRng(trajectory, &rng);
+  struct OqsAmplitude initialState[2] = {{1.0, 0.0}, {0.0, 0.0}};
+  oqsJumpTrajectoryReset(trajectory, initialState, 0.0);
+  EXPECT_EQ(u, oqsJumpTrajectoryGetNextDecayNorm(trajectory));
+  oqsJumpTrajectorySetRng(trajectory, 0);
+  oqsJumpTrajectoryReset(trajectory, initialState, 0.0);
+  EXPECT_NE(u, oqsJumpTrajectoryGetNextDecayNorm(trajectory));
+}
 
 TEST_F(JumpTrajectory, SetDecayTimeTolerance) {
   double dt = 1.0e-12;
@@ -214,6 +248,52 @@ TEST_F(ExcitedStateDecay, IntegrateToDecay) {
   EXPECT_LE(std::abs(oqsJumpTrajectoryGetTime(trajectory) - decayTime), 1.0e-6);
 }
 
+TEST_F(ExcitedStateDecay, IntegrateToDecayDopri5) {
+  OQS_STATUS stat =
+      oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_DOPRI5);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  oqsJumpTrajectorySetTolerances(trajectory, 1.0e-10, 1.0e-10);
+  double z = oqsJumpTrajectoryGetNextDecayNorm(trajectory);
+  double decayTime = -log(z) / gamma;
+  int decayOccurred = oqsJumpTrajectoryAdvance(trajectory, 1.2 * decayTime);
+  ASSERT_NE(0, decayOccurred);
+  EXPECT_LE(std::abs(oqsJumpTrajectoryGetTime(trajectory) - decayTime), 1.0e-6);
+}
+
+TEST_F(RabiOscillations, PopulationOscillationsDopri5) {
+  oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_DOPRI5);
+  oqsJumpTrajectorySetTolerances(trajectory, 1.0e-10, 1.0e-10);
+  double t = 2.3;
+  oqsJumpTrajectoryAdvance(trajectory, t);
+  EXPECT_FLOAT_EQ(t, oqsJumpTrajectoryGetTime(trajectory));
+  struct OqsAmplitude* finalState = oqsJumpTrajectoryGetState(trajectory);
+  double c = cos(0.5 * omega * t);
+  EXPECT_NEAR(c * c, normSquared(finalState + 0), 1.0e-8);
+}
+
+TEST_F(ExcitedStateDecay, IntegrateToDecayKrylov) {
+  OQS_STATUS stat =
+      oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_KRYLOV);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  oqsJumpTrajectorySetTolerances(trajectory, 1.0e-10, 1.0e-10);
+  double z = oqsJumpTrajectoryGetNextDecayNorm(trajectory);
+  double decayTime = -log(z) / gamma;
+  int decayOccurred = oqsJumpTrajectoryAdvance(trajectory, 1.2 * decayTime);
+  ASSERT_NE(0, decayOccurred);
+  EXPECT_LE(std::abs(oqsJumpTrajectoryGetTime(trajectory) - decayTime), 1.0e-6);
+}
+
+TEST_F(RabiOscillations, PopulationOscillationsKrylov) {
+  oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_KRYLOV);
+  oqsJumpTrajectorySetTolerances(trajectory, 1.0e-10, 1.0e-10);
+  double t = 2.3;
+  oqsJumpTrajectoryAdvance(trajectory, t);
+  EXPECT_FLOAT_EQ(t, oqsJumpTrajectoryGetTime(trajectory));
+  struct OqsAmplitude* finalState = oqsJumpTrajectoryGetState(trajectory);
+  double c = cos(0.5 * omega * t);
+  EXPECT_NEAR(c * c, normSquared(finalState + 0), 1.0e-8);
+}
+
 struct EToGCtx {
   int dim;
   double gamma;
@@ -271,3 +351,735 @@ TEST_F(ExcitedStateDecay, NextDecayNormReset) {
   double postDecayNrm = oqsJumpTrajectoryGetNextDecayNorm(trajectory);
   EXPECT_NE(preDecayNrm, postDecayNrm);
 }
+
+TEST_F(ExcitedStateDecay, IntegrateToDecayWtd) {
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryEnableWtd(trajectory, 0.02, 100, 2));
+  // Decays inside and beyond the end of the table
+  double norms[] = {0.3, 0.05};
+  for (double z : norms) {
+    oqsJumpTrajectoryReset(trajectory, &initialState[0], 0.0);
+    oqsJumpTrajectorySetNextDecayNorm(trajectory, z);
+    double decayTime = -log(z) / gamma;
+    int decayOccurred =
+        oqsJumpTrajectoryAdvanceWtd(trajectory, 1.2 * decayTime);
+    ASSERT_NE(0, decayOccurred);
+    EXPECT_LE(std::abs(oqsJumpTrajectoryGetTime(trajectory) - decayTime),
+              1.0e-6);
+  }
+}
+
+TEST_F(ExcitedStateDecay, SubnormalizedStateDecaysRightAway) {
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryEnableWtd(trajectory, 0.02, 100, 2));
+  // Tabulate the normalized state first so that the subnormalized state
+  // shares its table.
+  oqsJumpTrajectoryReset(trajectory, &initialState[0], 0.0);
+  oqsJumpTrajectorySetNextDecayNorm(trajectory, 0.01);
+  ASSERT_EQ(0, oqsJumpTrajectoryAdvanceWtd(trajectory, 0.5));
+  struct OqsAmplitude subnormalized[2] = {{0, 0}, {0.5, 0}};
+  for (int wtd = 0; wtd < 2; ++wtd) {
+    oqsJumpTrajectoryReset(trajectory, subnormalized, 1.0);
+    oqsJumpTrajectorySetNextDecayNorm(trajectory, 0.5);
+    int decayOccurred =
+        wtd ? oqsJumpTrajectoryAdvanceWtd(trajectory, 2.0)
+            : oqsJumpTrajectoryAdvance(trajectory, 2.0);
+    ASSERT_NE(0, decayOccurred);
+    EXPECT_EQ(1.0, oqsJumpTrajectoryGetTime(trajectory));
+    struct OqsAmplitude* state = oqsJumpTrajectoryGetState(trajectory);
+    EXPECT_EQ(0.5, state[1].re);
+    EXPECT_EQ(0.0, state[1].im);
+  }
+}
+
+struct CountingRabiCtx {
+  double omega;
+  int numCalls;
+};
+
+static void countingRabiRHS(double t, const struct OqsAmplitude* x,
+                            struct OqsAmplitude* y, void* ctx) {
+  struct CountingRabiCtx* c = (struct CountingRabiCtx*)ctx;
+  ++c->numCalls;
+  RabiOscillationsRHS(t, x, y, &c->omega);
+}
+
+TEST_F(RabiOscillations, AdvanceWtd) {
+  struct CountingRabiCtx ctx = {omega, 0};
+  eqn.RHS = &countingRabiRHS;
+  eqn.ctx = &ctx;
+  oqsJumpTrajectorySetSchrodingerEqn(trajectory, &eqn);
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryEnableWtd(trajectory, 0.1, 50, 1));
+  for (int i = 1; i <= 10; ++i) {
+    double t = 0.37 * i;
+    EXPECT_EQ(0, oqsJumpTrajectoryAdvanceWtd(trajectory, t));
+    EXPECT_FLOAT_EQ(t, oqsJumpTrajectoryGetTime(trajectory));
+    struct OqsAmplitude* state = oqsJumpTrajectoryGetState(trajectory);
+    double c = cos(0.5 * omega * t);
+    EXPECT_NEAR(c * c, normSquared(state + 0), 1.0e-8);
+  }
+
+  // A state that differs by a phase reuses the table and needs at most
+  // one grid interval of integration.
+  std::vector<OqsAmplitude> expected(oqsJumpTrajectoryGetState(trajectory),
+                                     oqsJumpTrajectoryGetState(trajectory) + 2);
+  std::vector<OqsAmplitude> rotated(2);
+  for (int i = 0; i < 2; ++i) {
+    rotated[i].re = -initialState[i].im;
+    rotated[i].im = initialState[i].re;
+  }
+  oqsJumpTrajectoryReset(trajectory, &rotated[0], 0.0);
+  oqsJumpTrajectorySetNextDecayNorm(trajectory, 0.0);
+  ctx.numCalls = 0;
+  oqsJumpTrajectoryAdvanceWtd(trajectory, 3.7);
+  EXPECT_GE(400, ctx.numCalls);
+  struct OqsAmplitude* state = oqsJumpTrajectoryGetState(trajectory);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_NEAR(-expected[i].im, state[i].re, 1.0e-12);
+    EXPECT_NEAR(expected[i].re, state[i].im, 1.0e-12);
+  }
+}
+
+TEST_F(RabiOscillations, Stats) {
+  struct CountingRabiCtx ctx = {omega, 0};
+  eqn.RHS = &countingRabiRHS;
+  eqn.ctx = &ctx;
+  oqsJumpTrajectorySetSchrodingerEqn(trajectory, &eqn);
+  oqsJumpTrajectoryEnableTimers(trajectory, 1);
+  oqsJumpTrajectoryAdvance(trajectory, 0.25);
+  struct OqsTrajectoryStats stats;
+  oqsJumpTrajectoryGetStats(trajectory, &stats);
+#ifdef OQS_ENABLE_STATS
+  EXPECT_EQ((uint64_t)ctx.numCalls, stats.rhsCalls);
+  EXPECT_EQ(stats.rhsCalls, 4 * stats.steps);
+  EXPECT_LE(stats.backtracks, 1u);
+  EXPECT_EQ(0u, stats.jumps);
+  EXPECT_GE(stats.advanceSeconds, stats.rhsSeconds);
+  EXPECT_GT(stats.advanceSeconds, 0.0);
+#else
+  EXPECT_EQ(0u, stats.steps);
+  EXPECT_EQ(0u, stats.rhsCalls);
+  EXPECT_EQ(0.0, stats.advanceSeconds);
+#endif
+  oqsJumpTrajectoryResetStats(trajectory);
+  oqsJumpTrajectoryGetStats(trajectory, &stats);
+  EXPECT_EQ(0u, stats.steps);
+  EXPECT_EQ(0u, stats.rhsCalls);
+  EXPECT_EQ(0.0, stats.rhsSeconds);
+}
+
+TEST_F(RabiOscillations, ResetRepeatsRun) {
+  oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_DOPRI5);
+  oqsJumpTrajectorySetTolerances(trajectory, 1.0e-10, 1.0e-10);
+  oqsJumpTrajectorySeed(trajectory, 5, 0);
+  oqsJumpTrajectoryReset(trajectory, &initialState[0], 0);
+  oqsJumpTrajectoryAdvance(trajectory, 2.3);
+  std::vector<OqsAmplitude> first(oqsJumpTrajectoryGetState(trajectory),
+                                  oqsJumpTrajectoryGetState(trajectory) + 2);
+  // The step size adapted during the first run must not leak into the
+  // second one.
+  oqsJumpTrajectorySeed(trajectory, 5, 0);
+  oqsJumpTrajectoryReset(trajectory, &initialState[0], 0);
+  struct OqsTrajectoryStats stats;
+  oqsJumpTrajectoryGetStats(trajectory, &stats);
+  EXPECT_EQ(0u, stats.steps);
+  EXPECT_EQ(0u, stats.rhsCalls);
+  oqsJumpTrajectoryAdvance(trajectory, 2.3);
+  const struct OqsAmplitude* second = oqsJumpTrajectoryGetState(trajectory);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(first[i].re, second[i].re);
+    EXPECT_EQ(first[i].im, second[i].im);
+  }
+}
+
+TEST_F(ExcitedStateDecay, Checkpoint) {
+  oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_DOPRI5);
+  oqsJumpTrajectorySetTolerances(trajectory, 1.0e-10, 1.0e-10);
+  oqsJumpTrajectorySeed(trajectory, 7, 1);
+  oqsJumpTrajectoryReset(trajectory, &initialState[0], 0);
+  std::string path = ::testing::TempDir() + "oqs_trajectory.ckpt";
+  oqsJumpTrajectoryAdvance(trajectory, 0.1);
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectorySave(trajectory, path.c_str()));
+  oqsJumpTrajectoryAdvance(trajectory, 10.0);
+  double t = oqsJumpTrajectoryGetTime(trajectory);
+  std::vector<OqsAmplitude> state(oqsJumpTrajectoryGetState(trajectory),
+                                  oqsJumpTrajectoryGetState(trajectory) + 2);
+
+  OqsJumpTrajectory restarted;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(2, &restarted));
+  oqsJumpTrajectorySetSchrodingerEqn(restarted, &eqn);
+  oqsJumpTrajectorySetIntegrator(restarted, OQS_INTEGRATOR_DOPRI5);
+  oqsJumpTrajectorySetTolerances(restarted, 1.0e-10, 1.0e-10);
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryLoad(restarted, path.c_str()));
+  EXPECT_EQ(0.1, oqsJumpTrajectoryGetTime(restarted));
+  oqsJumpTrajectoryAdvance(restarted, 10.0);
+  EXPECT_EQ(t, oqsJumpTrajectoryGetTime(restarted));
+  const struct OqsAmplitude* resumed = oqsJumpTrajectoryGetState(restarted);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(state[i].re, resumed[i].re);
+    EXPECT_EQ(state[i].im, resumed[i].im);
+  }
+  oqsJumpTrajectoryDestroy(&restarted);
+  remove(path.c_str());
+}
+
+TEST_F(ExcitedStateDecay, CheckpointErrors) {
+  std::string path = ::testing::TempDir() + "oqs_trajectory_errors.ckpt";
+  remove(path.c_str());
+  EXPECT_EQ(OQS_IO_ERROR, oqsJumpTrajectoryLoad(trajectory, path.c_str()));
+
+  FILE* f = fopen(path.c_str(), "wb");
+  fputs("not a checkpoint", f);
+  fclose(f);
+  EXPECT_EQ(OQS_FORMAT_ERROR,
+            oqsJumpTrajectoryLoad(trajectory, path.c_str()));
+
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectorySave(trajectory, path.c_str()));
+  OqsJumpTrajectory other;
+  oqsJumpTrajectoryCreate(3, &other);
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsJumpTrajectoryLoad(other, path.c_str()));
+  oqsJumpTrajectoryDestroy(&other);
+  oqsJumpTrajectoryCreateWithLayout(2, OQS_LAYOUT_SPLIT, &other);
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsJumpTrajectoryLoad(other, path.c_str()));
+  oqsJumpTrajectoryDestroy(&other);
+
+  // A truncated file leaves the trajectory unchanged.
+  long size;
+  f = fopen(path.c_str(), "rb");
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  std::vector<char> bytes(size);
+  fseek(f, 0, SEEK_SET);
+  ASSERT_EQ((size_t)size, fread(&bytes[0], 1, size, f));
+  fclose(f);
+  f = fopen(path.c_str(), "wb");
+  fwrite(&bytes[0], 1, size - 1, f);
+  fclose(f);
+  oqsJumpTrajectorySetTime(trajectory, 2.0);
+  EXPECT_EQ(OQS_FORMAT_ERROR,
+            oqsJumpTrajectoryLoad(trajectory, path.c_str()));
+  EXPECT_EQ(2.0, oqsJumpTrajectoryGetTime(trajectory));
+  remove(path.c_str());
+}
+
+TEST_F(ExcitedStateDecay, JumpRecord) {
+  struct EToGCtx ctx;
+  ctx.dim = 2;
+  ctx.gamma = 1.0;
+  struct OqsDecayOperator decayOps[2];
+  for (int i = 0; i < 2; ++i) {
+    decayOps[i].apply = excitedToGroundDecay;
+    decayOps[i].ctx = &ctx;
+  }
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectoryEnableJumpRecord(trajectory, 1, 4));
+  oqsJumpTrajectorySeed(trajectory, 11, 0);
+  oqsJumpTrajectoryReset(trajectory, &initialState[0], 0);
+  std::vector<double> times;
+  std::vector<int> channels;
+  // More jumps than the initial capacity.
+  for (int k = 0; k < 100; ++k) {
+    ASSERT_NE(0, oqsJumpTrajectoryAdvance(trajectory, 1.0e3));
+    int channel = oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps);
+    oqsJumpTrajectoryApplyDecay(trajectory, decayOps + channel);
+    times.push_back(oqsJumpTrajectoryGetTime(trajectory));
+    channels.push_back(channel);
+    oqsJumpTrajectorySetState(trajectory, &initialState[0]);
+  }
+  // Not selected by oqsJumpTrajectoryGetDecay
+  oqsJumpTrajectoryApplyDecay(trajectory, decayOps);
+
+  const struct OqsJumpRecord* jumps;
+  size_t numJumps;
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectoryGetJumps(trajectory, &jumps, &numJumps));
+  ASSERT_EQ(101u, numJumps);
+  for (int k = 0; k < 100; ++k) {
+    EXPECT_EQ(times[k], jumps[k].t);
+    EXPECT_EQ(channels[k], jumps[k].channel);
+  }
+  EXPECT_EQ(-1, jumps[100].channel);
+
+  oqsJumpTrajectoryReset(trajectory, &initialState[0], 0);
+  oqsJumpTrajectoryGetJumps(trajectory, &jumps, &numJumps);
+  EXPECT_EQ(0u, numJumps);
+  oqsJumpTrajectoryEnableJumpRecord(trajectory, 0, 0);
+  oqsJumpTrajectoryAdvance(trajectory, 1.0e3);
+  oqsJumpTrajectoryApplyDecay(trajectory, decayOps);
+  oqsJumpTrajectoryGetJumps(trajectory, &jumps, &numJumps);
+  EXPECT_EQ(0u, numJumps);
+}
+
+TEST_F(ExcitedStateDecay, Stats) {
+  struct OqsDecayOperator decayOperator;
+  decayOperator.apply = excitedToGroundDecay;
+  struct EToGCtx ctx;
+  ctx.dim = 2;
+  ctx.gamma = 1.0;
+  decayOperator.ctx = &ctx;
+  oqsJumpTrajectorySetNextDecayNorm(trajectory, 0.5);
+  ASSERT_NE(0, oqsJumpTrajectoryAdvance(trajectory, 2.0));
+  oqsJumpTrajectoryApplyDecay(trajectory, &decayOperator);
+  struct OqsTrajectoryStats stats;
+  oqsJumpTrajectoryGetStats(trajectory, &stats);
+#ifdef OQS_ENABLE_STATS
+  EXPECT_EQ(1u, stats.jumps);
+  EXPECT_EQ(1u, stats.backtracks);
+  EXPECT_GT(stats.rootIterations, 0u);
+  // No timers were enabled.
+  EXPECT_EQ(0.0, stats.advanceSeconds);
+#else
+  EXPECT_EQ(0u, stats.jumps);
+  EXPECT_EQ(0u, stats.rootIterations);
+#endif
+}
+
+struct ChannelCtx {
+  int target;
+  double gamma;
+  int numApplies;
+};
+
+// sqrt(gamma) |target><1|
+static void channelApply(const struct OqsAmplitude* x, struct OqsAmplitude* y,
+                         void* ctx) {
+  struct ChannelCtx* c = (struct ChannelCtx*)ctx;
+  ++c->numApplies;
+  double sgamma = sqrt(c->gamma);
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1].re = 0;
+  y[1].im = 0;
+  y[c->target].re = sgamma * x[1].re;
+  y[c->target].im = sgamma * x[1].im;
+}
+
+static double channelExpectation(const struct OqsAmplitude* x, void* ctx) {
+  struct ChannelCtx* c = (struct ChannelCtx*)ctx;
+  return c->gamma * normSquared(x + 1);
+}
+
+TEST_F(ExcitedStateDecay, GetDecayReusesJumpedState) {
+  struct ChannelCtx ctx[2] = {{0, 1.0, 0}, {1, 3.0, 0}};
+  struct OqsDecayOperator decayOps[2];
+  for (int i = 0; i < 2; ++i) {
+    decayOps[i].apply = &channelApply;
+    decayOps[i].ctx = ctx + i;
+  }
+  int decay = oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps);
+  EXPECT_EQ(1, ctx[0].numApplies);
+  EXPECT_EQ(1, ctx[1].numApplies);
+  oqsJumpTrajectoryApplyDecay(trajectory, decayOps + decay);
+  EXPECT_EQ(1, ctx[0].numApplies);
+  EXPECT_EQ(1, ctx[1].numApplies);
+  struct OqsAmplitude* state = oqsJumpTrajectoryGetState(trajectory);
+  EXPECT_FLOAT_EQ(1.0, normSquared(state + ctx[decay].target));
+  EXPECT_FLOAT_EQ(1.0, vecNormSquared(state, 2));
+
+  // A stale selection is not reused.
+  oqsJumpTrajectorySetState(trajectory, &initialState[0]);
+  decay = oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps);
+  oqsJumpTrajectorySetState(trajectory, &initialState[0]);
+  oqsJumpTrajectoryApplyDecay(trajectory, decayOps + decay);
+  EXPECT_EQ(5, ctx[0].numApplies + ctx[1].numApplies);
+}
+
+TEST_F(ExcitedStateDecay, GetDecayExpectation) {
+  struct ChannelCtx ctx[2] = {{0, 1.0, 0}, {1, 3.0, 0}};
+  struct OqsDecayOperator decayOps[2];
+  for (int i = 0; i < 2; ++i) {
+    decayOps[i].apply = &channelApply;
+    decayOps[i].ctx = ctx + i;
+  }
+  const OqsDecayExpectation expectations[2] = {&channelExpectation,
+                                               &channelExpectation};
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectorySetDecayExpectations(
+                             trajectory, 2, expectations));
+  oqsJumpTrajectorySeed(trajectory, 7, 0);
+  int n = 4000;
+  int counts[2] = {0, 0};
+  for (int i = 0; i < n; ++i) {
+    ++counts[oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps)];
+  }
+  EXPECT_EQ(0, ctx[0].numApplies + ctx[1].numApplies);
+  double p = 0.25;
+  double sigma = sqrt(n * p * (1.0 - p));
+  EXPECT_NEAR(p * n, counts[0], 5.0 * sigma);
+  EXPECT_EQ(n, counts[0] + counts[1]);
+
+  int decay = oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps);
+  oqsJumpTrajectoryApplyDecay(trajectory, decayOps + decay);
+  EXPECT_EQ(1, ctx[0].numApplies + ctx[1].numApplies);
+  struct OqsAmplitude* state = oqsJumpTrajectoryGetState(trajectory);
+  EXPECT_FLOAT_EQ(1.0, normSquared(state + ctx[decay].target));
+
+  // The callbacks are only used for the registered number of operators.
+  oqsJumpTrajectorySetState(trajectory, &initialState[0]);
+  ctx[0].numApplies = 0;
+  ctx[1].numApplies = 0;
+  oqsJumpTrajectoryGetDecay(trajectory, 1, decayOps);
+  EXPECT_EQ(1, ctx[0].numApplies);
+  // Operators without a callback are applied.
+  const OqsDecayExpectation partial[2] = {&channelExpectation, 0};
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectorySetDecayExpectations(trajectory, 2, partial));
+  oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps);
+  EXPECT_EQ(1, ctx[0].numApplies);
+  EXPECT_EQ(1, ctx[1].numApplies);
+  EXPECT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectorySetDecayExpectations(trajectory, 0, 0));
+  oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps);
+  EXPECT_EQ(2, ctx[0].numApplies);
+  EXPECT_EQ(2, ctx[1].numApplies);
+}
+
+TEST_F(ExcitedStateDecay, SetDecayRates) {
+  struct ChannelCtx ctx[2] = {{0, 1.0, 0}, {1, 3.0, 0}};
+  struct OqsDecayOperator decayOps[2];
+  for (int i = 0; i < 2; ++i) {
+    decayOps[i].apply = &channelApply;
+    decayOps[i].ctx = ctx + i;
+  }
+  const double rates[] = {1.0, 3.0};
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectorySetDecayRates(trajectory, 2, rates));
+  oqsJumpTrajectorySeed(trajectory, 7, 0);
+  int n = 4000;
+  int counts[2] = {0, 0};
+  for (int i = 0; i < n; ++i) {
+    ++counts[oqsJumpTrajectoryGetDecay(trajectory, 2, decayOps)];
+  }
+  // The operators aren't evaluated.
+  EXPECT_EQ(0, ctx[0].numApplies + ctx[1].numApplies);
+  double p = 0.25;
+  double sigma = sqrt(n * p * (1.0 - p));
+  EXPECT_NEAR(p * n, counts[0], 5.0 * sigma);
+
+  // Calls with a different number of operators ignore the rates.
+  EXPECT_EQ(0, oqsJumpTrajectoryGetDecay(trajectory, 1, decayOps));
+  EXPECT_EQ(1, ctx[0].numApplies);
+
+  const double zeros[] = {0.0, 0.0};
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsJumpTrajectorySetDecayRates(trajectory, 2, zeros));
+  EXPECT_EQ(OQS_SUCCESS, oqsJumpTrajectorySetDecayRates(trajectory, 0, 0));
+}
+
+struct SplitCtx {
+  size_t dim;
+  double omega;
+  double gamma;
+};
+
+// Driven and damped two level system in the split layout
+static void splitRHS(double t, const struct OqsAmplitude* x,
+                     struct OqsAmplitude* y, void* ctx) {
+  struct SplitCtx* c = (struct SplitCtx*)ctx;
+  const double* xr = OQS_SPLIT_RE(x);
+  const double* xi = OQS_SPLIT_IM(x, c->dim);
+  double* yr = OQS_SPLIT_RE(y);
+  double* yi = OQS_SPLIT_IM(y, c->dim);
+  yr[0] = 0.5 * c->omega * xi[1];
+  yi[0] = -0.5 * c->omega * xr[1];
+  yr[1] = 0.5 * c->omega * xi[0] - 0.5 * c->gamma * xr[1];
+  yi[1] = -0.5 * c->omega * xr[0] - 0.5 * c->gamma * xi[1];
+}
+
+static void interleavedRHS(double t, const struct OqsAmplitude* x,
+                           struct OqsAmplitude* y, void* ctx) {
+  struct SplitCtx* c = (struct SplitCtx*)ctx;
+  y[0].re = 0.5 * c->omega * x[1].im;
+  y[0].im = -0.5 * c->omega * x[1].re;
+  y[1].re = 0.5 * c->omega * x[0].im - 0.5 * c->gamma * x[1].re;
+  y[1].im = -0.5 * c->omega * x[0].re - 0.5 * c->gamma * x[1].im;
+}
+
+static void splitDecay(const struct OqsAmplitude* x, struct OqsAmplitude* y,
+                       void* ctx) {
+  struct SplitCtx* c = (struct SplitCtx*)ctx;
+  double sgamma = sqrt(c->gamma);
+  OQS_SPLIT_RE(y)[0] = sgamma * OQS_SPLIT_RE(x)[1];
+  OQS_SPLIT_IM(y, c->dim)[0] = sgamma * OQS_SPLIT_IM(x, c->dim)[1];
+  OQS_SPLIT_RE(y)[1] = 0;
+  OQS_SPLIT_IM(y, c->dim)[1] = 0;
+}
+
+static void interleavedDecay(const struct OqsAmplitude* x,
+                             struct OqsAmplitude* y, void* ctx) {
+  struct SplitCtx* c = (struct SplitCtx*)ctx;
+  double sgamma = sqrt(c->gamma);
+  y[0].re = sgamma * x[1].re;
+  y[0].im = sgamma * x[1].im;
+  y[1].re = 0;
+  y[1].im = 0;
+}
+
+class SplitLayout : public ::testing::TestWithParam<OqsIntegratorType> {
+ public:
+  OqsJumpTrajectory split, interleaved;
+  struct SplitCtx ctx;
+  struct OqsSchrodingerEqn splitEqn, interleavedEqn;
+  struct OqsDecayOperator splitDecayOp, interleavedDecayOp;
+  void SetUp() {
+    ctx.dim = 2;
+    ctx.omega = 1.0;
+    ctx.gamma = 0.5;
+    ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreateWithLayout(
+                               2, OQS_LAYOUT_SPLIT, &split));
+    ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(2, &interleaved));
+    splitEqn.RHS = &splitRHS;
+    splitEqn.ctx = &ctx;
+    interleavedEqn.RHS = &interleavedRHS;
+    interleavedEqn.ctx = &ctx;
+    splitDecayOp.apply = &splitDecay;
+    splitDecayOp.ctx = &ctx;
+    interleavedDecayOp.apply = &interleavedDecay;
+    interleavedDecayOp.ctx = &ctx;
+    oqsJumpTrajectorySetSchrodingerEqn(split, &splitEqn);
+    oqsJumpTrajectorySetSchrodingerEqn(interleaved, &interleavedEqn);
+    oqsJumpTrajectorySetIntegrator(split, GetParam());
+    oqsJumpTrajectorySetIntegrator(interleaved, GetParam());
+    oqsJumpTrajectorySeed(split, 11, 0);
+    oqsJumpTrajectorySeed(interleaved, 11, 0);
+
+    struct OqsAmplitude initial[2] = {{0.6, 0.0}, {0.0, 0.8}};
+    std::vector<double> splitInitial(2 * OQS_SPLIT_STRIDE(2), 0.0);
+    splitInitial[0] = 0.6;
+    splitInitial[OQS_SPLIT_STRIDE(2) + 1] = 0.8;
+    // The padding of the argument may hold anything.
+    splitInitial[5] = 1.0e300;
+    oqsJumpTrajectorySetState(split, (struct OqsAmplitude*)&splitInitial[0]);
+    oqsJumpTrajectorySetState(interleaved, initial);
+  }
+  void TearDown() {
+    oqsJumpTrajectoryDestroy(&split);
+    oqsJumpTrajectoryDestroy(&interleaved);
+  }
+  void expectSameState() {
+    const double* re = oqsJumpTrajectoryGetStateRe(split);
+    const double* im = oqsJumpTrajectoryGetStateIm(split);
+    const struct OqsAmplitude* x = oqsJumpTrajectoryGetState(interleaved);
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_NEAR(x[i].re, re[i], 1.0e-12);
+      EXPECT_NEAR(x[i].im, im[i], 1.0e-12);
+    }
+    for (size_t i = 2; i < OQS_SPLIT_STRIDE(2); ++i) {
+      EXPECT_EQ(0.0, re[i]);
+      EXPECT_EQ(0.0, im[i]);
+    }
+    EXPECT_NEAR(oqsJumpTrajectoryGetTime(interleaved),
+                oqsJumpTrajectoryGetTime(split), 1.0e-12);
+  }
+};
+
+TEST_P(SplitLayout, Accessors) {
+  EXPECT_EQ(OQS_LAYOUT_SPLIT, oqsJumpTrajectoryGetLayout(split));
+  EXPECT_EQ(OQS_LAYOUT_INTERLEAVED, oqsJumpTrajectoryGetLayout(interleaved));
+  const double* re = oqsJumpTrajectoryGetStateRe(split);
+  EXPECT_EQ((const double*)oqsJumpTrajectoryGetState(split), re);
+  EXPECT_EQ(0u, (uintptr_t)re % 64);
+  EXPECT_EQ(0u, (uintptr_t)oqsJumpTrajectoryGetStateIm(split) % 64);
+  EXPECT_TRUE(0 == oqsJumpTrajectoryGetStateRe(interleaved));
+  expectSameState();
+}
+
+TEST_P(SplitLayout, AgreesWithInterleaved) {
+  for (int i = 1; i <= 20; ++i) {
+    double t = 0.25 * i;
+    int splitDecayed = oqsJumpTrajectoryAdvance(split, t);
+    int interleavedDecayed = oqsJumpTrajectoryAdvance(interleaved, t);
+    ASSERT_EQ(interleavedDecayed, splitDecayed);
+    expectSameState();
+    if (splitDecayed) {
+      oqsJumpTrajectoryApplyDecay(split, &splitDecayOp);
+      oqsJumpTrajectoryApplyDecay(interleaved, &interleavedDecayOp);
+      expectSameState();
+    }
+  }
+}
+
+TEST_P(SplitLayout, AdvanceWtd) {
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryEnableWtd(split, 0.05, 100, 2));
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectoryEnableWtd(interleaved, 0.05, 100, 2));
+  for (int i = 1; i <= 20; ++i) {
+    double t = 0.3 * i;
+    int decayed = oqsJumpTrajectoryAdvanceWtd(split, t);
+    ASSERT_EQ(oqsJumpTrajectoryAdvanceWtd(interleaved, t), decayed);
+    expectSameState();
+    if (decayed) {
+      oqsJumpTrajectoryApplyDecay(split, &splitDecayOp);
+      oqsJumpTrajectoryApplyDecay(interleaved, &interleavedDecayOp);
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Integrators, SplitLayout,
+                        ::testing::Values(OQS_INTEGRATOR_RK4,
+                                          OQS_INTEGRATOR_DOPRI5,
+                                          OQS_INTEGRATOR_KRYLOV,
+                                          OQS_INTEGRATOR_LSRK4));
+
+struct CountingAllocator {
+  int numAllocations;
+  int numLive;
+  size_t bytesLive;
+  // Allocations fail once numAllocations reaches this value.
+  int failAt;
+};
+
+static void* countingAllocate(size_t size, size_t alignment, void* ctx) {
+  CountingAllocator* counter = static_cast<CountingAllocator*>(ctx);
+  if (counter->numAllocations == counter->failAt) return 0;
+  void* p = 0;
+  if (posix_memalign(&p, alignment, size) != 0) return 0;
+  ++counter->numAllocations;
+  ++counter->numLive;
+  counter->bytesLive += size;
+  return p;
+}
+
+static void countingDeallocate(void* p, size_t size, void* ctx) {
+  CountingAllocator* counter = static_cast<CountingAllocator*>(ctx);
+  --counter->numLive;
+  counter->bytesLive -= size;
+  free(p);
+}
+
+class Allocator : public ::testing::Test {
+  public:
+    CountingAllocator counter;
+    void SetUp() {
+      counter.numAllocations = 0;
+      counter.numLive = 0;
+      counter.bytesLive = 0;
+      counter.failAt = -1;
+      struct OqsAllocator allocator = {&countingAllocate,
+                                       &countingDeallocate, &counter};
+      oqsSetAllocator(&allocator);
+    }
+    void TearDown() {
+      oqsSetAllocator(0);
+    }
+};
+
+TEST_F(Allocator, OneArenaPerObject) {
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreateWithLayout(
+                             5, OQS_LAYOUT_SPLIT, &trajectory));
+  // The trajectory with its states and its integrator.
+  EXPECT_EQ(1, counter.numLive);
+  // An integrator set later has an arena of its own.
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_DOPRI5));
+  EXPECT_EQ(2, counter.numLive);
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryEnableWtd(trajectory, 0.1, 10, 3));
+  EXPECT_EQ(3, counter.numLive);
+  oqsJumpTrajectoryDestroy(&trajectory);
+  EXPECT_EQ(0, counter.numLive);
+  EXPECT_EQ(0u, counter.bytesLive);
+}
+
+TEST_F(Allocator, AlignedStates) {
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreateWithLayout(
+                             5, OQS_LAYOUT_SPLIT, &trajectory));
+  EXPECT_EQ(0u,
+            reinterpret_cast<uintptr_t>(oqsJumpTrajectoryGetStateRe(
+                trajectory)) % 64);
+  EXPECT_EQ(0u,
+            reinterpret_cast<uintptr_t>(oqsJumpTrajectoryGetStateIm(
+                trajectory)) % 64);
+  oqsJumpTrajectoryDestroy(&trajectory);
+}
+
+TEST_F(Allocator, DefaultRestored) {
+  struct OqsAllocator allocator;
+  oqsGetAllocator(&allocator);
+  EXPECT_EQ(&counter, allocator.ctx);
+  oqsSetAllocator(0);
+  oqsGetAllocator(&allocator);
+  EXPECT_TRUE(0 == allocator.ctx);
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(5, &trajectory));
+  oqsJumpTrajectoryDestroy(&trajectory);
+  EXPECT_EQ(0, counter.numAllocations);
+}
+
+TEST_F(Allocator, CreateFailureDoesNotLeak) {
+  counter.failAt = 0;
+  OqsJumpTrajectory trajectory;
+  EXPECT_EQ(OQS_OUT_OF_MEMORY, oqsJumpTrajectoryCreate(5, &trajectory));
+  EXPECT_TRUE(0 == trajectory);
+  EXPECT_EQ(0, counter.numLive);
+  OqsJumpTrajectory trajectories[3];
+  EXPECT_EQ(OQS_OUT_OF_MEMORY,
+            oqsJumpTrajectoryCreateMany(5, OQS_LAYOUT_SPLIT, 3, trajectories));
+  EXPECT_TRUE(0 == trajectories[0]);
+  EXPECT_EQ(0, counter.numLive);
+}
+
+TEST_F(Allocator, SetIntegratorFailureKeepsIntegrator) {
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreate(2, &trajectory));
+  counter.failAt = counter.numAllocations;
+  EXPECT_EQ(OQS_OUT_OF_MEMORY,
+            oqsJumpTrajectorySetIntegrator(trajectory, OQS_INTEGRATOR_DOPRI5));
+  EXPECT_EQ(OQS_OUT_OF_MEMORY,
+            oqsJumpTrajectoryEnableWtd(trajectory, 0.1, 10, 3));
+  EXPECT_EQ(1, counter.numLive);
+  struct OqsAmplitude state[2] = {{1, 0}, {0, 0}};
+  oqsJumpTrajectorySetState(trajectory, state);
+  oqsJumpTrajectoryDestroy(&trajectory);
+  EXPECT_EQ(0, counter.numLive);
+}
+
+TEST_F(Allocator, CreateManyIsOneAllocation) {
+  std::vector<OqsJumpTrajectory> trajectories(1000);
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectoryCreateMany(5, OQS_LAYOUT_SPLIT,
+                                        trajectories.size(),
+                                        &trajectories[0]));
+  EXPECT_EQ(1, counter.numLive);
+  for (size_t i = 0; i < trajectories.size(); ++i) {
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(
+                      oqsJumpTrajectoryGetStateIm(trajectories[i])) % 64);
+  }
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsJumpTrajectoryDestroy(&trajectories[1]));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsJumpTrajectoryCreateMany(5, OQS_LAYOUT_SPLIT, 0,
+                                        &trajectories[0]));
+  oqsJumpTrajectoryDestroyMany(trajectories.size(), &trajectories[0]);
+  EXPECT_TRUE(0 == trajectories[1]);
+  EXPECT_EQ(0, counter.numLive);
+}
+
+TEST(CreateMany, AgreesWithCreate) {
+  struct SplitCtx ctx = {2, 1.0, 0.5};
+  struct OqsSchrodingerEqn eqn = {&splitRHS, &ctx};
+  OqsJumpTrajectory single, many[3];
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreateWithLayout(
+                             2, OQS_LAYOUT_SPLIT, &single));
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsJumpTrajectoryCreateMany(2, OQS_LAYOUT_SPLIT, 3, many));
+  std::vector<double> initial(2 * OQS_SPLIT_STRIDE(2), 0.0);
+  initial[0] = 0.6;
+  initial[OQS_SPLIT_STRIDE(2) + 1] = 0.8;
+  initial[5] = 1.0e300;
+  for (int i = 0; i < 4; ++i) {
+    OqsJumpTrajectory t = i < 3 ? many[i] : single;
+    oqsJumpTrajectorySetSchrodingerEqn(t, &eqn);
+    oqsJumpTrajectorySeed(t, 11, 0);
+    oqsJumpTrajectorySetState(t, (struct OqsAmplitude*)&initial[0]);
+    oqsJumpTrajectoryAdvance(t, 1.0);
+  }
+  const double* re = oqsJumpTrajectoryGetStateRe(single);
+  const double* im = oqsJumpTrajectoryGetStateIm(single);
+  for (int i = 0; i < 3; ++i) {
+    const double* r = oqsJumpTrajectoryGetStateRe(many[i]);
+    const double* m = oqsJumpTrajectoryGetStateIm(many[i]);
+    for (size_t j = 0; j < OQS_SPLIT_STRIDE(2); ++j) {
+      EXPECT_EQ(re[j], r[j]);
+      EXPECT_EQ(im[j], m[j]);
+    }
+  }
+  oqsJumpTrajectoryDestroy(&single);
+  oqsJumpTrajectoryDestroyMany(3, many);
+}
@@ -0,0 +1,224 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsMasterEqn.h>
+#include <OqsAccumulator.h>
+#include <cmath>
+#include <vector>
+
+// Two level atom driven with Rabi frequency omega that decays with rate
+// gamma from the excited state |1> to the ground state |0>.
+struct AtomCtx {
+  double omega;
+  double gamma;
+};
+
+static void atomRHS(double t, const struct OqsAmplitude* x,
+                    struct OqsAmplitude* y, void* ctx) {
+  struct AtomCtx* c = (struct AtomCtx*)ctx;
+  // -i (omega / 2 sigma_x - i gamma / 2 |1><1|) x
+  y[0].re = 0.5 * c->omega * x[1].im;
+  y[0].im = -0.5 * c->omega * x[1].re;
+  y[1].re = 0.5 * c->omega * x[0].im - 0.5 * c->gamma * x[1].re;
+  y[1].im = -0.5 * c->omega * x[0].re - 0.5 * c->gamma * x[1].im;
+}
+
+static void atomDecay(const struct OqsAmplitude* x, struct OqsAmplitude* y,
+                      void* ctx) {
+  struct AtomCtx* c = (struct AtomCtx*)ctx;
+  double sgamma = sqrt(c->gamma);
+  y[0].re = sgamma * x[1].re;
+  y[0].im = sgamma * x[1].im;
+  y[1].re = 0;
+  y[1].im = 0;
+}
+
+static void excitedStateProjector(const struct OqsAmplitude* x,
+                                  struct OqsAmplitude* y, void* ctx) {
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1] = x[1];
+}
+
+class Atom : public ::testing::TestWithParam<OqsIntegratorType> {
+ public:
+  OqsMasterEqn master;
+  struct AtomCtx ctx;
+  struct OqsSchrodingerEqn eqn;
+  struct OqsDecayOperator decayOp;
+  struct OqsObservable excited;
+  void SetUp() {
+    ctx.omega = 0.0;
+    ctx.gamma = 0.5;
+    ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnCreate(2, &master));
+    ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnSetIntegrator(master, GetParam()));
+    oqsMasterEqnTimeStepHint(master, 0.01);
+    oqsMasterEqnSetTolerances(master, 1.0e-10, 1.0e-10);
+    eqn.RHS = &atomRHS;
+    eqn.ctx = &ctx;
+    decayOp.apply = &atomDecay;
+    decayOp.ctx = &ctx;
+    excited.apply = &excitedStateProjector;
+    excited.ctx = 0;
+    oqsMasterEqnSetSchrodingerEqn(master, &eqn);
+    oqsMasterEqnSetDecayOperators(master, 1, &decayOp);
+  }
+  void TearDown() { oqsMasterEqnDestroy(&master); }
+};
+
+TEST_P(Atom, Decay) {
+  // Superposition 0.6 |0> + 0.8 i |1>
+  struct OqsAmplitude x[2] = {{0.6, 0.0}, {0.0, 0.8}};
+  ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnSetState(master, x));
+  for (int i = 1; i <= 10; ++i) {
+    double t = 0.3 * i;
+    oqsMasterEqnAdvance(master, t);
+    EXPECT_DOUBLE_EQ(t, oqsMasterEqnGetTime(master));
+    const struct OqsAmplitude* rho = oqsMasterEqnGetDensityMatrix(master);
+    double decay = exp(-ctx.gamma * t);
+    EXPECT_NEAR(1.0, oqsMasterEqnGetTrace(master), 1.0e-10);
+    EXPECT_NEAR(0.64 * decay, rho[3].re, 1.0e-7);
+    EXPECT_NEAR(0.64 * decay, oqsMasterEqnGetExpectation(master, &excited),
+                1.0e-7);
+    // The coherence <0|rho|1> = -0.48 i decays at half the rate.
+    EXPECT_NEAR(-0.48 * sqrt(decay), rho[2].im, 1.0e-7);
+    EXPECT_NEAR(rho[2].re, rho[1].re, 1.0e-12);
+    EXPECT_NEAR(-rho[2].im, rho[1].im, 1.0e-12);
+  }
+}
+
+TEST_P(Atom, SteadyState) {
+  ctx.omega = 1.0;
+  struct OqsAmplitude x[2] = {{1.0, 0.0}, {0.0, 0.0}};
+  ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnSetState(master, x));
+  oqsMasterEqnAdvance(master, 60.0);
+  double s = ctx.omega * ctx.omega;
+  double expected = 0.25 * s / (0.5 * s + 0.25 * ctx.gamma * ctx.gamma);
+  EXPECT_NEAR(expected, oqsMasterEqnGetExpectation(master, &excited),
+              1.0e-6);
+  EXPECT_NEAR(1.0, oqsMasterEqnGetTrace(master), 1.0e-10);
+}
+
+TEST_P(Atom, SampleMasterEqn) {
+  struct OqsAmplitude x[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnSetState(master, x));
+  OqsAccumulator accumulator;
+  ASSERT_EQ(OQS_SUCCESS, oqsAccumulatorCreate(2, 1, &excited, 11, 0.0, 0.2,
+                                              &accumulator));
+  oqsAccumulatorSampleMasterEqn(accumulator, master);
+  EXPECT_DOUBLE_EQ(2.0, oqsMasterEqnGetTime(master));
+  for (size_t i = 0; i < 11; ++i) {
+    double t = oqsAccumulatorGetTime(accumulator, i);
+    EXPECT_EQ(1, oqsAccumulatorGetCount(accumulator, i));
+    EXPECT_NEAR(exp(-ctx.gamma * t), oqsAccumulatorGetMean(accumulator, 0, i),
+                1.0e-7);
+  }
+  oqsAccumulatorDestroy(&accumulator);
+}
+
+INSTANTIATE_TEST_CASE_P(Integrators, Atom,
+                        ::testing::Values(OQS_INTEGRATOR_RK4,
+                                          OQS_INTEGRATOR_DOPRI5,
+                                          OQS_INTEGRATOR_KRYLOV,
+                                          OQS_INTEGRATOR_LSRK4));
+
+// Damped harmonic oscillator truncated to a dimension that isn't a
+// multiple of the tile size, with H = a^\dagger a and decay operator
+// sqrt(kappa) a.
+static const size_t oscillatorDim = 70;
+static const double kappa = 0.2;
+
+static void oscillatorRHS(double t, const struct OqsAmplitude* x,
+                          struct OqsAmplitude* y, void* ctx) {
+  for (size_t n = 0; n < oscillatorDim; ++n) {
+    // -i (n - i kappa / 2 n) x_n
+    y[n].re = n * x[n].im - 0.5 * kappa * n * x[n].re;
+    y[n].im = -(n * x[n].re) - 0.5 * kappa * n * x[n].im;
+  }
+}
+
+static void oscillatorDecay(const struct OqsAmplitude* x,
+                            struct OqsAmplitude* y, void* ctx) {
+  for (size_t n = 0; n + 1 < oscillatorDim; ++n) {
+    double a = sqrt(kappa * (n + 1));
+    y[n].re = a * x[n + 1].re;
+    y[n].im = a * x[n + 1].im;
+  }
+  y[oscillatorDim - 1].re = 0;
+  y[oscillatorDim - 1].im = 0;
+}
+
+static void numberOperator(const struct OqsAmplitude* x,
+                           struct OqsAmplitude* y, void* ctx) {
+  for (size_t n = 0; n < oscillatorDim; ++n) {
+    y[n].re = n * x[n].re;
+    y[n].im = n * x[n].im;
+  }
+}
+
+TEST(MasterEqn, Oscillator) {
+  OqsMasterEqn master;
+  ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnCreate(oscillatorDim, &master));
+  EXPECT_EQ(oscillatorDim, oqsMasterEqnGetDim(master));
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsMasterEqnSetIntegrator(master, OQS_INTEGRATOR_DOPRI5));
+  oqsMasterEqnSetTolerances(master, 1.0e-10, 1.0e-10);
+  struct OqsSchrodingerEqn eqn = {&oscillatorRHS, 0};
+  struct OqsDecayOperator decayOp = {&oscillatorDecay, 0};
+  struct OqsObservable number = {&numberOperator, 0};
+  oqsMasterEqnSetSchrodingerEqn(master, &eqn);
+  oqsMasterEqnSetDecayOperators(master, 1, &decayOp);
+  // Coherent state with mean occupation 4.
+  std::vector<OqsAmplitude> x(oscillatorDim);
+  double alpha = 2.0;
+  double c = exp(-0.5 * alpha * alpha);
+  for (size_t n = 0; n < oscillatorDim; ++n) {
+    x[n].re = c;
+    x[n].im = 0;
+    c *= alpha / sqrt(n + 1.0);
+  }
+  ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnSetState(master, &x[0]));
+  EXPECT_NEAR(4.0, oqsMasterEqnGetExpectation(master, &number), 1.0e-10);
+  oqsMasterEqnAdvance(master, 3.0);
+  EXPECT_NEAR(4.0 * exp(-kappa * 3.0),
+              oqsMasterEqnGetExpectation(master, &number), 1.0e-7);
+  EXPECT_NEAR(1.0, oqsMasterEqnGetTrace(master), 1.0e-10);
+  const struct OqsAmplitude* rho = oqsMasterEqnGetDensityMatrix(master);
+  for (size_t j = 0; j < oscillatorDim; ++j) {
+    for (size_t i = 0; i < oscillatorDim; ++i) {
+      EXPECT_NEAR(rho[j * oscillatorDim + i].re,
+                  rho[i * oscillatorDim + j].re, 1.0e-12);
+      EXPECT_NEAR(rho[j * oscillatorDim + i].im,
+                  -rho[i * oscillatorDim + j].im, 1.0e-12);
+    }
+  }
+  oqsMasterEqnDestroy(&master);
+}
+
+TEST(MasterEqn, InvalidArguments) {
+  OqsMasterEqn master;
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsMasterEqnCreate(0, &master));
+  ASSERT_EQ(OQS_SUCCESS, oqsMasterEqnCreate(2, &master));
+  struct OqsAmplitude zero[2] = {{0.0, 0.0}, {0.0, 0.0}};
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsMasterEqnSetState(master, zero));
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsMasterEqnSetDecayOperators(master, -1, 0));
+  oqsMasterEqnDestroy(&master);
+  EXPECT_TRUE(0 == master);
+}
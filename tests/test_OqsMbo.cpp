@@ -82,3 +82,50 @@ TEST_F(SchrodingerEqn, CanBeApplied) {
   EXPECT_FLOAT_EQ(-x[1].re, y[1].im);
   stat = oqsMboDestroySchrodingerEqn(&schEqn);
 }
+
+struct EffectiveSchrodingerEqn : public DecayOperator {
+  void SetUp() {
+    DecayOperator::SetUp();
+    MboProdSpace h = mboProdSpaceCreate(2);
+    mboTensorOpNull(h, &jumpOp);
+    mboTensorOpNull(h, &jumpOpAdjoint);
+    mboProdSpaceDestroy(&h);
+    MboElemOp sm = mboSigmaMinus();
+    mboTensorOpAddTo(sm, 0, jumpOp);
+    mboElemOpDestroy(&sm);
+    MboElemOp sp = mboSigmaPlus();
+    mboTensorOpAddTo(sp, 0, jumpOpAdjoint);
+    mboElemOpDestroy(&sp);
+  }
+  void TearDown() {
+    mboTensorOpDestroy(&jumpOp);
+    mboTensorOpDestroy(&jumpOpAdjoint);
+    DecayOperator::TearDown();
+  }
+  MboTensorOp jumpOp;
+  MboTensorOp jumpOpAdjoint;
+};
+
+TEST_F(EffectiveSchrodingerEqn, IncludesDecay) {
+  struct OqsSchrodingerEqn schEqn = {0};
+  struct OqsDecayOperator decayOperator = {0};
+  OQS_STATUS stat = oqsMboCreateEffectiveSchrodingerEqn(
+      op, 1, &jumpOp, &jumpOpAdjoint, &schEqn, &decayOperator);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  struct OqsAmplitude x[2] = {{2.3, 1.7}, {5.2, -1.8}};
+  struct OqsAmplitude y[2] = {{0}};
+  // -i (sigma_z - i/2 sigma_+ sigma_-) x
+  schEqn.RHS(0, x, y, schEqn.ctx);
+  EXPECT_FLOAT_EQ(-x[0].im, y[0].re);
+  EXPECT_FLOAT_EQ(x[0].re, y[0].im);
+  EXPECT_FLOAT_EQ(x[1].im - 0.5 * x[1].re, y[1].re);
+  EXPECT_FLOAT_EQ(-x[1].re - 0.5 * x[1].im, y[1].im);
+  // sigma_- x
+  decayOperator.apply(x, y, decayOperator.ctx);
+  EXPECT_FLOAT_EQ(x[1].re, y[0].re);
+  EXPECT_FLOAT_EQ(x[1].im, y[0].im);
+  EXPECT_FLOAT_EQ(0, y[1].re);
+  EXPECT_FLOAT_EQ(0, y[1].im);
+  stat = oqsMboDestroyEffectiveSchrodingerEqn(&schEqn, 1, &decayOperator);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+}
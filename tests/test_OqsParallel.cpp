@@ -0,0 +1,183 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsParallel.h>
+#include <cmath>
+#include <vector>
+
+static void ExcitedStateDecayRHS(double t, const struct OqsAmplitude* x,
+                                 struct OqsAmplitude* y, void* ctx) {
+  double gamma = *(double*)ctx;
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1].re = -0.5 * gamma * x[1].re;
+  y[1].im = -0.5 * gamma * x[1].im;
+}
+
+struct DecayTimesCtx {
+  double gamma;
+  struct OqsSchrodingerEqn eqn;
+  std::vector<double> decayTimes;
+  std::vector<int> numRuns;
+};
+
+static OQS_STATUS setupDecay(OqsJumpTrajectory trajectory, int thread,
+                             void* ctx) {
+  struct DecayTimesCtx* c = (struct DecayTimesCtx*)ctx;
+  return oqsJumpTrajectorySetSchrodingerEqn(trajectory, &c->eqn);
+}
+
+static void runDecay(OqsJumpTrajectory trajectory, size_t index, int thread,
+                     void* ctx) {
+  struct DecayTimesCtx* c = (struct DecayTimesCtx*)ctx;
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  oqsJumpTrajectoryReset(trajectory, initialState, 0.0);
+  if (oqsJumpTrajectoryAdvance(trajectory, 10.0)) {
+    c->decayTimes[index] = oqsJumpTrajectoryGetTime(trajectory);
+  } else {
+    c->decayTimes[index] = -1.0;
+  }
+  ++c->numRuns[index];
+}
+
+static void runDecayTimes(int numThreads, uint64_t seed, size_t n,
+                          std::vector<double>* decayTimes,
+                          std::vector<int>* numRuns) {
+  struct DecayTimesCtx ctx;
+  ctx.gamma = 1.0;
+  ctx.eqn.RHS = &ExcitedStateDecayRHS;
+  ctx.eqn.ctx = &ctx.gamma;
+  ctx.decayTimes.resize(n);
+  ctx.numRuns.resize(n);
+  struct OqsTrajectoryTask task;
+  task.setup = &setupDecay;
+  task.run = &runDecay;
+  task.ctx = &ctx;
+  OQS_STATUS stat = oqsRunTrajectories(2, n, numThreads, seed, &task);
+  ASSERT_EQ(OQS_SUCCESS, stat);
+  *decayTimes = ctx.decayTimes;
+  *numRuns = ctx.numRuns;
+}
+
+TEST(RunTrajectories, EveryTrajectoryRunsOnce) {
+  std::vector<double> decayTimes;
+  std::vector<int> numRuns;
+  runDecayTimes(4, 17, 103, &decayTimes, &numRuns);
+  for (size_t i = 0; i < numRuns.size(); ++i) {
+    EXPECT_EQ(1, numRuns[i]);
+  }
+}
+
+TEST(RunTrajectories, IndependentOfNumberOfThreads) {
+  std::vector<double> decayTimes1, decayTimes3;
+  std::vector<int> numRuns;
+  runDecayTimes(1, 5, 64, &decayTimes1, &numRuns);
+  runDecayTimes(3, 5, 64, &decayTimes3, &numRuns);
+  for (size_t i = 0; i < decayTimes1.size(); ++i) {
+    EXPECT_EQ(decayTimes1[i], decayTimes3[i]);
+  }
+}
+
+TEST(RunTrajectories, TrajectoriesDiffer) {
+  std::vector<double> decayTimes;
+  std::vector<int> numRuns;
+  runDecayTimes(2, 5, 2, &decayTimes, &numRuns);
+  EXPECT_NE(decayTimes[0], decayTimes[1]);
+}
+
+TEST(RunTrajectories, DefaultNumberOfThreads) {
+  std::vector<double> decayTimes;
+  std::vector<int> numRuns;
+  runDecayTimes(0, 5, 10, &decayTimes, &numRuns);
+  for (size_t i = 0; i < numRuns.size(); ++i) {
+    EXPECT_EQ(1, numRuns[i]);
+  }
+}
+
+static void excitedStateProjector(const struct OqsAmplitude* x,
+                                  struct OqsAmplitude* y, void* ctx) {
+  y[0].re = 0;
+  y[0].im = 0;
+  y[1] = x[1];
+}
+
+// |0><1|
+static void excitedToGround(const struct OqsAmplitude* x,
+                            struct OqsAmplitude* y, void* ctx) {
+  y[0] = x[1];
+  y[1].re = 0;
+  y[1].im = 0;
+}
+
+static void sampleDecay(OqsJumpTrajectory trajectory, size_t index,
+                        OqsAccumulator accumulator, void* ctx) {
+  struct DecayTimesCtx* c = (struct DecayTimesCtx*)ctx;
+  struct OqsAmplitude initialState[2] = {{0.0, 0.0}, {1.0, 0.0}};
+  struct OqsDecayOperator decay = {&excitedToGround, 0};
+  oqsJumpTrajectoryReset(trajectory, initialState, 0.0);
+  ++c->numRuns[index];
+  oqsAccumulatorSampleTrajectory(accumulator, trajectory, 1, &decay);
+}
+
+static void sampleDecays(int numThreads, size_t blockSize, size_t n,
+                         OqsAccumulator* accumulator) {
+  struct DecayTimesCtx ctx;
+  ctx.gamma = 1.0;
+  ctx.eqn.RHS = &ExcitedStateDecayRHS;
+  ctx.eqn.ctx = &ctx.gamma;
+  ctx.numRuns.resize(n);
+  struct OqsObservable projector = {&excitedStateProjector, 0};
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsAccumulatorCreate(2, 1, &projector, 21, 0.0, 0.1, accumulator));
+  struct OqsSamplingTask task;
+  task.setup = &setupDecay;
+  task.sample = &sampleDecay;
+  task.ctx = &ctx;
+  ASSERT_EQ(OQS_SUCCESS, oqsSampleTrajectories(2, n, blockSize, numThreads,
+                                               9, &task, *accumulator));
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(1, ctx.numRuns[i]);
+  }
+}
+
+TEST(SampleTrajectories, IndependentOfNumberOfThreads) {
+  OqsAccumulator serial, parallel;
+  sampleDecays(1, 7, 200, &serial);
+  sampleDecays(4, 7, 200, &parallel);
+  for (size_t t = 0; t < 21; ++t) {
+    EXPECT_EQ(200, oqsAccumulatorGetCount(serial, t));
+    EXPECT_EQ(oqsAccumulatorGetCount(serial, t),
+              oqsAccumulatorGetCount(parallel, t));
+    EXPECT_EQ(oqsAccumulatorGetMean(serial, 0, t),
+              oqsAccumulatorGetMean(parallel, 0, t));
+    EXPECT_EQ(oqsAccumulatorGetVariance(serial, 0, t),
+              oqsAccumulatorGetVariance(parallel, 0, t));
+  }
+  // Trajectories that decayed have no excited state population.
+  EXPECT_NEAR(exp(-2.0), oqsAccumulatorGetMean(serial, 0, 20), 0.1);
+  oqsAccumulatorDestroy(&serial);
+  oqsAccumulatorDestroy(&parallel);
+}
+
+TEST(SampleTrajectories, InvalidBlockSize) {
+  struct OqsSamplingTask task = {0, &sampleDecay, 0};
+  OqsAccumulator accumulator = 0;
+  EXPECT_EQ(OQS_INVALID_ARGUMENT,
+            oqsSampleTrajectories(2, 10, 0, 1, 9, &task, accumulator));
+}
@@ -0,0 +1,198 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsRecorder.h>
+#include <OqsParallel.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class Recorder : public ::testing::Test {
+  public:
+    std::string path;
+    OqsRecorder recorder;
+    OqsRecorderStream stream;
+    void SetUp() {
+      path = ::testing::TempDir() + "oqs_recorder.rec";
+      ASSERT_EQ(OQS_SUCCESS, oqsRecorderCreate(path.c_str(), 2, &recorder));
+      ASSERT_EQ(OQS_SUCCESS, oqsRecorderStreamCreate(recorder, &stream));
+    }
+    void TearDown() {
+      oqsRecorderStreamDestroy(&stream);
+      oqsRecorderDestroy(&recorder);
+      remove(path.c_str());
+    }
+    void Close() {
+      ASSERT_EQ(OQS_SUCCESS, oqsRecorderStreamDestroy(&stream));
+      ASSERT_EQ(OQS_SUCCESS, oqsRecorderDestroy(&recorder));
+    }
+};
+
+TEST_F(Recorder, RoundTrip) {
+  const int numJumps = 10000;
+  const int numSamples = 5000;
+  for (int i = 0; i < numJumps; ++i) {
+    ASSERT_EQ(OQS_SUCCESS, oqsRecorderStreamJump(stream, i, 0.5 * i, i % 3));
+    if (i < numSamples) {
+      double values[2] = {1.0 * i, -1.0 * i};
+      ASSERT_EQ(OQS_SUCCESS,
+                oqsRecorderStreamSample(stream, i, 0.25 * i, values));
+    }
+  }
+  Close();
+
+  OqsRecording recording;
+  ASSERT_EQ(OQS_SUCCESS, oqsRecordingOpen(path.c_str(), &recording));
+  EXPECT_EQ(2, oqsRecordingGetNumObservables(recording));
+  // Blocks hold 4096 records.
+  EXPECT_EQ(5u, oqsRecordingGetNumChunks(recording));
+  int nextJump = 0, nextSample = 0;
+  for (size_t c = 0; c < oqsRecordingGetNumChunks(recording); ++c) {
+    struct OqsRecordChunk chunk;
+    oqsRecordingGetChunk(recording, c, &chunk);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(chunk.times) % 64);
+    for (size_t j = 0; j < chunk.numRecords; ++j) {
+      if (chunk.kind == OQS_RECORD_JUMPS) {
+        EXPECT_EQ((uint64_t)nextJump, chunk.trajectories[j]);
+        EXPECT_EQ(0.5 * nextJump, chunk.times[j]);
+        EXPECT_EQ(nextJump % 3, chunk.channels[j]);
+        ++nextJump;
+      } else {
+        ASSERT_EQ(OQS_RECORD_SAMPLES, chunk.kind);
+        EXPECT_EQ((uint64_t)nextSample, chunk.trajectories[j]);
+        EXPECT_EQ(0.25 * nextSample, chunk.times[j]);
+        EXPECT_EQ(1.0 * nextSample, chunk.values[j]);
+        EXPECT_EQ(-1.0 * nextSample, chunk.values[chunk.numRecords + j]);
+        ++nextSample;
+      }
+    }
+  }
+  EXPECT_EQ(numJumps, nextJump);
+  EXPECT_EQ(numSamples, nextSample);
+  oqsRecordingClose(&recording);
+}
+
+TEST_F(Recorder, Flush) {
+  oqsRecorderStreamJump(stream, 3, 1.5, 0);
+  ASSERT_EQ(OQS_SUCCESS, oqsRecorderFlush(recorder));
+  OqsRecording recording;
+  ASSERT_EQ(OQS_SUCCESS, oqsRecordingOpen(path.c_str(), &recording));
+  // The jump is still held by the stream.
+  EXPECT_EQ(0u, oqsRecordingGetNumChunks(recording));
+  oqsRecordingClose(&recording);
+
+  ASSERT_EQ(OQS_SUCCESS, oqsRecorderStreamFlush(stream));
+  ASSERT_EQ(OQS_SUCCESS, oqsRecorderFlush(recorder));
+  ASSERT_EQ(OQS_SUCCESS, oqsRecordingOpen(path.c_str(), &recording));
+  ASSERT_EQ(1u, oqsRecordingGetNumChunks(recording));
+  struct OqsRecordChunk chunk;
+  oqsRecordingGetChunk(recording, 0, &chunk);
+  EXPECT_EQ(OQS_RECORD_JUMPS, chunk.kind);
+  EXPECT_EQ(1u, chunk.numRecords);
+  EXPECT_EQ(3u, chunk.trajectories[0]);
+  EXPECT_TRUE(0 == chunk.values);
+  oqsRecordingClose(&recording);
+}
+
+TEST_F(Recorder, TruncatedChunkIgnored) {
+  for (int i = 0; i < 5000; ++i) {
+    oqsRecorderStreamJump(stream, i, i, 0);
+  }
+  Close();
+  FILE* f = fopen(path.c_str(), "rb");
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  std::vector<char> bytes(size);
+  fseek(f, 0, SEEK_SET);
+  ASSERT_EQ((size_t)size, fread(&bytes[0], 1, size, f));
+  fclose(f);
+  f = fopen(path.c_str(), "wb");
+  fwrite(&bytes[0], 1, size - 100, f);
+  fclose(f);
+
+  OqsRecording recording;
+  ASSERT_EQ(OQS_SUCCESS, oqsRecordingOpen(path.c_str(), &recording));
+  ASSERT_EQ(1u, oqsRecordingGetNumChunks(recording));
+  struct OqsRecordChunk chunk;
+  oqsRecordingGetChunk(recording, 0, &chunk);
+  EXPECT_EQ(4096u, chunk.numRecords);
+  oqsRecordingClose(&recording);
+}
+
+TEST_F(Recorder, OpenErrors) {
+  OqsRecording recording;
+  std::string missing = ::testing::TempDir() + "oqs_missing.rec";
+  remove(missing.c_str());
+  EXPECT_EQ(OQS_IO_ERROR, oqsRecordingOpen(missing.c_str(), &recording));
+  FILE* f = fopen(missing.c_str(), "wb");
+  for (int i = 0; i < 10; ++i) fputs("not a recording", f);
+  fclose(f);
+  EXPECT_EQ(OQS_FORMAT_ERROR, oqsRecordingOpen(missing.c_str(), &recording));
+  EXPECT_TRUE(0 == recording);
+  remove(missing.c_str());
+}
+
+struct ThreadedRecording {
+  OqsRecorder recorder;
+  OqsRecorderStream streams[4];
+};
+
+static OQS_STATUS openStream(OqsJumpTrajectory trajectory, int thread,
+                             void* ctx) {
+  ThreadedRecording* r = static_cast<ThreadedRecording*>(ctx);
+  return oqsRecorderStreamCreate(r->recorder, r->streams + thread);
+}
+
+static void recordJumps(OqsJumpTrajectory trajectory, size_t index,
+                        int thread, void* ctx) {
+  ThreadedRecording* r = static_cast<ThreadedRecording*>(ctx);
+  for (int k = 0; k < 3; ++k) {
+    oqsRecorderStreamJump(r->streams[thread], index, k, k);
+  }
+}
+
+TEST(RecorderThreads, OneStreamPerThread) {
+  std::string path = ::testing::TempDir() + "oqs_recorder_threads.rec";
+  ThreadedRecording r;
+  ASSERT_EQ(OQS_SUCCESS, oqsRecorderCreate(path.c_str(), 0, &r.recorder));
+  for (int i = 0; i < 4; ++i) r.streams[i] = 0;
+  struct OqsTrajectoryTask task = {&openStream, &recordJumps, &r};
+  const size_t numTrajectories = 5000;
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsRunTrajectories(2, numTrajectories, 4, 1, &task));
+  for (int i = 0; i < 4; ++i) oqsRecorderStreamDestroy(r.streams + i);
+  ASSERT_EQ(OQS_SUCCESS, oqsRecorderDestroy(&r.recorder));
+
+  OqsRecording recording;
+  ASSERT_EQ(OQS_SUCCESS, oqsRecordingOpen(path.c_str(), &recording));
+  std::vector<int> counts(numTrajectories, 0);
+  for (size_t c = 0; c < oqsRecordingGetNumChunks(recording); ++c) {
+    struct OqsRecordChunk chunk;
+    oqsRecordingGetChunk(recording, c, &chunk);
+    for (size_t j = 0; j < chunk.numRecords; ++j) {
+      ASSERT_LT(chunk.trajectories[j], numTrajectories);
+      ++counts[chunk.trajectories[j]];
+    }
+  }
+  for (size_t i = 0; i < numTrajectories; ++i) {
+    EXPECT_EQ(3, counts[i]);
+  }
+  oqsRecordingClose(&recording);
+  remove(path.c_str());
+}
@@ -0,0 +1,93 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsRng.h>
+
+TEST(Philox, KnownAnswerZero) {
+  uint32_t counter[4] = {0, 0, 0, 0};
+  uint32_t key[2] = {0, 0};
+  uint32_t output[4];
+  oqsPhilox4x32(counter, key, output);
+  EXPECT_EQ(0x6627e8d5u, output[0]);
+  EXPECT_EQ(0xe169c58du, output[1]);
+  EXPECT_EQ(0xbc57ac4cu, output[2]);
+  EXPECT_EQ(0x9b00dbd8u, output[3]);
+}
+
+TEST(Philox, KnownAnswerPi) {
+  uint32_t counter[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+  uint32_t key[2] = {0xa4093822, 0x299f31d0};
+  uint32_t output[4];
+  oqsPhilox4x32(counter, key, output);
+  EXPECT_EQ(0xd16cfe09u, output[0]);
+  EXPECT_EQ(0x94fdccebu, output[1]);
+  EXPECT_EQ(0x5001e420u, output[2]);
+  EXPECT_EQ(0x24126ea1u, output[3]);
+}
+
+TEST(Philox, UniformRange) {
+  struct OqsPhilox rng;
+  oqsPhiloxInit(&rng, 42, 7);
+  double mean = 0;
+  int n = 10000;
+  for (int i = 0; i < n; ++i) {
+    double u = oqsPhiloxUniform(&rng);
+    EXPECT_LE(0.0, u);
+    EXPECT_GT(1.0, u);
+    mean += u;
+  }
+  EXPECT_NEAR(0.5, mean / n, 0.02);
+}
+
+TEST(Philox, Replay) {
+  struct OqsPhilox rng1, rng2;
+  oqsPhiloxInit(&rng1, 3, 11);
+  oqsPhiloxInit(&rng2, 3, 11);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(oqsPhiloxUniform(&rng1), oqsPhiloxUniform(&rng2));
+  }
+}
+
+TEST(Philox, StreamsDiffer) {
+  struct OqsPhilox rng1, rng2;
+  oqsPhiloxInit(&rng1, 3, 11);
+  oqsPhiloxInit(&rng2, 3, 12);
+  EXPECT_NE(oqsPhiloxUniform(&rng1), oqsPhiloxUniform(&rng2));
+}
+
+TEST(Philox, SetPosition) {
+  struct OqsPhilox rng;
+  oqsPhiloxInit(&rng, 5, 1);
+  double u[7];
+  for (int i = 0; i < 7; ++i) {
+    u[i] = oqsPhiloxUniform(&rng);
+  }
+  oqsPhiloxSetPosition(&rng, 5);
+  EXPECT_EQ(u[5], oqsPhiloxUniform(&rng));
+  EXPECT_EQ(u[6], oqsPhiloxUniform(&rng));
+  oqsPhiloxSetPosition(&rng, 2);
+  EXPECT_EQ(u[2], oqsPhiloxUniform(&rng));
+}
+
+TEST(Philox, ReserveStreams) {
+  uint64_t first = oqsPhiloxReserveStreams(3);
+  EXPECT_EQ(first + 3, oqsPhiloxReserveStreams(1));
+  EXPECT_EQ(first + 4, oqsPhiloxReserveStreams(0));
+  EXPECT_EQ(first + 4, oqsPhiloxReserveStreams(1));
+}
@@ -0,0 +1,121 @@
+/*
+Copyright 2014 Dominic Meiser
+
+This file is part of oqs.
+
+oqs is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+oqs is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License along
+with oqs.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <gtest/gtest.h>
+#include <OqsTrajectoryPool.h>
+
+class TrajectoryPool : public ::testing::Test {
+  public:
+    OqsTrajectoryPool pool;
+    void SetUp() {
+      ASSERT_EQ(OQS_SUCCESS, oqsTrajectoryPoolCreate(&pool));
+    }
+    void TearDown() {
+      oqsTrajectoryPoolDestroy(&pool);
+    }
+};
+
+TEST_F(TrajectoryPool, Create) {
+  EXPECT_TRUE(0 != pool);
+  EXPECT_EQ(0, oqsTrajectoryPoolGetNumIdle(pool));
+}
+
+TEST_F(TrajectoryPool, AcquireCreates) {
+  OqsJumpTrajectory trajectory;
+  ASSERT_EQ(OQS_SUCCESS, oqsTrajectoryPoolAcquire(
+                             pool, 3, OQS_LAYOUT_INTERLEAVED, &trajectory));
+  EXPECT_EQ(3u, oqsJumpTrajectoryGetDim(trajectory));
+  EXPECT_EQ(OQS_LAYOUT_INTERLEAVED, oqsJumpTrajectoryGetLayout(trajectory));
+  ASSERT_EQ(OQS_SUCCESS, oqsTrajectoryPoolRelease(pool, &trajectory));
+  EXPECT_TRUE(0 == trajectory);
+  EXPECT_EQ(1, oqsTrajectoryPoolGetNumIdle(pool));
+}
+
+TEST_F(TrajectoryPool, Reuse) {
+  OqsJumpTrajectory first, second;
+  oqsTrajectoryPoolAcquire(pool, 3, OQS_LAYOUT_INTERLEAVED, &first);
+  OqsJumpTrajectory released = first;
+  oqsTrajectoryPoolRelease(pool, &first);
+  oqsTrajectoryPoolAcquire(pool, 3, OQS_LAYOUT_INTERLEAVED, &second);
+  EXPECT_EQ(released, second);
+  EXPECT_EQ(0, oqsTrajectoryPoolGetNumIdle(pool));
+  oqsTrajectoryPoolRelease(pool, &second);
+}
+
+TEST_F(TrajectoryPool, KeyedByDimAndLayout) {
+  OqsJumpTrajectory a, b, c;
+  oqsTrajectoryPoolAcquire(pool, 3, OQS_LAYOUT_INTERLEAVED, &a);
+  oqsTrajectoryPoolAcquire(pool, 4, OQS_LAYOUT_INTERLEAVED, &b);
+  oqsTrajectoryPoolAcquire(pool, 3, OQS_LAYOUT_SPLIT, &c);
+  OqsJumpTrajectory a0 = a, b0 = b, c0 = c;
+  oqsTrajectoryPoolRelease(pool, &a);
+  oqsTrajectoryPoolRelease(pool, &b);
+  oqsTrajectoryPoolRelease(pool, &c);
+  EXPECT_EQ(3, oqsTrajectoryPoolGetNumIdle(pool));
+  oqsTrajectoryPoolAcquire(pool, 4, OQS_LAYOUT_INTERLEAVED, &b);
+  EXPECT_EQ(b0, b);
+  oqsTrajectoryPoolAcquire(pool, 3, OQS_LAYOUT_INTERLEAVED, &a);
+  EXPECT_EQ(a0, a);
+  oqsTrajectoryPoolAcquire(pool, 3, OQS_LAYOUT_SPLIT, &c);
+  EXPECT_EQ(c0, c);
+  EXPECT_EQ(0, oqsTrajectoryPoolGetNumIdle(pool));
+  oqsTrajectoryPoolRelease(pool, &a);
+  oqsTrajectoryPoolRelease(pool, &b);
+  oqsTrajectoryPoolRelease(pool, &c);
+}
+
+TEST_F(TrajectoryPool, MostRecentFirst) {
+  OqsJumpTrajectory a, b;
+  oqsTrajectoryPoolAcquire(pool, 2, OQS_LAYOUT_INTERLEAVED, &a);
+  oqsTrajectoryPoolAcquire(pool, 2, OQS_LAYOUT_INTERLEAVED, &b);
+  OqsJumpTrajectory b0 = b;
+  oqsTrajectoryPoolRelease(pool, &a);
+  oqsTrajectoryPoolRelease(pool, &b);
+  oqsTrajectoryPoolAcquire(pool, 2, OQS_LAYOUT_INTERLEAVED, &a);
+  EXPECT_EQ(b0, a);
+  oqsTrajectoryPoolRelease(pool, &a);
+}
+
+TEST_F(TrajectoryPool, Reserve) {
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsTrajectoryPoolReserve(pool, 2, OQS_LAYOUT_INTERLEAVED, 4));
+  EXPECT_EQ(4, oqsTrajectoryPoolGetNumIdle(pool));
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsTrajectoryPoolReserve(pool, 2, OQS_LAYOUT_INTERLEAVED, 3));
+  EXPECT_EQ(4, oqsTrajectoryPoolGetNumIdle(pool));
+  ASSERT_EQ(OQS_SUCCESS,
+            oqsTrajectoryPoolReserve(pool, 5, OQS_LAYOUT_INTERLEAVED, 2));
+  EXPECT_EQ(6, oqsTrajectoryPoolGetNumIdle(pool));
+}
+
+TEST_F(TrajectoryPool, ReleaseNull) {
+  OqsJumpTrajectory trajectory = 0;
+  EXPECT_EQ(OQS_SUCCESS, oqsTrajectoryPoolRelease(pool, &trajectory));
+  EXPECT_EQ(0, oqsTrajectoryPoolGetNumIdle(pool));
+}
+
+TEST_F(TrajectoryPool, ReleaseSharedFails) {
+  OqsJumpTrajectory trajectories[2];
+  ASSERT_EQ(OQS_SUCCESS, oqsJumpTrajectoryCreateMany(
+                             3, OQS_LAYOUT_INTERLEAVED, 2, trajectories));
+  OqsJumpTrajectory trajectory = trajectories[1];
+  EXPECT_EQ(OQS_INVALID_ARGUMENT, oqsTrajectoryPoolRelease(pool, &trajectory));
+  EXPECT_EQ(trajectories[1], trajectory);
+  EXPECT_EQ(0, oqsTrajectoryPoolGetNumIdle(pool));
+  oqsJumpTrajectoryDestroyMany(2, trajectories);
+}